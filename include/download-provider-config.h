@@ -15,9 +15,17 @@
 #define DOWNLOAD_PROVIDER_DOWNLOADING_DB_NAME DATABASE_DIR"/"DATABASE_NAME
 
 #define MAX_CLIENT 64		// Backgound Daemon should has the limitation of resource.
+#define DOWNLOAD_PROVIDER_MAX_RETRY_COUNT 10	// automatic retries for a request in all its life.
+#define DOWNLOAD_PROVIDER_LOW_SPEED_LIMIT 1024	// bytes per second
+#define DOWNLOAD_PROVIDER_LOW_SPEED_TIME 30	// second
+#define DOWNLOAD_PROVIDER_DROP_CACHE_SIZE 64	// MB
 
 #define DOWNLOAD_PROVIDER_REQUESTID_LEN 20
 
+// RETRY_WAITING is between FINISHED and STOPPED.
+#define IS_FINISHED_STATE(state) ((state) == DOWNLOAD_STATE_FINISHED \
+	|| (state) == DOWNLOAD_STATE_STOPPED || (state) == DOWNLOAD_STATE_FAILED)
+
 #define DOWNLOAD_PROVIDER_HISTORY_DB_LIMIT_ROWS 1000
 
 typedef struct {
@@ -38,6 +46,10 @@ typedef struct {
 	downloading_state_info *downloadinginfo;
 	download_content_info *downloadinfo;
 	char *tmp_saved_path;
+	char *etag;	// validators of the content. saved in history
+	char *digest;	// hex digest of the content. saved in history
+	char *last_modified;
+	int retrycount;	// automatic retries which the agent used
 	download_states state;
 	download_error err;
 } download_clientinfo;
@@ -16,8 +16,17 @@ typedef struct {
 	char *mimetype;
 	char *etag;
 	char *saved_path;
+	char *mirrors;	// mirror urls, separated by new line
 } download_dbinfo;
 
+// validators of the content which is downloaded before.
+typedef struct {
+	char *etag;
+	char *last_modified;
+	unsigned int content_size;
+	char *file_path;
+} download_validator_info;
+
 typedef struct {
 	unsigned int count;
 	download_dbinfo *item;
@@ -51,5 +60,8 @@ int download_provider_db_history_new(download_clientinfo *clientinfo);
 int download_provider_db_history_remove(int uniqueid);
 int download_provider_db_history_limit_rows();
 download_dbinfo *download_provider_db_history_get_info(int requestid);
+download_validator_info *download_provider_db_history_get_validator(char *url,
+								char *packagename);
+void download_provider_db_validator_free(download_validator_info *info);
 
 #endif
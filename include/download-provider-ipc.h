@@ -9,5 +9,8 @@ int ipc_send_downloadinfo(download_clientinfo *clientinfo);
 int ipc_send_downloadinginfo(download_clientinfo *clientinfo);
 int ipc_send_request_stateinfo(download_clientinfo *clientinfo);
 int ipc_receive_request_msg(download_clientinfo *clientinfo);
+int ipc_receive_request_option_msg(download_clientinfo *clientinfo);
+int ipc_receive_max_downloads(int fd);
+int ipc_receive_rate_limit(int fd, download_rate_limit_info *ratelimitinfo);
 
 #endif
@@ -1,6 +1,8 @@
 #ifndef DOWNLOAD_PROVIDER_H
 #define DOWNLOAD_PROVIDER_H
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -11,6 +13,8 @@ extern "C" {
 #define DP_MAX_STR_LEN 256
 #define DP_MAX_PATH_LEN DP_MAX_STR_LEN
 #define DP_MAX_URL_LEN 2048
+// bigger download_request_option_info is not accepted.
+#define DP_MAX_OPTION_INFO_LEN 4096
 
 	typedef enum {
 		DOWNLOAD_CONTROL_START = 1,
@@ -20,7 +24,12 @@ extern "C" {
 		DOWNLOAD_CONTROL_GET_DOWNLOADING_INFO = 11,
 		DOWNLOAD_CONTROL_GET_STATE_INFO = 13,
 		DOWNLOAD_CONTROL_GET_DOWNLOAD_INFO = 14,
-		DOWNLOAD_CONTROL_GET_REQUEST_STATE_INFO = 15
+		DOWNLOAD_CONTROL_GET_REQUEST_STATE_INFO = 15,
+		DOWNLOAD_CONTROL_SET_MAX_DOWNLOADS = 16,
+		DOWNLOAD_CONTROL_SET_RATE_LIMIT = 17,
+		// same with START, and download_request_option_info follows
+		// the request info.
+		DOWNLOAD_CONTROL_START_WITH_OPTIONS = 18
 	} download_controls;
 
 	typedef enum {
@@ -32,10 +41,20 @@ extern "C" {
 		DOWNLOAD_STATE_DOWNLOADING = 5,
 		DOWNLOAD_STATE_INSTALLING = 6,
 		DOWNLOAD_STATE_FINISHED = 7,
+		// paused by error, and will be resumed automatically.
+		// the client which does not send the options sees it as PAUSED.
+		DOWNLOAD_STATE_RETRY_WAITING = 8,
 		DOWNLOAD_STATE_STOPPED = 10,
 		DOWNLOAD_STATE_FAILED = 11
 	} download_states;
 
+	// when the downloaded file is synced to the storage.
+	typedef enum {
+		DOWNLOAD_DURABILITY_DEFAULT = 0,	// on completion
+		DOWNLOAD_DURABILITY_NONE = 1,
+		DOWNLOAD_DURABILITY_PERIODIC = 2
+	} download_durability;
+
 	typedef enum {
 		DOWNLOAD_ERROR_NONE = 0,
 		DOWNLOAD_ERROR_INVALID_PARAMETER = 1,
@@ -51,6 +70,7 @@ extern "C" {
 		DOWNLOAD_ERROR_INVALID_DESTINATION = 11,
 		DOWNLOAD_ERROR_TOO_MANY_DOWNLOADS = 12,
 		DOWNLOAD_ERROR_ALREADY_COMPLETED = 13,
+		DOWNLOAD_ERROR_DIGEST_MISMATCH = 14,
 		DOWNLOAD_ERROR_INSTALL_FAIL = 20,
 		DOWNLOAD_ERROR_FAIL_INIT_AGENT = 100,
 		DOWNLOAD_ERROR_UNKOWN = 900
@@ -77,6 +97,12 @@ extern "C" {
 	typedef struct {
 		unsigned int received_size;
 		char saved_path[DP_MAX_PATH_LEN];
+		// sent only to the client which sent download_request_option_info.
+		// older clients read the fields above only.
+		unsigned int stall_count; // transfers aborted by low speed limit
+		// hex digest of the content. set with the last one when
+		// the digest option is requested.
+		char digest[DP_MAX_STR_LEN];
 	} downloading_state_info;
 
 	typedef struct {
@@ -90,6 +116,30 @@ extern "C" {
 		char content_name[DP_MAX_STR_LEN];
 	} download_content_info;
 
+	// options which are added after the first release.
+	// they are not a part of download_request_info on the socket, so that
+	// the clients built with older header keep working. the client sends
+	// this after download_request_info with DOWNLOAD_CONTROL_START_WITH_OPTIONS.
+	// new fields should be appended only. provider reads the fields up to
+	// "size", and the fields which are not sent are 0.
+	typedef struct {
+		unsigned int size; // sizeof(download_request_option_info) of client
+		download_flexible_double_string mirrors; // same content as url
+		// "<algorithm>:<hex>". md5, sha1 or sha256.
+		// "<algorithm>" only to get the digest without verification.
+		download_flexible_string digest;
+		// abort and retry the transfer which is slower than
+		// low_speed_limit bytes/sec for low_speed_time sec. 0 is default.
+		unsigned int low_speed_limit;
+		unsigned int low_speed_time;
+		download_durability durability;
+		// pages of the file over drop_cache_size MB are dropped from
+		// the page cache. 0 is default, negative keeps them.
+		int drop_cache_size;
+	} download_request_option_info;
+
+	// the fields up to "options" are the message on the socket.
+	// DO NOT change them. it breaks the ABI with the clients.
 	typedef struct {
 		callback_info callbackinfo;
 		unsigned int notification;
@@ -100,13 +150,33 @@ extern "C" {
 		download_flexible_string filename;
 		download_flexible_string service_data;
 		download_flexible_double_string headers;
+		// not on the socket as a part of this. size is 0 if not sent.
+		download_request_option_info options;
 	} download_request_info;
 
+// length of the messages which the clients built with first header use.
+// the fields of first download_request_option_info should be sent.
+#define DP_MIN_OPTION_INFO_LEN \
+	(offsetof(download_request_option_info, drop_cache_size) + sizeof(int))
+#define DP_REQUEST_INFO_MSG_LEN offsetof(download_request_info, options)
+#define DP_DOWNLOADING_INFO_MSG_LEN offsetof(downloading_state_info, stall_count)
+
 	typedef struct {
 		download_state_info stateinfo;
 		int requestid;
 	} download_request_state_info;
 
+	typedef enum {
+		DOWNLOAD_RATE_LIMIT_GLOBAL = 0,
+		DOWNLOAD_RATE_LIMIT_REQUEST = 1, // requestid of requestinfo
+		DOWNLOAD_RATE_LIMIT_PACKAGE = 2 // client_packagename of requestinfo
+	} download_rate_limit_scope;
+
+	typedef struct {
+		download_rate_limit_scope scope;
+		unsigned int bytes_per_sec; // 0 means unlimited
+	} download_rate_limit_info;
+
 #ifdef __cplusplus
 }
 #endif
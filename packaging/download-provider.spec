@@ -55,9 +55,15 @@ mkdir -p /opt/dbspace/
 if [ ! -f /opt/dbspace/.download-provider.db ];
 then
     sqlite3 /opt/dbspace/.download-provider.db 'PRAGMA journal_mode=PERSIST;
-    CREATE TABLE downloading (id INTEGER PRIMARY KEY AUTOINCREMENT, uniqueid INTEGER UNIQUE, packagename TEXT, notification INTEGER, installpath TEXT, filename TEXT, creationdate TEXT, retrycount INTEGER, state INTEGER, url TEXT, mimetype TEXT, etag TEXT, savedpath TEXT);'
+    CREATE TABLE downloading (id INTEGER PRIMARY KEY AUTOINCREMENT, uniqueid INTEGER UNIQUE, packagename TEXT, notification INTEGER, installpath TEXT, filename TEXT, creationdate TEXT, retrycount INTEGER, state INTEGER, url TEXT, mimetype TEXT, etag TEXT, savedpath TEXT, mirrors TEXT);'
     sqlite3 /opt/dbspace/.download-provider.db 'PRAGMA journal_mode=PERSIST;
-    CREATE TABLE history (id INTEGER PRIMARY KEY AUTOINCREMENT, uniqueid INTEGER UNIQUE, packagename TEXT, filename TEXT, creationdate TEXT, state INTEGER, mimetype TEXT, savedpath TEXT);'
+    CREATE TABLE history (id INTEGER PRIMARY KEY AUTOINCREMENT, uniqueid INTEGER UNIQUE, packagename TEXT, filename TEXT, creationdate TEXT, state INTEGER, mimetype TEXT, savedpath TEXT, url TEXT, etag TEXT, lastmodified TEXT, contentsize INTEGER, filepath TEXT, digest TEXT);'
+else
+    for column in 'url TEXT' 'etag TEXT' 'lastmodified TEXT' 'contentsize INTEGER' 'filepath TEXT' 'digest TEXT';
+    do
+        sqlite3 /opt/dbspace/.download-provider.db "ALTER TABLE history ADD COLUMN $column;" 2>/dev/null || true
+    done
+    sqlite3 /opt/dbspace/.download-provider.db "ALTER TABLE downloading ADD COLUMN mirrors TEXT;" 2>/dev/null || true
 fi
 
 %files
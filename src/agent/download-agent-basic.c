@@ -34,6 +34,10 @@
 #include "download-agent-dl-mgr.h"
 #include "download-agent-installation.h"
 #include "download-agent-pthread.h"
+#include "download-agent-http-rate.h"
+#include "download-agent-http-mirror.h"
+#include "download-agent-digest.h"
+#include "download-agent-disk-writer.h"
 
 static void* __thread_start_download(void* data);
 void __thread_clean_up_handler_for_start_download(void *arg);
@@ -60,6 +64,20 @@ da_result_t start_download_with_extension(
 	const char *install_path = DA_NULL;
 	const char *file_name = DA_NULL;
 	int request_header_count = 0;
+	int segment_count = 0;
+	const char *rate_group = DA_NULL;
+	int retry_budget = DA_DEFAULT_RETRY_BUDGET;
+	const char *validated_path = DA_NULL;
+	const char **mirror_url = DA_NULL;
+	int mirror_url_count = 0;
+	int low_speed_limit = DA_DEFAULT_LOW_SPEED_LIMIT;
+	int low_speed_time = DA_DEFAULT_LOW_SPEED_TIME;
+	int queue_high_watermark = Q_DEFAULT_HIGH_WATERMARK;
+	int queue_low_watermark = Q_DEFAULT_LOW_WATERMARK;
+	int durability = DA_DURABILITY_ON_COMPLETE;
+	int drop_cache_size = DA_DEFAULT_DROP_CACHE_SIZE;
+	const char *digest_algorithm = DA_NULL;
+	const char *digest_expected = DA_NULL;
 	void *user_data = DA_NULL;
 	client_input_t *client_input = DA_NULL;
 	client_input_basic_t *client_input_basic = DA_NULL;
@@ -75,12 +93,53 @@ da_result_t start_download_with_extension(
 		install_path = extension_data->install_path;
 		file_name = extension_data->file_name;
 		user_data = extension_data->user_data;
+		if (extension_data->segment_count)
+			segment_count = *(extension_data->segment_count);
+		rate_group = extension_data->rate_group;
+		if (extension_data->retry_budget)
+			retry_budget = *(extension_data->retry_budget);
+		validated_path = extension_data->validated_path;
+		mirror_url = extension_data->mirror_url;
+		if (extension_data->mirror_url_count)
+			mirror_url_count = *(extension_data->mirror_url_count);
+		if (extension_data->low_speed_limit)
+			low_speed_limit = *(extension_data->low_speed_limit);
+		if (extension_data->low_speed_time)
+			low_speed_time = *(extension_data->low_speed_time);
+		if (extension_data->queue_high_watermark)
+			queue_high_watermark = *(extension_data->queue_high_watermark);
+		if (extension_data->queue_low_watermark)
+			queue_low_watermark = *(extension_data->queue_low_watermark);
+		digest_algorithm = extension_data->digest_algorithm;
+		digest_expected = extension_data->digest_expected;
+		if (extension_data->durability)
+			durability = *(extension_data->durability);
+		if (extension_data->drop_cache_size)
+			drop_cache_size = *(extension_data->drop_cache_size);
+	}
+
+	if (durability < DA_DURABILITY_NONE || durability >= DA_DURABILITY_MAX) {
+		DA_LOG_ERR(Default, "unknown durability [%d]", durability);
+		return DA_ERR_INVALID_ARGUMENT;
+	}
+
+	/* Empty algorithm means that there is no digest to make */
+	if (digest_algorithm && *digest_algorithm &&
+			DA_FALSE == digest_is_supported(digest_algorithm)) {
+		DA_LOG_ERR(Default, "unknown digest [%s]", digest_algorithm);
+		return DA_ERR_INVALID_ARGUMENT;
 	}
 
 	ret = get_available_download_id(&download_id);
 	if (DA_RESULT_OK != ret)
 		return ret;
 
+	if (rate_group) {
+		ret = rate_set_download_group(download_id, rate_group);
+		if (DA_RESULT_OK != ret)
+			goto ERR;
+	}
+
 	*dl_req_id = GET_DL_REQ_ID(download_id);
 
 	client_input = (client_input_t *)calloc(1, sizeof(client_input_t));
@@ -130,6 +189,41 @@ da_result_t start_download_with_extension(
 			}
 			client_input_basic->user_request_header_count = request_header_count;
 		}
+		client_input_basic->segment_count = segment_count;
+		client_input_basic->retry_budget = retry_budget;
+		client_input_basic->low_speed_limit = low_speed_limit;
+		client_input_basic->low_speed_time = low_speed_time;
+		client_input_basic->queue_high_watermark = queue_high_watermark;
+		client_input_basic->queue_low_watermark = queue_low_watermark;
+		client_input_basic->durability = durability;
+		client_input_basic->drop_cache_size = drop_cache_size;
+		/* Empty path means that there is no file to validate */
+		if (validated_path && *validated_path)
+			client_input_basic->validated_path = strdup(validated_path);
+		if (digest_algorithm && *digest_algorithm) {
+			client_input_basic->digest_algorithm = strdup(digest_algorithm);
+			if (digest_expected && *digest_expected)
+				client_input_basic->digest_expected = strdup(digest_expected);
+		}
+		if (mirror_url && mirror_url_count > 0) {
+			int i = 0;
+			if (mirror_url_count > DA_MAX_MIRROR_COUNT)
+				mirror_url_count = DA_MAX_MIRROR_COUNT;
+			client_input_basic->mirror_url =
+				(char **)calloc(mirror_url_count, sizeof(char *));
+			if(DA_NULL == client_input_basic->mirror_url) {
+				DA_LOG_ERR(Default, "DA_ERR_FAIL_TO_MEMALLOC");
+				ret = DA_ERR_FAIL_TO_MEMALLOC;
+				goto ERR;
+			}
+			for (i = 0; i < mirror_url_count; i++) {
+				if (!mirror_url[i] || !*mirror_url[i])
+					continue;
+				client_input_basic->mirror_url[
+					client_input_basic->mirror_url_count++] =
+						strdup(mirror_url[i]);
+			}
+		}
 	}
 
 	thread_info = (download_thread_input *)calloc(1, sizeof(download_thread_input));
@@ -151,6 +245,9 @@ da_result_t start_download_with_extension(
 		goto ERR;
 	}
 
+	/* The control thread of download blocks on its queue, so the number of
+	 * threads grows with the number of active downloads. Only transport is
+	 * shared, on the loop thread of libsoup plugin. */
 	if (pthread_create(&GET_DL_THREAD_ID(download_id), &thread_attr,
 			__thread_start_download, thread_info) < 0) {
 		DA_LOG_ERR(Thread, "making thread failed..");
@@ -225,6 +322,26 @@ da_result_t __make_source_info_basic_download(
 		client_input_basic->user_request_header = DA_NULL;
 		client_input_basic->user_request_header_count = 0;
 	}
+	source_info_basic->segment_count = client_input_basic->segment_count;
+	source_info_basic->retry_budget = client_input_basic->retry_budget;
+	source_info_basic->low_speed_limit = client_input_basic->low_speed_limit;
+	source_info_basic->low_speed_time = client_input_basic->low_speed_time;
+	source_info_basic->queue_high_watermark =
+		client_input_basic->queue_high_watermark;
+	source_info_basic->queue_low_watermark =
+		client_input_basic->queue_low_watermark;
+	source_info_basic->durability = client_input_basic->durability;
+	source_info_basic->drop_cache_size = client_input_basic->drop_cache_size;
+	source_info_basic->validated_path = client_input_basic->validated_path;
+	client_input_basic->validated_path = DA_NULL;
+	source_info_basic->digest_algorithm = client_input_basic->digest_algorithm;
+	client_input_basic->digest_algorithm = DA_NULL;
+	source_info_basic->digest_expected = client_input_basic->digest_expected;
+	client_input_basic->digest_expected = DA_NULL;
+	source_info_basic->mirror_url = client_input_basic->mirror_url;
+	source_info_basic->mirror_url_count = client_input_basic->mirror_url_count;
+	client_input_basic->mirror_url = DA_NULL;
+	client_input_basic->mirror_url_count = 0;
 
 	source_info = GET_STAGE_SOURCE_INFO(stage);
 	memset(source_info, 0, sizeof(source_info_t));
@@ -344,18 +461,18 @@ da_result_t __download_content(stage_info *stage)
 
 	do {
 		stage = GET_DL_CURRENT_STAGE(download_id);
-		_da_thread_mutex_lock (&mutex_download_state[GET_STAGE_DL_ID(stage)]);
+		_da_thread_mutex_lock (&GET_DL_MUTEX_STATE(GET_STAGE_DL_ID(stage)));
 		download_state = GET_DL_STATE_ON_STAGE(stage);
 		DA_LOG(Default, "download_state to - [%d] ", download_state);
-		_da_thread_mutex_unlock (&mutex_download_state[GET_STAGE_DL_ID(stage)]);
+		_da_thread_mutex_unlock (&GET_DL_MUTEX_STATE(GET_STAGE_DL_ID(stage)));
 
 		switch(download_state) {
 		case DOWNLOAD_STATE_NEW_DOWNLOAD:
 			ret = requesting_download(stage);
 
-			_da_thread_mutex_lock (&mutex_download_state[GET_STAGE_DL_ID(stage)]);
+			_da_thread_mutex_lock (&GET_DL_MUTEX_STATE(GET_STAGE_DL_ID(stage)));
 			download_state = GET_DL_STATE_ON_STAGE(stage);
-			_da_thread_mutex_unlock (&mutex_download_state[GET_STAGE_DL_ID(stage)]);
+			_da_thread_mutex_unlock (&GET_DL_MUTEX_STATE(GET_STAGE_DL_ID(stage)));
 
 			if (download_state == DOWNLOAD_STATE_CANCELED) {
 				break;
@@ -29,6 +29,7 @@
 #include "download-agent-debug.h"
 #include "download-agent-utils.h"
 #include "download-agent-file.h"
+#include "download-agent-pool.h"
 
 #define IS_CLIENT_Q_HAVING_DATA(QUEUE)	(QUEUE->having_data)
 
@@ -118,7 +119,7 @@ da_result_t dereg_client_app(void)
 
 	DA_LOG_FUNC_START(ClientNoti);
 
-	client_noti = (client_noti_t *)calloc(1, sizeof(client_noti_t));
+	client_noti = (client_noti_t *)pool_alloc(DA_POOL_CLIENT_NOTI);
 	if (!client_noti) {
 		DA_LOG_ERR(ClientNoti, "calloc fail");
 		return DA_ERR_FAIL_TO_MEMALLOC;
@@ -192,7 +193,7 @@ da_result_t  send_client_da_state (int download_id, da_state state, int err)
 	GET_DL_DA_STATE(download_id) = state;
 	DA_LOG_VERBOSE(ClientNoti, "change da_state to %d", state);
 
-	client_noti = (client_noti_t *)calloc(1, sizeof(client_noti_t));
+	client_noti = (client_noti_t *)pool_alloc(DA_POOL_CLIENT_NOTI);
 	if (!client_noti) {
 		DA_LOG_ERR(ClientNoti, "calloc fail");
 		return DA_ERR_FAIL_TO_MEMALLOC;
@@ -233,7 +234,7 @@ da_result_t  send_client_update_downloading_info (
 		return DA_ERR_INVALID_DL_REQ_ID;
 	}
 
-	client_noti = (client_noti_t *)calloc(1, sizeof(client_noti_t));
+	client_noti = (client_noti_t *)pool_alloc(DA_POOL_CLIENT_NOTI);
 	if (!client_noti) {
 		DA_LOG_ERR(ClientNoti, "calloc fail");
 		return DA_ERR_FAIL_TO_MEMALLOC;
@@ -247,10 +248,13 @@ da_result_t  send_client_update_downloading_info (
 	downloading_info = (user_downloading_info_t *)&(client_noti->type.update_downloading_info);
 	downloading_info->da_dl_req_id = dl_req_id;
 	downloading_info->total_received_size = total_received_size;
+	downloading_info->stall_count = GET_DL_STALL_COUNT(download_id);
 
 	/* These strings MUST be copied to detach __thread_for_client_noti from download_info */
 	if (saved_path)
 		downloading_info->saved_path = strdup(saved_path);
+	if (saved_path && GET_DL_DIGEST(download_id))
+		downloading_info->digest = strdup(GET_DL_DIGEST(download_id));
 	DA_LOG(ClientNoti, "pushing received_size=%lu, download_id=%d, dl_req_id=%d",
 			total_received_size, download_id, dl_req_id);
 
@@ -266,7 +270,9 @@ da_result_t  send_client_update_dl_info (
 		unsigned long int file_size,
 		char *tmp_saved_path,
 		char *http_response_header,
-		char *http_chunked_data
+		char *http_chunked_data,
+		char *etag,
+		char *last_modified
 		)
 {
 	client_noti_t *client_noti = DA_NULL;
@@ -279,7 +285,7 @@ da_result_t  send_client_update_dl_info (
 		return DA_ERR_INVALID_DL_REQ_ID;
 	}
 
-	client_noti = (client_noti_t *)calloc(1, sizeof(client_noti_t));
+	client_noti = (client_noti_t *)pool_alloc(DA_POOL_CLIENT_NOTI);
 	if (!client_noti) {
 		DA_LOG_ERR(ClientNoti, "calloc fail");
 		return DA_ERR_FAIL_TO_MEMALLOC;
@@ -310,6 +316,10 @@ da_result_t  send_client_update_dl_info (
 			memcpy(update_dl_info->http_chunked_data, http_chunked_data,
 				file_size);
 	}
+	if (etag)
+		update_dl_info->etag = strdup(etag);
+	if (last_modified)
+		update_dl_info->last_modified = strdup(last_modified);
 	DA_LOG(ClientNoti, "pushing file_size=%lu, download_id=%d, dl_req_id=%d",
 			file_size, download_id, dl_req_id);
 
@@ -355,6 +365,14 @@ void destroy_client_noti(client_noti_t *client_noti)
 				free(update_dl_info->http_chunked_data);
 				update_dl_info->http_chunked_data = DA_NULL;
 			}
+			if (update_dl_info->etag) {
+				free(update_dl_info->etag);
+				update_dl_info->etag = DA_NULL;
+			}
+			if (update_dl_info->last_modified) {
+				free(update_dl_info->last_modified);
+				update_dl_info->last_modified = DA_NULL;
+			}
 		} else if (client_noti->noti_type ==
 				Q_CLIENT_NOTI_TYPE_UPDATE_DOWNLOADING_INFO) {
 			user_downloading_info_t *downloading_info = DA_NULL;
@@ -363,8 +381,12 @@ void destroy_client_noti(client_noti_t *client_noti)
 				free(downloading_info->saved_path);
 				downloading_info->saved_path = DA_NULL;
 			}
+			if (downloading_info->digest) {
+				free(downloading_info->digest);
+				downloading_info->digest = DA_NULL;
+			}
 		}
-		free(client_noti);
+		pool_free(DA_POOL_CLIENT_NOTI, client_noti);
 	}
 }
 
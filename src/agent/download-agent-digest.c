@@ -0,0 +1,198 @@
+/*
+ * Download Agent
+ *
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Jungki Kwak <jungki.kwak@samsung.com>, Keunsoon Lee <keunsoon.lee@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file		download-agent-digest.c
+ * @brief		functions for the digest of downloaded content
+ ***/
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <glib.h>
+
+#include "download-agent-debug.h"
+#include "download-agent-digest.h"
+
+struct _da_digest_t {
+	GChecksum *checksum;
+	unsigned long long len;
+};
+
+static GChecksumType __get_checksum_type(const char *algorithm,
+		da_bool_t *out_is_supported);
+
+GChecksumType __get_checksum_type(const char *algorithm,
+		da_bool_t *out_is_supported)
+{
+	*out_is_supported = DA_TRUE;
+	if (algorithm) {
+		if (!strcasecmp(algorithm, "md5"))
+			return G_CHECKSUM_MD5;
+		if (!strcasecmp(algorithm, "sha1"))
+			return G_CHECKSUM_SHA1;
+		if (!strcasecmp(algorithm, "sha256"))
+			return G_CHECKSUM_SHA256;
+	}
+	*out_is_supported = DA_FALSE;
+	return G_CHECKSUM_SHA256;
+}
+
+da_bool_t digest_is_supported(const char *algorithm)
+{
+	da_bool_t is_supported = DA_FALSE;
+
+	__get_checksum_type(algorithm, &is_supported);
+	return is_supported;
+}
+
+da_result_t digest_create(const char *algorithm, da_digest_t **out_digest)
+{
+	da_digest_t *digest = DA_NULL;
+	GChecksumType type;
+	da_bool_t is_supported = DA_FALSE;
+
+	if (!out_digest)
+		return DA_ERR_INVALID_ARGUMENT;
+
+	type = __get_checksum_type(algorithm, &is_supported);
+	if (DA_FALSE == is_supported) {
+		DA_LOG_ERR(FileManager, "not supported [%s]", algorithm);
+		return DA_ERR_INVALID_ARGUMENT;
+	}
+
+	digest = (da_digest_t *)calloc(1, sizeof(da_digest_t));
+	if (!digest)
+		return DA_ERR_FAIL_TO_MEMALLOC;
+	digest->checksum = g_checksum_new(type);
+	if (!digest->checksum) {
+		free(digest);
+		return DA_ERR_FAIL_TO_MEMALLOC;
+	}
+
+	*out_digest = digest;
+	return DA_RESULT_OK;
+}
+
+void digest_destroy(da_digest_t *digest)
+{
+	if (!digest)
+		return;
+	if (digest->checksum)
+		g_checksum_free(digest->checksum);
+	free(digest);
+}
+
+void digest_update(da_digest_t *digest, const char *data, int len)
+{
+	if (!digest || !data || len <= 0)
+		return;
+	g_checksum_update(digest->checksum, (const guchar *)data, len);
+	digest->len += len;
+}
+
+da_result_t digest_update_from_file(da_digest_t *digest, const char *file_path,
+		unsigned long long len)
+{
+	da_result_t ret = DA_RESULT_OK;
+	char *buff = DA_NULL;
+	ssize_t read_len = 0;
+	size_t want_len = 0;
+	int fd = -1;
+
+	if (!digest || !file_path)
+		return DA_ERR_INVALID_ARGUMENT;
+	if (len == 0)
+		return ret;
+
+	DA_LOG(FileManager, "hash [%s] up to [%llu]", file_path, len);
+
+	fd = open(file_path, O_RDONLY);
+	if (fd < 0) {
+		DA_LOG_ERR(FileManager, "fail to open [%d]", errno);
+		return DA_ERR_FAIL_TO_ACCESS_FILE;
+	}
+	/* The file is read only once */
+	posix_fadvise(fd, 0, (off_t)len, POSIX_FADV_SEQUENTIAL);
+
+	buff = (char *)malloc(DA_DIGEST_READ_BUF_SIZE);
+	if (!buff) {
+		ret = DA_ERR_FAIL_TO_MEMALLOC;
+		goto ERR;
+	}
+
+	while (len > 0) {
+		want_len = DA_DIGEST_READ_BUF_SIZE;
+		if ((unsigned long long)want_len > len)
+			want_len = len;
+		read_len = read(fd, buff, want_len);
+		if (read_len < 0 && errno == EINTR)
+			continue;
+		if (read_len <= 0) {
+			DA_LOG_ERR(FileManager, "fail to read [%d]", errno);
+			ret = DA_ERR_FAIL_TO_ACCESS_FILE;
+			goto ERR;
+		}
+		digest_update(digest, buff, read_len);
+		len -= read_len;
+	}
+
+ERR:
+	if (buff)
+		free(buff);
+	close(fd);
+	return ret;
+}
+
+unsigned long long digest_get_len(da_digest_t *digest)
+{
+	if (!digest)
+		return 0;
+	return digest->len;
+}
+
+char *digest_get_hex(da_digest_t *digest)
+{
+	GChecksum *copied = DA_NULL;
+	char *hex = DA_NULL;
+
+	if (!digest)
+		return DA_NULL;
+
+	/* The string can not be got twice from the same one */
+	copied = g_checksum_copy(digest->checksum);
+	if (!copied)
+		return DA_NULL;
+	if (g_checksum_get_string(copied))
+		hex = strdup(g_checksum_get_string(copied));
+	g_checksum_free(copied);
+
+	return hex;
+}
+
+da_bool_t digest_is_same(const char *hex1, const char *hex2)
+{
+	if (!hex1 || !hex2)
+		return DA_FALSE;
+	if (strcasecmp(hex1, hex2))
+		return DA_FALSE;
+	return DA_TRUE;
+}
@@ -0,0 +1,468 @@
+/*
+ * Download Agent
+ *
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Jungki Kwak <jungki.kwak@samsung.com>, Keunsoon Lee <keunsoon.lee@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file		download-agent-disk-writer.c
+ * @brief		functions for the writer thread for each storage device
+ ***/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE	/* for pwritev(), sync_file_range() and posix_fadvise() */
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include "download-agent-defs.h"
+#include "download-agent-debug.h"
+#include "download-agent-pthread.h"
+#include "download-agent-utils.h"
+#include "download-agent-disk-writer.h"
+
+/* Slices written with one pwritev() */
+#define DA_DISK_WRITER_IOV_COUNT	64
+
+typedef struct _write_request_t write_request_t;
+struct _write_request_t {
+	disk_writer_job_t *job;
+	da_body_slice_t *slices;
+	int slice_count;
+	int len;
+	unsigned long long offset;
+	write_request_t *next;
+};
+
+typedef struct _disk_writer_t disk_writer_t;
+struct _disk_writer_t {
+	dev_t dev;
+	pthread_t thread_id;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond_request;
+	pthread_cond_t cond_done; /* written, so there is some room */
+	write_request_t *head;
+	write_request_t *tail;
+	unsigned long in_flight_len;
+	int ref_count; /* protected by mutex_writers */
+	da_bool_t is_stopping;
+	disk_writer_t *next;
+};
+
+/* Fields are protected by writer->mutex */
+struct _disk_writer_job_t {
+	disk_writer_t *writer;
+	int fd;
+	int durability;
+	int drop_cache_size;
+	int pending_count;
+	da_result_t result;
+	/* Written after the last write back. Used only by the writer thread */
+	unsigned long long unsynced_len;
+	/* End of the data written. Used only by the writer thread */
+	unsigned long long written_end;
+	/* Written end when write back is started at the last time, and the
+	 * end of the range whose pages are dropped already. Used only by
+	 * the writer thread */
+	unsigned long long write_back_end;
+	unsigned long long dropped_end;
+	da_bool_t is_written;
+};
+
+static pthread_mutex_t mutex_writers = PTHREAD_MUTEX_INITIALIZER;
+static disk_writer_t *writers = DA_NULL;
+
+static da_result_t __write_slices(int fd, da_body_slice_t *slices,
+		int slice_count, unsigned long long offset);
+static da_result_t __write_back(disk_writer_job_t *job, int len,
+		unsigned long long offset);
+static void __release_request(write_request_t *request);
+static void *__thread_for_disk_writer(void *data);
+static disk_writer_t *__get_writer(dev_t dev);
+static void __put_writer(disk_writer_t *writer);
+
+da_result_t __write_slices(int fd, da_body_slice_t *slices,
+		int slice_count, unsigned long long offset)
+{
+	struct iovec iov[DA_DISK_WRITER_IOV_COUNT];
+	int iov_count = 0;
+	int iov_index = 0;
+	ssize_t write_len = 0;
+	int i = 0;
+
+	while (i < slice_count) {
+		/* Up to the size of iov at once */
+		for (iov_count = 0; i < slice_count &&
+				iov_count < DA_DISK_WRITER_IOV_COUNT; i++) {
+			if (slices[i].len <= 0)
+				continue;
+			iov[iov_count].iov_base = slices[i].data;
+			iov[iov_count].iov_len = slices[i].len;
+			iov_count++;
+		}
+
+		iov_index = 0;
+		while (iov_index < iov_count) {
+			write_len = pwritev(fd, iov + iov_index, iov_count - iov_index,
+					(off_t)offset);
+			if (write_len < 0 && errno == EINTR)
+				continue;
+			if (write_len <= 0) {
+				DA_LOG_ERR(FileManager, "write fails [%d]", errno);
+				if (errno == ENOSPC)
+					return DA_ERR_DISK_FULL;
+				return DA_ERR_FAIL_TO_ACCESS_FILE;
+			}
+			offset += write_len;
+
+			/* Continue from the rest of partial write */
+			while (iov_index < iov_count &&
+					(size_t)write_len >= iov[iov_index].iov_len) {
+				write_len -= iov[iov_index].iov_len;
+				iov_index++;
+			}
+			if (iov_index < iov_count) {
+				iov[iov_index].iov_base =
+					(char *)iov[iov_index].iov_base + write_len;
+				iov[iov_index].iov_len -= write_len;
+			}
+		}
+	}
+	return DA_RESULT_OK;
+}
+
+da_result_t __write_back(disk_writer_job_t *job, int len,
+		unsigned long long offset)
+{
+	/* Pages are dropped from where this job starts to write */
+	if (DA_FALSE == job->is_written) {
+		job->is_written = DA_TRUE;
+		job->write_back_end = job->dropped_end = offset;
+	}
+	if (offset + len > job->written_end)
+		job->written_end = offset + len;
+	job->unsynced_len += len;
+	if (job->unsynced_len < DA_DISK_WRITER_WRITE_BACK_SIZE)
+		return DA_RESULT_OK;
+	job->unsynced_len = 0;
+
+	if (DA_DURABILITY_PERIODIC == job->durability) {
+		if (fdatasync(job->fd) != 0) {
+			DA_LOG_ERR(FileManager, "fdatasync fails [%d]", errno);
+			if (errno == ENOSPC)
+				return DA_ERR_DISK_FULL;
+			return DA_ERR_FAIL_TO_ACCESS_FILE;
+		}
+		/* All of the written pages are clean now */
+		if (disk_writer_drop_cache(job->fd, job->drop_cache_size,
+				job->written_end, job->dropped_end, job->written_end))
+			job->dropped_end = job->written_end;
+		return DA_RESULT_OK;
+	}
+#ifdef SYNC_FILE_RANGE_WRITE
+	/* Wait for the pages which started to be written at the last time,
+	 * and start to write the ones dirtied since then. So dirty pages
+	 * of the file are kept under about twice of the size */
+	if (sync_file_range(job->fd, 0, 0, SYNC_FILE_RANGE_WAIT_BEFORE) != 0)
+		DA_LOG(FileManager, "sync_file_range fails [%d]", errno);
+	/* The pages waited above are clean now. Only the range which is
+	 * written back since the last time is dropped, not the whole file */
+	if (disk_writer_drop_cache(job->fd, job->drop_cache_size,
+			job->written_end, job->dropped_end, job->write_back_end))
+		job->dropped_end = job->write_back_end;
+	if (sync_file_range(job->fd, 0, 0, SYNC_FILE_RANGE_WRITE) != 0)
+		DA_LOG(FileManager, "sync_file_range fails [%d]", errno);
+	job->write_back_end = job->written_end;
+#endif
+	return DA_RESULT_OK;
+}
+
+void __release_request(write_request_t *request)
+{
+	int i = 0;
+
+	for (i = 0; i < request->slice_count; i++)
+		release_body_slice(&(request->slices[i]));
+	free(request->slices);
+	request->slices = DA_NULL;
+	request->slice_count = 0;
+}
+
+void *__thread_for_disk_writer(void *data)
+{
+	disk_writer_t *writer = (disk_writer_t *)data;
+	write_request_t *batch = DA_NULL;
+	write_request_t *request = DA_NULL;
+	da_result_t ret = DA_RESULT_OK;
+
+	DA_LOG_FUNC_START(Thread);
+
+	_da_thread_mutex_lock(&(writer->mutex));
+	while (1) {
+		while (!writer->head && DA_FALSE == writer->is_stopping)
+			_da_thread_cond_wait(&(writer->cond_request), &(writer->mutex));
+		if (!writer->head)
+			break;
+
+		/* All the requests on the queue are written at once */
+		batch = writer->head;
+		writer->head = writer->tail = DA_NULL;
+		_da_thread_mutex_unlock(&(writer->mutex));
+
+		for (request = batch; request; request = request->next) {
+			_da_thread_mutex_lock(&(writer->mutex));
+			ret = request->job->result;
+			_da_thread_mutex_unlock(&(writer->mutex));
+			if (DA_RESULT_OK == ret) {
+				ret = __write_slices(request->job->fd, request->slices,
+						request->slice_count, request->offset);
+				if (DA_RESULT_OK == ret)
+					ret = __write_back(request->job, request->len,
+							request->offset);
+				if (DA_RESULT_OK != ret) {
+					_da_thread_mutex_lock(&(writer->mutex));
+					request->job->result = ret;
+					_da_thread_mutex_unlock(&(writer->mutex));
+				}
+			}
+			__release_request(request);
+		}
+
+		_da_thread_mutex_lock(&(writer->mutex));
+		while (batch) {
+			request = batch;
+			batch = batch->next;
+			writer->in_flight_len -= request->len;
+			request->job->pending_count--;
+			free(request);
+		}
+		pthread_cond_broadcast(&(writer->cond_done));
+	}
+	_da_thread_mutex_unlock(&(writer->mutex));
+
+	return DA_NULL;
+}
+
+disk_writer_t *__get_writer(dev_t dev)
+{
+	disk_writer_t *writer = DA_NULL;
+
+	_da_thread_mutex_lock(&mutex_writers);
+	for (writer = writers; writer; writer = writer->next) {
+		if (writer->dev == dev)
+			break;
+	}
+	if (!writer) {
+		writer = (disk_writer_t *)calloc(1, sizeof(disk_writer_t));
+		if (!writer)
+			goto ERR;
+		writer->dev = dev;
+		_da_thread_mutex_init(&(writer->mutex), DA_NULL);
+		_da_thread_cond_init(&(writer->cond_request), DA_NULL);
+		_da_thread_cond_init(&(writer->cond_done), DA_NULL);
+		if (pthread_create(&(writer->thread_id), DA_NULL,
+				__thread_for_disk_writer, writer) != 0) {
+			DA_LOG_ERR(Thread, "fail to make disk writer thread");
+			_da_thread_cond_destroy(&(writer->cond_request));
+			_da_thread_cond_destroy(&(writer->cond_done));
+			_da_thread_mutex_destroy(&(writer->mutex));
+			free(writer);
+			writer = DA_NULL;
+			goto ERR;
+		}
+		writer->next = writers;
+		writers = writer;
+		DA_LOG(FileManager, "new disk writer for dev[%lu]", (unsigned long)dev);
+	}
+	writer->ref_count++;
+ERR:
+	_da_thread_mutex_unlock(&mutex_writers);
+	return writer;
+}
+
+/* The thread is finished when no file uses it */
+void __put_writer(disk_writer_t *writer)
+{
+	disk_writer_t **cur = DA_NULL;
+
+	_da_thread_mutex_lock(&mutex_writers);
+	writer->ref_count--;
+	if (writer->ref_count > 0) {
+		_da_thread_mutex_unlock(&mutex_writers);
+		return;
+	}
+	for (cur = &writers; *cur; cur = &((*cur)->next)) {
+		if (*cur == writer) {
+			*cur = writer->next;
+			break;
+		}
+	}
+	_da_thread_mutex_unlock(&mutex_writers);
+
+	_da_thread_mutex_lock(&(writer->mutex));
+	writer->is_stopping = DA_TRUE;
+	_da_thread_cond_signal(&(writer->cond_request));
+	_da_thread_mutex_unlock(&(writer->mutex));
+	pthread_join(writer->thread_id, DA_NULL);
+
+	_da_thread_cond_destroy(&(writer->cond_request));
+	_da_thread_cond_destroy(&(writer->cond_done));
+	_da_thread_mutex_destroy(&(writer->mutex));
+	free(writer);
+}
+
+da_result_t disk_writer_open(int fd, int durability, int drop_cache_size,
+		disk_writer_job_t **out_job)
+{
+	disk_writer_job_t *job = DA_NULL;
+	struct stat file_state;
+
+	if (fd < 0 || !out_job)
+		return DA_ERR_INVALID_ARGUMENT;
+
+	if (fstat(fd, &file_state) != 0)
+		return DA_ERR_FAIL_TO_ACCESS_FILE;
+
+	job = (disk_writer_job_t *)calloc(1, sizeof(disk_writer_job_t));
+	if (!job)
+		return DA_ERR_FAIL_TO_MEMALLOC;
+
+	job->writer = __get_writer(file_state.st_dev);
+	if (!job->writer) {
+		free(job);
+		return DA_ERR_FAIL_TO_CREATE_THREAD;
+	}
+	job->fd = fd;
+	job->durability = durability;
+	job->drop_cache_size = drop_cache_size;
+	job->result = DA_RESULT_OK;
+
+	*out_job = job;
+	return DA_RESULT_OK;
+}
+
+da_result_t disk_writer_submit(disk_writer_job_t *job, da_body_slice_t *slices,
+		int slice_count, int len, unsigned long long offset)
+{
+	da_result_t ret = DA_RESULT_OK;
+	disk_writer_t *writer = DA_NULL;
+	write_request_t *request = DA_NULL;
+
+	request = (write_request_t *)calloc(1, sizeof(write_request_t));
+	if (!request) {
+		ret = DA_ERR_FAIL_TO_MEMALLOC;
+		goto ERR;
+	}
+	request->job = job;
+	request->slices = slices;
+	request->slice_count = slice_count;
+	request->len = len;
+	request->offset = offset;
+
+	if (!job) {
+		ret = DA_ERR_INVALID_ARGUMENT;
+		goto ERR;
+	}
+	writer = job->writer;
+
+	_da_thread_mutex_lock(&(writer->mutex));
+	/* One request is always accepted even if it is over the limit */
+	while (DA_RESULT_OK == job->result && writer->in_flight_len > 0 &&
+			writer->in_flight_len + len > DA_DISK_WRITER_MAX_IN_FLIGHT)
+		_da_thread_cond_wait(&(writer->cond_done), &(writer->mutex));
+	ret = job->result;
+	if (DA_RESULT_OK == ret) {
+		if (writer->tail)
+			writer->tail->next = request;
+		else
+			writer->head = request;
+		writer->tail = request;
+		writer->in_flight_len += len;
+		job->pending_count++;
+		request = DA_NULL;
+		_da_thread_cond_signal(&(writer->cond_request));
+	}
+	_da_thread_mutex_unlock(&(writer->mutex));
+
+ERR:
+	if (request) {
+		__release_request(request);
+		free(request);
+	} else if (DA_RESULT_OK != ret) {
+		/* Not even the request is made */
+		for (; slice_count > 0; slice_count--)
+			release_body_slice(&slices[slice_count - 1]);
+		free(slices);
+	}
+	return ret;
+}
+
+da_result_t disk_writer_wait(disk_writer_job_t *job)
+{
+	da_result_t ret = DA_RESULT_OK;
+	disk_writer_t *writer = DA_NULL;
+
+	if (!job)
+		return DA_ERR_INVALID_ARGUMENT;
+	writer = job->writer;
+
+	_da_thread_mutex_lock(&(writer->mutex));
+	while (job->pending_count > 0)
+		_da_thread_cond_wait(&(writer->cond_done), &(writer->mutex));
+	ret = job->result;
+	_da_thread_mutex_unlock(&(writer->mutex));
+
+	return ret;
+}
+
+da_result_t disk_writer_close(disk_writer_job_t *job)
+{
+	da_result_t ret = DA_RESULT_OK;
+
+	if (!job)
+		return DA_ERR_INVALID_ARGUMENT;
+
+	ret = disk_writer_wait(job);
+	__put_writer(job->writer);
+	free(job);
+
+	return ret;
+}
+
+da_bool_t disk_writer_drop_cache(int fd, int drop_cache_size,
+		unsigned long long size, unsigned long long start,
+		unsigned long long end)
+{
+	int err = 0;
+
+	if (fd < 0 || drop_cache_size < 0 ||
+			size < (unsigned long long)drop_cache_size * 1024 * 1024)
+		return DA_FALSE;
+	if (end != 0 && end <= start)
+		return DA_TRUE;
+	/* Only clean pages are dropped. It does not wait for dirty ones */
+	err = posix_fadvise(fd, (off_t)start, end ? (off_t)(end - start) : 0,
+			POSIX_FADV_DONTNEED);
+	if (err != 0)
+		DA_LOG(FileManager, "posix_fadvise fails [%d]", err);
+	return DA_TRUE;
+}
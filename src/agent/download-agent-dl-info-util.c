@@ -32,8 +32,11 @@
 #include "download-agent-file.h"
 #include "download-agent-http-mgr.h"
 #include "download-agent-plugin-conf.h"
+#include "download-agent-http-segment.h"
+#include "download-agent-http-rate.h"
+#include "download-agent-digest.h"
+#include "download-agent-space.h"
 
-pthread_mutex_t mutex_download_state[DA_MAX_DOWNLOAD_ID];
 static pthread_mutex_t mutex_download_mgr = PTHREAD_MUTEX_INITIALIZER;
 download_mgr_t download_mgr;
 
@@ -41,6 +44,7 @@ void init_state_watcher(state_watcher_t *state_watcher);
 void cleanup_state_watcher(state_watcher_t *state_watcher);
 
 da_result_t set_default_header_info(void);
+da_result_t __alloc_download_info(int count);
 
 void cleanup_source_info_basic_download(source_info_basic_t *source_info_basic);
 void cleanup_req_dl_info_http(req_dl_info *http_download);
@@ -60,12 +64,16 @@ da_result_t init_download_mgr() {
 	_da_thread_mutex_lock(&mutex_download_mgr);
 
 	if (download_mgr.is_init == DA_FALSE) {
+		if (download_mgr.max_download_count <= 0)
+			download_mgr.max_download_count = DA_MAX_DOWNLOAD_REQ_AT_ONCE;
+		ret = __alloc_download_info(download_mgr.max_download_count);
+		if (ret != DA_RESULT_OK)
+			goto ERR;
+
 		download_mgr.is_init = DA_TRUE;
 
-		for (i = 0; i < DA_MAX_DOWNLOAD_ID; i++) {
-			_da_thread_mutex_init(&mutex_download_state[i], DA_NULL);
+		for (i = 0; i < download_mgr.download_info_count; i++)
 			init_download_info(i);
-		}
 
 		init_state_watcher(&(download_mgr.state_watcher));
 		init_dl_req_id_history(&(download_mgr.dl_req_id_history));
@@ -82,11 +90,74 @@ da_result_t init_download_mgr() {
 		}
 	}
 
+ERR:
 	_da_thread_mutex_unlock(&mutex_download_mgr);
 
 	return ret;
 }
 
+/* Must be called with mutex_download_mgr locked */
+da_result_t __alloc_download_info(int count)
+{
+	download_info_t *dl_info = DA_NULL;
+	int i = 0;
+
+	for (i = download_mgr.download_info_count; i < count; i++) {
+		dl_info = (download_info_t *)calloc(1, sizeof(download_info_t));
+		if (!dl_info) {
+			DA_LOG_ERR(Default, "DA_ERR_FAIL_TO_MEMALLOC");
+			return DA_ERR_FAIL_TO_MEMALLOC;
+		}
+		_da_thread_mutex_init(&(dl_info->mutex_state), DA_NULL);
+		download_mgr.download_info[i] = dl_info;
+		download_mgr.download_info_count = i + 1;
+		if (download_mgr.is_init == DA_TRUE)
+			init_download_info(i);
+	}
+
+	return DA_RESULT_OK;
+}
+
+da_result_t set_max_download_count(int count)
+{
+	da_result_t ret = DA_RESULT_OK;
+
+	DA_LOG_FUNC_START(Default);
+
+	if (count < 1 || count > DA_MAX_DOWNLOAD_REQ_LIMIT) {
+		DA_LOG_ERR(Default, "invalid count [%d]", count);
+		return DA_ERR_INVALID_ARGUMENT;
+	}
+
+	_da_thread_mutex_lock(&mutex_download_mgr);
+	/* The entries are allocated on init_download_mgr() if it is not init yet */
+	if (download_mgr.is_init == DA_TRUE) {
+		ret = __alloc_download_info(count);
+		if (ret != DA_RESULT_OK)
+			goto ERR;
+	}
+	/* If it is lowered, running downloads over the count are not affected.
+	 * Only new download id is not handed out until they are finished. */
+	download_mgr.max_download_count = count;
+	DA_LOG_CRITICAL(Default, "max download count = %d", count);
+ERR:
+	_da_thread_mutex_unlock(&mutex_download_mgr);
+	return ret;
+}
+
+int get_max_download_count(void)
+{
+	int count = 0;
+
+	_da_thread_mutex_lock(&mutex_download_mgr);
+	count = download_mgr.max_download_count;
+	_da_thread_mutex_unlock(&mutex_download_mgr);
+
+	if (count <= 0)
+		count = DA_MAX_DOWNLOAD_REQ_AT_ONCE;
+	return count;
+}
+
 da_result_t deinit_download_mgr(void) {
 	da_result_t ret = DA_RESULT_OK;
 
@@ -97,8 +168,8 @@ da_result_t deinit_download_mgr(void) {
 		int i = 0;
 		download_info_t *dl_info = DA_NULL;
 		void *t_return = NULL;
-		for (i = 0; i < DA_MAX_DOWNLOAD_ID; i++) {
-			dl_info = &(download_mgr.download_info[i]);
+		for (i = 0; i < download_mgr.download_info_count; i++) {
+			dl_info = download_mgr.download_info[i];
 			if (dl_info && dl_info->is_using) {
 				request_to_abort_http_download(GET_DL_CURRENT_STAGE(i));
 				DA_LOG_CRITICAL(Thread, "===download id[%d] thread id[%lu] join===",i, GET_DL_THREAD_ID(i));
@@ -150,9 +221,9 @@ void init_download_info(int download_id)
 
 //	DA_LOG_FUNC_START(Default);
 
-	_da_thread_mutex_lock(&mutex_download_state[download_id]);
+	_da_thread_mutex_lock(&GET_DL_MUTEX_STATE(download_id));
 	DA_LOG(Default, "Init download_id [%d] Info", download_id);
-	dl_info = &(download_mgr.download_info[download_id]);
+	dl_info = download_mgr.download_info[download_id];
 
 	dl_info->is_using = DA_FALSE;
 	dl_info->state = DOWNLOAD_STATE_IDLE;
@@ -160,11 +231,13 @@ void init_download_info(int download_id)
 	dl_info->dl_req_id = DA_NULL;
 	dl_info->user_install_path = DA_NULL;
 	dl_info->user_data = DA_NULL;
+	dl_info->stall_count = 0;
+	dl_info->digest = DA_NULL;
 
 	Q_init_queue(&(dl_info->queue));
 
 	DA_LOG(Default, "Init download_id [%d] Info END", download_id);
-	_da_thread_mutex_unlock(&mutex_download_state[download_id]);
+	_da_thread_mutex_unlock(&GET_DL_MUTEX_STATE(download_id));
 
 	return;
 }
@@ -182,13 +255,13 @@ void destroy_download_info(int download_id)
 		return;
 	}
 
-	dl_info = &(download_mgr.download_info[download_id]);
+	dl_info = download_mgr.download_info[download_id];
 	if (DA_FALSE == dl_info->is_using) {
 /*		DA_LOG_ERR(Default, "invalid download_id"); */
 		return;
 	}
 
-	_da_thread_mutex_lock (&mutex_download_state[download_id]);
+	_da_thread_mutex_lock (&GET_DL_MUTEX_STATE(download_id));
 	dl_info->state = DOWNLOAD_STATE_IDLE;
 	DA_LOG(Default, "Changed download_state to - [%d] ", dl_info->state);
 
@@ -204,14 +277,20 @@ void destroy_download_info(int download_id)
 		dl_info->user_install_path = DA_NULL;
 	}
 	dl_info->user_data = DA_NULL;
+	dl_info->stall_count = 0;
+	if (dl_info->digest) {
+		free(dl_info->digest);
+		dl_info->digest = DA_NULL;
+	}
 	dl_info->cur_da_state = DA_STATE_WAITING;
 
 	Q_destroy_queue(&(dl_info->queue));
+	rate_reset_download(download_id);
 
 	dl_info->is_using = DA_FALSE;
 
 	DA_LOG(Default, "Destroying download_id [%d] Info END", download_id);
-	_da_thread_mutex_unlock (&mutex_download_state[download_id]);
+	_da_thread_mutex_unlock (&GET_DL_MUTEX_STATE(download_id));
 	return;
 }
 
@@ -227,6 +306,8 @@ void *Add_new_download_stage(int download_id)
 		goto ERR;
 
 	new_download_stage_data->dl_id = download_id;
+	GET_CONTENT_STORE_FILE_FD(GET_STAGE_CONTENT_STORE_INFO(
+			new_download_stage_data)) = -1;
 	download_stage_data = GET_DL_CURRENT_STAGE(download_id);
 	if (download_stage_data) {
 		while (download_stage_data->next_stage_info) {
@@ -320,6 +401,32 @@ void cleanup_source_info_basic_download(source_info_basic_t *source_info_basic)
 		source_info_basic->url = DA_NULL;
 	}
 
+	if (NULL != source_info_basic->validated_path) {
+		free(source_info_basic->validated_path);
+		source_info_basic->validated_path = DA_NULL;
+	}
+
+	if (NULL != source_info_basic->digest_algorithm) {
+		free(source_info_basic->digest_algorithm);
+		source_info_basic->digest_algorithm = DA_NULL;
+	}
+
+	if (NULL != source_info_basic->digest_expected) {
+		free(source_info_basic->digest_expected);
+		source_info_basic->digest_expected = DA_NULL;
+	}
+
+	if (NULL != source_info_basic->mirror_url) {
+		int i = 0;
+		for (i = 0; i < source_info_basic->mirror_url_count; i++) {
+			if (source_info_basic->mirror_url[i])
+				free(source_info_basic->mirror_url[i]);
+		}
+		free(source_info_basic->mirror_url);
+		source_info_basic->mirror_url = DA_NULL;
+		source_info_basic->mirror_url_count = 0;
+	}
+
 ERR:
 	return;
 
@@ -329,6 +436,8 @@ void cleanup_req_dl_info_http(req_dl_info *http_download)
 {
 	DA_LOG_FUNC_START(Default);
 
+	destroy_segment_info(&(http_download->segment_info));
+
 	if (http_download->http_info.http_msg_request) {
 		http_msg_request_destroy(
 		                &(http_download->http_info.http_msg_request));
@@ -343,6 +452,10 @@ void cleanup_req_dl_info_http(req_dl_info *http_download)
 		free(http_download->location_url);
 		http_download->location_url = DA_NULL;
 	}
+	if (DA_NULL != http_download->cached_redirect_url) {
+		free(http_download->cached_redirect_url);
+		http_download->cached_redirect_url = DA_NULL;
+	}
 	if (DA_NULL != http_download->content_type_from_header) {
 		free(http_download->content_type_from_header);
 		http_download->content_type_from_header = DA_NULL;
@@ -353,6 +466,11 @@ void cleanup_req_dl_info_http(req_dl_info *http_download)
 		http_download->etag_from_header = DA_NULL;
 	}
 
+	if (DA_NULL != http_download->last_modified_from_header) {
+		free(http_download->last_modified_from_header);
+		http_download->last_modified_from_header = DA_NULL;
+	}
+
 	http_download->invloved_transaction_id = DA_INVALID_ID;
 	http_download->content_len_from_header = 0;
 	http_download->downloaded_data_size = 0;
@@ -393,6 +511,16 @@ void destroy_file_info(file_info *file_information)
 		free(file_information->extension);
 		file_information->extension = NULL;
 	}
+
+	if (file_information->digest) {
+		digest_destroy(file_information->digest);
+		file_information->digest = NULL;
+	}
+
+	if (file_information->space_reservation) {
+		space_release(file_information->space_reservation);
+		file_information->space_reservation = NULL;
+	}
 	return;
 }
 
@@ -421,6 +549,32 @@ void clean_up_client_input_info(client_input_t *client_input)
 			client_input_basic->req_url = DA_NULL;
 		}
 
+		if (client_input_basic && client_input_basic->validated_path) {
+			free(client_input_basic->validated_path);
+			client_input_basic->validated_path = DA_NULL;
+		}
+
+		if (client_input_basic && client_input_basic->digest_algorithm) {
+			free(client_input_basic->digest_algorithm);
+			client_input_basic->digest_algorithm = DA_NULL;
+		}
+
+		if (client_input_basic && client_input_basic->digest_expected) {
+			free(client_input_basic->digest_expected);
+			client_input_basic->digest_expected = DA_NULL;
+		}
+
+		if (client_input_basic && client_input_basic->mirror_url) {
+			int i = 0;
+			for (i = 0; i < client_input_basic->mirror_url_count; i++) {
+				if (client_input_basic->mirror_url[i])
+					free(client_input_basic->mirror_url[i]);
+			}
+			free(client_input_basic->mirror_url);
+			client_input_basic->mirror_url = DA_NULL;
+			client_input_basic->mirror_url_count = 0;
+		}
+
 		if (client_input_basic && client_input_basic->user_request_header) {
 			int i = 0;
 			int count = client_input_basic->user_request_header_count;
@@ -456,9 +610,9 @@ da_result_t get_download_id_for_dl_req_id(
 	}
 
 	_da_thread_mutex_lock(&mutex_download_mgr);
-	for (iter = 0; iter < DA_MAX_DOWNLOAD_ID; iter++) {
-		if (download_mgr.download_info[iter].is_using == DA_TRUE) {
-			if (download_mgr.download_info[iter].dl_req_id ==
+	for (iter = 0; iter < download_mgr.download_info_count; iter++) {
+		if (download_mgr.download_info[iter]->is_using == DA_TRUE) {
+			if (download_mgr.download_info[iter]->dl_req_id ==
 				dl_req_id) {
 				*download_id = iter;
 				ret = DA_RESULT_OK;
@@ -478,13 +632,14 @@ da_result_t get_available_download_id(da_handle_t *available_id)
 	int i;
 
 	_da_thread_mutex_lock(&mutex_download_mgr);
-	for (i = 0; i < DA_MAX_DOWNLOAD_ID; i++) {
-		if (download_mgr.download_info[i].is_using == DA_FALSE) {
+	for (i = 0; i < download_mgr.max_download_count &&
+			i < download_mgr.download_info_count; i++) {
+		if (download_mgr.download_info[i]->is_using == DA_FALSE) {
 			init_download_info(i);
 
-			download_mgr.download_info[i].is_using = DA_TRUE;
+			download_mgr.download_info[i]->is_using = DA_TRUE;
 
-			download_mgr.download_info[i].dl_req_id
+			download_mgr.download_info[i]->dl_req_id
 				= get_available_dl_req_id(&(download_mgr.dl_req_id_history));
 
 			*available_id = i;
@@ -503,8 +658,8 @@ da_bool_t is_valid_dl_ID( download_id)
 {
 	da_bool_t ret = DA_FALSE;
 
-	if (download_id >= 0 && download_id < DA_MAX_DOWNLOAD_ID) {
-		if (download_mgr.download_info[download_id].is_using == DA_TRUE)
+	if (download_id >= 0 && download_id < download_mgr.download_info_count) {
+		if (download_mgr.download_info[download_id]->is_using == DA_TRUE)
 			ret = DA_TRUE;
 	}
 
@@ -541,15 +696,15 @@ void state_watcher_flag_ON_for_download_id(
                 state_watcher_t *state_watcher,
                 int download_id)
 {
-	unsigned short mask = 0;
+	unsigned long long mask = 0;
 
 	_da_thread_mutex_lock(&(state_watcher->mutex));
 
-	mask = 1 << download_id;
+	mask = 1ULL << download_id;
 
 	state_watcher->state_watching_bitmap |= mask;
 
-	DA_LOG(Default, "state_watcher [%d], download_id [%d]", state_watcher->state_watching_bitmap, download_id);
+	DA_LOG(Default, "state_watcher [%llx], download_id [%d]", state_watcher->state_watching_bitmap, download_id);
 
 	_da_thread_mutex_unlock(&(state_watcher->mutex));
 }
@@ -558,15 +713,15 @@ void state_watcher_flag_OFF_for_download_id(
                 state_watcher_t *state_watcher,
                 int download_id)
 {
-	unsigned short mask = 0;
+	unsigned long long mask = 0;
 
 	_da_thread_mutex_lock(&(state_watcher->mutex));
 
-	mask = ~(1 << download_id);
+	mask = ~(1ULL << download_id);
 
 	state_watcher->state_watching_bitmap &= mask;
 
-	DA_LOG(Default, "state_watcher [%d], download_id [%d]", state_watcher->state_watching_bitmap, download_id);
+	DA_LOG(Default, "state_watcher [%llx], download_id [%d]", state_watcher->state_watching_bitmap, download_id);
 
 	_da_thread_mutex_unlock(&(state_watcher->mutex));
 }
@@ -576,12 +731,12 @@ da_bool_t state_watcher_is_flag_on_for_download_id_Q(
                 int download_id)
 {
 	da_bool_t b_ret = DA_FALSE;
-	unsigned short mask = 0;
-	unsigned short result = 0;
+	unsigned long long mask = 0;
+	unsigned long long result = 0;
 
 	_da_thread_mutex_lock(&(state_watcher->mutex));
 
-	mask = 1 << download_id;
+	mask = 1ULL << download_id;
 
 	result = state_watcher->state_watching_bitmap & mask;
 
@@ -64,9 +64,9 @@ da_result_t requesting_download(stage_info *stage)
 		goto ERR;
 	}
 
-	_da_thread_mutex_lock (&mutex_download_state[GET_STAGE_DL_ID(stage)]);
+	_da_thread_mutex_lock (&GET_DL_MUTEX_STATE(GET_STAGE_DL_ID(stage)));
 	download_state = GET_DL_STATE_ON_STAGE(stage);
-	_da_thread_mutex_unlock (&mutex_download_state[GET_STAGE_DL_ID(stage)]);
+	_da_thread_mutex_unlock (&GET_DL_MUTEX_STATE(GET_STAGE_DL_ID(stage)));
 
 	/* Ignore  install content process if the download is failed or paused or canceled */
 	if (download_state == DOWNLOAD_STATE_PAUSED ||
@@ -84,6 +84,30 @@ da_result_t handle_after_download(stage_info *stage)
 
 	DA_LOG_FUNC_START(Default);
 
+	/* Server said that the file which client has is fresh.
+	 * There is nothing to install. */
+	if (DA_TRUE == GET_STAGE_TRANSACTION_INFO(stage)->is_not_modified) {
+		int download_id = GET_STAGE_DL_ID(stage);
+		char *validated_path =
+			GET_SOURCE_BASIC(GET_STAGE_SOURCE_INFO(stage))->validated_path;
+		int file_size = 0;
+
+		get_file_size(validated_path, &file_size);
+		DA_LOG(Default, "not modified [%s] size[%d]", validated_path,
+				file_size);
+		if (file_size < 0) {
+			DA_LOG_ERR(Default, "validated file is gone");
+			return DA_ERR_FAIL_TO_ACCESS_FILE;
+		}
+		send_client_update_downloading_info(
+				download_id,
+				GET_DL_REQ_ID(download_id),
+				file_size,
+				validated_path);
+		CHANGE_DOWNLOAD_STATE(DOWNLOAD_STATE_FINISH,stage);
+		return ret;
+	}
+
 	if (DA_TRUE == is_this_client_manual_download_type()) {
 		if (DA_RESULT_OK == ret) {
 			CHANGE_DOWNLOAD_STATE(DOWNLOAD_STATE_FINISH,stage);
@@ -147,7 +171,7 @@ static da_result_t __cancel_download_with_download_id(int download_id)
 
 	DA_LOG_FUNC_START(Default);
 
-	_da_thread_mutex_lock (&mutex_download_state[download_id]);
+	_da_thread_mutex_lock (&GET_DL_MUTEX_STATE(download_id));
 	download_state = GET_DL_STATE_ON_ID(download_id);
 	DA_LOG(Default, "download_state = %d", GET_DL_STATE_ON_ID(download_id));
 	if (download_state == DOWNLOAD_STATE_IDLE) {
@@ -155,10 +179,10 @@ static da_result_t __cancel_download_with_download_id(int download_id)
 		pthread_cancel(GET_DL_THREAD_ID(download_id));
 	} else if (download_state >= DOWNLOAD_STATE_READY_TO_INSTAL) {
 		DA_LOG_CRITICAL(Default, "Already download is completed. Do not send cancel request");
-		_da_thread_mutex_unlock (&mutex_download_state[download_id]);
+		_da_thread_mutex_unlock (&GET_DL_MUTEX_STATE(download_id));
 		return ret;
 	}
-	_da_thread_mutex_unlock (&mutex_download_state[download_id]);
+	_da_thread_mutex_unlock (&GET_DL_MUTEX_STATE(download_id));
 
 	stage = GET_DL_CURRENT_STAGE(download_id);
 	if (!stage)
@@ -228,7 +252,7 @@ da_result_t cancel_download_all(int dl_req_id)
 	}
 
 	for (iter = 0; iter < DA_MAX_DOWNLOAD_ID; iter++) {
-		if (download_mgr.download_info[iter].is_using == DA_TRUE) {
+		if (IS_THIS_DL_ID_USING(iter)) {
 			download_id = iter;
 
 			if (dl_req_id == DA_DOWNLOAD_REQ_ID_FOR_ALL_ITEMS_WITH_UNIFIED_NOTI) {
@@ -270,10 +294,10 @@ static da_result_t __suspend_download_with_download_id(int download_id)
 
 	DA_LOG_FUNC_START(Default);
 
-	_da_thread_mutex_lock (&mutex_download_state[download_id]);
+	_da_thread_mutex_lock (&GET_DL_MUTEX_STATE(download_id));
 	download_state = GET_DL_STATE_ON_ID(download_id);
 	DA_LOG(Default, "download_state = %d", GET_DL_STATE_ON_ID(download_id));
-	_da_thread_mutex_unlock (&mutex_download_state[download_id]);
+	_da_thread_mutex_unlock (&GET_DL_MUTEX_STATE(download_id));
 
 	stage = GET_DL_CURRENT_STAGE(download_id);
 	if (!stage)
@@ -342,7 +366,7 @@ da_result_t suspend_download_all(int dl_req_id)
 	}
 
 	for (iter = 0; iter < DA_MAX_DOWNLOAD_ID; iter++) {
-		if (download_mgr.download_info[iter].is_using == DA_TRUE) {
+		if (IS_THIS_DL_ID_USING(iter)) {
 			download_id = iter;
 			/* ToDo: retry if fail, check download_state, don't set flag for state_watcher if state is invalid */
 			ret = __suspend_download_with_download_id(download_id);
@@ -379,10 +403,10 @@ static da_result_t __resume_download_with_download_id(int download_id)
 
 	DA_LOG_FUNC_START(Default);
 
-	_da_thread_mutex_lock (&mutex_download_state[download_id]);
+	_da_thread_mutex_lock (&GET_DL_MUTEX_STATE(download_id));
 	download_state = GET_DL_STATE_ON_ID(download_id);
 	DA_LOG(Default, "download_state = %d", GET_DL_STATE_ON_ID(download_id));
-	_da_thread_mutex_unlock (&mutex_download_state[download_id]);
+	_da_thread_mutex_unlock (&GET_DL_MUTEX_STATE(download_id));
 
 	stage = GET_DL_CURRENT_STAGE(download_id);
 
@@ -446,7 +470,7 @@ da_result_t resume_download_all(int dl_req_id)
 	}
 
 	for (iter = 0; iter < DA_MAX_DOWNLOAD_ID; iter++) {
-		if (download_mgr.download_info[iter].is_using == DA_TRUE) {
+		if (IS_THIS_DL_ID_USING(iter)) {
 			download_id = iter;
 
 			if (dl_req_id == DA_DOWNLOAD_REQ_ID_FOR_ALL_ITEMS_WITH_UNIFIED_NOTI) {
@@ -488,10 +512,10 @@ da_result_t send_user_noti_and_finish_download_flow(int download_id)
 
 	DA_LOG_FUNC_START(Default);
 
-	_da_thread_mutex_lock (&mutex_download_state[download_id]);
+	_da_thread_mutex_lock (&GET_DL_MUTEX_STATE(download_id));
 	download_state = GET_DL_STATE_ON_ID(download_id);
 	DA_LOG(Default, "state = %d", download_state);
-	_da_thread_mutex_unlock (&mutex_download_state[download_id]);
+	_da_thread_mutex_unlock (&GET_DL_MUTEX_STATE(download_id));
 
 	switch (download_state) {
 	case DOWNLOAD_STATE_FINISH:
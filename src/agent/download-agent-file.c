@@ -23,9 +23,18 @@
  * @author		Jungki Kwak(jungki.kwak@samsung.com)
  ***/
 
-#include <dirent.h>
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE	/* for fallocate() */
+#endif
+
 #include <unistd.h>
 #include <math.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#include <linux/fs.h>
 
 #include "download-agent-client-mgr.h"
 #include "download-agent-debug.h"
@@ -35,12 +44,38 @@
 #include "download-agent-installation.h"
 #include "download-agent-mime-util.h"
 #include "download-agent-http-mgr.h"
+#include "download-agent-http-segment.h"
+#include "download-agent-disk-writer.h"
+#include "download-agent-digest.h"
+#include "download-agent-pthread.h"
+#include "download-agent-plugin-install.h"
+#include "download-agent-space.h"
 
 #define NO_NAME_TEMP_STR "No name"
 
+typedef struct _unique_path_hint_t {
+	char *path;	/* path without suffix */
+	int next_suffix;
+} unique_path_hint_t;
+
+static pthread_mutex_t mutex_unique_path = PTHREAD_MUTEX_INITIALIZER;
+static unique_path_hint_t unique_path_hint[DA_MAX_UNIQUE_PATH_HINT_COUNT];
+static int unique_path_hint_next = 0;
+
 static da_result_t  __set_file_size(stage_info *stage);
 static da_result_t  __tmp_file_open(stage_info *stage);
-
+static da_result_t __tmp_file_open_for_segment(stage_info *stage,
+		const char *file_path, int *out_fd);
+static da_result_t __preallocate_file(int fd, unsigned long long offset,
+		unsigned long long size, da_bool_t keep_size);
+static da_result_t __prepare_digest(stage_info *stage,
+		file_info *file_storage, const char *file_path);
+static int __get_durability(stage_info *stage);
+static int __get_drop_cache_size(stage_info *stage);
+
+static char *__get_install_dir_on_other_fs(stage_info *stage,
+		const char *tmp_dir, da_bool_t need_create);
+static char *__get_existing_dir(const char *dir);
 static char *__derive_extension(stage_info *stage);
 static da_result_t __divide_file_name_into_pure_name_N_extesion(
 		const char *in_file_name,
@@ -53,10 +88,20 @@ static da_result_t __file_write_buf_make_buf(file_info *file_storage);
 static da_result_t __file_write_buf_destroy_buf(file_info *file_storage);
 static da_result_t __file_write_buf_flush_buf(stage_info *stage,
 		file_info *file_storage);
-static da_result_t __file_write_buf_copy_to_buf(file_info *file_storage,
-		char *body, int body_len);
-static da_result_t __file_write_buf_directly_write(stage_info *stage,
-		file_info *file_storage, char *body, int body_len);
+static void __file_write_buf_add_to_buf(file_info *file_storage,
+		da_body_slice_t *body);
+
+static da_result_t __copy_by_clone(int src_fd, int dest_fd,
+		unsigned long long *copied);
+static da_result_t __copy_by_copy_file_range(int src_fd, int dest_fd,
+		unsigned long long size, unsigned long long *copied,
+		da_copy_progress_cb progress_cb, void *user_data);
+static da_result_t __copy_by_sendfile(int src_fd, int dest_fd,
+		unsigned long long size, unsigned long long *copied,
+		da_copy_progress_cb progress_cb, void *user_data);
+static da_result_t __copy_by_read_write(int src_fd, int dest_fd,
+		unsigned long long size, unsigned long long *copied,
+		da_copy_progress_cb progress_cb, void *user_data);
 
 
 da_result_t create_temp_saved_dir(void)
@@ -89,54 +134,6 @@ ERR:
 	return ret;
 }
 
-da_result_t clean_files_from_dir(char* dir_path)
-{
-	da_result_t ret = DA_RESULT_OK;
-	struct dirent *d = DA_NULL;
-	DIR *dir;
-	char file_path[DA_MAX_FULL_PATH_LEN] = { 0, };
-
-	DA_LOG_FUNC_START(FileManager);
-
-	if (dir_path == DA_NULL) {
-		ret = DA_ERR_INVALID_ARGUMENT;
-		goto ERR;
-	}
-
-	if (is_dir_exist(dir_path)) {
-		dir = opendir(dir_path);
-		if (DA_NULL == dir) {
-			DA_LOG_ERR(FileManager, "opendir() for DA_DEFAULT_TMP_FILE_DIR_PATH is failed.");
-			ret = DA_ERR_FAIL_TO_ACCESS_FILE;
-		} else {
-			while (DA_NULL != (d = readdir(dir))) {
-				DA_LOG(FileManager, "%s",d->d_name);
-				if (0 == strncmp(d->d_name, ".", strlen("."))
-						|| 0 == strncmp(d->d_name,
-								"..",
-								strlen(".."))) {
-					continue;
-				}
-
-				memset(file_path, 0x00, DA_MAX_FULL_PATH_LEN);
-				snprintf(file_path, DA_MAX_FULL_PATH_LEN,
-						"%s/%s", dir_path, d->d_name);
-				if (remove(file_path) < 0) {
-					DA_LOG_ERR(FileManager, "fail to remove file");
-				}
-			}
-
-			closedir(dir);
-			if (remove(dir_path) < 0) {
-				DA_LOG_ERR(FileManager, "fail to remove dir");
-			}
-		}
-	}
-
-ERR:
-	return ret;
-}
-
 /* Priority to obtain MIME Type
  * 1. HTTP response header's <Content-Type> field
  * 2. from OMA descriptor file's <content-type> attribute (mandatory field)
@@ -255,7 +252,8 @@ da_result_t __tmp_file_open(stage_info *stage)
 	file_info *file_storage = DA_NULL;
 	char *actual_file_path = DA_NULL;
 	char *tmp_file_path = DA_NULL;
-	void *fd = DA_NULL;
+	struct stat file_state;
+	int fd = -1;
 
 	DA_LOG_FUNC_START(FileManager);
 
@@ -278,13 +276,60 @@ da_result_t __tmp_file_open(stage_info *stage)
 	GET_CONTENT_STORE_TMP_FILE_NAME(file_storage) = tmp_file_path;
 	DA_LOG(FileManager, "GET_CONTENT_STORE_TMP_FILE_NAME = %s ",GET_CONTENT_STORE_TMP_FILE_NAME(file_storage));
 
-	fd = fopen(tmp_file_path, "a"); // for resume
-	if (fd == DA_NULL) {
-		DA_LOG_ERR(FileManager, "File open failed");
-		ret = DA_ERR_FAIL_TO_ACCESS_FILE;
+	if (IS_SEGMENTED_DOWNLOAD(stage)) {
+		ret = __tmp_file_open_for_segment(stage, tmp_file_path, &fd);
+		if (DA_RESULT_OK != ret)
+			goto ERR;
+		GET_CONTENT_STORE_FILE_OFFSET(file_storage) =
+				segment_get_main_offset(stage);
+	} else {
+		/* Not O_APPEND, because the disk writer writes with its own offset */
+		fd = open(tmp_file_path, O_WRONLY | O_CREAT, 0644);
+		if (fd < 0) {
+			DA_LOG_ERR(FileManager, "File open failed");
+			ret = DA_ERR_FAIL_TO_ACCESS_FILE;
+			goto ERR;
+		}
+		/* For resume, it is written after the existing data */
+		if (fstat(fd, &file_state) != 0) {
+			ret = DA_ERR_FAIL_TO_ACCESS_FILE;
+			close(fd);
+			goto ERR;
+		}
+		GET_CONTENT_STORE_FILE_OFFSET(file_storage) =
+				(unsigned long long)file_state.st_size;
+		/* The size is used for resume, so it should not be changed.
+		 * Only the range after the existing data is allocated */
+		ret = __preallocate_file(fd, (unsigned long long)file_state.st_size,
+				(unsigned long long)
+				GET_CONTENT_STORE_FILE_SIZE(file_storage), DA_TRUE);
+		if (DA_RESULT_OK != ret) {
+			close(fd);
+			goto ERR;
+		}
+	}
+	/* Blocks which are allocated already need not be reserved any more */
+	if (GET_CONTENT_STORE_SPACE_RESERVATION(file_storage) &&
+			fstat(fd, &file_state) == 0) {
+		unsigned long long allocated_size =
+				(unsigned long long)file_state.st_blocks * 512;
+		unsigned long long total_size =
+				GET_CONTENT_STORE_FILE_SIZE(file_storage);
+		space_shrink(GET_CONTENT_STORE_SPACE_RESERVATION(file_storage),
+				total_size > allocated_size ?
+				total_size - allocated_size : 0);
+	}
+
+	ret = __prepare_digest(stage, file_storage, tmp_file_path);
+	if (DA_RESULT_OK == ret)
+		ret = disk_writer_open(fd, __get_durability(stage),
+				__get_drop_cache_size(stage),
+				&GET_CONTENT_STORE_FILE_WRITE_JOB(file_storage));
+	if (DA_RESULT_OK != ret) {
+		close(fd);
 		goto ERR;
 	}
-	GET_CONTENT_STORE_FILE_HANDLE(file_storage) = fd;
+	GET_CONTENT_STORE_FILE_FD(file_storage) = fd;
 
 	DA_LOG(FileManager, "file path for tmp saving = %s", GET_CONTENT_STORE_TMP_FILE_NAME(file_storage));
 
@@ -295,12 +340,151 @@ ERR:
 		}
 		if (file_storage != DA_NULL) {
 			GET_CONTENT_STORE_TMP_FILE_NAME(file_storage) = DA_NULL;
-			GET_CONTENT_STORE_FILE_HANDLE(file_storage) = DA_NULL;
+			GET_CONTENT_STORE_FILE_FD(file_storage) = -1;
+		}
+	}
+	return ret;
+}
+
+/* Segment threads write on their own offsets of the file.
+ * So, the file is allocated with whole size and main segment is written
+ * from its current offset instead of appending */
+da_result_t __tmp_file_open_for_segment(stage_info *stage,
+		const char *file_path, int *out_fd)
+{
+	da_result_t ret = DA_RESULT_OK;
+	struct stat file_state;
+	unsigned long long total_size = 0;
+	int fd = -1;
+
+	DA_LOG_FUNC_START(FileManager);
+
+	fd = open(file_path, O_WRONLY | O_CREAT, 0644);
+	if (fd < 0) {
+		DA_LOG_ERR(FileManager, "open failed [%s]", strerror(errno));
+		ret = DA_ERR_FAIL_TO_ACCESS_FILE;
+		goto ERR;
+	}
+
+	total_size = segment_get_total_size(stage);
+	if (fstat(fd, &file_state) == 0 &&
+			(unsigned long long)file_state.st_size < total_size) {
+		ret = __preallocate_file(fd, 0, total_size, DA_FALSE);
+		if (DA_RESULT_OK != ret)
+			goto ERR;
+		/* Sparse file if the filesystem can not allocate it */
+		if (fstat(fd, &file_state) != 0 ||
+				(unsigned long long)file_state.st_size < total_size) {
+			if (ftruncate(fd, (off_t)total_size) != 0) {
+				DA_LOG_ERR(FileManager, "ftruncate failed [%s]", strerror(errno));
+				ret = DA_ERR_FAIL_TO_ACCESS_FILE;
+				goto ERR;
+			}
 		}
 	}
+
+	*out_fd = fd;
+	fd = -1;
+
+ERR:
+	if (fd >= 0)
+		close(fd);
 	return ret;
 }
 
+int __get_durability(stage_info *stage)
+{
+	source_info_basic_t *source_info_basic = DA_NULL;
+
+	source_info_basic = GET_SOURCE_BASIC(GET_STAGE_SOURCE_INFO(stage));
+	if (!source_info_basic)
+		return DA_DURABILITY_ON_COMPLETE;
+	return source_info_basic->durability;
+}
+
+int __get_drop_cache_size(stage_info *stage)
+{
+	source_info_basic_t *source_info_basic = DA_NULL;
+
+	source_info_basic = GET_SOURCE_BASIC(GET_STAGE_SOURCE_INFO(stage));
+	if (!source_info_basic)
+		return DA_DEFAULT_DROP_CACHE_SIZE;
+	return source_info_basic->drop_cache_size;
+}
+
+/* The digest is kept while paused. If it is not same with the data on the file,
+ * e.g. resumed by new process, the data on the file is hashed again once */
+da_result_t __prepare_digest(stage_info *stage, file_info *file_storage,
+		const char *file_path)
+{
+	da_result_t ret = DA_RESULT_OK;
+	source_info_basic_t *source_info_basic = DA_NULL;
+	da_digest_t *digest = DA_NULL;
+	unsigned long long offset = 0;
+
+	source_info_basic = GET_SOURCE_BASIC(GET_STAGE_SOURCE_INFO(stage));
+	/* Segments are not received in order. It is hashed at the end */
+	if (!source_info_basic || !source_info_basic->digest_algorithm ||
+			IS_SEGMENTED_DOWNLOAD(stage))
+		return ret;
+
+	offset = GET_CONTENT_STORE_FILE_OFFSET(file_storage);
+	digest = GET_CONTENT_STORE_DIGEST(file_storage);
+	if (digest && digest_get_len(digest) == offset)
+		return ret;
+	if (digest) {
+		digest_destroy(digest);
+		GET_CONTENT_STORE_DIGEST(file_storage) = DA_NULL;
+	}
+
+	ret = digest_create(source_info_basic->digest_algorithm, &digest);
+	if (DA_RESULT_OK != ret)
+		return ret;
+	ret = digest_update_from_file(digest, file_path, offset);
+	if (DA_RESULT_OK != ret) {
+		digest_destroy(digest);
+		return ret;
+	}
+	GET_CONTENT_STORE_DIGEST(file_storage) = digest;
+
+	return ret;
+}
+
+/* Blocks from offset to the end of the whole content (size) are allocated
+ * before writing, so that the file is not fragmented and ENOSPC is found
+ * at the start. With keep_size, the file size is not changed and the blocks
+ * over it are released by file_write_complete() */
+da_result_t __preallocate_file(int fd, unsigned long long offset,
+		unsigned long long size, da_bool_t keep_size)
+{
+	int mode = 0;
+
+	if (fd < 0 || size <= offset)
+		return DA_RESULT_OK;
+
+#ifdef FALLOC_FL_KEEP_SIZE
+	if (DA_TRUE == keep_size)
+		mode = FALLOC_FL_KEEP_SIZE;
+#else
+	if (DA_TRUE == keep_size)
+		return DA_RESULT_OK;
+#endif
+
+	if (fallocate(fd, mode, (off_t)offset, (off_t)(size - offset)) == 0) {
+		DA_LOG(FileManager, "allocated [%llu] from [%llu]",
+				size - offset, offset);
+		return DA_RESULT_OK;
+	}
+	if (errno == ENOSPC) {
+		DA_LOG_ERR(FileManager, "no space for [%llu] from [%llu]",
+				size - offset, offset);
+		return DA_ERR_DISK_FULL;
+	}
+	/* e.g. EOPNOTSUPP. The file grows while writing as before */
+	DA_LOG(FileManager, "fallocate failed [%s]", strerror(errno));
+	return DA_RESULT_OK;
+}
+
 da_result_t __set_file_size(stage_info *stage)
 {
 	da_result_t ret = DA_RESULT_OK;
@@ -504,6 +688,8 @@ da_result_t decide_final_file_path(stage_info *stage)
 	char *extension = DA_NULL;
 	char *tmp_file_path = DA_NULL;
 	char *file_name_without_extension = DA_NULL;
+	char *install_dir = DA_NULL;
+	char *hidden_file_name = DA_NULL;
 	file_info *file_info_data = DA_NULL;
 
 	DA_LOG_FUNC_START(FileManager);
@@ -521,7 +707,24 @@ da_result_t decide_final_file_path(stage_info *stage)
 		goto ERR;
 	}
 
-	tmp_file_path = get_full_path_avoided_duplication(default_dir, file_name_without_extension, extension);
+	install_dir = __get_install_dir_on_other_fs(stage, default_dir, DA_TRUE);
+	if (install_dir) {
+		/* Hidden one until it is renamed to the final name on install */
+		int hidden_len = strlen(DA_HIDDEN_TMP_FILE_PREFIX)
+				+ strlen(file_name_without_extension) + 1;
+		hidden_file_name = (char *)calloc(1, hidden_len);
+		if (!hidden_file_name) {
+			ret = DA_ERR_FAIL_TO_MEMALLOC;
+			goto ERR;
+		}
+		snprintf(hidden_file_name, hidden_len, "%s%s",
+				DA_HIDDEN_TMP_FILE_PREFIX, file_name_without_extension);
+		tmp_file_path = get_full_path_avoided_duplication(install_dir,
+				hidden_file_name, extension);
+	} else {
+		tmp_file_path = get_full_path_avoided_duplication(default_dir,
+				file_name_without_extension, extension);
+	}
 	if (tmp_file_path) {
 		GET_CONTENT_STORE_ACTUAL_FILE_NAME(GET_STAGE_CONTENT_STORE_INFO(stage))
 				= tmp_file_path;
@@ -548,6 +751,16 @@ ERR:
 		default_dir = DA_NULL;
 	}
 
+	if (install_dir) {
+		free(install_dir);
+		install_dir = DA_NULL;
+	}
+
+	if (hidden_file_name) {
+		free(hidden_file_name);
+		hidden_file_name = DA_NULL;
+	}
+
 	if (file_name_without_extension) {
 		free(file_name_without_extension);
 		file_name_without_extension = DA_NULL;
@@ -561,6 +774,170 @@ ERR:
 	return ret;
 }
 
+/* If the install directory is on other file system than the temporary one,
+ * the content is written on the install directory to be renamed at once.
+ * If need_create is DA_FALSE, the directory is not created, and its nearest
+ * existing parent is returned instead if it does not exist yet */
+char *__get_install_dir_on_other_fs(stage_info *stage, const char *tmp_dir,
+		da_bool_t need_create)
+{
+	char *install_dir = DA_NULL;
+	char *existing_dir = DA_NULL;
+	struct stat tmp_dir_state;
+	struct stat install_dir_state;
+
+	install_dir = GET_DL_USER_INSTALL_PATH(GET_STAGE_DL_ID(stage));
+	if (!install_dir)
+		install_dir = PI_get_default_install_dir();
+	if (!install_dir)
+		return DA_NULL;
+
+	if (DA_TRUE == need_create) {
+		if (DA_FALSE == is_dir_exist(install_dir) &&
+				DA_RESULT_OK != create_dir(install_dir))
+			return DA_NULL;
+		existing_dir = strdup(install_dir);
+	} else {
+		existing_dir = __get_existing_dir(install_dir);
+	}
+	if (!existing_dir)
+		return DA_NULL;
+
+	if (stat(tmp_dir, &tmp_dir_state) != 0 ||
+			stat(existing_dir, &install_dir_state) != 0 ||
+			tmp_dir_state.st_dev == install_dir_state.st_dev) {
+		free(existing_dir);
+		return DA_NULL;
+	}
+
+	DA_LOG(FileManager, "write on install dir [%s]", existing_dir);
+	return existing_dir;
+}
+
+/* The directory itself if it exists, or its nearest existing parent */
+static char *__get_existing_dir(const char *dir)
+{
+	char *path = DA_NULL;
+	char *ptr = DA_NULL;
+
+	path = strdup(dir);
+	if (!path)
+		return DA_NULL;
+
+	while (DA_FALSE == is_dir_exist(path)) {
+		ptr = strrchr(path, '/');
+		if (!ptr) {
+			free(path);
+			return DA_NULL;
+		}
+		if (ptr == path) {
+			/* Root always exists */
+			*(ptr + 1) = '\0';
+			break;
+		}
+		*ptr = '\0';
+	}
+	return path;
+}
+
+char *get_tmp_file_dir(stage_info *stage)
+{
+	file_info *file_storage = GET_STAGE_CONTENT_STORE_INFO(stage);
+	char *tmp_dir = DA_NULL;
+	char *ptr = DA_NULL;
+
+	/* Resumed one is written on the file which is decided already */
+	if (file_storage && GET_CONTENT_STORE_ACTUAL_FILE_NAME(file_storage)) {
+		tmp_dir = strdup(GET_CONTENT_STORE_ACTUAL_FILE_NAME(file_storage));
+		ptr = tmp_dir ? strrchr(tmp_dir, '/') : DA_NULL;
+		if (ptr && ptr != tmp_dir) {
+			*ptr = '\0';
+			return tmp_dir;
+		}
+		if (tmp_dir)
+			free(tmp_dir);
+		tmp_dir = DA_NULL;
+	}
+
+	if (DA_RESULT_OK != get_client_download_path(&tmp_dir) || !tmp_dir)
+		return DA_NULL;
+	/* Only looks for the file system. Nothing is created for the check */
+	ptr = __get_install_dir_on_other_fs(stage, tmp_dir, DA_FALSE);
+	if (ptr) {
+		free(tmp_dir);
+		tmp_dir = ptr;
+	}
+	return tmp_dir;
+}
+
+/* Should be called with mutex_unique_path locked */
+static int __find_suffix_hint(const char *path)
+{
+	int i = 0;
+
+	for (i = 0; i < DA_MAX_UNIQUE_PATH_HINT_COUNT; i++) {
+		if (unique_path_hint[i].path && !strcmp(unique_path_hint[i].path, path))
+			return i;
+	}
+	return -1;
+}
+
+static int __get_suffix_hint(const char *path)
+{
+	int index = -1;
+	int suffix = 0;
+
+	_da_thread_mutex_lock(&mutex_unique_path);
+	index = __find_suffix_hint(path);
+	if (index >= 0)
+		suffix = unique_path_hint[index].next_suffix;
+	_da_thread_mutex_unlock(&mutex_unique_path);
+	return suffix;
+}
+
+static void __set_suffix_hint(const char *path, int next_suffix)
+{
+	int index = -1;
+
+	_da_thread_mutex_lock(&mutex_unique_path);
+	index = __find_suffix_hint(path);
+	if (index < 0) {
+		/* Replace the oldest one */
+		index = unique_path_hint_next;
+		unique_path_hint_next = (unique_path_hint_next + 1) %
+				DA_MAX_UNIQUE_PATH_HINT_COUNT;
+		if (unique_path_hint[index].path)
+			free(unique_path_hint[index].path);
+		unique_path_hint[index].path = strdup(path);
+	}
+	unique_path_hint[index].next_suffix = next_suffix;
+	_da_thread_mutex_unlock(&mutex_unique_path);
+}
+
+static void __make_path_with_suffix(char *out_path, int path_len,
+		const char *dir, const char *file_name, const char *extension,
+		int suffix_count)
+{
+	/* e.g) /tmp/abc.jpg
+	 * if there is no extension name, just make a file name without extension */
+	if (!extension || 0 == strlen(extension)) {
+		if (suffix_count == 0)
+			snprintf(out_path, path_len, "%s/%s", dir, file_name);
+		else
+			snprintf(out_path, path_len, "%s/%s_%d", dir, file_name,
+					suffix_count);
+	} else {
+		if (suffix_count == 0)
+			snprintf(out_path, path_len, "%s/%s.%s", dir, file_name,
+					extension);
+		else
+			snprintf(out_path, path_len, "%s/%s_%d.%s", dir, file_name,
+					suffix_count, extension);
+	}
+}
+
+/* The returned path is created as an empty file with O_EXCL, so that it is
+ * not taken by other downloads. It should be replaced or removed by caller */
 char *get_full_path_avoided_duplication(char *in_dir, char *in_candidate_file_name, char * in_extension)
 {
 	char *dir = in_dir;
@@ -571,9 +948,12 @@ char *get_full_path_avoided_duplication(char *in_dir, char *in_candidate_file_na
 	int final_path_len = 0;
 	int extension_len = 0;
 
-	int suffix_count = 0;	/* means suffix on file name. up to "_99" */
-	const int max_suffix_count = 99;
+	int suffix_count = 0;	/* means suffix on file name. up to "_9999" */
+	int tried_count = 0;
+	const int max_suffix_count = DA_MAX_FILE_NAME_SUFFIX;
 	int suffix_len = (int)log10(max_suffix_count+1) + 1;	/* 1 means "_" */
+	int fd = -1;
+	char *hint_key = DA_NULL;
 
 	if (!in_dir || !in_candidate_file_name)
 		return DA_NULL;
@@ -594,44 +974,43 @@ char *get_full_path_avoided_duplication(char *in_dir, char *in_candidate_file_na
 		return DA_NULL;
 	}
 
-	do {
-		/* e.g) /tmp/abc.jpg
-		 * if there is no extension name, just make a file name without extension */
-		if (0 == extension_len) {
-			if (suffix_count == 0) {
-				snprintf(final_path, final_path_len,
-						"%s/%s", dir, file_name);
-			} else {
-				snprintf(final_path, final_path_len,
-						"%s/%s_%d", dir, file_name, suffix_count);
-			}
-		} else {
-			if (suffix_count == 0) {
-				snprintf(final_path, final_path_len,
-						"%s/%s.%s", dir, file_name, extension);
-			} else {
-				snprintf(final_path, final_path_len,
-						"%s/%s_%d.%s",
-						dir, file_name, suffix_count, extension);
-			}
-		}
-
-		if (is_file_exist(final_path)) {
-			suffix_count++;
-			if (suffix_count > max_suffix_count) {
-				free(final_path);
-				final_path = DA_NULL;
-				break;
-			} else {
-				memset(final_path, 0x00, final_path_len);
-				continue;
-			}
+	/* The path without suffix is the key of the hint */
+	__make_path_with_suffix(final_path, final_path_len, dir, file_name,
+			extension, 0);
+	hint_key = strdup(final_path);
+	if (hint_key)
+		suffix_count = __get_suffix_hint(hint_key);
+
+	/* Try from the next one of the last decided suffix. If all of them are
+	 * taken, try from "_1" again because some ones may be removed */
+	for (tried_count = 0; tried_count <= max_suffix_count; tried_count++) {
+		__make_path_with_suffix(final_path, final_path_len, dir,
+				file_name, extension, suffix_count);
+		fd = open(final_path, O_WRONLY | O_CREAT | O_EXCL, 0644);
+		if (fd >= 0)
+			break;
+		if (errno != EEXIST) {
+			DA_LOG_ERR(FileManager, "open failed [%s] [%s]", final_path,
+					strerror(errno));
+			break;
 		}
+		suffix_count++;
+		if (suffix_count > max_suffix_count)
+			suffix_count = 0;
+	}
 
-		break;
-	} while (1);
+	if (fd < 0) {
+		free(final_path);
+		final_path = DA_NULL;
+	} else {
+		close(fd);
+		if (hint_key)
+			__set_suffix_hint(hint_key, suffix_count + 1);
+	}
+	if (hint_key)
+		free(hint_key);
 
-	DA_LOG(FileManager, "decided path = [%s]", final_path);
+	DA_LOG(FileManager, "decided path = [%s] tried[%d]", final_path, tried_count + 1);
 	return final_path;
 }
 
@@ -690,17 +1069,19 @@ da_result_t __divide_file_name_into_pure_name_N_extesion(const char *in_file_nam
 da_result_t __file_write_buf_make_buf(file_info *file_storage)
 {
 	da_result_t ret = DA_RESULT_OK;
-	char *buffer = DA_NULL;
+	da_body_slice_t *slices = DA_NULL;
 
 	DA_LOG_FUNC_START(FileManager);
 
-	buffer = (char*) calloc(DOWNLOAD_NOTIFY_LIMIT, 1);
-	if (DA_NULL == buffer) {
+	slices = (da_body_slice_t *) calloc(DA_MAX_PENDING_SLICE_COUNT,
+			sizeof(da_body_slice_t));
+	if (DA_NULL == slices) {
 		DA_LOG_ERR(FileManager, "Calloc failure ");
 		ret = DA_ERR_FAIL_TO_MEMALLOC;
 	} else {
 		GET_CONTENT_STORE_FILE_BUFF_LEN(file_storage) = 0;
-		GET_CONTENT_STORE_FILE_BUFFER(file_storage) = buffer;
+		GET_CONTENT_STORE_FILE_SLICE_COUNT(file_storage) = 0;
+		GET_CONTENT_STORE_FILE_SLICES(file_storage) = slices;
 	}
 
 	return ret;
@@ -709,121 +1090,93 @@ da_result_t __file_write_buf_make_buf(file_info *file_storage)
 da_result_t __file_write_buf_destroy_buf(file_info *file_storage)
 {
 	da_result_t ret = DA_RESULT_OK;
+	da_body_slice_t *slices = DA_NULL;
+	int i = 0;
 
 	DA_LOG_FUNC_START(FileManager);
 
-	if (GET_CONTENT_STORE_FILE_BUFFER(file_storage))
-		free(GET_CONTENT_STORE_FILE_BUFFER(file_storage));
+	slices = GET_CONTENT_STORE_FILE_SLICES(file_storage);
+	if (slices) {
+		for (i = 0; i < GET_CONTENT_STORE_FILE_SLICE_COUNT(file_storage); i++)
+			release_body_slice(&slices[i]);
+		free(slices);
+	}
 
-	GET_CONTENT_STORE_FILE_BUFFER(file_storage) = DA_NULL;
+	GET_CONTENT_STORE_FILE_SLICES(file_storage) = DA_NULL;
+	GET_CONTENT_STORE_FILE_SLICE_COUNT(file_storage) = 0;
 	GET_CONTENT_STORE_FILE_BUFF_LEN(file_storage) = 0;
 
 	return ret;
 }
 
+/* The buffer is handed to the disk writer, and a new one is made on next write */
 da_result_t __file_write_buf_flush_buf(stage_info *stage, file_info *file_storage)
 {
 	da_result_t ret = DA_RESULT_OK;
-	char *buffer = DA_NULL;
-	int buffer_size = 0;
-	int write_success_len = 0;
-	void *fd = DA_NULL;
+	da_body_slice_t *slices = DA_NULL;
+	int slice_count = 0;
+	int len = 0;
 
 	//	DA_LOG_FUNC_START(FileManager);
 
-	buffer = GET_CONTENT_STORE_FILE_BUFFER(file_storage);
-	buffer_size = GET_CONTENT_STORE_FILE_BUFF_LEN(file_storage);
+	slices = GET_CONTENT_STORE_FILE_SLICES(file_storage);
+	slice_count = GET_CONTENT_STORE_FILE_SLICE_COUNT(file_storage);
+	len = GET_CONTENT_STORE_FILE_BUFF_LEN(file_storage);
 
-	if (buffer_size == 0) {
+	if (slice_count == 0) {
 		DA_LOG_ERR(FileManager, "no data on buffer..");
 		return ret;
 	}
 
-	fd = GET_CONTENT_STORE_FILE_HANDLE(file_storage);
-	if (DA_NULL == fd) {
+	if (DA_NULL == GET_CONTENT_STORE_FILE_WRITE_JOB(file_storage)) {
 		DA_LOG_ERR(FileManager, "There is no file handle.");
-
 		ret = DA_ERR_FAIL_TO_ACCESS_FILE;
 		goto ERR;
 	}
 
-	write_success_len = fwrite(buffer, sizeof(char), buffer_size,
-			(FILE *) fd);
-	fflush((FILE *) fd);
-	if (write_success_len != buffer_size) {
-		DA_LOG_ERR(FileManager, "write  fails ");
-		ret = DA_ERR_FAIL_TO_ACCESS_FILE;
+	GET_CONTENT_STORE_FILE_SLICES(file_storage) = DA_NULL;
+	GET_CONTENT_STORE_FILE_SLICE_COUNT(file_storage) = 0;
+	GET_CONTENT_STORE_FILE_BUFF_LEN(file_storage) = 0;
+
+	/* The offset is kept by us, not by the descriptor */
+	ret = disk_writer_submit(GET_CONTENT_STORE_FILE_WRITE_JOB(file_storage),
+			slices, slice_count, len,
+			GET_CONTENT_STORE_FILE_OFFSET(file_storage));
+	if (ret != DA_RESULT_OK)
 		goto ERR;
-	}
+	GET_CONTENT_STORE_FILE_OFFSET(file_storage) += len;
+	space_consume(GET_CONTENT_STORE_SPACE_RESERVATION(file_storage), len);
 	GET_CONTENT_STORE_CURRENT_FILE_SIZE(GET_STAGE_CONTENT_STORE_INFO(stage))
-			+= write_success_len;
-	DA_LOG(FileManager, "write %d bytes", write_success_len);
-
-	IS_CONTENT_STORE_FILE_BYTES_WRITTEN_TO_FILE(file_storage) = DA_TRUE;
-	GET_CONTENT_STORE_FILE_BUFF_LEN(file_storage) = 0;
+			+= len;
+	DA_LOG(FileManager, "write %d bytes", len);
 
 ERR:
 	return ret;
 }
 
-da_result_t __file_write_buf_copy_to_buf(file_info *file_storage, char *body,
-		int body_len)
-{
-	da_result_t ret = DA_RESULT_OK;
-	char *buffer = DA_NULL;
-	int buffer_size = 0;
-
-	//	DA_LOG_FUNC_START(FileManager);
-
-	buffer = GET_CONTENT_STORE_FILE_BUFFER(file_storage);
-	buffer_size = GET_CONTENT_STORE_FILE_BUFF_LEN(file_storage);
-
-	memcpy(buffer + buffer_size, body, body_len);
-	GET_CONTENT_STORE_FILE_BUFF_LEN(file_storage) += body_len;
-
-	return ret;
-}
-
-da_result_t __file_write_buf_directly_write(stage_info *stage,
-		file_info *file_storage, char *body, int body_len)
+/* The slice is moved to the buffer without copying the body */
+void __file_write_buf_add_to_buf(file_info *file_storage,
+		da_body_slice_t *body)
 {
-	da_result_t ret = DA_RESULT_OK;
-	int write_success_len = 0;
-	void *fd = DA_NULL;
+	int index = 0;
 
 	//	DA_LOG_FUNC_START(FileManager);
 
-	fd = GET_CONTENT_STORE_FILE_HANDLE(file_storage);
-	if (DA_NULL == fd) {
-		DA_LOG_ERR(FileManager, "There is no file handle.");
-
-		ret = DA_ERR_FAIL_TO_ACCESS_FILE;
-		goto ERR;
-	}
-
-	write_success_len = fwrite(body, sizeof(char), body_len,
-			(FILE *) fd);
-	fflush((FILE *) fd);
-	if (write_success_len != body_len) {
-		DA_LOG_ERR(FileManager, "write  fails ");
-		ret = DA_ERR_FAIL_TO_ACCESS_FILE;
-		goto ERR;
-	}
-	GET_CONTENT_STORE_CURRENT_FILE_SIZE(GET_STAGE_CONTENT_STORE_INFO(stage))
-			+= write_success_len;
-	DA_LOG(FileManager, "write %d bytes", write_success_len);
-	IS_CONTENT_STORE_FILE_BYTES_WRITTEN_TO_FILE(file_storage) = DA_TRUE;
+	index = GET_CONTENT_STORE_FILE_SLICE_COUNT(file_storage);
+	GET_CONTENT_STORE_FILE_SLICES(file_storage)[index] = *body;
+	GET_CONTENT_STORE_FILE_SLICE_COUNT(file_storage)++;
+	GET_CONTENT_STORE_FILE_BUFF_LEN(file_storage) += body->len;
 
-ERR:
-	return ret;
+	body->data = DA_NULL;
+	body->len = 0;
+	body->owner = DA_NULL;
+	body->release = DA_NULL;
 }
 
-da_result_t file_write_ongoing(stage_info *stage, char *body, int body_len)
+da_result_t file_write_ongoing(stage_info *stage, da_body_slice_t *body)
 {
 	da_result_t ret = DA_RESULT_OK;
 	file_info *file_storage = DA_NULL;
-	int buffer_size = 0;
-	char *buffer = DA_NULL;
 
 	//	DA_LOG_FUNC_START(FileManager);
 
@@ -837,56 +1190,39 @@ da_result_t file_write_ongoing(stage_info *stage, char *body, int body_len)
 		goto ERR;
 	}
 
-	buffer = GET_CONTENT_STORE_FILE_BUFFER(file_storage);
-	buffer_size = GET_CONTENT_STORE_FILE_BUFF_LEN(file_storage);
 	IS_CONTENT_STORE_FILE_BYTES_WRITTEN_TO_FILE(file_storage) = DA_FALSE;
 
-	if (DA_NULL == buffer) {
-		if (body_len < DOWNLOAD_NOTIFY_LIMIT) {
-			ret = __file_write_buf_make_buf(file_storage);
-			if (ret != DA_RESULT_OK)
-				goto ERR;
+	if (DA_NULL == GET_CONTENT_STORE_FILE_SLICES(file_storage)) {
+		ret = __file_write_buf_make_buf(file_storage);
+		if (ret != DA_RESULT_OK)
+			goto ERR;
+	}
 
-			__file_write_buf_copy_to_buf(file_storage, body, body_len);
-		} else {
-			ret = __file_write_buf_directly_write(stage,
-					file_storage, body, body_len);
-			if (ret != DA_RESULT_OK)
-				goto ERR;
-		}
-	} else {
-		if (DOWNLOAD_NOTIFY_LIMIT <= body_len) {
-			ret = __file_write_buf_flush_buf(stage, file_storage);
-			if (ret != DA_RESULT_OK)
-				goto ERR;
+	/* Progress is notified with received size, whether it is written or not */
+	GET_CONTENT_STORE_FILE_UNNOTIFIED_LEN(file_storage) += body->len;
+	if (DOWNLOAD_NOTIFY_LIMIT <= GET_CONTENT_STORE_FILE_UNNOTIFIED_LEN(file_storage)) {
+		IS_CONTENT_STORE_FILE_BYTES_WRITTEN_TO_FILE(file_storage) = DA_TRUE;
+		GET_CONTENT_STORE_FILE_UNNOTIFIED_LEN(file_storage) = 0;
+	}
 
-			ret = __file_write_buf_directly_write(stage,
-					file_storage, body, body_len);
-			if (ret != DA_RESULT_OK)
-				goto ERR;
+	if (GET_CONTENT_STORE_DIGEST(file_storage))
+		digest_update(GET_CONTENT_STORE_DIGEST(file_storage), body->data,
+				body->len);
 
-		} else if ((DOWNLOAD_NOTIFY_LIMIT - buffer_size) <= body_len) {
-			ret = __file_write_buf_flush_buf(stage, file_storage);
-			if (ret != DA_RESULT_OK)
-				goto ERR;
+	__file_write_buf_add_to_buf(file_storage, body);
 
-			__file_write_buf_copy_to_buf(file_storage, body, body_len);
-		} else {
-			__file_write_buf_copy_to_buf(file_storage, body, body_len);
-		}
+	if (DA_FILE_WRITE_BUF_SIZE <= GET_CONTENT_STORE_FILE_BUFF_LEN(file_storage) ||
+			DA_MAX_PENDING_SLICE_COUNT <=
+			GET_CONTENT_STORE_FILE_SLICE_COUNT(file_storage)) {
+		ret = __file_write_buf_flush_buf(stage, file_storage);
+		if (ret != DA_RESULT_OK)
+			goto ERR;
 	}
 
 ERR:
 	if (ret != DA_RESULT_OK) {
-		if (file_storage) {
-			GET_CONTENT_STORE_FILE_BUFF_LEN(file_storage) = 0;
-			if (GET_CONTENT_STORE_FILE_BUFFER(file_storage)) {
-				free(
-						GET_CONTENT_STORE_FILE_BUFFER(file_storage));
-				GET_CONTENT_STORE_FILE_BUFFER(file_storage)
-						= DA_NULL;
-			}
-		}
+		if (file_storage)
+			__file_write_buf_destroy_buf(file_storage);
 	}
 	return ret;
 }
@@ -895,9 +1231,7 @@ da_result_t file_write_complete(stage_info *stage)
 {
 	da_result_t ret = DA_RESULT_OK;
 	file_info*file_storage = DA_NULL;
-	char *buffer = DA_NULL;
-	unsigned int buffer_size = 0;
-	void *fd = DA_NULL;
+	int fd = -1;
 
 	DA_LOG_FUNC_START(FileManager);
 
@@ -911,29 +1245,107 @@ da_result_t file_write_complete(stage_info *stage)
 		goto ERR;
 	}
 
-	buffer = GET_CONTENT_STORE_FILE_BUFFER(file_storage);
-	buffer_size = GET_CONTENT_STORE_FILE_BUFF_LEN(file_storage);
+	if (GET_CONTENT_STORE_FILE_SLICE_COUNT(file_storage) != 0) {
+		ret = __file_write_buf_flush_buf(stage, file_storage);
+		if (ret != DA_RESULT_OK)
+			goto ERR;
+	}
+	__file_write_buf_destroy_buf(file_storage);
 
-	if (DA_NULL == buffer) {
-		DA_LOG_ERR(FileManager, "file buffer is DA_NULL");
-	} else {
-		if (buffer_size != 0) {
-			ret = __file_write_buf_flush_buf(stage, file_storage);
-			if (ret != DA_RESULT_OK)
-				goto ERR;
+	if (GET_CONTENT_STORE_FILE_WRITE_JOB(file_storage)) {
+		ret = disk_writer_close(GET_CONTENT_STORE_FILE_WRITE_JOB(file_storage));
+		GET_CONTENT_STORE_FILE_WRITE_JOB(file_storage) = DA_NULL;
+		if (ret != DA_RESULT_OK)
+			goto ERR;
+	}
+	fd = GET_CONTENT_STORE_FILE_FD(file_storage);
+
+	if (fd >= 0) {
+		struct stat file_state;
+		/* Release the blocks allocated over the real size */
+		if (fstat(fd, &file_state) != 0)
+			file_state.st_size = 0;
+		else if (ftruncate(fd, file_state.st_size) != 0)
+			DA_LOG_ERR(FileManager, "ftruncate failed [%s]", strerror(errno));
+		if (DA_DURABILITY_NONE != __get_durability(stage)) {
+			fsync(fd);
+			/* All the pages are clean now */
+			disk_writer_drop_cache(fd, __get_drop_cache_size(stage),
+					(unsigned long long)file_state.st_size, 0, 0);
 		}
-		__file_write_buf_destroy_buf(file_storage);
+		close(fd);
+		fd = -1;
+	}
+	GET_CONTENT_STORE_FILE_FD(file_storage) = -1;
+	GET_CONTENT_STORE_FILE_UNNOTIFIED_LEN(file_storage) = 0;
+	if (GET_CONTENT_STORE_SPACE_RESERVATION(file_storage)) {
+		space_release(GET_CONTENT_STORE_SPACE_RESERVATION(file_storage));
+		GET_CONTENT_STORE_SPACE_RESERVATION(file_storage) = DA_NULL;
 	}
-	fd = GET_CONTENT_STORE_FILE_HANDLE(file_storage);
+ERR:
+	return ret;
+}
+
+da_result_t file_verify_digest(stage_info *stage)
+{
+	da_result_t ret = DA_RESULT_OK;
+	source_info_basic_t *source_info_basic = DA_NULL;
+	file_info *file_storage = DA_NULL;
+	da_digest_t *digest = DA_NULL;
+	da_digest_t *file_digest = DA_NULL;
+	struct stat file_state;
+	char *hex = DA_NULL;
+	int download_id = GET_STAGE_DL_ID(stage);
 
-	if (fd) {
-		// call sync
-		fsync(fileno(fd));
-		fclose(fd);
-		fd = DA_NULL;
+	DA_LOG_FUNC_START(FileManager);
+
+	if (DA_TRUE == is_this_client_manual_download_type())
+		return ret;
+	source_info_basic = GET_SOURCE_BASIC(GET_STAGE_SOURCE_INFO(stage));
+	if (!source_info_basic || !source_info_basic->digest_algorithm)
+		return ret;
+	file_storage = GET_STAGE_CONTENT_STORE_INFO(stage);
+
+	digest = GET_CONTENT_STORE_DIGEST(file_storage);
+	if (!digest) {
+		/* Segmented download. The whole file is read once */
+		if (stat(GET_CONTENT_STORE_TMP_FILE_NAME(file_storage), &file_state) != 0)
+			return DA_ERR_FAIL_TO_ACCESS_FILE;
+		ret = digest_create(source_info_basic->digest_algorithm, &file_digest);
+		if (DA_RESULT_OK != ret)
+			return ret;
+		ret = digest_update_from_file(file_digest,
+				GET_CONTENT_STORE_TMP_FILE_NAME(file_storage),
+				(unsigned long long)file_state.st_size);
+		if (DA_RESULT_OK != ret)
+			goto ERR;
+		digest = file_digest;
 	}
-	GET_CONTENT_STORE_FILE_HANDLE(file_storage) = DA_NULL;
+
+	hex = digest_get_hex(digest);
+	if (!hex) {
+		ret = DA_ERR_FAIL_TO_MEMALLOC;
+		goto ERR;
+	}
+	DA_LOG(FileManager, "%s [%s]", source_info_basic->digest_algorithm, hex);
+
+	if (source_info_basic->digest_expected &&
+			DA_FALSE == digest_is_same(hex, source_info_basic->digest_expected)) {
+		DA_LOG_ERR(FileManager, "expected [%s]", source_info_basic->digest_expected);
+		ret = DA_ERR_MISMATCH_DIGEST;
+		goto ERR;
+	}
+
+	if (GET_DL_DIGEST(download_id))
+		free(GET_DL_DIGEST(download_id));
+	GET_DL_DIGEST(download_id) = hex;
+	hex = DA_NULL;
+
 ERR:
+	if (hex)
+		free(hex);
+	if (file_digest)
+		digest_destroy(file_digest);
 	return ret;
 }
 
@@ -989,19 +1401,31 @@ da_result_t discard_download(stage_info *stage)
 	da_result_t ret = DA_RESULT_OK;
 	file_info *file_storage = DA_NULL;
 	char *temp_file_path = DA_NULL;
-	FILE *f_handle = DA_NULL;
 
 	DA_LOG_FUNC_START(FileManager);
 
 	file_storage = GET_STAGE_CONTENT_STORE_INFO(stage);
 
-	f_handle = GET_CONTENT_STORE_FILE_HANDLE(file_storage);
-	if (f_handle) {
-		fclose(f_handle);
-		GET_CONTENT_STORE_FILE_HANDLE(file_storage) = DA_NULL;
+	__file_write_buf_destroy_buf(file_storage);
+	if (GET_CONTENT_STORE_FILE_WRITE_JOB(file_storage)) {
+		disk_writer_close(GET_CONTENT_STORE_FILE_WRITE_JOB(file_storage));
+		GET_CONTENT_STORE_FILE_WRITE_JOB(file_storage) = DA_NULL;
+	}
+	if (IS_CONTENT_STORE_FILE_OPENED(file_storage)) {
+		close(GET_CONTENT_STORE_FILE_FD(file_storage));
+		GET_CONTENT_STORE_FILE_FD(file_storage) = -1;
+	}
+	if (GET_CONTENT_STORE_DIGEST(file_storage)) {
+		digest_destroy(GET_CONTENT_STORE_DIGEST(file_storage));
+		GET_CONTENT_STORE_DIGEST(file_storage) = DA_NULL;
+	}
+	if (GET_CONTENT_STORE_SPACE_RESERVATION(file_storage)) {
+		space_release(GET_CONTENT_STORE_SPACE_RESERVATION(file_storage));
+		GET_CONTENT_STORE_SPACE_RESERVATION(file_storage) = DA_NULL;
 	}
 	temp_file_path = GET_CONTENT_STORE_ACTUAL_FILE_NAME(file_storage);
 	if (temp_file_path) {
+		segment_remove_map(stage);
 		remove_file((const char*) temp_file_path);
 		free(temp_file_path);
 		GET_CONTENT_STORE_ACTUAL_FILE_NAME(file_storage) = DA_NULL;
@@ -1014,19 +1438,32 @@ void clean_paused_file(stage_info *stage)
 {
 	file_info *file_info_data = DA_NULL;
 	char *paused_file_path = DA_NULL;
-	FILE *fd = DA_NULL;
 
 	DA_LOG_FUNC_START(FileManager);
 
 	file_info_data = GET_STAGE_CONTENT_STORE_INFO(stage);
 
-	fd = GET_CONTENT_STORE_FILE_HANDLE(file_info_data);
-	if (fd) {
-		fclose(fd);
-		GET_CONTENT_STORE_FILE_HANDLE(file_info_data) = DA_NULL;
+	__file_write_buf_destroy_buf(file_info_data);
+	if (GET_CONTENT_STORE_FILE_WRITE_JOB(file_info_data)) {
+		disk_writer_close(GET_CONTENT_STORE_FILE_WRITE_JOB(file_info_data));
+		GET_CONTENT_STORE_FILE_WRITE_JOB(file_info_data) = DA_NULL;
+	}
+	if (IS_CONTENT_STORE_FILE_OPENED(file_info_data)) {
+		close(GET_CONTENT_STORE_FILE_FD(file_info_data));
+		GET_CONTENT_STORE_FILE_FD(file_info_data) = -1;
+	}
+
+	if (GET_CONTENT_STORE_DIGEST(file_info_data)) {
+		digest_destroy(GET_CONTENT_STORE_DIGEST(file_info_data));
+		GET_CONTENT_STORE_DIGEST(file_info_data) = DA_NULL;
+	}
+	if (GET_CONTENT_STORE_SPACE_RESERVATION(file_info_data)) {
+		space_release(GET_CONTENT_STORE_SPACE_RESERVATION(file_info_data));
+		GET_CONTENT_STORE_SPACE_RESERVATION(file_info_data) = DA_NULL;
 	}
 
 	paused_file_path = GET_CONTENT_STORE_ACTUAL_FILE_NAME(file_info_data);
+	segment_remove_map(stage);
 	remove_file((const char*) paused_file_path);
 
 	return;
@@ -1069,53 +1506,214 @@ ERR:
 
 }
 
+/* DA_RESULT_OK without copying anything if the filesystem can not share the blocks */
+da_result_t __copy_by_clone(int src_fd, int dest_fd, unsigned long long *copied)
+{
+#ifdef FICLONE
+	if (ioctl(dest_fd, FICLONE, src_fd) == 0) {
+		struct stat file_state;
+		if (fstat(dest_fd, &file_state) == 0)
+			*copied = (unsigned long long)file_state.st_size;
+		DA_LOG(FileManager, "cloned [%llu]", *copied);
+	}
+#endif
+	return DA_RESULT_OK;
+}
+
+/* Each method continues from *copied, and stops without error
+ * if it is not supported, so that the next one can do the rest */
+da_result_t __copy_by_copy_file_range(int src_fd, int dest_fd,
+		unsigned long long size, unsigned long long *copied,
+		da_copy_progress_cb progress_cb, void *user_data)
+{
+#ifdef __NR_copy_file_range
+	loff_t src_offset = 0;
+	loff_t dest_offset = 0;
+	size_t len = 0;
+	long copy_len = 0;
+
+	while (*copied < size) {
+		src_offset = dest_offset = (loff_t)*copied;
+		len = DA_COPY_CHUNK_SIZE;
+		if ((unsigned long long)len > size - *copied)
+			len = size - *copied;
+		copy_len = syscall(__NR_copy_file_range, src_fd, &src_offset,
+				dest_fd, &dest_offset, len, 0);
+		if (copy_len < 0 && errno == EINTR)
+			continue;
+		if (copy_len < 0 && errno == ENOSPC)
+			return DA_ERR_DISK_FULL;
+		/* e.g. ENOSYS, or EXDEV on old kernels */
+		if (copy_len <= 0)
+			break;
+		*copied += copy_len;
+		if (progress_cb)
+			progress_cb(*copied, size, user_data);
+	}
+#endif
+	return DA_RESULT_OK;
+}
+
+da_result_t __copy_by_sendfile(int src_fd, int dest_fd,
+		unsigned long long size, unsigned long long *copied,
+		da_copy_progress_cb progress_cb, void *user_data)
+{
+	off_t src_offset = 0;
+	size_t len = 0;
+	ssize_t copy_len = 0;
+
+	/* sendfile() writes on the current position of dest_fd */
+	if (lseek(dest_fd, (off_t)*copied, SEEK_SET) < 0)
+		return DA_RESULT_OK;
+
+	while (*copied < size) {
+		src_offset = (off_t)*copied;
+		len = DA_COPY_CHUNK_SIZE;
+		if ((unsigned long long)len > size - *copied)
+			len = size - *copied;
+		copy_len = sendfile(dest_fd, src_fd, &src_offset, len);
+		if (copy_len < 0 && errno == EINTR)
+			continue;
+		if (copy_len < 0 && errno == ENOSPC)
+			return DA_ERR_DISK_FULL;
+		if (copy_len <= 0)
+			break;
+		*copied += copy_len;
+		if (progress_cb)
+			progress_cb(*copied, size, user_data);
+	}
+	return DA_RESULT_OK;
+}
+
+da_result_t __copy_by_read_write(int src_fd, int dest_fd,
+		unsigned long long size, unsigned long long *copied,
+		da_copy_progress_cb progress_cb, void *user_data)
+{
+	da_result_t ret = DA_RESULT_OK;
+	char *buff = DA_NULL;
+	ssize_t read_len = 0;
+	ssize_t write_len = 0;
+	ssize_t written = 0;
+	unsigned long long last_notified = *copied;
+
+	buff = (char *)malloc(DA_COPY_BUF_SIZE);
+	if (!buff)
+		return DA_ERR_FAIL_TO_MEMALLOC;
+
+	while (*copied < size) {
+		read_len = pread(src_fd, buff, DA_COPY_BUF_SIZE, (off_t)*copied);
+		if (read_len < 0 && errno == EINTR)
+			continue;
+		if (read_len <= 0) {
+			DA_LOG_ERR(FileManager, "read fails [%d]", errno);
+			ret = DA_ERR_FAIL_TO_ACCESS_FILE;
+			goto ERR;
+		}
+		/* Continue from the rest of short write */
+		written = 0;
+		while (written < read_len) {
+			write_len = pwrite(dest_fd, buff + written, read_len - written,
+					(off_t)(*copied + written));
+			if (write_len < 0 && errno == EINTR)
+				continue;
+			if (write_len <= 0) {
+				DA_LOG_ERR(FileManager, "write fails [%d]", errno);
+				if (errno == ENOSPC)
+					ret = DA_ERR_DISK_FULL;
+				else
+					ret = DA_ERR_FAIL_TO_ACCESS_FILE;
+				goto ERR;
+			}
+			written += write_len;
+		}
+		*copied += read_len;
+		if (progress_cb && *copied - last_notified >= DA_COPY_CHUNK_SIZE) {
+			progress_cb(*copied, size, user_data);
+			last_notified = *copied;
+		}
+	}
+	if (progress_cb && last_notified != *copied)
+		progress_cb(*copied, size, user_data);
+
+ERR:
+	free(buff);
+	return ret;
+}
+
 da_result_t copy_file(const char *src, const char *dest)
 {
-	FILE *fs = DA_NULL;
-	FILE *fd = DA_NULL;
-	int freadnum = 0;
-	int fwritenum = 0;
-	char buff[4096] = { 0, };
+	return copy_file_with_progress(src, dest, DA_NULL, DA_NULL);
+}
+
+/* Blocks are shared if possible, or copied in kernel without reading them
+ * to user space. Read and write by ourselves is the last way */
+da_result_t copy_file_with_progress(const char *src, const char *dest,
+		da_copy_progress_cb progress_cb, void *user_data)
+{
+	da_result_t ret = DA_RESULT_OK;
+	struct stat file_state;
+	unsigned long long size = 0;
+	unsigned long long copied = 0;
+	int src_fd = -1;
+	int dest_fd = -1;
 
 	DA_LOG_FUNC_START(FileManager);
 
+	if (!src || !dest)
+		return DA_ERR_INVALID_ARGUMENT;
+
 	/* open files to copy */
-	fs = fopen(src, "rb");
-	if (!fs) {
+	src_fd = open(src, O_RDONLY);
+	if (src_fd < 0) {
 		DA_LOG_ERR(FileManager, "Fail to open src file");
 		return DA_ERR_FAIL_TO_ACCESS_FILE;
 	}
+	if (fstat(src_fd, &file_state) != 0) {
+		ret = DA_ERR_FAIL_TO_ACCESS_FILE;
+		goto ERR;
+	}
+	size = (unsigned long long)file_state.st_size;
 
-	fd = fopen(dest, "wb");
-	if (!fd) {
+	dest_fd = open(dest, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (dest_fd < 0) {
 		DA_LOG_ERR(FileManager, "Fail to open dest file");
-
-		fclose(fs);
-		return DA_ERR_FAIL_TO_ACCESS_FILE;
+		ret = DA_ERR_FAIL_TO_ACCESS_FILE;
+		goto ERR;
 	}
 
-	/* actual copy */
-	while (!feof(fs)) {
-		memset(buff, 0x00, 4096);
-		freadnum = fread(buff, sizeof(char), sizeof(buff), fs);
-		if (freadnum > 0) {
-			fwritenum = fwrite(buff, sizeof(char), freadnum, fd);
-			if (fwritenum <= 0) {
-				DA_LOG(FileManager, "written = %d",fwritenum);
-				break;
-			}
-		} else {
-			DA_LOG(FileManager, "read = %d",freadnum);
-			break;
-		}
-	}
+	ret = __copy_by_clone(src_fd, dest_fd, &copied);
+	if (DA_RESULT_OK != ret)
+		goto ERR;
+	if (copied < size) {
+		ret = __preallocate_file(dest_fd, copied, size, DA_TRUE);
+		if (DA_RESULT_OK != ret)
+			goto ERR;
+		ret = __copy_by_copy_file_range(src_fd, dest_fd, size, &copied,
+				progress_cb, user_data);
+	}
+	if (DA_RESULT_OK == ret && copied < size)
+		ret = __copy_by_sendfile(src_fd, dest_fd, size, &copied,
+				progress_cb, user_data);
+	if (DA_RESULT_OK == ret && copied < size)
+		ret = __copy_by_read_write(src_fd, dest_fd, size, &copied,
+				progress_cb, user_data);
+	if (DA_RESULT_OK != ret)
+		goto ERR;
 
-	fflush(fd);
-	fsync(fileno(fd));
-	fclose(fd);
-	fclose(fs);
+	if (fdatasync(dest_fd) != 0 || fstat(dest_fd, &file_state) != 0 ||
+			(unsigned long long)file_state.st_size != size || copied != size) {
+		DA_LOG_ERR(FileManager, "copied [%llu] of [%llu]", copied, size);
+		ret = DA_ERR_FAIL_TO_ACCESS_FILE;
+		goto ERR;
+	}
+	DA_LOG(FileManager, "copied [%llu]", copied);
 
-	return DA_RESULT_OK;
+ERR:
+	if (dest_fd >= 0)
+		close(dest_fd);
+	if (src_fd >= 0)
+		close(src_fd);
+	return ret;
 }
 
 da_result_t create_dir(const char *install_dir)
@@ -33,11 +33,12 @@
 #include "download-agent-plugin-conf.h"
 #include "download-agent-installation.h"
 #include "download-agent-plugin-http-interface.h"
+#include "download-agent-http-segment.h"
+#include "download-agent-http-rate.h"
+#include "download-agent-http-redirect.h"
+#include "download-agent-http-mirror.h"
+#include "download-agent-space.h"
 
-da_result_t make_default_http_request_hdr(const char *url,
-		char **user_request_header,
-		int user_request_heaer_count,
-		http_msg_request_t **out_http_msg_request);
 da_result_t create_resume_http_request_hdr(stage_info *stage,
 		http_msg_request_t **out_resume_request);
 
@@ -45,15 +46,26 @@ da_result_t start_new_transaction(stage_info *stage);
 da_result_t set_http_request_hdr(stage_info *stage);
 da_result_t make_transaction_info_and_start_transaction(stage_info *stage);
 
-da_result_t pause_for_flow_control(stage_info *stage);
 da_result_t unpause_for_flow_control(stage_info *stage);
 
+da_bool_t _is_resumable_http_state(http_state_t http_state);
+da_bool_t _is_source_error(da_result_t err);
+void _forget_cached_redirection(stage_info *stage);
+da_result_t _pause_for_http_retry(stage_info *stage, http_state_t http_state,
+		unsigned long wait_msec);
+da_bool_t is_http_retry_available(stage_info *stage, http_state_t http_state);
+da_result_t schedule_http_retry(stage_info *stage, http_state_t http_state);
+da_bool_t is_http_failover_available(stage_info *stage, http_state_t http_state);
+da_result_t failover_http_source(stage_info *stage, http_state_t http_state);
+unsigned long get_http_retry_wait_msec(stage_info *stage);
+
 da_result_t handle_any_input(stage_info *stage);
 da_result_t handle_event_control(stage_info *stage, q_event_t *event);
 da_result_t handle_event_http(stage_info *stage, q_event_t *event);
 da_result_t handle_event_http_packet(stage_info *stage, q_event_t *event);
 da_result_t handle_event_http_final(stage_info *stage, q_event_t *event);
 da_result_t handle_event_http_abort(stage_info *stage, q_event_t *event);
+da_result_t handle_event_segment_finished(stage_info *stage);
 
 da_result_t exchange_url_from_header_for_redirection(stage_info *stage,
 		http_msg_response_t *http_msg_response);
@@ -67,12 +79,14 @@ da_result_t handle_http_hdr(stage_info *stage,
 		http_msg_response_t *http_msg_response, int http_status);
 da_result_t handle_http_status_code(stage_info *stage,
 		http_msg_response_t *http_msg_response, int http_status);
-da_result_t handle_http_body(stage_info *stage, char *body, int body_len);
+da_result_t handle_http_body(stage_info *stage, da_body_slice_t *body);
 
 da_result_t set_hdr_fields_on_download_info(stage_info *stage);
 
 da_result_t _check_content_type_is_matched(stage_info *stage);
 da_result_t _check_enough_memory_for_this_download(stage_info *stage);
+da_result_t _reserve_space_for_this_download(stage_info *stage,
+		unsigned long long size);
 da_result_t _check_downloaded_file_size_is_same_with_header_content_size(
 		stage_info *stage);
 
@@ -81,6 +95,7 @@ da_result_t _check_this_partial_download_is_available(stage_info *stage,
 
 da_result_t _cancel_transaction(stage_info *stage);
 da_result_t _disconnect_transaction(stage_info *stage);
+unsigned int _get_received_size(stage_info *stage);
 
 void __parsing_user_request_header(char *user_request_header,
 		char **out_field, char **out_value);
@@ -94,6 +109,9 @@ da_result_t init_http_mgr(void)
 	DA_LOG_FUNC_START(HTTPManager);
 
 	if (http_mgr.is_http_init == DA_FALSE) {
+		ret = PI_http_set_max_transaction_count(get_max_download_count());
+		if (ret != DA_RESULT_OK)
+			return ret;
 		http_mgr.is_http_init = DA_TRUE;
 		ret = PI_http_init();
 	}
@@ -101,6 +119,17 @@ da_result_t init_http_mgr(void)
 	return ret;
 }
 
+da_result_t set_max_http_transaction_count(int count)
+{
+	DA_LOG_FUNC_START(HTTPManager);
+
+	/* It is applied on init_http_mgr() if it is not init yet */
+	if (http_mgr.is_http_init == DA_FALSE)
+		return DA_RESULT_OK;
+
+	return PI_http_set_max_transaction_count(count);
+}
+
 
 da_result_t request_to_abort_http_download(stage_info *stage)
 {
@@ -146,6 +175,7 @@ da_result_t request_http_download(stage_info *stage)
 	int download_id = DA_INVALID_ID;
 	http_state_t http_state = 0;
 	da_bool_t need_wait = DA_TRUE;
+	unsigned long wait_msec = 0;
 
 	queue_t *queue = DA_NULL;
 	req_dl_info *req_info = DA_NULL;
@@ -170,6 +200,25 @@ da_result_t request_http_download(stage_info *stage)
 			_cancel_transaction(stage);
 		}
 
+		/* The transaction is paused by the plugin when the queue reaches
+		 * the high watermark. Continue it before the queue is empty */
+		if (DA_TRUE == Q_is_drained_to_low_watermark(queue) &&
+				DA_FALSE == req_info->is_throttled &&
+				DA_FALSE == req_info->is_retry_pending)
+			unpause_for_flow_control(stage);
+
+		if (DA_TRUE == req_info->is_retry_pending
+				&& 0 == get_http_retry_wait_msec(stage)) {
+			DA_LOG_CRITICAL(HTTPManager, "retry download. left budget[%d]",
+					GET_REQUEST_HTTP_RETRY_BUDGET(req_info));
+			ret = handle_event_resume(stage);
+			if (ret != DA_RESULT_OK) {
+				GET_REQUEST_HTTP_RESULT(req_info) = ret;
+				discard_download(stage);
+				CHANGE_HTTP_STATE(HTTP_STATE_ABORTED, stage);
+			}
+		}
+
 		_da_thread_mutex_lock(&(GET_REQUEST_HTTP_MUTEX_HTTP_STATE(stage)));
 		http_state = GET_HTTP_STATE_ON_STAGE(stage);
 		DA_LOG(HTTPManager, "http_state = %d", http_state);
@@ -209,11 +258,22 @@ da_result_t request_http_download(stage_info *stage)
 		if (need_wait == DA_TRUE) {
 			_da_thread_mutex_lock(&(queue->mutex_queue));
 			if (DA_FALSE == GET_IS_Q_HAVING_DATA(queue)) {
-				unpause_for_flow_control(stage);
-
-//				DA_LOG(HTTPManager, "Waiting for input");
-				Q_goto_sleep(queue);
-//				DA_LOG(HTTPManager, "Woke up to receive new packet or control event");
+				if (DA_TRUE == req_info->is_retry_pending)
+					wait_msec = get_http_retry_wait_msec(stage);
+				else
+					wait_msec = rate_get_throttle_msec(download_id,
+							&(req_info->is_throttled));
+				if (wait_msec > 0) {
+					/* Keep the transaction paused until the rate allows,
+					 * or wait for the time to retry */
+					Q_goto_sleep_with_timeout(queue, wait_msec);
+				} else if (DA_FALSE == req_info->is_retry_pending) {
+					unpause_for_flow_control(stage);
+
+//					DA_LOG(HTTPManager, "Waiting for input");
+					Q_goto_sleep(queue);
+//					DA_LOG(HTTPManager, "Woke up to receive new packet or control event");
+				}
 			}
 			_da_thread_mutex_unlock (&(queue->mutex_queue));
 
@@ -222,6 +282,8 @@ da_result_t request_http_download(stage_info *stage)
 	} while (need_wait == DA_TRUE);
 
 	ret = GET_REQUEST_HTTP_RESULT(req_info);
+	if (_is_source_error(ret))
+		_forget_cached_redirection(stage);
 	DA_LOG(HTTPManager, "--------------Exiting request_http_download! ret = %d", ret);
 	return ret;
 }
@@ -262,12 +324,16 @@ da_result_t request_to_suspend_http_download(stage_info *stage)
 
 	switch (http_state) {
 	case HTTP_STATE_PAUSED:
+		/* Paused for a retry. The client should be able to stop the retry */
+		if (DA_TRUE == GET_STAGE_TRANSACTION_INFO(stage)->is_retry_pending)
+			goto SUSPEND;
 	case HTTP_STATE_REQUEST_PAUSE:
 		DA_LOG_CRITICAL(HTTPManager, "Already paused. http_state = %d", http_state);
 		ret = DA_ERR_ALREADY_SUSPENDED;
 		break;
 
 	default:
+SUSPEND:
 		DA_LOG(HTTPManager, "Q_EVENT_TYPE_CONTROL_SUSPEND");
 		ret = Q_make_control_event(Q_EVENT_TYPE_CONTROL_SUSPEND,
 				&q_event);
@@ -487,8 +553,13 @@ da_result_t make_transaction_info_and_start_transaction(stage_info *stage)
 		input_for_tranx->http_method = PI_HTTP_METHOD_GET;
 		input_for_tranx->http_msg_request
 				= request_info->http_info.http_msg_request;
+		input_for_tranx->low_speed_limit =
+			GET_REQUEST_HTTP_LOW_SPEED_LIMIT(request_info);
+		input_for_tranx->low_speed_time =
+			GET_REQUEST_HTTP_LOW_SPEED_TIME(request_info);
 	}
 
+	request_info->is_throttled = DA_FALSE;
 	ret = PI_http_start_transaction(input_for_tranx,
 			&(GET_REQUEST_HTTP_TRANS_ID(request_info)));
 	if (ret != DA_RESULT_OK)
@@ -527,10 +598,30 @@ da_result_t make_req_dl_info_http(stage_info *stage, req_dl_info *out_info)
 	DA_LOG(HTTPManager, "url [%s]", url);
 
 	if (url) {
+		/* Skip the permanent redirection which was seen before */
+		GET_REQUEST_HTTP_CACHED_REDIRECT_URL(out_info) =
+			redirect_cache_get_target(url);
+		if (GET_REQUEST_HTTP_CACHED_REDIRECT_URL(out_info))
+			url = GET_REQUEST_HTTP_CACHED_REDIRECT_URL(out_info);
 		GET_REQUEST_HTTP_REQ_URL(out_info) = url;
 		GET_REQUEST_HTTP_USER_REQUEST_HEADER(out_info) = user_request_header;
 		GET_REQUEST_HTTP_USER_REQUEST_HEADER_COUNT(out_info) =
 			user_request_header_count;
+		GET_REQUEST_HTTP_SEGMENT_COUNT(out_info) =
+			source_info->source_info_type.source_info_basic->segment_count;
+		GET_REQUEST_HTTP_RETRY_BUDGET(out_info) =
+			source_info->source_info_type.source_info_basic->retry_budget;
+		GET_REQUEST_HTTP_LOW_SPEED_LIMIT(out_info) =
+			source_info->source_info_type.source_info_basic->low_speed_limit;
+		GET_REQUEST_HTTP_LOW_SPEED_TIME(out_info) =
+			source_info->source_info_type.source_info_basic->low_speed_time;
+		GET_REQUEST_HTTP_QUEUE_HIGH_WATERMARK(out_info) =
+			source_info->source_info_type.source_info_basic->queue_high_watermark;
+		GET_REQUEST_HTTP_QUEUE_LOW_WATERMARK(out_info) =
+			source_info->source_info_type.source_info_basic->queue_low_watermark;
+		Q_set_watermark(GET_DL_QUEUE(GET_STAGE_DL_ID(stage)),
+				GET_REQUEST_HTTP_QUEUE_HIGH_WATERMARK(out_info),
+				GET_REQUEST_HTTP_QUEUE_LOW_WATERMARK(out_info));
 	} else {
 		DA_LOG_ERR(HTTPManager, "DA_ERR_NO_URL");
 		return DA_ERR_INVALID_URL;
@@ -538,12 +629,7 @@ da_result_t make_req_dl_info_http(stage_info *stage, req_dl_info *out_info)
 
 	_da_thread_mutex_init(&(GET_REQUEST_HTTP_MUTEX_HTTP_STATE(stage)), NULL);
 
-	return DA_RESULT_OK;
-}
-
-da_result_t pause_for_flow_control(stage_info *stage)
-{
-	return DA_RESULT_OK;
+	return mirror_select_fastest_source(stage);
 }
 
 da_result_t unpause_for_flow_control(stage_info *stage)
@@ -580,6 +666,7 @@ da_result_t handle_event_abort(stage_info *stage)
 		CHANGE_HTTP_STATE(HTTP_STATE_ABORTED,stage);
 		CHANGE_DOWNLOAD_STATE(DOWNLOAD_STATE_CANCELED, stage);
 		_disconnect_transaction(stage);
+		destroy_segment_info(&GET_SEGMENT_INFO(stage));
 		break;
 	case HTTP_STATE_DOWNLOAD_FINISH:
 		break;
@@ -650,6 +737,17 @@ da_result_t handle_event_suspend(stage_info *stage)
 		DA_LOG(HTTPManager, "already requested to pause! do nothing");
 		break;
 
+	case HTTP_STATE_PAUSED:
+		/* Waiting for automatic retry. Just stop the retry */
+		if (DA_TRUE == GET_STAGE_TRANSACTION_INFO(stage)->is_retry_pending) {
+			GET_STAGE_TRANSACTION_INFO(stage)->is_retry_pending = DA_FALSE;
+			send_client_da_state(GET_STAGE_DL_ID(stage),
+					DA_STATE_SUSPENDED, DA_RESULT_OK);
+		} else {
+			DA_LOG(HTTPManager, "already paused! do nothing");
+		}
+		break;
+
 	case HTTP_STATE_READY_TO_DOWNLOAD:
 		CHANGE_HTTP_STATE(HTTP_STATE_PAUSED,stage);
 		CHANGE_DOWNLOAD_STATE(DOWNLOAD_STATE_PAUSED, stage);
@@ -688,9 +786,23 @@ da_result_t handle_event_resume(stage_info *stage)
 	GET_REQUEST_HTTP_RESULT(GET_STAGE_TRANSACTION_INFO(stage)) = DA_RESULT_OK;
 	DA_LOG_CRITICAL(HTTPManager, "[%d] cleanup internal error", GET_STAGE_DL_ID(stage));
 
+	GET_STAGE_TRANSACTION_INFO(stage)->is_retry_pending = DA_FALSE;
+	if (DA_TRUE == GET_STAGE_TRANSACTION_INFO(stage)->is_retry_from_start) {
+		/* Nothing to resume. Request it again from the first */
+		GET_STAGE_TRANSACTION_INFO(stage)->is_retry_from_start = DA_FALSE;
+		CHANGE_HTTP_STATE(HTTP_STATE_READY_TO_DOWNLOAD,stage);
+		CHANGE_DOWNLOAD_STATE(DOWNLOAD_STATE_NEW_DOWNLOAD,stage);
+		goto ERR;
+	}
+
 	CHANGE_HTTP_STATE(HTTP_STATE_REQUEST_RESUME,stage);
 	CHANGE_DOWNLOAD_STATE(DOWNLOAD_STATE_NEW_DOWNLOAD,stage);
 
+	/* The offset of main transaction is decided by segment map */
+	ret = segment_prepare_resume(stage);
+	if (ret != DA_RESULT_OK)
+		goto ERR;
+
 	ret = create_resume_http_request_hdr(stage, &resume_request);
 	if (ret != DA_RESULT_OK)
 		goto ERR;
@@ -765,7 +877,11 @@ da_result_t create_resume_http_request_hdr(stage_info *stage,
 	if (ret != DA_RESULT_OK)
 		goto ERR;
 
-	if (etag_from_response) {
+	if (request_info->source_index != request_info->validator_source_index) {
+		/* Validator of other source is meaningless to this one */
+		DA_LOG(HTTPManager, "no If-Range for source[%d]",
+				request_info->source_index);
+	} else if (etag_from_response) {
 		http_msg_request_add_field(resume_request, HTTP_FIELD_IF_RANGE,
 				etag_from_response);
 	} else {
@@ -858,9 +974,14 @@ da_result_t handle_event_control(stage_info *stage, q_event_t *event)
 			DA_LOG(HTTPManager, "Q_EVENT_TYPE_CONTROL_ABORT");
 			ret = handle_event_abort(stage);
 			break;
-			/* Fixme: need to think how we use this type. For now, this type is not used. */
+		case Q_EVENT_TYPE_CONTROL_SEGMENT_FINISHED:
+			DA_LOG(HTTPManager, "Q_EVENT_TYPE_CONTROL_SEGMENT_FINISHED");
+			ret = handle_event_segment_finished(stage);
+			break;
 		case Q_EVENT_TYPE_CONTROL_NET_DISCONNECTED:
+			/* The abort which follows this can be retried */
 			DA_LOG(HTTPManager, "Q_EVENT_TYPE_CONTROL_NET_DISCONNECTED");
+			GET_STAGE_TRANSACTION_INFO(stage)->is_net_disconnected = DA_TRUE;
 			break;
 		}
 	}
@@ -905,6 +1026,7 @@ da_result_t handle_event_http_packet(stage_info *stage, q_event_t *event)
 	da_result_t ret = DA_RESULT_OK;
 	da_bool_t is_handle_hdr_success = DA_TRUE;
 	q_event_data_http_t *received_data = DA_NULL;
+	da_body_slice_t body = {0,};
 
 	//	DA_LOG_FUNC_START(HTTPManager);
 
@@ -921,13 +1043,21 @@ da_result_t handle_event_http_packet(stage_info *stage, q_event_t *event)
 	}
 
 	if (received_data->body_len > 0) {
+		Q_take_http_body_from_http_data_event(event, &body);
 		if (is_handle_hdr_success == DA_TRUE) {
-			ret = handle_http_body(stage, received_data->body_data,
-					received_data->body_len);
+			/* The body is taken by the file writer if it is kept to be written */
+			ret = handle_http_body(stage, &body);
 		}
 		/*For all cases body_data should be deleted*/
-		free(received_data->body_data);
-		received_data->body_data = DA_NULL;
+		release_body_slice(&body);
+
+		rate_charge_transaction(GET_STAGE_DL_ID(stage),
+				GET_REQUEST_HTTP_TRANS_ID(GET_STAGE_TRANSACTION_INFO(stage)),
+				received_data->body_len,
+				&(GET_STAGE_TRANSACTION_INFO(stage)->is_throttled));
+		/* Network is alive. Next failure starts backoff from the base */
+		GET_STAGE_TRANSACTION_INFO(stage)->retry_backoff_count = 0;
+		GET_STAGE_TRANSACTION_INFO(stage)->source_failover_count = 0;
 	}
 
 	return ret;
@@ -945,11 +1075,27 @@ da_result_t handle_event_http_final(stage_info *stage, q_event_t *event)
 	download_id = GET_STAGE_DL_ID(stage);
 	_disconnect_transaction(stage);
 
+	if (IS_SEGMENTED_DOWNLOAD(stage)) {
+		segment_set_main_tranx_finished(stage);
+		/* This is called again when the last segment thread is finished */
+		if (DA_FALSE == segment_is_all_finished(stage)) {
+			DA_LOG(HTTPManager, "waiting for segment threads");
+			return ret;
+		}
+	}
+
 	_da_thread_mutex_lock(&(GET_REQUEST_HTTP_MUTEX_HTTP_STATE(stage)));
 	http_state = GET_HTTP_STATE_ON_STAGE(stage);
 	DA_LOG(HTTPManager, "http_state = %d", http_state);
 	_da_thread_mutex_unlock(&(GET_REQUEST_HTTP_MUTEX_HTTP_STATE(stage)));
 
+	/* e.g. error status from the source */
+	if (DA_TRUE == is_http_failover_available(stage, http_state)) {
+		ret = failover_http_source(stage, http_state);
+		if (ret == DA_RESULT_OK)
+			goto ERR;
+	}
+
 	switch (http_state) {
 	case HTTP_STATE_REDIRECTED:
 		CHANGE_HTTP_STATE(HTTP_STATE_READY_TO_DOWNLOAD,stage);
@@ -967,6 +1113,19 @@ da_result_t handle_event_http_final(stage_info *stage, q_event_t *event)
 			discard_download(stage);
 			goto ERR;
 		}
+		ret = segment_get_result(stage);
+		if (ret == DA_RESULT_OK)
+			ret = segment_check_all_received(stage);
+		if (ret != DA_RESULT_OK) {
+			discard_download(stage);
+			goto ERR;
+		}
+		segment_remove_map(stage);
+		ret = file_verify_digest(stage);
+		if (ret != DA_RESULT_OK) {
+			discard_download(stage);
+			goto ERR;
+		}
 		/*			ret = _check_downloaded_file_size_is_same_with_header_content_size(stage);
 		 if(ret != DA_RESULT_OK)
 		 {
@@ -978,17 +1137,18 @@ da_result_t handle_event_http_final(stage_info *stage, q_event_t *event)
 		send_client_update_downloading_info(
 				download_id,
 				GET_DL_REQ_ID(download_id),
-				GET_CONTENT_STORE_CURRENT_FILE_SIZE(GET_STAGE_CONTENT_STORE_INFO(stage)),
+				_get_received_size(stage),
 				DA_NULL);
 		break;
 
 	case HTTP_STATE_REQUEST_PAUSE:
-		if (GET_CONTENT_STORE_FILE_HANDLE(GET_STAGE_CONTENT_STORE_INFO(stage))) {
+		if (IS_CONTENT_STORE_FILE_OPENED(GET_STAGE_CONTENT_STORE_INFO(stage))) {
 			ret = file_write_complete(stage);
+			segment_save_map(stage);
 			send_client_update_downloading_info(
 					download_id,
 					GET_DL_REQ_ID(download_id),
-					GET_CONTENT_STORE_CURRENT_FILE_SIZE(GET_STAGE_CONTENT_STORE_INFO(stage)),
+					_get_received_size(stage),
 					GET_CONTENT_STORE_ACTUAL_FILE_NAME(GET_STAGE_CONTENT_STORE_INFO(stage)));
 
 			IS_CONTENT_STORE_FILE_BYTES_WRITTEN_TO_FILE(GET_STAGE_CONTENT_STORE_INFO(stage))
@@ -1029,6 +1189,7 @@ ERR:
 	if (DA_RESULT_OK != ret) {
 		CHANGE_HTTP_STATE(HTTP_STATE_DOWNLOAD_FINISH, stage);
 	}
+	destroy_segment_info(&GET_SEGMENT_INFO(stage));
 	return ret;
 }
 
@@ -1036,13 +1197,21 @@ da_result_t handle_event_http_abort(stage_info *stage, q_event_t *event)
 {
 	da_result_t ret = DA_RESULT_OK;
 	http_state_t http_state = 0;
+	da_bool_t is_stalled = DA_FALSE;
 
 	DA_LOG_FUNC_START(HTTPManager);
 
 	GET_REQUEST_HTTP_RESULT(GET_STAGE_TRANSACTION_INFO(stage))
 		= event->type.q_event_data_http.error_type;
 	DA_LOG_CRITICAL(HTTPManager, "set internal error code : [%d]", GET_REQUEST_HTTP_RESULT(GET_STAGE_TRANSACTION_INFO(stage)));
+	if (GET_REQUEST_HTTP_RESULT(GET_STAGE_TRANSACTION_INFO(stage)) ==
+			DA_ERR_HTTP_TIMEOUT) {
+		is_stalled = DA_TRUE;
+		GET_DL_STALL_COUNT(GET_STAGE_DL_ID(stage))++;
+	}
 	_disconnect_transaction(stage);
+	/* Body of the segments should be written before the file is completed */
+	segment_stop_and_wait(stage);
 
 	_da_thread_mutex_lock(&(GET_REQUEST_HTTP_MUTEX_HTTP_STATE(stage)));
 	http_state = GET_HTTP_STATE_ON_STAGE(stage);
@@ -1058,6 +1227,8 @@ da_result_t handle_event_http_abort(stage_info *stage, q_event_t *event)
 		ret = file_write_complete(stage);
 		if (ret != DA_RESULT_OK)
 			goto ERR;
+		/* The range which is written after this is just received again */
+		segment_save_map(stage);
 		break;
 
 	case HTTP_STATE_REQUEST_CANCEL:
@@ -1070,6 +1241,24 @@ da_result_t handle_event_http_abort(stage_info *stage, q_event_t *event)
 		break;
 
 	default:
+		/* Stalled source may be slow still on new connection. Try other one first */
+		if (DA_TRUE == is_stalled &&
+				DA_TRUE == is_http_failover_available(stage, http_state)) {
+			ret = failover_http_source(stage, http_state);
+			if (ret == DA_RESULT_OK)
+				break;
+			/* Failed failover is retried after a while, like other network errors */
+		}
+		if (DA_TRUE == is_http_retry_available(stage, http_state)) {
+			ret = schedule_http_retry(stage, http_state);
+			if (ret == DA_RESULT_OK)
+				break;
+		} else if (DA_FALSE == is_stalled &&
+				DA_TRUE == is_http_failover_available(stage, http_state)) {
+			ret = failover_http_source(stage, http_state);
+			if (ret == DA_RESULT_OK)
+				break;
+		}
 		CHANGE_HTTP_STATE(HTTP_STATE_ABORTED,stage);
 		ret = file_write_complete(stage);
 		if (ret != DA_RESULT_OK)
@@ -1078,6 +1267,205 @@ da_result_t handle_event_http_abort(stage_info *stage, q_event_t *event)
 		break;
 	}
 ERR:
+	GET_STAGE_TRANSACTION_INFO(stage)->is_net_disconnected = DA_FALSE;
+	destroy_segment_info(&GET_SEGMENT_INFO(stage));
+	return ret;
+}
+
+da_bool_t is_http_retry_available(stage_info *stage, http_state_t http_state)
+{
+	req_dl_info *req_info = GET_STAGE_TRANSACTION_INFO(stage);
+
+	if (DA_FALSE == req_info->is_net_disconnected ||
+			GET_REQUEST_HTTP_RETRY_BUDGET(req_info) <= 0)
+		return DA_FALSE;
+
+	if (DA_TRUE == is_this_client_manual_download_type())
+		return DA_FALSE;
+
+	return _is_resumable_http_state(http_state);
+}
+
+da_bool_t _is_resumable_http_state(http_state_t http_state)
+{
+	switch (http_state) {
+	case HTTP_STATE_DOWNLOAD_REQUESTED:
+	case HTTP_STATE_REQUEST_RESUME:
+	case HTTP_STATE_RESUMED:
+	case HTTP_STATE_DOWNLOADING:
+		return DA_TRUE;
+	default:
+		return DA_FALSE;
+	}
+}
+
+/* The error which may not happen with other source */
+da_bool_t _is_source_error(da_result_t err)
+{
+	switch (err) {
+	case DA_ERR_NETWORK_FAIL:
+	case DA_ERR_UNREACHABLE_SERVER:
+	case DA_ERR_HTTP_TIMEOUT:
+	case DA_ERR_SSL_FAIL:
+	case DA_ERR_SERVER_RESPOND_BUT_SEND_NO_CONTENT:
+		return DA_TRUE;
+	default:
+		return DA_FALSE;
+	}
+}
+
+/* The cached location may be gone. The original url is followed from the next
+ * request of this download, and by the other downloads */
+void _forget_cached_redirection(stage_info *stage)
+{
+	req_dl_info *req_info = GET_STAGE_TRANSACTION_INFO(stage);
+	char *url = GET_SOURCE_BASIC_URL(GET_STAGE_SOURCE_INFO(stage));
+
+	if (!GET_REQUEST_HTTP_CACHED_REDIRECT_URL(req_info) ||
+			req_info->source_index != 0)
+		return;
+
+	DA_LOG_ERR(HTTPManager, "fail with cached redirection");
+	redirect_cache_remove(url);
+	if (GET_REQUEST_HTTP_REQ_URL(req_info) ==
+			GET_REQUEST_HTTP_CACHED_REDIRECT_URL(req_info))
+		GET_REQUEST_HTTP_REQ_URL(req_info) = url;
+	free(GET_REQUEST_HTTP_CACHED_REDIRECT_URL(req_info));
+	GET_REQUEST_HTTP_CACHED_REDIRECT_URL(req_info) = DA_NULL;
+}
+
+/* The download is paused like suspend, and resumed after wait_msec
+ * from the received data. */
+da_result_t _pause_for_http_retry(stage_info *stage, http_state_t http_state,
+		unsigned long wait_msec)
+{
+	da_result_t ret = DA_RESULT_OK;
+	req_dl_info *req_info = GET_STAGE_TRANSACTION_INFO(stage);
+
+	if (IS_CONTENT_STORE_FILE_OPENED(GET_STAGE_CONTENT_STORE_INFO(stage))) {
+		ret = file_write_complete(stage);
+		if (ret != DA_RESULT_OK)
+			return ret;
+	}
+	/* The range which is written after this is just received again */
+	segment_save_map(stage);
+
+	req_info->is_retry_from_start =
+		(http_state == HTTP_STATE_DOWNLOAD_REQUESTED) ? DA_TRUE : DA_FALSE;
+	req_info->retry_at_msec = get_monotonic_msec() + wait_msec;
+	req_info->is_retry_pending = DA_TRUE;
+	GET_REQUEST_HTTP_RESULT(req_info) = DA_RESULT_OK;
+
+	CHANGE_HTTP_STATE(HTTP_STATE_PAUSED,stage);
+	CHANGE_DOWNLOAD_STATE(DOWNLOAD_STATE_PAUSED, stage);
+
+	return ret;
+}
+
+/* The download is resumed on the retry time with If-Range. */
+da_result_t schedule_http_retry(stage_info *stage, http_state_t http_state)
+{
+	da_result_t ret = DA_RESULT_OK;
+	req_dl_info *req_info = GET_STAGE_TRANSACTION_INFO(stage);
+	int download_id = GET_STAGE_DL_ID(stage);
+	da_result_t err = GET_REQUEST_HTTP_RESULT(req_info);
+	unsigned long backoff_msec = DA_RETRY_BACKOFF_MAX_MSEC;
+	unsigned int seed = 0;
+
+	DA_LOG_FUNC_START(HTTPManager);
+
+	if (req_info->retry_backoff_count < 16)
+		backoff_msec = DA_RETRY_BACKOFF_BASE_MSEC <<
+			req_info->retry_backoff_count;
+	if (backoff_msec > DA_RETRY_BACKOFF_MAX_MSEC)
+		backoff_msec = DA_RETRY_BACKOFF_MAX_MSEC;
+	/* Jitter not to retry at once with other downloads */
+	seed = (unsigned int)get_monotonic_msec() + download_id;
+	backoff_msec = backoff_msec / 2 + rand_r(&seed) % (backoff_msec / 2 + 1);
+
+	DA_LOG_CRITICAL(HTTPManager, "[%d] retry after %lu msec. err[%d]",
+			download_id, backoff_msec, err);
+
+	ret = _pause_for_http_retry(stage, http_state, backoff_msec);
+	if (ret != DA_RESULT_OK)
+		return ret;
+
+	req_info->retry_backoff_count++;
+	GET_REQUEST_HTTP_RETRY_BUDGET(req_info)--;
+	/* Client can know that the retry budget is used by the error */
+	send_client_da_state(download_id, DA_STATE_RETRY_WAITING, err);
+
+	return ret;
+}
+
+da_bool_t is_http_failover_available(stage_info *stage, http_state_t http_state)
+{
+	req_dl_info *req_info = GET_STAGE_TRANSACTION_INFO(stage);
+
+	if (DA_FALSE == _is_source_error(GET_REQUEST_HTTP_RESULT(req_info)))
+		return DA_FALSE;
+
+	if (DA_FALSE == mirror_is_failover_available(stage))
+		return DA_FALSE;
+
+	return _is_resumable_http_state(http_state);
+}
+
+/* Continue with next source at once. It does not use the retry budget,
+ * and the client is not notified. */
+da_result_t failover_http_source(stage_info *stage, http_state_t http_state)
+{
+	DA_LOG_FUNC_START(HTTPManager);
+
+	DA_LOG_CRITICAL(HTTPManager, "[%d] failover. err[%d]",
+			GET_STAGE_DL_ID(stage),
+			GET_REQUEST_HTTP_RESULT(GET_STAGE_TRANSACTION_INFO(stage)));
+	mirror_switch_to_next_source(stage);
+	return _pause_for_http_retry(stage, http_state, 0);
+}
+
+unsigned long get_http_retry_wait_msec(stage_info *stage)
+{
+	req_dl_info *req_info = GET_STAGE_TRANSACTION_INFO(stage);
+	unsigned long long now = get_monotonic_msec();
+
+	if (DA_FALSE == req_info->is_retry_pending ||
+			now >= req_info->retry_at_msec)
+		return 0;
+	return (unsigned long)(req_info->retry_at_msec - now);
+}
+
+da_result_t handle_event_segment_finished(stage_info *stage)
+{
+	da_result_t ret = DA_RESULT_OK;
+	http_state_t http_state = 0;
+	int download_id = DA_INVALID_ID;
+
+	DA_LOG_FUNC_START(HTTPManager);
+
+	if (!IS_SEGMENTED_DOWNLOAD(stage))
+		return ret;
+
+	if (DA_TRUE == segment_is_all_finished(stage))
+		return handle_event_http_final(stage, DA_NULL);
+
+	/* Other segments are stopped by canceling transaction */
+	ret = segment_get_result(stage);
+	if (ret != DA_RESULT_OK)
+		return ret;
+
+	download_id = GET_STAGE_DL_ID(stage);
+	_da_thread_mutex_lock(&(GET_REQUEST_HTTP_MUTEX_HTTP_STATE(stage)));
+	http_state = GET_HTTP_STATE_ON_STAGE(stage);
+	_da_thread_mutex_unlock(&(GET_REQUEST_HTTP_MUTEX_HTTP_STATE(stage)));
+
+	if (http_state == HTTP_STATE_DOWNLOADING)
+		send_client_update_downloading_info(
+				download_id,
+				GET_DL_REQ_ID(download_id),
+				_get_received_size(stage),
+				DA_NULL);
+
 	return ret;
 }
 
@@ -1116,6 +1504,8 @@ da_result_t handle_http_hdr(stage_info *stage,
 				GET_CONTENT_STORE_FILE_SIZE(GET_STAGE_CONTENT_STORE_INFO(stage)),
 				DA_NULL,
 				response_header_data,
+				DA_NULL,
+				DA_NULL,
 				DA_NULL);
 			if (response_header_data) {
 				free(response_header_data);
@@ -1177,6 +1567,9 @@ da_result_t handle_http_status_code(stage_info *stage,
 		if (ret != DA_RESULT_OK)
 			goto ERR;
 		ret = _check_enough_memory_for_this_download(stage);
+		if (ret != DA_RESULT_OK)
+			goto ERR;
+		ret = segment_prepare_download(stage, http_msg_response);
 		if (ret != DA_RESULT_OK)
 			goto ERR;
 		CHANGE_HTTP_STATE(HTTP_STATE_DOWNLOAD_STARTED,stage);
@@ -1205,6 +1598,7 @@ da_result_t handle_http_status_code(stage_info *stage,
 	case 305:
 	case 306:
 	case 307:
+	case 308:
 		DA_LOG(HTTPManager, "HTTP Status is %d - redirection!",http_status);
 		ret = exchange_url_from_header_for_redirection(stage, http_msg_response);
 		if (ret != DA_RESULT_OK)
@@ -1213,15 +1607,28 @@ da_result_t handle_http_status_code(stage_info *stage,
 		http_msg_response_destroy(&http_msg_response);
 		break;
 
+	case 304:
+		if (GET_SOURCE_BASIC(GET_STAGE_SOURCE_INFO(stage))->validated_path) {
+			DA_LOG(HTTPManager, "HTTP Status is %d - validated file is not modified!",http_status);
+			request_info->is_not_modified = DA_TRUE;
+			/* Nothing to receive. Just wait for the final event */
+			CHANGE_HTTP_STATE(HTTP_STATE_DOWNLOAD_REQUESTED,stage);
+			break;
+		}
+		/* Not requested with a validator. Handled as no content. Fall through */
 	case 100:
 	case 101:
 	case 102:
 	case 204:
-	case 304:
 		DA_LOG(HTTPManager, "HTTP Status is %d - 204 means server got the request, but no content to reply back, 304 means not modified!",http_status);
 		ret = DA_ERR_SERVER_RESPOND_BUT_SEND_NO_CONTENT;
 		break;
 
+	case 404: // Not found
+	case 410: // Gone
+		/* Not to retry on the cached location */
+		_forget_cached_redirection(stage);
+		/* Fall through */
 	case 416: // Requested range not satisfiable
 	case 503:
 	case 504:
@@ -1240,23 +1647,44 @@ da_result_t exchange_url_from_header_for_redirection(stage_info *stage,
 		http_msg_response_t *http_msg_response)
 {
 	da_result_t ret = DA_RESULT_OK;
+	req_dl_info *request_info = DA_NULL;
 	char *location = DA_NULL;
+	char *cache_control = DA_NULL;
+	char *from_url = DA_NULL;
+	int http_status = 0;
 
 	DA_LOG_FUNC_START(HTTPManager);
 
+	request_info = GET_STAGE_TRANSACTION_INFO(stage);
+
 	if (http_msg_response_get_location(http_msg_response, &location)) {
 		DA_LOG(HTTPManager, "location  = %s\n", location);
-		GET_REQUEST_HTTP_REQ_LOCATION(GET_STAGE_TRANSACTION_INFO(stage)) = location;
+		http_msg_response_get_status_code(http_msg_response, &http_status);
+		if (http_status == 301 || http_status == 308) {
+			/* The url of this hop is the previous location if it is chained */
+			from_url = GET_REQUEST_HTTP_REQ_LOCATION(request_info);
+			if (!from_url)
+				from_url = GET_REQUEST_HTTP_REQ_URL(request_info);
+			http_msg_response_get_cache_control(http_msg_response,
+					&cache_control);
+			redirect_cache_add(from_url, location, cache_control);
+			if (cache_control)
+				free(cache_control);
+		}
+		if (GET_REQUEST_HTTP_REQ_LOCATION(request_info))
+			free(GET_REQUEST_HTTP_REQ_LOCATION(request_info));
+		GET_REQUEST_HTTP_REQ_LOCATION(request_info) = location;
 	}
 
 	return ret;
 }
 
-da_result_t handle_http_body(stage_info *stage, char *body, int body_len)
+da_result_t handle_http_body(stage_info *stage, da_body_slice_t *body)
 {
 	da_result_t ret = DA_RESULT_OK;
 	http_state_t http_state = 0;
 	int download_id = DA_INVALID_ID;
+	da_bool_t is_range_done = DA_FALSE;
 
 	//	DA_LOG_FUNC_START(HTTPManager);
 
@@ -1276,6 +1704,9 @@ da_result_t handle_http_body(stage_info *stage, char *body, int body_len)
 
 	if (http_state == HTTP_STATE_DOWNLOAD_STARTED) {
 		ret = start_file_writing(stage);
+		if (DA_RESULT_OK != ret)
+			goto ERR;
+		ret = segment_start_threads(stage);
 		if (DA_RESULT_OK != ret)
 			goto ERR;
 
@@ -1289,9 +1720,14 @@ da_result_t handle_http_body(stage_info *stage, char *body, int body_len)
 				GET_CONTENT_STORE_FILE_SIZE(GET_STAGE_CONTENT_STORE_INFO(stage)),
 				GET_CONTENT_STORE_TMP_FILE_NAME(GET_STAGE_CONTENT_STORE_INFO(stage)),
 				DA_NULL,
-				DA_NULL);
+				DA_NULL,
+				GET_REQUEST_HTTP_HDR_ETAG(GET_STAGE_TRANSACTION_INFO(stage)),
+				GET_REQUEST_HTTP_HDR_LAST_MODIFIED(GET_STAGE_TRANSACTION_INFO(stage)));
 	} else if (http_state == HTTP_STATE_RESUMED) {
 		ret = start_file_writing_append(stage);
+		if (DA_RESULT_OK != ret)
+			goto ERR;
+		ret = segment_start_threads(stage);
 		if (DA_RESULT_OK != ret)
 			goto ERR;
 
@@ -1307,6 +1743,19 @@ da_result_t handle_http_body(stage_info *stage, char *body, int body_len)
 	//	DA_LOG(HTTPManager, "http_state = %d", http_state);
 	_da_thread_mutex_unlock(&(GET_REQUEST_HTTP_MUTEX_HTTP_STATE(stage)));
 
+	/* The rest of main segment may be taken by segment threads */
+	if (IS_SEGMENTED_DOWNLOAD(stage) && (http_state == HTTP_STATE_DOWNLOADING
+			|| http_state == HTTP_STATE_REQUEST_PAUSE)) {
+		body->len = segment_accept_main_body(stage, body->len, &is_range_done);
+		if (is_range_done) {
+			DA_LOG(HTTPManager, "main segment is received");
+			PI_http_cancel_transaction(GET_REQUEST_HTTP_TRANS_ID(
+					GET_STAGE_TRANSACTION_INFO(stage)), DA_FALSE);
+		}
+		if (body->len == 0)
+			goto ERR;
+	}
+
 	switch (http_state) {
 	case HTTP_STATE_REDIRECTED:
 		DA_LOG(HTTPManager, "Just ignore http body, because this body is not for redirection one.");
@@ -1315,7 +1764,8 @@ da_result_t handle_http_body(stage_info *stage, char *body, int body_len)
 	case HTTP_STATE_DOWNLOADING:
 		/* Should this function before updating download info
 		 * Because it extract mime type at once only if first download updating at client */
-		ret = file_write_ongoing(stage, body, body_len);
+		/* The body is not taken for manual download type */
+		ret = file_write_ongoing(stage, body);
 		if (ret != DA_RESULT_OK)
 			goto ERR;
 		if (DA_TRUE == is_this_client_manual_download_type()) {
@@ -1323,16 +1773,18 @@ da_result_t handle_http_body(stage_info *stage, char *body, int body_len)
 					download_id,
 					GET_DL_REQ_ID(download_id),
 					GET_CONTENT_STORE_CONTENT_TYPE(GET_STAGE_CONTENT_STORE_INFO(stage)),
-					body_len,
+					body->len,
 					GET_CONTENT_STORE_TMP_FILE_NAME(GET_STAGE_CONTENT_STORE_INFO(stage)),
 					DA_NULL,
-					body);
+					body->data,
+					DA_NULL,
+					DA_NULL);
 		} else if ((DA_TRUE ==
 				IS_CONTENT_STORE_FILE_BYTES_WRITTEN_TO_FILE(GET_STAGE_CONTENT_STORE_INFO(stage)))) {
 			send_client_update_downloading_info(
 					download_id,
 					GET_DL_REQ_ID(download_id),
-					GET_CONTENT_STORE_CURRENT_FILE_SIZE(GET_STAGE_CONTENT_STORE_INFO(stage)),
+					_get_received_size(stage),
 					DA_NULL);
 
 			IS_CONTENT_STORE_FILE_BYTES_WRITTEN_TO_FILE(GET_STAGE_CONTENT_STORE_INFO(stage))
@@ -1348,10 +1800,12 @@ da_result_t handle_http_body(stage_info *stage, char *body, int body_len)
 					GET_CONTENT_STORE_CONTENT_TYPE(GET_STAGE_CONTENT_STORE_INFO(stage)),
 					GET_CONTENT_STORE_FILE_SIZE(GET_STAGE_CONTENT_STORE_INFO(stage)),
 					GET_CONTENT_STORE_TMP_FILE_NAME(GET_STAGE_CONTENT_STORE_INFO(stage)),
-					body,
+					body->data,
+					DA_NULL,
+					DA_NULL,
 					DA_NULL);
 		} else {
-			ret = file_write_ongoing(stage, body, body_len);
+			ret = file_write_ongoing(stage, body);
 			if (ret != DA_RESULT_OK)
 			goto ERR;
 		}
@@ -1412,6 +1866,14 @@ da_result_t set_hdr_fields_on_download_info(stage_info *stage)
 		value = NULL;
 		DA_LOG(HTTPManager, "[ETag][%s] - stored ", GET_REQUEST_HTTP_HDR_ETAG(request_info));
 	}
+	request_info->validator_source_index = request_info->source_index;
+
+	b_ret = http_msg_response_get_last_modified(http_msg_response, &value);
+	if (b_ret) {
+		GET_REQUEST_HTTP_HDR_LAST_MODIFIED(request_info) = value;
+		value = NULL;
+		DA_LOG(HTTPManager, "[Last-Modified][%s] - stored ", GET_REQUEST_HTTP_HDR_LAST_MODIFIED(request_info));
+	}
 
 ERR:
 	return ret;
@@ -1445,29 +1907,44 @@ da_result_t _check_enough_memory_for_this_download(stage_info *stage)
 	req_dl_info *request_info = DA_NULL;
 
 	long long cont_len = 0;
-	da_storage_size_t memory;
 
 	DA_LOG_FUNC_START(HTTPManager);
 
-	memset(&memory, 0x00, sizeof(da_storage_size_t));
 	request_info = GET_STAGE_TRANSACTION_INFO(stage);
 
 	cont_len = (long long) GET_REQUEST_HTTP_HDR_CONT_LEN(request_info);
 	if (cont_len) {
-		ret = get_available_memory(DA_STORAGE_PHONE, &memory);
-		if (DA_RESULT_OK == ret) {
-			DA_LOG(HTTPManager, "Memory avail: %lu, Memory block :%lu Content: %lld",memory.b_available,memory.b_size, cont_len);
-			if (memory.b_available < ((cont_len
-					+ SAVE_FILE_BUFFERING_SIZE_50KB)
-					/ memory.b_size)) /* 50KB buffering */
-			{
-				ret = DA_ERR_DISK_FULL;
-				goto ERR;
-			}
-		}
+		DA_LOG(HTTPManager, "Content: %lld", cont_len);
+		ret = _reserve_space_for_this_download(stage,
+				(unsigned long long)cont_len);
 	}
 
-ERR:
+	return ret;
+}
+
+/* Other downloads on the same file system are considered together */
+da_result_t _reserve_space_for_this_download(stage_info *stage,
+		unsigned long long size)
+{
+	da_result_t ret = DA_RESULT_OK;
+	file_info *file_storage = DA_NULL;
+	char *tmp_dir = DA_NULL;
+
+	file_storage = GET_STAGE_CONTENT_STORE_INFO(stage);
+	if (!file_storage)
+		return DA_ERR_INVALID_ARGUMENT;
+
+	if (GET_CONTENT_STORE_SPACE_RESERVATION(file_storage)) {
+		space_release(GET_CONTENT_STORE_SPACE_RESERVATION(file_storage));
+		GET_CONTENT_STORE_SPACE_RESERVATION(file_storage) = DA_NULL;
+	}
+
+	tmp_dir = get_tmp_file_dir(stage);
+	if (!tmp_dir)
+		return DA_ERR_FAIL_TO_ACCESS_STORAGE;
+	ret = space_reserve(tmp_dir, size, SAVE_FILE_BUFFERING_SIZE_50KB, /* 50KB buffering */
+			&GET_CONTENT_STORE_SPACE_RESERVATION(file_storage));
+	free(tmp_dir);
 	return ret;
 }
 
@@ -1476,12 +1953,12 @@ da_result_t _check_this_partial_download_is_available(stage_info *stage,
 {
 	da_result_t ret = DA_RESULT_OK;
 	da_bool_t b_ret = DA_FALSE;
+	req_dl_info *request_info = DA_NULL;
 
 	char *origin_ETag = NULL;
 	char *new_ETag = NULL;
 
 	int remained_content_len = 0;
-	da_storage_size_t memory;
 
 	char *value = NULL;
 	int int_value = 0;
@@ -1499,35 +1976,39 @@ da_result_t _check_this_partial_download_is_available(stage_info *stage,
 		DA_LOG(HTTPManager, "[remained_content_len][%d]", remained_content_len);
 	}
 
-	b_ret = http_msg_response_get_ETag(new_http_msg_response, &value);
-	if (b_ret) {
-		new_ETag = value;
-		value = NULL;
-		DA_LOG(HTTPManager, "[new ETag][%s]", new_ETag);
+	request_info = GET_STAGE_TRANSACTION_INFO(stage);
+	if (request_info->source_index != request_info->validator_source_index) {
+		if (DA_FALSE == mirror_is_same_content(new_http_msg_response,
+				GET_REQUEST_HTTP_HDR_CONT_LEN(request_info))) {
+			DA_LOG_ERR(HTTPManager, "Content of source[%d] is different! revoke!",
+					request_info->source_index);
+			ret = DA_ERR_NETWORK_FAIL;
+			goto ERR;
+		}
 	} else {
-		goto ERR;
-	}
+		b_ret = http_msg_response_get_ETag(new_http_msg_response, &value);
+		if (b_ret) {
+			new_ETag = value;
+			value = NULL;
+			DA_LOG(HTTPManager, "[new ETag][%s]", new_ETag);
+		} else {
+			goto ERR;
+		}
 
-	if (0 != strcmp(origin_ETag, new_ETag)) {
-		DA_LOG_ERR(HTTPManager, "ETag is not identical! revoke!");
-		/* FIXME Later : Need to detail error exception handling */
-		ret = DA_ERR_NETWORK_FAIL;
-		/*ret = DA_ERR_MISMATCH_HTTP_HEADER; */
-		goto ERR;
+		if (0 != strcmp(origin_ETag, new_ETag)) {
+			DA_LOG_ERR(HTTPManager, "ETag is not identical! revoke!");
+			/* FIXME Later : Need to detail error exception handling */
+			ret = DA_ERR_NETWORK_FAIL;
+			/*ret = DA_ERR_MISMATCH_HTTP_HEADER; */
+			goto ERR;
+		}
 	}
 
 	if (remained_content_len) {
-		ret = get_available_memory(DA_STORAGE_PHONE, &memory);
-		if (DA_RESULT_OK == ret) {
-			DA_LOG(HTTPManager, "Memory avail: %lu, Memory block :%lu Content: %lld",memory.b_available,memory.b_size, remained_content_len );
-			if (memory.b_available < ((remained_content_len
-					+ SAVE_FILE_BUFFERING_SIZE_50KB)
-					/ memory.b_size)) /* 50KB buffering */
-			{
-				ret = DA_ERR_DISK_FULL;
-				goto ERR;
-			}
-		}
+		ret = _reserve_space_for_this_download(stage,
+				(unsigned long long)remained_content_len);
+		if (ret != DA_RESULT_OK)
+			goto ERR;
 	}
 
 ERR:
@@ -1608,6 +2089,8 @@ da_result_t _cancel_transaction(stage_info *stage)
 
 	DA_LOG(HTTPManager, "transaction_id = %d", transaction_id);
 
+	segment_stop(stage);
+
 	if (transaction_id != DA_INVALID_ID) {
 		http_state_t state = 0;
 		_da_thread_mutex_lock(&(GET_REQUEST_HTTP_MUTEX_HTTP_STATE(stage)));
@@ -1622,6 +2105,18 @@ da_result_t _cancel_transaction(stage_info *stage)
 	return ret;
 }
 
+unsigned int _get_received_size(stage_info *stage)
+{
+	if (IS_SEGMENTED_DOWNLOAD(stage))
+		return (unsigned int)segment_get_received_size(stage);
+
+	/* Body on the write buffer is also received */
+	return GET_CONTENT_STORE_CURRENT_FILE_SIZE(
+			GET_STAGE_CONTENT_STORE_INFO(stage)) +
+			GET_CONTENT_STORE_FILE_BUFF_LEN(
+			GET_STAGE_CONTENT_STORE_INFO(stage));
+}
+
 void __parsing_user_request_header(char *user_request_header,
 		char **out_field, char **out_value)
 {
@@ -0,0 +1,174 @@
+/*
+ * Download Agent
+ *
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Jungki Kwak <jungki.kwak@samsung.com>, Keunsoon Lee <keunsoon.lee@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file		download-agent-http-mirror.c
+ * @brief		functions for mirrors of download
+ ***/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "download-agent-debug.h"
+#include "download-agent-http-mgr.h"
+#include "download-agent-http-mirror.h"
+#include "download-agent-client-mgr.h"
+#include "download-agent-plugin-conf.h"
+#include "download-agent-plugin-http-interface.h"
+
+static void __set_source(stage_info *stage, int source_index);
+
+int mirror_get_source_count(stage_info *stage)
+{
+	return GET_SOURCE_BASIC(GET_STAGE_SOURCE_INFO(stage))->mirror_url_count + 1;
+}
+
+char *mirror_get_source_url(stage_info *stage, int source_index)
+{
+	source_info_basic_t *source_info_basic =
+		GET_SOURCE_BASIC(GET_STAGE_SOURCE_INFO(stage));
+	req_dl_info *request_info = GET_STAGE_TRANSACTION_INFO(stage);
+
+	if (source_index > 0 &&
+			source_index <= source_info_basic->mirror_url_count)
+		return source_info_basic->mirror_url[source_index - 1];
+
+	if (GET_REQUEST_HTTP_CACHED_REDIRECT_URL(request_info))
+		return GET_REQUEST_HTTP_CACHED_REDIRECT_URL(request_info);
+	return source_info_basic->url;
+}
+
+static void __set_source(stage_info *stage, int source_index)
+{
+	req_dl_info *request_info = GET_STAGE_TRANSACTION_INFO(stage);
+
+	request_info->source_index = source_index;
+	GET_REQUEST_HTTP_REQ_URL(request_info) =
+		mirror_get_source_url(stage, source_index);
+	/* The redirected location of previous source is not used any more */
+	if (GET_REQUEST_HTTP_REQ_LOCATION(request_info)) {
+		free(GET_REQUEST_HTTP_REQ_LOCATION(request_info));
+		GET_REQUEST_HTTP_REQ_LOCATION(request_info) = DA_NULL;
+	}
+	DA_LOG(HTTPManager, "source[%d] [%s]", source_index,
+			GET_REQUEST_HTTP_REQ_URL(request_info));
+}
+
+da_result_t mirror_select_fastest_source(stage_info *stage)
+{
+	da_result_t ret = DA_RESULT_OK;
+	req_dl_info *request_info = DA_NULL;
+	http_msg_request_t *requests[DA_MAX_MIRROR_COUNT + 1] = { DA_NULL, };
+	char range_str[64] = { 0, };
+	char *proxy_addr = DA_NULL;
+	int count = 0;
+	int fastest = -1;
+	int i = 0;
+
+	DA_LOG_FUNC_START(HTTPManager);
+
+	count = mirror_get_source_count(stage);
+	if (count <= 1)
+		return ret;
+	if (DA_TRUE == is_this_client_manual_download_type())
+		return ret;
+
+	request_info = GET_STAGE_TRANSACTION_INFO(stage);
+
+	snprintf(range_str, sizeof(range_str), "bytes=0-%d",
+			DA_MIRROR_PROBE_SIZE - 1);
+	for (i = 0; i < count; i++) {
+		ret = make_default_http_request_hdr(mirror_get_source_url(stage, i),
+				GET_REQUEST_HTTP_USER_REQUEST_HEADER(request_info),
+				GET_REQUEST_HTTP_USER_REQUEST_HEADER_COUNT(request_info),
+				&requests[i]);
+		if (ret != DA_RESULT_OK)
+			goto ERR;
+		http_msg_request_add_field(requests[i], HTTP_FIELD_RANGE, range_str);
+	}
+
+	proxy_addr = get_proxy_address();
+	ret = PI_http_probe_transactions(requests, count, proxy_addr,
+			DA_MIRROR_PROBE_TIMEOUT_MSEC, &fastest);
+	if (proxy_addr)
+		free(proxy_addr);
+
+	DA_LOG_CRITICAL(HTTPManager, "[%d] fastest source [%d] of [%d]",
+			GET_STAGE_DL_ID(stage), fastest, count);
+	if (ret == DA_RESULT_OK && fastest > 0)
+		__set_source(stage, fastest);
+
+ERR:
+	for (i = 0; i < count; i++) {
+		if (requests[i])
+			http_msg_request_destroy(&requests[i]);
+	}
+	/* The probe is just a hint. The url is requested anyway if it is failed */
+	return DA_RESULT_OK;
+}
+
+da_bool_t mirror_is_failover_available(stage_info *stage)
+{
+	req_dl_info *request_info = GET_STAGE_TRANSACTION_INFO(stage);
+	int count = mirror_get_source_count(stage);
+
+	if (count <= 1)
+		return DA_FALSE;
+	if (DA_TRUE == is_this_client_manual_download_type())
+		return DA_FALSE;
+	return (request_info->source_failover_count < count - 1) ?
+		DA_TRUE : DA_FALSE;
+}
+
+void mirror_switch_to_next_source(stage_info *stage)
+{
+	req_dl_info *request_info = GET_STAGE_TRANSACTION_INFO(stage);
+	int next = 0;
+
+	next = (request_info->source_index + 1) % mirror_get_source_count(stage);
+	request_info->source_failover_count++;
+	DA_LOG_CRITICAL(HTTPManager, "[%d] switch source [%d] -> [%d]",
+			GET_STAGE_DL_ID(stage), request_info->source_index, next);
+	__set_source(stage, next);
+}
+
+da_bool_t mirror_is_same_content(http_msg_response_t *http_msg_response,
+		unsigned long long total_size)
+{
+	char *value = DA_NULL;
+	char *slash = DA_NULL;
+	da_bool_t is_same = DA_FALSE;
+
+	if (total_size == 0)
+		return DA_FALSE;
+
+	if (!http_msg_response_get_content_range(http_msg_response, &value))
+		return DA_FALSE;
+
+	/* bytes first-last/total */
+	slash = strchr(value, '/');
+	if (slash && strtoull(slash + 1, DA_NULL, 10) == total_size)
+		is_same = DA_TRUE;
+	else
+		DA_LOG_ERR(HTTPManager, "Content-Range[%s] total[%llu]", value,
+				total_size);
+	free(value);
+
+	return is_same;
+}
@@ -30,6 +30,7 @@
 #include "download-agent-debug.h"
 #include "download-agent-http-misc.h"
 #include "download-agent-encoding.h"
+#include "download-agent-pool.h"
 
 // '.' and ';' are request from Vodafone
 #define IS_TERMINATING_CHAR(c)      	( ((c) == ';') || ((c) == '\0') || ((c) == 0x0d) || ((c) == 0x0a) || ((c) == 0x20) )
@@ -355,7 +356,7 @@ da_result_t __http_header_add_field(http_header_t **head,
 		cur = cur->next;
 	}
 
-	cur = (http_header_t *)calloc(1, sizeof(http_header_t));
+	cur = (http_header_t *)pool_alloc(DA_POOL_HTTP_HEADER);
 	if (cur) {
 		cur->field = strdup(field);
 		cur->raw_value = strdup(value);
@@ -412,7 +413,7 @@ void __http_header_destroy_all_field(http_header_t **head)
 		pre = cur;
 		cur = cur->next;
 
-		free(pre);
+		pool_free(DA_POOL_HTTP_HEADER, pre);
 	}
 
 	*head = DA_NULL;
@@ -1014,6 +1015,90 @@ da_bool_t http_msg_response_get_ETag(http_msg_response_t *http_msg_response,
 	return DA_TRUE;
 }
 
+da_bool_t http_msg_response_get_last_modified(
+	http_msg_response_t *http_msg_response, char **out_value)
+{
+	da_bool_t b_ret = DA_FALSE;
+	http_header_t *header = NULL;
+
+	DA_LOG_FUNC_START(HTTPManager);
+
+	b_ret = __get_http_header_for_field(http_msg_response,
+		HTTP_FIELD_LAST_MODIFIED, &header);
+	if (!b_ret) {
+		DA_LOG(HTTPManager, "no Last-Modified");
+		return DA_FALSE;
+	}
+
+	if (out_value)
+		*out_value = strdup(header->value);
+
+	return DA_TRUE;
+}
+
+da_bool_t http_msg_response_get_cache_control(
+	http_msg_response_t *http_msg_response, char **out_value)
+{
+	da_bool_t b_ret = DA_FALSE;
+	http_header_t *header = NULL;
+
+	DA_LOG_FUNC_START(HTTPManager);
+
+	b_ret = __get_http_header_for_field(http_msg_response,
+		HTTP_FIELD_CACHE_CONTROL, &header);
+	if (!b_ret) {
+		DA_LOG(HTTPManager, "no Cache-Control");
+		return DA_FALSE;
+	}
+
+	if (out_value)
+		*out_value = strdup(header->value);
+
+	return DA_TRUE;
+}
+
+da_bool_t http_msg_response_get_accept_ranges(
+	http_msg_response_t *http_msg_response, char **out_value)
+{
+	da_bool_t b_ret = DA_FALSE;
+	http_header_t *header = NULL;
+
+	DA_LOG_FUNC_START(HTTPManager);
+
+	b_ret = __get_http_header_for_field(http_msg_response,
+		HTTP_FIELD_ACCEPT_RANGES, &header);
+	if (!b_ret) {
+		DA_LOG(HTTPManager, "no Accept-Ranges");
+		return DA_FALSE;
+	}
+
+	if (out_value)
+		*out_value = strdup(header->value);
+
+	return DA_TRUE;
+}
+
+da_bool_t http_msg_response_get_content_range(
+	http_msg_response_t *http_msg_response, char **out_value)
+{
+	da_bool_t b_ret = DA_FALSE;
+	http_header_t *header = NULL;
+
+	DA_LOG_FUNC_START(HTTPManager);
+
+	b_ret = __get_http_header_for_field(http_msg_response,
+		HTTP_FIELD_CONTENT_RANGE, &header);
+	if (!b_ret) {
+		DA_LOG(HTTPManager, "no Content-Range");
+		return DA_FALSE;
+	}
+
+	if (out_value)
+		*out_value = strdup(header->value);
+
+	return DA_TRUE;
+}
+
 da_bool_t http_msg_response_get_date(http_msg_response_t *http_msg_response,
 	char **out_value)
 {
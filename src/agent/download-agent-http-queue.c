@@ -26,16 +26,30 @@
 #include "download-agent-http-mgr.h"
 #include "download-agent-debug.h"
 #include "download-agent-pthread.h"
+#include "download-agent-pool.h"
 
 void init_q_event_data_http(q_event_t *q_event);
 void init_q_event_control(q_event_t *q_event);
 
+static void __push_control_event(queue_t *queue, q_event_t *event);
+static da_bool_t __push_data_event(queue_t *queue, q_event_t *event);
+static void __wake_up_if_waiting(queue_t *queue);
+
 void Q_init_queue(queue_t *queue)
 {
-	queue->having_data = DA_FALSE;
+	int i = 0;
+
 	queue->control_head = DA_NULL;
-	queue->data_head = DA_NULL;
+	queue->control_count = 0;
+	for (i = 0; i < Q_DATA_RING_SIZE; i++)
+		queue->data_ring[i] = DA_NULL;
+	queue->data_tail = 0;
+	queue->data_head = 0;
+	queue->is_waiting = 0;
 	queue->queue_size = 0;
+	queue->high_watermark = Q_DEFAULT_HIGH_WATERMARK;
+	queue->low_watermark = Q_DEFAULT_LOW_WATERMARK;
+	queue->is_over_high_watermark = 0;
 
 	_da_thread_mutex_init(&(queue->mutex_queue), DA_NULL);
 	_da_thread_cond_init(&(queue->cond_queue), DA_NULL);
@@ -52,15 +66,32 @@ void Q_destroy_queue(queue_t *queue)
 		Q_destroy_q_event(&event);
 	} while(event);
 
-	queue->having_data = DA_FALSE;
 	queue->control_head = DA_NULL;
-	queue->data_head = DA_NULL;
+	queue->control_count = 0;
+	queue->data_tail = 0;
+	queue->data_head = 0;
 	queue->queue_size = 0;
 
 	_da_thread_mutex_destroy(&(queue->mutex_queue));
 	_da_thread_cond_destroy(&(queue->cond_queue));
 }
 
+void Q_set_watermark(queue_t *queue, int high_watermark, int low_watermark)
+{
+	if (high_watermark <= 0 || high_watermark > Q_MAX_HIGH_WATERMARK) {
+		DA_LOG_ERR(HTTPManager, "invalid high watermark [%d]", high_watermark);
+		high_watermark = Q_DEFAULT_HIGH_WATERMARK;
+	}
+	if (low_watermark < 0 || low_watermark >= high_watermark) {
+		DA_LOG_ERR(HTTPManager, "invalid low watermark [%d]", low_watermark);
+		low_watermark = high_watermark / 4;
+	}
+	DA_LOG(HTTPManager, "watermark high[%d] low[%d]", high_watermark, low_watermark);
+
+	queue->high_watermark = high_watermark;
+	queue->low_watermark = low_watermark;
+}
+
 void Q_init_q_event(q_event_t *q_event)
 {
 	switch(q_event->event_type) {
@@ -91,13 +122,13 @@ void Q_destroy_q_event(q_event_t **in_q_event)
 			init_q_event_data_http(q_event);
 			q_event->size = 0;
 			q_event->next = DA_NULL;
-			free(q_event);
+			pool_free(DA_POOL_Q_EVENT, q_event);
 			break;
 		case Q_EVENT_TYPE_CONTROL:
 			init_q_event_control(q_event);
 			q_event->size = 0;
 			q_event->next = DA_NULL;
-			free(q_event);
+			pool_free(DA_POOL_Q_EVENT, q_event);
 			break;
 	}
 }
@@ -109,7 +140,7 @@ da_result_t  Q_make_control_event(q_event_type_control control_type, q_event_t *
 
 	DA_LOG_FUNC_START(HTTPManager);
 
-	q_event = (q_event_t *)calloc(1, sizeof(q_event_t));
+	q_event = (q_event_t *)pool_alloc(DA_POOL_Q_EVENT);
 	if(q_event == DA_NULL) {
 		DA_LOG_ERR(HTTPManager, "calloc fail for q_event");
 		ret = DA_ERR_FAIL_TO_MEMALLOC;
@@ -133,7 +164,7 @@ da_result_t  Q_make_http_data_event(q_event_type_data data_type, q_event_t **out
 
 //	DA_LOG_FUNC_START(HTTPManager);
 
-	q_event = (q_event_t *)calloc(1, sizeof(q_event_t));
+	q_event = (q_event_t *)pool_alloc(DA_POOL_Q_EVENT);
 	if(q_event == DA_NULL) {
 		DA_LOG_ERR(HTTPManager, "calloc fail for q_event");
 		ret = DA_ERR_FAIL_TO_MEMALLOC;
@@ -196,6 +227,42 @@ ERR:
 
 }
 
+da_result_t  Q_set_http_body_owner_on_http_data_event(q_event_t *q_event,
+		void *body_owner, int owner_size,
+		void (*release_body)(void *body_owner))
+{
+	da_result_t  ret = DA_RESULT_OK;
+
+	if(q_event->event_type != Q_EVENT_TYPE_DATA_HTTP) {
+		DA_LOG_ERR(HTTPManager, "http body can be set only for Q_EVENT_TYPE_DATA_HTTP.");
+		ret = DA_ERR_INVALID_ARGUMENT;
+		goto ERR;
+	}
+
+	q_event->type.q_event_data_http.body_owner = body_owner;
+	q_event->type.q_event_data_http.release_body = release_body;
+	/* The whole block is held until the event is destroyed */
+	if (owner_size > q_event->size)
+		q_event->size = owner_size;
+
+ERR:
+	return ret;
+}
+
+void Q_take_http_body_from_http_data_event(q_event_t *q_event, da_body_slice_t *out_slice)
+{
+	q_event_data_http_t *q_event_data_http = &(q_event->type.q_event_data_http);
+
+	out_slice->data = q_event_data_http->body_data;
+	out_slice->len = q_event_data_http->body_len;
+	out_slice->owner = q_event_data_http->body_owner;
+	out_slice->release = q_event_data_http->release_body;
+
+	q_event_data_http->body_data = DA_NULL;
+	q_event_data_http->body_owner = DA_NULL;
+	q_event_data_http->release_body = DA_NULL;
+}
+
 da_result_t  Q_set_error_type_on_http_data_event(q_event_t *q_event, int error_type)
 {
 	da_result_t  ret = DA_RESULT_OK;
@@ -217,14 +284,86 @@ ERR:
 
 }
 
+/* Should be called with mutex_queue locked */
+static void __push_control_event(queue_t *queue, q_event_t *event)
+{
+	q_event_t *cur = DA_NULL;
+
+	if (queue->control_head == DA_NULL) {
+		queue->control_head = event;
+	} else {
+		cur = queue->control_head;
+		while (cur->next != DA_NULL) {
+			cur = cur->next;
+		}
+		cur->next = event;
+	}
+	/* Full barrier. The consumer sees the count before the data pushed after this */
+	__sync_fetch_and_add(&(queue->control_count), 1);
+}
+
+/* Should be called only by the producer of data events */
+static da_bool_t __push_data_event(queue_t *queue, q_event_t *event)
+{
+	unsigned int tail = queue->data_tail;
+	unsigned int used = 0;
+
+	used = tail - queue->data_head;
+	/* Do not write the slot before the consumer finishes reading it */
+	__sync_synchronize();
+
+	if (event->size > 0) {
+		if (queue->queue_size >= queue->high_watermark ||
+				used >= Q_DATA_RING_SIZE - Q_DATA_RING_RESERVED) {
+			DA_LOG_CRITICAL(HTTPManager, "rejected event's size is %d queue_size %d",
+					event->size, queue->queue_size);
+			queue->is_over_high_watermark = 1;
+			return DA_FALSE;
+		}
+	} else if (used >= Q_DATA_RING_SIZE) {
+		DA_LOG_CRITICAL(HTTPManager, "data ring is full");
+		return DA_FALSE;
+	}
+
+	queue->data_ring[tail & Q_DATA_RING_MASK] = event;
+	/* Full barrier. The slot is published before the tail */
+	__sync_fetch_and_add(&(queue->queue_size), event->size);
+	queue->data_tail = tail + 1;
+	/* The tail is published before is_waiting is read */
+	__sync_synchronize();
+
+	return DA_TRUE;
+}
+
+/* The consumer sets is_waiting with mutex_queue locked, and checks the ring again
+ * before sleeping. So either the consumer sees the new event,
+ * or the producer sees is_waiting and the signal is sent after the consumer sleeps. */
+static void __wake_up_if_waiting(queue_t *queue)
+{
+	if (queue->is_waiting) {
+		_da_thread_mutex_lock (&(queue->mutex_queue));
+		Q_wake_up(queue);
+		_da_thread_mutex_unlock (&(queue->mutex_queue));
+	}
+}
+
 da_bool_t Q_push_event(const queue_t *in_queue, const q_event_t *in_event)
 {
 	da_bool_t b_ret = DA_FALSE;
 	queue_t *queue = (queue_t *)in_queue;
+	q_event_t *event = (q_event_t *)in_event;
 
-	_da_thread_mutex_lock (&(queue->mutex_queue));
-	b_ret = Q_push_event_without_lock(in_queue, in_event);
-	_da_thread_mutex_unlock (&(queue->mutex_queue));
+	if (event->event_type == Q_EVENT_TYPE_CONTROL) {
+		_da_thread_mutex_lock (&(queue->mutex_queue));
+		__push_control_event(queue, event);
+		Q_wake_up(queue);
+		_da_thread_mutex_unlock (&(queue->mutex_queue));
+		b_ret = DA_TRUE;
+	} else {
+		b_ret = __push_data_event(queue, event);
+		if (b_ret == DA_TRUE)
+			__wake_up_if_waiting(queue);
+	}
 
 	return b_ret;
 }
@@ -234,65 +373,23 @@ da_bool_t Q_push_event_without_lock(const queue_t *in_queue, const q_event_t *in
 	da_bool_t b_ret = DA_FALSE;
 	queue_t *queue = (queue_t *)in_queue;
 	q_event_t *event = (q_event_t *)in_event;
-	q_event_type event_type;
-	q_event_t *head = DA_NULL;
-	q_event_t *cur = DA_NULL;
-
-//	DA_LOG_FUNC_START(HTTPManager);
-//	DA_LOG(HTTPManager, "queue = %x", in_queue);
-
-	event_type = event->event_type;
 
-//	_da_thread_mutex_lock (&(queue->mutex_queue));
-
-	if(event_type == Q_EVENT_TYPE_CONTROL) {
-		head = queue->control_head;
-		if(head == DA_NULL) {
-			queue->control_head = event;
-		} else {
-			cur = head;
-
-			while(cur->next != DA_NULL) {
-				cur = cur->next;
-			}
-			cur->next= event;
-		}
+	if (event->event_type == Q_EVENT_TYPE_CONTROL) {
+		__push_control_event(queue, event);
 		b_ret = DA_TRUE;
 	} else {
-		if((event->size == 0) || (queue->queue_size < MAX_QUEUE_SIZE)) {
-			head = queue->data_head;
-			if(head == DA_NULL)	{
-				queue->data_head = event;
-			} else {
-				cur = head;
-				while(cur->next != DA_NULL) {
-					cur = cur->next;
-				}
-				cur->next= event ;
-			}
-
-			queue->queue_size += event->size;
-//			DA_LOG(HTTPManager, "queue size is %d", queue->queue_size);
-
-			b_ret = DA_TRUE;
-		} else {
-			DA_LOG_CRITICAL(HTTPManager, "rejected event's size is %d queue_size %d", event->size, queue->queue_size);
-			b_ret = DA_FALSE;
-		}
+		b_ret = __push_data_event(queue, event);
 	}
 
-	queue->having_data = DA_TRUE;
 	Q_wake_up(queue);
-//	_da_thread_mutex_unlock (&(queue->mutex_queue));
 	return b_ret;
 }
 
 void Q_pop_event(const queue_t *in_queue, q_event_t **out_event)
 {
 	queue_t *queue = (queue_t*)in_queue;
-
-//	DA_LOG_FUNC_START(HTTPManager);
-//	DA_LOG(HTTPManager, "queue = %x", in_queue);
+	unsigned int head = 0;
+	unsigned int tail = 0;
 
 	/** Pop Priority
 	  * 1. If there are control event, control event should pop first
@@ -300,54 +397,95 @@ void Q_pop_event(const queue_t *in_queue, q_event_t **out_event)
 	  * 3. If there is no control and data event on queue, pop NULL
 	 */
 
-	_da_thread_mutex_lock (&(queue->mutex_queue));
+	*out_event = DA_NULL;
 
-	if(queue->control_head != DA_NULL) {/* Priority 1 */
+	head = queue->data_head;
+	tail = queue->data_tail;
+	/* The control event which is pushed before the tail is seen, too */
+	__sync_synchronize();
+
+	if (queue->control_count > 0) {/* Priority 1 */
+		_da_thread_mutex_lock (&(queue->mutex_queue));
 		*out_event = queue->control_head;
 		queue->control_head = queue->control_head->next;
-	} else {
-		if(queue->data_head != DA_NULL) {/* Priority 2 */
-			*out_event = queue->data_head;
-			queue->data_head = queue->data_head->next;
-			queue->queue_size -= (*out_event)->size;
-//			DA_LOG(HTTPManager, "queue size is %d", queue->queue_size);
-		} else {/* Priority 3 */
-			*out_event = DA_NULL;
-		}
+		(*out_event)->next = DA_NULL;
+		__sync_fetch_and_sub(&(queue->control_count), 1);
+		_da_thread_mutex_unlock (&(queue->mutex_queue));
+	} else if (head != tail) {/* Priority 2 */
+		*out_event = queue->data_ring[head & Q_DATA_RING_MASK];
+		queue->data_ring[head & Q_DATA_RING_MASK] = DA_NULL;
+		/* Full barrier. The slot is read before it is given back to the producer */
+		__sync_fetch_and_sub(&(queue->queue_size), (*out_event)->size);
+		queue->data_head = head + 1;
 	}
+}
 
-	if((queue->control_head == DA_NULL) && (queue->data_head == DA_NULL)) {
-		queue->having_data = DA_FALSE;
-	} else {
-		queue->having_data = DA_TRUE;
-	}
+da_bool_t Q_is_having_data(const queue_t *in_queue)
+{
+	if (in_queue->control_count > 0 ||
+			in_queue->data_head != in_queue->data_tail)
+		return DA_TRUE;
+	return DA_FALSE;
+}
 
-	_da_thread_mutex_unlock (&(queue->mutex_queue));
+da_bool_t Q_is_drained_to_low_watermark(const queue_t *in_queue)
+{
+	queue_t *queue = (queue_t *)in_queue;
 
+	if (queue->is_over_high_watermark &&
+			queue->queue_size <= queue->low_watermark) {
+		queue->is_over_high_watermark = 0;
+		return DA_TRUE;
+	}
+	return DA_FALSE;
 }
 
+/* Should be called with mutex_queue locked */
 void Q_goto_sleep(const queue_t *in_queue)
 {
+	queue_t *queue = (queue_t *)in_queue;
+
 //	DA_LOG_FUNC_START(HTTPManager);
 	DA_LOG(HTTPManager, "sleep for %p", in_queue);
 
-//** SHOULD NOT use mutex **//
+	queue->is_waiting = 1;
+	__sync_synchronize();
+	if (DA_FALSE == Q_is_having_data(queue))
+		_da_thread_cond_wait(&(queue->cond_queue), &(queue->mutex_queue));
+	queue->is_waiting = 0;
+}
+
+/* Same with Q_goto_sleep(), but wakes up by itself after msec */
+void Q_goto_sleep_with_timeout(const queue_t *in_queue, unsigned long msec)
+{
+	queue_t *queue = (queue_t *)in_queue;
+	struct timespec ts;
+
+	DA_LOG(HTTPManager, "sleep for %p, %lu msec", in_queue, msec);
 
-//	_da_thread_mutex_lock (&(in_queue->mutex_queue));
-	_da_thread_cond_wait((pthread_cond_t*)(&(in_queue->cond_queue)),(pthread_mutex_t*) (&(in_queue->mutex_queue)));
-//	_da_thread_mutex_unlock (&(in_queue->mutex_queue));
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += msec / 1000;
+	ts.tv_nsec += (msec % 1000) * 1000000;
+	if (ts.tv_nsec >= 1000000000) {
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000;
+	}
+
+	queue->is_waiting = 1;
+	__sync_synchronize();
+	/* ETIMEDOUT is expected */
+	if (DA_FALSE == Q_is_having_data(queue))
+		pthread_cond_timedwait(&(queue->cond_queue), &(queue->mutex_queue), &ts);
+	queue->is_waiting = 0;
 }
 
+/* Should be called with mutex_queue locked */
 void Q_wake_up(const queue_t *in_queue)
 {
 //	DA_LOG_FUNC_START(HTTPManager);
 	DA_LOG(HTTPManager, "wake up for %p", in_queue);
 
-//** SHOULD NOT use mutex **//
-
-//	_da_thread_mutex_lock (&(in_queue->mutex_queue));
 	_da_thread_cond_signal((pthread_cond_t*)(&(in_queue->cond_queue)));
-//	_da_thread_mutex_unlock (&(in_queue->mutex_queue));
 }
 
 void init_q_event_data_http(q_event_t *q_event)
@@ -366,10 +504,16 @@ void init_q_event_data_http(q_event_t *q_event)
 			}
 
 			if(q_event_data_http->body_len > 0 ) {
-				if (q_event_data_http->body_data) {
+				if (q_event_data_http->release_body) {
+					if (q_event_data_http->body_owner)
+						q_event_data_http->release_body(
+								q_event_data_http->body_owner);
+				} else if (q_event_data_http->body_data) {
 					free(q_event_data_http->body_data);
-					q_event_data_http->body_data = DA_NULL;
 				}
+				q_event_data_http->body_data = DA_NULL;
+				q_event_data_http->body_owner = DA_NULL;
+				q_event_data_http->release_body = DA_NULL;
 			}
 			q_event_data_http->error_type = DA_NULL;
 		}
@@ -0,0 +1,294 @@
+/*
+ * Download Agent
+ *
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Jungki Kwak <jungki.kwak@samsung.com>, Keunsoon Lee <keunsoon.lee@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file		download-agent-http-rate.c
+ * @brief		functions for bandwidth shaping with token buckets
+ ***/
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "download-agent-debug.h"
+#include "download-agent-pthread.h"
+#include "download-agent-utils.h"
+#include "download-agent-dl-info-util.h"
+#include "download-agent-http-rate.h"
+#include "download-agent-plugin-http-interface.h"
+
+typedef struct _rate_bucket_t {
+	unsigned int rate; /* bytes per second. 0 means unlimited */
+	long long tokens; /* negative value is debt */
+	unsigned long long last_msec;
+} rate_bucket_t;
+
+typedef struct _rate_group_t {
+	char *name;
+	rate_bucket_t bucket;
+} rate_group_t;
+
+static pthread_mutex_t mutex_rate = PTHREAD_MUTEX_INITIALIZER;
+static rate_bucket_t global_bucket;
+static rate_bucket_t download_bucket[DA_MAX_DOWNLOAD_ID];
+static rate_group_t rate_group[DA_MAX_RATE_GROUP_COUNT];
+/* index + 1 of rate_group. 0 means no group */
+static int download_group[DA_MAX_DOWNLOAD_ID];
+
+static void __set_bucket_rate(rate_bucket_t *bucket, unsigned int rate);
+static void __refill_bucket(rate_bucket_t *bucket, unsigned long long now);
+static unsigned long __get_debt_msec(rate_bucket_t *bucket);
+static int __get_group_index(const char *group, da_bool_t need_to_add);
+static unsigned long __charge_buckets(int download_id, int len);
+
+static void __set_bucket_rate(rate_bucket_t *bucket, unsigned int rate)
+{
+	long long max_tokens = (long long)rate * DA_RATE_BURST_MSEC / 1000;
+
+	bucket->rate = rate;
+	bucket->last_msec = get_monotonic_msec();
+	/* Debt is kept not to make a burst by changing rate continuously */
+	if (rate == 0 || bucket->tokens > max_tokens)
+		bucket->tokens = rate ? max_tokens : 0;
+}
+
+static void __refill_bucket(rate_bucket_t *bucket, unsigned long long now)
+{
+	long long max_tokens = 0;
+	long long new_tokens = 0;
+
+	if (bucket->rate == 0 || now <= bucket->last_msec)
+		return;
+
+	new_tokens = (long long)bucket->rate * (now - bucket->last_msec) / 1000;
+	/* Not to lose the elapsed time on frequent calls for low rate */
+	if (new_tokens == 0)
+		return;
+
+	max_tokens = (long long)bucket->rate * DA_RATE_BURST_MSEC / 1000;
+	bucket->tokens += new_tokens;
+	if (bucket->tokens > max_tokens)
+		bucket->tokens = max_tokens;
+	bucket->last_msec = now;
+}
+
+static unsigned long __get_debt_msec(rate_bucket_t *bucket)
+{
+	if (bucket->rate == 0 || bucket->tokens >= 0)
+		return 0;
+	return (unsigned long)((-bucket->tokens * 1000 + bucket->rate - 1) /
+			bucket->rate);
+}
+
+/* Should be called with mutex_rate locked */
+static int __get_group_index(const char *group, da_bool_t need_to_add)
+{
+	int i = 0;
+	int j = 0;
+	int empty = -1;
+
+	for (i = 0; i < DA_MAX_RATE_GROUP_COUNT; i++) {
+		if (rate_group[i].name) {
+			if (!strcmp(rate_group[i].name, group))
+				return i;
+		} else if (empty < 0) {
+			empty = i;
+		}
+	}
+
+	if (DA_FALSE == need_to_add)
+		return -1;
+
+	/* Reuse a group which is not limited and not used by any download */
+	for (i = 0; i < DA_MAX_RATE_GROUP_COUNT && empty < 0; i++) {
+		if (rate_group[i].bucket.rate)
+			continue;
+		for (j = 0; j < DA_MAX_DOWNLOAD_ID; j++) {
+			if (download_group[j] == i + 1)
+				break;
+		}
+		if (j == DA_MAX_DOWNLOAD_ID) {
+			free(rate_group[i].name);
+			rate_group[i].name = DA_NULL;
+			empty = i;
+		}
+	}
+
+	if (empty < 0) {
+		DA_LOG_ERR(HTTPManager, "No more rate group for [%s]", group);
+		return -1;
+	}
+
+	rate_group[empty].name = strdup(group);
+	if (!rate_group[empty].name)
+		return -1;
+	memset(&(rate_group[empty].bucket), 0x00, sizeof(rate_bucket_t));
+	return empty;
+}
+
+da_result_t rate_set_global_limit(unsigned int bytes_per_sec)
+{
+	DA_LOG(HTTPManager, "global rate [%u]", bytes_per_sec);
+
+	_da_thread_mutex_lock(&mutex_rate);
+	__set_bucket_rate(&global_bucket, bytes_per_sec);
+	_da_thread_mutex_unlock(&mutex_rate);
+
+	return DA_RESULT_OK;
+}
+
+da_result_t rate_set_download_limit(int download_id, unsigned int bytes_per_sec)
+{
+	DA_LOG(HTTPManager, "download_id[%d] rate [%u]", download_id,
+			bytes_per_sec);
+
+	if (download_id < 0 || download_id >= DA_MAX_DOWNLOAD_ID)
+		return DA_ERR_INVALID_ARGUMENT;
+
+	_da_thread_mutex_lock(&mutex_rate);
+	__set_bucket_rate(&(download_bucket[download_id]), bytes_per_sec);
+	_da_thread_mutex_unlock(&mutex_rate);
+
+	return DA_RESULT_OK;
+}
+
+da_result_t rate_set_group_limit(const char *group, unsigned int bytes_per_sec)
+{
+	da_result_t ret = DA_RESULT_OK;
+	int index = -1;
+
+	if (!group || !*group)
+		return DA_ERR_INVALID_ARGUMENT;
+
+	DA_LOG(HTTPManager, "group[%s] rate [%u]", group, bytes_per_sec);
+
+	_da_thread_mutex_lock(&mutex_rate);
+	/* No need to make a group only for unlimited rate */
+	index = __get_group_index(group, bytes_per_sec ? DA_TRUE : DA_FALSE);
+	if (index >= 0)
+		__set_bucket_rate(&(rate_group[index].bucket), bytes_per_sec);
+	else if (bytes_per_sec)
+		ret = DA_ERR_FAIL_TO_MEMALLOC;
+	_da_thread_mutex_unlock(&mutex_rate);
+
+	return ret;
+}
+
+da_result_t rate_set_download_group(int download_id, const char *group)
+{
+	da_result_t ret = DA_RESULT_OK;
+	int index = -1;
+
+	if (download_id < 0 || download_id >= DA_MAX_DOWNLOAD_ID)
+		return DA_ERR_INVALID_ARGUMENT;
+
+	_da_thread_mutex_lock(&mutex_rate);
+	if (group && *group) {
+		index = __get_group_index(group, DA_TRUE);
+		if (index < 0)
+			ret = DA_ERR_FAIL_TO_MEMALLOC;
+	}
+	download_group[download_id] = index + 1;
+	_da_thread_mutex_unlock(&mutex_rate);
+
+	return ret;
+}
+
+void rate_reset_download(int download_id)
+{
+	if (download_id < 0 || download_id >= DA_MAX_DOWNLOAD_ID)
+		return;
+
+	_da_thread_mutex_lock(&mutex_rate);
+	memset(&(download_bucket[download_id]), 0x00, sizeof(rate_bucket_t));
+	download_group[download_id] = 0;
+	_da_thread_mutex_unlock(&mutex_rate);
+}
+
+/* Returns the time to wait until all the buckets of the download are
+ * out of debt. Should be called with mutex_rate locked */
+static unsigned long __charge_buckets(int download_id, int len)
+{
+	rate_bucket_t *bucket[3] = { DA_NULL, };
+	unsigned long long now = get_monotonic_msec();
+	unsigned long msec = 0;
+	unsigned long max_msec = 0;
+	int group_index = 0;
+	int i = 0;
+
+	bucket[0] = &global_bucket;
+	bucket[1] = &(download_bucket[download_id]);
+	group_index = download_group[download_id];
+	if (group_index > 0)
+		bucket[2] = &(rate_group[group_index - 1].bucket);
+
+	for (i = 0; i < 3; i++) {
+		if (!bucket[i] || bucket[i]->rate == 0)
+			continue;
+		__refill_bucket(bucket[i], now);
+		bucket[i]->tokens -= len;
+		msec = __get_debt_msec(bucket[i]);
+		if (msec > max_msec)
+			max_msec = msec;
+	}
+	return max_msec;
+}
+
+void rate_charge_transaction(int download_id, int tranx_id, int body_len,
+		da_bool_t *is_throttled)
+{
+	unsigned long msec = 0;
+
+	if (download_id < 0 || download_id >= DA_MAX_DOWNLOAD_ID)
+		return;
+
+	_da_thread_mutex_lock(&mutex_rate);
+	msec = __charge_buckets(download_id, body_len);
+	_da_thread_mutex_unlock(&mutex_rate);
+
+	/* The data which is already on queue is also charged.
+	 * It just makes the debt larger */
+	if (msec > 0 && DA_FALSE == *is_throttled) {
+		*is_throttled = DA_TRUE;
+		PI_http_pause_transaction(tranx_id);
+	}
+}
+
+/* Returns 0 if the transaction can be unpaused. In this case,
+ * is_throttled is cleared. */
+unsigned long rate_get_throttle_msec(int download_id, da_bool_t *is_throttled)
+{
+	unsigned long msec = 0;
+
+	if (DA_FALSE == *is_throttled)
+		return 0;
+
+	if (download_id >= 0 && download_id < DA_MAX_DOWNLOAD_ID) {
+		_da_thread_mutex_lock(&mutex_rate);
+		msec = __charge_buckets(download_id, 0);
+		_da_thread_mutex_unlock(&mutex_rate);
+	}
+
+	if (msec == 0) {
+		*is_throttled = DA_FALSE;
+		return 0;
+	}
+
+	if (msec > DA_RATE_MAX_THROTTLE_MSEC)
+		msec = DA_RATE_MAX_THROTTLE_MSEC;
+	return msec;
+}
@@ -0,0 +1,291 @@
+/*
+ * Download Agent
+ *
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Jungki Kwak <jungki.kwak@samsung.com>, Keunsoon Lee <keunsoon.lee@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file		download-agent-http-redirect.c
+ * @brief		functions for the cache of permanent redirection
+ ***/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <time.h>
+
+#include "download-agent-debug.h"
+#include "download-agent-pthread.h"
+#include "download-agent-http-redirect.h"
+
+typedef struct _redirect_entry_t {
+	char *url;
+	char *target;
+	time_t expire_time;
+} redirect_entry_t;
+
+static pthread_mutex_t mutex_redirect = PTHREAD_MUTEX_INITIALIZER;
+static redirect_entry_t redirect_cache[DA_MAX_REDIRECT_CACHE_COUNT];
+static da_bool_t is_redirect_cache_loaded = DA_FALSE;
+
+static void __clear_entry(redirect_entry_t *entry);
+static void __load_cache(void);
+static void __save_cache(void);
+static int __find_entry(const char *url, time_t now);
+static long __get_ttl(const char *cache_control);
+
+static void __clear_entry(redirect_entry_t *entry)
+{
+	if (entry->url)
+		free(entry->url);
+	if (entry->target)
+		free(entry->target);
+	memset(entry, 0x00, sizeof(redirect_entry_t));
+}
+
+/* Should be called with mutex_redirect locked */
+static void __load_cache(void)
+{
+	FILE *fd = DA_NULL;
+	char line[DA_MAX_URI_LEN * 2 + 32] = {0,};
+	char *expire = DA_NULL;
+	char *url = DA_NULL;
+	char *target = DA_NULL;
+	char *save_ptr = DA_NULL;
+	time_t now = time(NULL);
+	int i = 0;
+
+	if (DA_TRUE == is_redirect_cache_loaded)
+		return;
+	is_redirect_cache_loaded = DA_TRUE;
+
+	fd = fopen(DA_REDIRECT_CACHE_FILE_PATH, "r");
+	if (!fd) {
+		DA_LOG(HTTPManager, "no redirect cache");
+		return;
+	}
+
+	/* One line for each entry : expire_time \t url \t target */
+	while (i < DA_MAX_REDIRECT_CACHE_COUNT &&
+			fgets(line, sizeof(line), fd)) {
+		expire = strtok_r(line, "\t\n", &save_ptr);
+		url = strtok_r(DA_NULL, "\t\n", &save_ptr);
+		target = strtok_r(DA_NULL, "\t\n", &save_ptr);
+		if (!expire || !url || !target)
+			continue;
+		if (atol(expire) <= now)
+			continue;
+		redirect_cache[i].url = strdup(url);
+		redirect_cache[i].target = strdup(target);
+		redirect_cache[i].expire_time = atol(expire);
+		if (!redirect_cache[i].url || !redirect_cache[i].target) {
+			__clear_entry(&redirect_cache[i]);
+			continue;
+		}
+		i++;
+	}
+	fclose(fd);
+	DA_LOG(HTTPManager, "loaded redirect cache [%d]", i);
+}
+
+/* Should be called with mutex_redirect locked */
+static void __save_cache(void)
+{
+	FILE *fd = DA_NULL;
+	char tmp_path[] = DA_REDIRECT_CACHE_FILE_PATH".tmp";
+	int i = 0;
+
+	fd = fopen(tmp_path, "w");
+	if (!fd) {
+		DA_LOG_ERR(HTTPManager, "fail to open [%s]", tmp_path);
+		return;
+	}
+	for (i = 0; i < DA_MAX_REDIRECT_CACHE_COUNT; i++) {
+		if (!redirect_cache[i].url)
+			continue;
+		fprintf(fd, "%ld\t%s\t%s\n", (long)redirect_cache[i].expire_time,
+				redirect_cache[i].url, redirect_cache[i].target);
+	}
+	/* Replace the file at once not to leave a broken one */
+	if (fclose(fd) != 0 || rename(tmp_path, DA_REDIRECT_CACHE_FILE_PATH) != 0) {
+		DA_LOG_ERR(HTTPManager, "fail to save redirect cache");
+		remove(tmp_path);
+	}
+}
+
+/* Should be called with mutex_redirect locked. Expired one is removed */
+static int __find_entry(const char *url, time_t now)
+{
+	int i = 0;
+
+	for (i = 0; i < DA_MAX_REDIRECT_CACHE_COUNT; i++) {
+		if (!redirect_cache[i].url || strcmp(redirect_cache[i].url, url))
+			continue;
+		if (redirect_cache[i].expire_time <= now) {
+			__clear_entry(&redirect_cache[i]);
+			return -1;
+		}
+		return i;
+	}
+	return -1;
+}
+
+static long __get_ttl(const char *cache_control)
+{
+	char *value = DA_NULL;
+	char *max_age = DA_NULL;
+	long ttl = DA_REDIRECT_CACHE_DEFAULT_TTL_SEC;
+	int i = 0;
+
+	if (!cache_control)
+		return ttl;
+
+	value = strdup(cache_control);
+	if (!value)
+		return 0;
+	for (i = 0; value[i]; i++)
+		value[i] = tolower(value[i]);
+
+	if (strstr(value, "no-store") || strstr(value, "no-cache")) {
+		ttl = 0;
+	} else {
+		max_age = strstr(value, "max-age=");
+		if (max_age)
+			ttl = atol(max_age + strlen("max-age="));
+	}
+	free(value);
+
+	if (ttl < 0)
+		ttl = 0;
+	if (ttl > DA_REDIRECT_CACHE_MAX_TTL_SEC)
+		ttl = DA_REDIRECT_CACHE_MAX_TTL_SEC;
+	return ttl;
+}
+
+char *redirect_cache_get_target(const char *url)
+{
+	const char *target = DA_NULL;
+	char *out_url = DA_NULL;
+	time_t now = time(NULL);
+	int index = -1;
+	int hop = 0;
+
+	if (!url)
+		return DA_NULL;
+
+	_da_thread_mutex_lock(&mutex_redirect);
+	__load_cache();
+	for (hop = 0; hop < DA_MAX_REDIRECT_CACHE_HOPS; hop++) {
+		index = __find_entry(target ? target : url, now);
+		if (index < 0)
+			break;
+		target = redirect_cache[index].target;
+	}
+	if (target)
+		out_url = strdup(target);
+	_da_thread_mutex_unlock(&mutex_redirect);
+
+	if (out_url)
+		DA_LOG(HTTPManager, "[%s] -> [%s] hops[%d]", url, out_url, hop);
+	return out_url;
+}
+
+void redirect_cache_add(const char *url, const char *target,
+		const char *cache_control)
+{
+	time_t now = time(NULL);
+	long ttl = __get_ttl(cache_control);
+	int index = -1;
+	int i = 0;
+
+	if (!url || !target || !strcmp(url, target))
+		return;
+	/* Relative location is resolved by libsoup, not by us */
+	if (strncasecmp(target, "http://", 7) && strncasecmp(target, "https://", 8))
+		return;
+
+	DA_LOG(HTTPManager, "[%s] -> [%s] ttl[%ld]", url, target, ttl);
+
+	_da_thread_mutex_lock(&mutex_redirect);
+	__load_cache();
+	index = __find_entry(url, now);
+	if (ttl == 0) {
+		/* Server does not want it to be reused any more */
+		if (index >= 0) {
+			__clear_entry(&redirect_cache[index]);
+			__save_cache();
+		}
+		_da_thread_mutex_unlock(&mutex_redirect);
+		return;
+	}
+
+	if (index < 0) {
+		/* Empty one, or the one which will be expired soonest */
+		for (i = 0; i < DA_MAX_REDIRECT_CACHE_COUNT; i++) {
+			if (!redirect_cache[i].url) {
+				index = i;
+				break;
+			}
+			if (index < 0 || redirect_cache[i].expire_time <
+					redirect_cache[index].expire_time)
+				index = i;
+		}
+	}
+	__clear_entry(&redirect_cache[index]);
+	redirect_cache[index].url = strdup(url);
+	redirect_cache[index].target = strdup(target);
+	redirect_cache[index].expire_time = now + ttl;
+	if (!redirect_cache[index].url || !redirect_cache[index].target)
+		__clear_entry(&redirect_cache[index]);
+	else
+		__save_cache();
+	_da_thread_mutex_unlock(&mutex_redirect);
+}
+
+void redirect_cache_remove(const char *url)
+{
+	char *next_url = DA_NULL;
+	time_t now = time(NULL);
+	int index = -1;
+	int hop = 0;
+	da_bool_t is_removed = DA_FALSE;
+
+	if (!url)
+		return;
+
+	_da_thread_mutex_lock(&mutex_redirect);
+	__load_cache();
+	for (hop = 0; hop < DA_MAX_REDIRECT_CACHE_HOPS; hop++) {
+		index = __find_entry(next_url ? next_url : url, now);
+		if (next_url) {
+			free(next_url);
+			next_url = DA_NULL;
+		}
+		if (index < 0)
+			break;
+		DA_LOG(HTTPManager, "remove [%s]", redirect_cache[index].url);
+		next_url = redirect_cache[index].target;
+		redirect_cache[index].target = DA_NULL;
+		__clear_entry(&redirect_cache[index]);
+		is_removed = DA_TRUE;
+	}
+	if (next_url)
+		free(next_url);
+	if (DA_TRUE == is_removed)
+		__save_cache();
+	_da_thread_mutex_unlock(&mutex_redirect);
+}
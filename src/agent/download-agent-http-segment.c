@@ -0,0 +1,1129 @@
+/*
+ * Download Agent
+ *
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Jungki Kwak <jungki.kwak@samsung.com>, Keunsoon Lee <keunsoon.lee@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file		download-agent-http-segment.c
+ * @brief		functions for segmented range download
+ ***/
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "download-agent-debug.h"
+#include "download-agent-pthread.h"
+#include "download-agent-utils.h"
+#include "download-agent-client-mgr.h"
+#include "download-agent-http-mgr.h"
+#include "download-agent-http-segment.h"
+#include "download-agent-http-rate.h"
+#include "download-agent-http-queue.h"
+#include "download-agent-file.h"
+#include "download-agent-disk-writer.h"
+#include "download-agent-space.h"
+#include "download-agent-plugin-conf.h"
+#include "download-agent-plugin-http-interface.h"
+
+typedef struct _segment_thread_input {
+	segment_info_t *segment_info;
+	/* -1 means that the thread takes a range by splitting other segment */
+	int index;
+} segment_thread_input;
+
+/* Received body which is not submitted to the disk writer yet */
+typedef struct _segment_write_buf_t {
+	disk_writer_job_t *job;
+	da_body_slice_t *slices;
+	int slice_count;
+	int len;
+	unsigned long long offset; /* of the first slice */
+} segment_write_buf_t;
+
+static void __init_segment(segment_t *segment);
+static char *__get_segment_map_path(stage_info *stage);
+static da_result_t __load_segment_map(stage_info *stage,
+		segment_info_t **out_segment_info);
+static segment_info_t *__create_segment_info(stage_info *stage);
+static int __split_largest_segment(segment_info_t *segment_info, int slot);
+static da_bool_t __give_back_segment(segment_info_t *segment_info, int index);
+static int __accept_segment_body(segment_t *segment, int body_len,
+		unsigned long long *out_offset, da_bool_t *out_is_range_done);
+static da_result_t __flush_segment_buf(segment_info_t *segment_info,
+		segment_write_buf_t *buf);
+static da_result_t __write_segment_body(segment_info_t *segment_info,
+		segment_write_buf_t *buf, q_event_t *q_event,
+		unsigned long long offset, int body_len);
+static da_result_t __download_segment(segment_info_t *segment_info, int index,
+		int source);
+static void *__thread_segment_download(void *data);
+static da_result_t __create_segment_thread(segment_info_t *segment_info,
+		int index);
+
+void __init_segment(segment_t *segment)
+{
+	segment->start = 0;
+	segment->end = 0;
+	segment->cur = 0;
+	segment->state = SEGMENT_STATE_IDLE;
+	segment->tranx_id = DA_INVALID_ID;
+}
+
+char *__get_segment_map_path(stage_info *stage)
+{
+	char *file_path = DA_NULL;
+	char *map_path = DA_NULL;
+	int len = 0;
+
+	file_path = GET_CONTENT_STORE_ACTUAL_FILE_NAME(
+			GET_STAGE_CONTENT_STORE_INFO(stage));
+	if (!file_path)
+		return DA_NULL;
+
+	len = strlen(file_path) + strlen(DA_SEGMENT_MAP_FILE_EXT) + 1;
+	map_path = (char *)calloc(1, len);
+	if (map_path)
+		snprintf(map_path, len, "%s%s", file_path, DA_SEGMENT_MAP_FILE_EXT);
+
+	return map_path;
+}
+
+segment_info_t *__create_segment_info(stage_info *stage)
+{
+	req_dl_info *request_info = DA_NULL;
+	segment_info_t *segment_info = DA_NULL;
+	char *url = DA_NULL;
+	int i = 0;
+
+	request_info = GET_STAGE_TRANSACTION_INFO(stage);
+
+	segment_info = (segment_info_t *)calloc(1, sizeof(segment_info_t));
+	if (!segment_info) {
+		DA_LOG_ERR(HTTPManager, "DA_ERR_FAIL_TO_MEMALLOC");
+		return DA_NULL;
+	}
+
+	segment_info->source_count = mirror_get_source_count(stage);
+	segment_info->main_source = request_info->source_index;
+	segment_info->validator_source = request_info->validator_source_index;
+	segment_info->low_speed_limit = GET_REQUEST_HTTP_LOW_SPEED_LIMIT(request_info);
+	segment_info->low_speed_time = GET_REQUEST_HTTP_LOW_SPEED_TIME(request_info);
+	segment_info->queue_high_watermark =
+		GET_REQUEST_HTTP_QUEUE_HIGH_WATERMARK(request_info);
+	segment_info->queue_low_watermark =
+		GET_REQUEST_HTTP_QUEUE_LOW_WATERMARK(request_info);
+	for (i = 0; i < segment_info->source_count; i++) {
+		url = DA_NULL;
+		/* Use the redirected url not to be redirected again for each segment */
+		if (i == segment_info->main_source) {
+			url = GET_REQUEST_HTTP_REQ_LOCATION(request_info);
+			if (!url || strncmp(url, "http", strlen("http")))
+				url = GET_REQUEST_HTTP_REQ_URL(request_info);
+		} else {
+			url = mirror_get_source_url(stage, i);
+		}
+		if (url)
+			segment_info->url[i] = strdup(url);
+	}
+	if (GET_REQUEST_HTTP_HDR_ETAG(request_info))
+		segment_info->etag = strdup(GET_REQUEST_HTTP_HDR_ETAG(request_info));
+
+	segment_info->download_id = GET_STAGE_DL_ID(stage);
+	segment_info->user_request_header =
+		GET_REQUEST_HTTP_USER_REQUEST_HEADER(request_info);
+	segment_info->user_request_header_count =
+		GET_REQUEST_HTTP_USER_REQUEST_HEADER_COUNT(request_info);
+	segment_info->result = DA_RESULT_OK;
+	for (i = 0; i < DA_MAX_SEGMENT_COUNT; i++)
+		__init_segment(&(segment_info->segment[i]));
+	_da_thread_mutex_init(&(segment_info->mutex), DA_NULL);
+
+	if (!segment_info->url[segment_info->main_source]) {
+		destroy_segment_info(&segment_info);
+		return DA_NULL;
+	}
+
+	return segment_info;
+}
+
+da_result_t segment_prepare_download(stage_info *stage,
+		http_msg_response_t *http_msg_response)
+{
+	da_result_t ret = DA_RESULT_OK;
+	req_dl_info *request_info = DA_NULL;
+	segment_info_t *segment_info = DA_NULL;
+	char *value = DA_NULL;
+	int content_len = 0;
+
+	DA_LOG_FUNC_START(HTTPManager);
+
+	request_info = GET_STAGE_TRANSACTION_INFO(stage);
+
+	/* The segment map which is loaded for resume is not valid any more */
+	destroy_segment_info(&GET_SEGMENT_INFO(stage));
+
+	if (GET_REQUEST_HTTP_SEGMENT_COUNT(request_info) <= 1)
+		goto ERR;
+
+	if (DA_TRUE == is_this_client_manual_download_type())
+		goto ERR;
+
+	if (!http_msg_response_get_accept_ranges(http_msg_response, &value)) {
+		DA_LOG(HTTPManager, "server does not support range request");
+		goto ERR;
+	}
+	if (strncmp(value, "bytes", strlen("bytes"))) {
+		DA_LOG(HTTPManager, "Accept-Ranges[%s]", value);
+		goto ERR;
+	}
+
+	content_len = GET_REQUEST_HTTP_HDR_CONT_LEN(request_info);
+	if (content_len < DA_MIN_SEGMENT_SIZE * 2) {
+		DA_LOG(HTTPManager, "too small to split [%d]", content_len);
+		goto ERR;
+	}
+
+	segment_info = __create_segment_info(stage);
+	if (!segment_info) {
+		ret = DA_ERR_FAIL_TO_MEMALLOC;
+		goto ERR;
+	}
+	segment_info->total_size = content_len;
+	/* Whole range is given to main transaction at first.
+	 * Segment threads will split it when they are started. */
+	segment_info->segment[DA_MAIN_SEGMENT].end = content_len;
+	segment_info->segment[DA_MAIN_SEGMENT].state = SEGMENT_STATE_RUNNING;
+
+	GET_SEGMENT_INFO(stage) = segment_info;
+	DA_LOG_CRITICAL(HTTPManager, "segmented download : total[%d] count[%d]",
+			content_len, GET_REQUEST_HTTP_SEGMENT_COUNT(request_info));
+
+ERR:
+	if (value)
+		free(value);
+	return ret;
+}
+
+da_result_t __load_segment_map(stage_info *stage,
+		segment_info_t **out_segment_info)
+{
+	da_result_t ret = DA_RESULT_OK;
+	segment_info_t *segment_info = DA_NULL;
+	segment_t *segment = DA_NULL;
+	char *map_path = DA_NULL;
+	FILE *fp = DA_NULL;
+	unsigned long long total_size = 0;
+	unsigned long long start = 0;
+	unsigned long long end = 0;
+	unsigned long long cur = 0;
+	int index = 0;
+
+	map_path = __get_segment_map_path(stage);
+	if (!map_path || DA_FALSE == is_file_exist(map_path)) {
+		ret = DA_ERR_FAIL_TO_ACCESS_FILE;
+		goto ERR;
+	}
+
+	fp = fopen(map_path, "r");
+	if (!fp) {
+		DA_LOG_ERR(HTTPManager, "fail to open segment map [%s]", map_path);
+		ret = DA_ERR_FAIL_TO_ACCESS_FILE;
+		goto ERR;
+	}
+
+	if (fscanf(fp, "%llu\n", &total_size) != 1 || total_size !=
+			(unsigned long long)GET_REQUEST_HTTP_HDR_CONT_LEN(
+			GET_STAGE_TRANSACTION_INFO(stage))) {
+		DA_LOG_ERR(HTTPManager, "invalid segment map");
+		ret = DA_ERR_FAIL_TO_ACCESS_FILE;
+		goto ERR;
+	}
+
+	segment_info = __create_segment_info(stage);
+	if (!segment_info) {
+		ret = DA_ERR_FAIL_TO_MEMALLOC;
+		goto ERR;
+	}
+	segment_info->total_size = total_size;
+
+	while (fscanf(fp, "%d %llu %llu %llu\n", &index, &start, &end, &cur) == 4) {
+		if (index < 0 || index >= DA_MAX_SEGMENT_COUNT || start > cur
+				|| cur > end || end > total_size) {
+			DA_LOG_ERR(HTTPManager, "invalid segment [%d]", index);
+			ret = DA_ERR_FAIL_TO_ACCESS_FILE;
+			goto ERR;
+		}
+		segment = &(segment_info->segment[index]);
+		segment->start = start;
+		segment->end = end;
+		segment->cur = cur;
+		/* Main segment is kept running to cancel main transaction
+		 * as soon as it receives first body */
+		if (cur < end || index == DA_MAIN_SEGMENT)
+			segment->state = SEGMENT_STATE_RUNNING;
+		else
+			segment->state = SEGMENT_STATE_FINISHED;
+	}
+
+	if (segment_info->segment[DA_MAIN_SEGMENT].state == SEGMENT_STATE_IDLE) {
+		DA_LOG_ERR(HTTPManager, "no main segment");
+		ret = DA_ERR_FAIL_TO_ACCESS_FILE;
+		goto ERR;
+	}
+
+	*out_segment_info = segment_info;
+
+ERR:
+	if (fp)
+		fclose(fp);
+	if (map_path)
+		free(map_path);
+	if (ret != DA_RESULT_OK)
+		destroy_segment_info(&segment_info);
+	return ret;
+}
+
+da_result_t segment_prepare_resume(stage_info *stage)
+{
+	da_result_t ret = DA_RESULT_OK;
+	segment_info_t *segment_info = DA_NULL;
+	file_info *file_storage = DA_NULL;
+	int file_size = 0;
+
+	DA_LOG_FUNC_START(HTTPManager);
+
+	if (GET_REQUEST_HTTP_SEGMENT_COUNT(GET_STAGE_TRANSACTION_INFO(stage)) <= 1)
+		return ret;
+
+	file_storage = GET_STAGE_CONTENT_STORE_INFO(stage);
+	destroy_segment_info(&GET_SEGMENT_INFO(stage));
+
+	ret = __load_segment_map(stage, &segment_info);
+	if (ret == DA_RESULT_OK) {
+		GET_SEGMENT_INFO(stage) = segment_info;
+		/* Main transaction is resumed at the end of main segment */
+		GET_CONTENT_STORE_CURRENT_FILE_SIZE(file_storage) =
+			segment_info->segment[DA_MAIN_SEGMENT].cur;
+		return ret;
+	}
+
+	/* If the file is preallocated for segments but the map is lost,
+	 * the received ranges cannot be known. So, receive it from the start. */
+	get_file_size(GET_CONTENT_STORE_ACTUAL_FILE_NAME(file_storage), &file_size);
+	if (file_size >= 0 && (unsigned int)file_size !=
+			GET_CONTENT_STORE_CURRENT_FILE_SIZE(file_storage)) {
+		DA_LOG_ERR(HTTPManager, "segment map is lost. restart download");
+		clean_paused_file(stage);
+		GET_CONTENT_STORE_CURRENT_FILE_SIZE(file_storage) = 0;
+	}
+
+	return DA_RESULT_OK;
+}
+
+/* Split the segment which has the largest range to receive.
+ * Because the slowest segment has the largest range generally, this is
+ * also used to share the remained range of slow segments dynamically.
+ * MUST be called with segment_info->mutex */
+int __split_largest_segment(segment_info_t *segment_info, int slot)
+{
+	segment_t *victim = DA_NULL;
+	segment_t *segment = DA_NULL;
+	unsigned long long max_remained = 0;
+	unsigned long long remained = 0;
+	unsigned long long middle = 0;
+	int victim_index = -1;
+	int i = 0;
+
+	for (i = 0; i < DA_MAX_SEGMENT_COUNT; i++) {
+		segment = &(segment_info->segment[i]);
+		if (segment->state != SEGMENT_STATE_RUNNING)
+			continue;
+		remained = segment->end - segment->cur;
+		if (remained > max_remained) {
+			max_remained = remained;
+			victim_index = i;
+		}
+	}
+
+	if (victim_index < 0 || max_remained < DA_MIN_SEGMENT_SIZE * 2)
+		return -1;
+
+	if (slot < 0) {
+		for (i = 0; i < DA_MAX_SEGMENT_COUNT; i++) {
+			if (segment_info->segment[i].state == SEGMENT_STATE_IDLE ||
+					segment_info->segment[i].state ==
+					SEGMENT_STATE_FINISHED) {
+				slot = i;
+				break;
+			}
+		}
+		if (slot < 0)
+			return -1;
+	}
+
+	victim = &(segment_info->segment[victim_index]);
+	segment = &(segment_info->segment[slot]);
+	middle = victim->cur + max_remained / 2;
+
+	segment->start = middle;
+	segment->cur = middle;
+	segment->end = victim->end;
+	segment->state = SEGMENT_STATE_RUNNING;
+	segment->tranx_id = DA_INVALID_ID;
+	victim->end = middle;
+
+	DA_LOG(HTTPManager, "split segment[%d] to [%d] : %llu-%llu",
+			victim_index, slot, segment->start, segment->end);
+
+	return slot;
+}
+
+/* If a segment cannot be started, return the range to the running segment
+ * which is just in front of it.
+ * MUST be called with segment_info->mutex */
+da_bool_t __give_back_segment(segment_info_t *segment_info, int index)
+{
+	segment_t *segment = &(segment_info->segment[index]);
+	segment_t *neighbor = DA_NULL;
+	int i = 0;
+
+	for (i = 0; i < DA_MAX_SEGMENT_COUNT; i++) {
+		if (i == index)
+			continue;
+		neighbor = &(segment_info->segment[i]);
+		if (neighbor->state == SEGMENT_STATE_RUNNING &&
+				neighbor->end == segment->cur) {
+			neighbor->end = segment->end;
+			__init_segment(segment);
+			return DA_TRUE;
+		}
+	}
+
+	return DA_FALSE;
+}
+
+/* Returns the length which is in the range, and takes it from the range.
+ * MUST be called with segment_info->mutex */
+int __accept_segment_body(segment_t *segment, int body_len,
+		unsigned long long *out_offset, da_bool_t *out_is_range_done)
+{
+	/* The range can be reduced by other segment thread at any time */
+	if (segment->cur >= segment->end) {
+		*out_is_range_done = DA_TRUE;
+		return 0;
+	}
+	*out_offset = segment->cur;
+	if ((unsigned long long)body_len > segment->end - segment->cur)
+		body_len = segment->end - segment->cur;
+	segment->cur += body_len;
+	if (segment->cur >= segment->end)
+		*out_is_range_done = DA_TRUE;
+
+	return body_len;
+}
+
+da_result_t __flush_segment_buf(segment_info_t *segment_info,
+		segment_write_buf_t *buf)
+{
+	da_result_t ret = DA_RESULT_OK;
+	int len = buf->len;
+
+	if (buf->slice_count == 0)
+		return ret;
+
+	/* The slices are taken by the writer, even if it is failed */
+	ret = disk_writer_submit(buf->job, buf->slices, buf->slice_count, len,
+			buf->offset);
+	buf->slices = DA_NULL;
+	buf->slice_count = 0;
+	buf->len = 0;
+	if (ret == DA_RESULT_OK)
+		space_consume(segment_info->space_reservation, len);
+
+	return ret;
+}
+
+/* The body of the event is taken without copying */
+da_result_t __write_segment_body(segment_info_t *segment_info,
+		segment_write_buf_t *buf, q_event_t *q_event,
+		unsigned long long offset, int body_len)
+{
+	da_result_t ret = DA_RESULT_OK;
+	da_body_slice_t slice;
+
+	/* Not next to the buffered one, e.g. the range is split */
+	if (buf->slice_count > 0 && buf->offset + buf->len != offset) {
+		ret = __flush_segment_buf(segment_info, buf);
+		if (ret != DA_RESULT_OK)
+			return ret;
+	}
+	if (!buf->slices) {
+		buf->slices = (da_body_slice_t *)calloc(DA_MAX_PENDING_SLICE_COUNT,
+				sizeof(da_body_slice_t));
+		if (!buf->slices)
+			return DA_ERR_FAIL_TO_MEMALLOC;
+	}
+	if (buf->slice_count == 0)
+		buf->offset = offset;
+
+	Q_take_http_body_from_http_data_event(q_event, &slice);
+	slice.len = body_len;
+	buf->slices[buf->slice_count++] = slice;
+	buf->len += body_len;
+
+	if (DA_FILE_WRITE_BUF_SIZE <= buf->len ||
+			DA_MAX_PENDING_SLICE_COUNT <= buf->slice_count)
+		ret = __flush_segment_buf(segment_info, buf);
+
+	return ret;
+}
+
+da_result_t __download_segment(segment_info_t *segment_info, int index,
+		int source)
+{
+	da_result_t ret = DA_RESULT_OK;
+	segment_t *segment = &(segment_info->segment[index]);
+	queue_t queue;
+	q_event_t *q_event = DA_NULL;
+	q_event_data_http_t *q_event_data_http = DA_NULL;
+	http_msg_request_t *http_msg_request = DA_NULL;
+	input_for_tranx_t input_for_tranx;
+	char range_str[64] = { 0, };
+	int tranx_id = DA_INVALID_ID;
+	int fd = -1;
+	int status_code = 0;
+	da_bool_t is_finished = DA_FALSE;
+	da_bool_t is_range_done = DA_FALSE;
+	da_bool_t is_stopped = DA_FALSE;
+	da_bool_t is_throttled = DA_FALSE;
+	unsigned long throttle_msec = 0;
+	segment_write_buf_t buf;
+	unsigned long long offset = 0;
+	int body_len = 0;
+	da_result_t write_ret = DA_RESULT_OK;
+
+	DA_LOG_FUNC_START(HTTPManager);
+
+	fd = open(segment_info->file_path, O_WRONLY);
+	if (fd < 0) {
+		DA_LOG_ERR(HTTPManager, "fail to open [%s]", segment_info->file_path);
+		return DA_ERR_FAIL_TO_ACCESS_FILE;
+	}
+	memset(&buf, 0x00, sizeof(segment_write_buf_t));
+	ret = disk_writer_open(fd, segment_info->durability,
+			segment_info->drop_cache_size, &(buf.job));
+	if (ret != DA_RESULT_OK) {
+		close(fd);
+		return ret;
+	}
+
+	Q_init_queue(&queue);
+	Q_set_watermark(&queue, segment_info->queue_high_watermark,
+			segment_info->queue_low_watermark);
+
+	ret = make_default_http_request_hdr(segment_info->url[source],
+			segment_info->user_request_header,
+			segment_info->user_request_header_count, &http_msg_request);
+	if (ret != DA_RESULT_OK)
+		goto ERR;
+
+	_da_thread_mutex_lock(&(segment_info->mutex));
+	snprintf(range_str, sizeof(range_str), "bytes=%llu-%llu",
+			segment->cur, segment->end - 1);
+	_da_thread_mutex_unlock(&(segment_info->mutex));
+	DA_LOG(HTTPManager, "segment[%d] %s source[%d]", index, range_str, source);
+
+	http_msg_request_add_field(http_msg_request, HTTP_FIELD_RANGE, range_str);
+	if (segment_info->etag && source == segment_info->validator_source)
+		http_msg_request_add_field(http_msg_request, HTTP_FIELD_IF_RANGE,
+				segment_info->etag);
+
+	memset(&input_for_tranx, 0x00, sizeof(input_for_tranx_t));
+	input_for_tranx.proxy_addr = get_proxy_address();
+	input_for_tranx.queue = &queue;
+	input_for_tranx.http_method = PI_HTTP_METHOD_GET;
+	input_for_tranx.http_msg_request = http_msg_request;
+	input_for_tranx.low_speed_limit = segment_info->low_speed_limit;
+	input_for_tranx.low_speed_time = segment_info->low_speed_time;
+	input_for_tranx.is_extra = DA_TRUE;
+
+	ret = PI_http_start_transaction(&input_for_tranx, &tranx_id);
+	if (input_for_tranx.proxy_addr)
+		free(input_for_tranx.proxy_addr);
+	/* Request header is already copied to the message of transaction */
+	http_msg_request_destroy(&http_msg_request);
+	if (ret != DA_RESULT_OK)
+		goto ERR;
+
+	_da_thread_mutex_lock(&(segment_info->mutex));
+	segment->tranx_id = tranx_id;
+	if (segment_info->is_stopped)
+		PI_http_cancel_transaction(tranx_id, DA_FALSE);
+	_da_thread_mutex_unlock(&(segment_info->mutex));
+
+	while (DA_FALSE == is_finished) {
+		_da_thread_mutex_lock(&(queue.mutex_queue));
+		if (DA_FALSE == GET_IS_Q_HAVING_DATA((&queue))) {
+			throttle_msec = rate_get_throttle_msec(
+					segment_info->download_id, &is_throttled);
+			if (throttle_msec > 0) {
+				Q_goto_sleep_with_timeout(&queue, throttle_msec);
+			} else {
+				PI_http_unpause_transaction(tranx_id);
+				Q_goto_sleep(&queue);
+			}
+		}
+		_da_thread_mutex_unlock(&(queue.mutex_queue));
+
+		Q_pop_event(&queue, &q_event);
+		if (!q_event)
+			continue;
+
+		if (q_event->event_type == Q_EVENT_TYPE_DATA_HTTP) {
+			q_event_data_http = &(q_event->type.q_event_data_http);
+			switch (q_event_data_http->data_type) {
+			case Q_EVENT_TYPE_DATA_PACKET:
+				if (q_event_data_http->http_response_msg) {
+					status_code =
+						q_event_data_http->http_response_msg->status_code;
+					/* redirection is handled by http plugin */
+					if (status_code != 206 && (status_code < 300 ||
+							status_code > 399) && ret == DA_RESULT_OK) {
+						DA_LOG_ERR(HTTPManager, "segment[%d] status[%d]",
+								index, status_code);
+						ret = DA_ERR_UNREACHABLE_SERVER;
+						PI_http_cancel_transaction(tranx_id, DA_FALSE);
+					} else if (status_code == 206 && ret == DA_RESULT_OK &&
+							source != segment_info->validator_source &&
+							DA_FALSE == mirror_is_same_content(
+							q_event_data_http->http_response_msg,
+							segment_info->total_size)) {
+						ret = DA_ERR_UNREACHABLE_SERVER;
+						PI_http_cancel_transaction(tranx_id, DA_FALSE);
+					}
+				}
+				if (q_event_data_http->body_len > 0 && ret == DA_RESULT_OK
+						&& DA_FALSE == is_range_done) {
+					_da_thread_mutex_lock(&(segment_info->mutex));
+					body_len = __accept_segment_body(segment,
+							q_event_data_http->body_len, &offset,
+							&is_range_done);
+					_da_thread_mutex_unlock(&(segment_info->mutex));
+					/* Writing may wait for the storage. Not with the mutex */
+					if (body_len > 0)
+						ret = __write_segment_body(segment_info, &buf,
+								q_event, offset, body_len);
+					if (ret != DA_RESULT_OK || is_range_done)
+						PI_http_cancel_transaction(tranx_id, DA_FALSE);
+				}
+				if (q_event_data_http->body_len > 0)
+					rate_charge_transaction(segment_info->download_id,
+							tranx_id, q_event_data_http->body_len,
+							&is_throttled);
+				break;
+
+			case Q_EVENT_TYPE_DATA_FINAL:
+				is_finished = DA_TRUE;
+				break;
+
+			case Q_EVENT_TYPE_DATA_ABORT:
+				if (ret == DA_RESULT_OK) {
+					ret = q_event_data_http->error_type;
+					if (ret == DA_RESULT_OK)
+						ret = DA_ERR_NETWORK_FAIL;
+				}
+				is_finished = DA_TRUE;
+				break;
+			}
+		}
+		Q_destroy_q_event(&q_event);
+
+		if (DA_TRUE == Q_is_drained_to_low_watermark(&queue) &&
+				DA_FALSE == is_throttled && DA_FALSE == is_finished)
+			PI_http_unpause_transaction(tranx_id);
+	}
+
+	_da_thread_mutex_lock(&(segment_info->mutex));
+	segment->tranx_id = DA_INVALID_ID;
+	is_stopped = segment_info->is_stopped;
+	if (segment->cur >= segment->end)
+		is_range_done = DA_TRUE;
+	_da_thread_mutex_unlock(&(segment_info->mutex));
+
+	PI_http_disconnect_transaction(tranx_id);
+
+	if (ret == DA_RESULT_OK && DA_FALSE == is_range_done
+			&& DA_FALSE == is_stopped) {
+		DA_LOG_ERR(HTTPManager, "segment[%d] is closed before the end", index);
+		ret = DA_ERR_NETWORK_FAIL;
+	}
+
+ERR:
+	/* The range of the buffered body is taken already. Write it anyway,
+	 * and wait until all of it is written */
+	write_ret = __flush_segment_buf(segment_info, &buf);
+	if (ret == DA_RESULT_OK)
+		ret = write_ret;
+	write_ret = disk_writer_close(buf.job);
+	if (ret == DA_RESULT_OK)
+		ret = write_ret;
+	Q_destroy_queue(&queue);
+	close(fd);
+	return ret;
+}
+
+void *__thread_segment_download(void *data)
+{
+	da_result_t ret = DA_RESULT_OK;
+	segment_thread_input *thread_input = (segment_thread_input *)data;
+	segment_info_t *segment_info = thread_input->segment_info;
+	segment_t *segment = DA_NULL;
+	q_event_t *q_event = DA_NULL;
+	int index = thread_input->index;
+	int source = 0;
+	da_bool_t is_main_source_retried = DA_FALSE;
+
+	free(thread_input);
+
+	_da_thread_mutex_lock(&(segment_info->mutex));
+	if (index < 0 && DA_FALSE == segment_info->is_stopped)
+		index = __split_largest_segment(segment_info, -1);
+	_da_thread_mutex_unlock(&(segment_info->mutex));
+
+	while (index >= 0) {
+		/* Spread the segments over the mirrors */
+		if (DA_FALSE == is_main_source_retried)
+			source = (segment_info->main_source + index) %
+					segment_info->source_count;
+		if (!segment_info->url[source])
+			source = segment_info->main_source;
+		ret = __download_segment(segment_info, index, source);
+
+		_da_thread_mutex_lock(&(segment_info->mutex));
+		segment = &(segment_info->segment[index]);
+		if (ret == DA_ERR_ALREADY_MAX_DOWNLOAD &&
+				__give_back_segment(segment_info, index)) {
+			DA_LOG(HTTPManager, "no more transaction for segment[%d]", index);
+			index = -1;
+		} else if (ret != DA_RESULT_OK &&
+				source != segment_info->main_source &&
+				DA_FALSE == is_main_source_retried &&
+				DA_FALSE == segment_info->is_stopped) {
+			/* The mirror is not good. Try the rest with main source */
+			DA_LOG_ERR(HTTPManager, "segment[%d] source[%d] ret[%d]",
+					index, source, ret);
+			is_main_source_retried = DA_TRUE;
+			source = segment_info->main_source;
+		} else if (ret != DA_RESULT_OK) {
+			segment->state = SEGMENT_STATE_FAILED;
+			if (segment_info->result == DA_RESULT_OK &&
+					DA_FALSE == segment_info->is_stopped)
+				segment_info->result = ret;
+			index = -1;
+		} else {
+			if (segment->cur >= segment->end)
+				segment->state = SEGMENT_STATE_FINISHED;
+			is_main_source_retried = DA_FALSE;
+			if (segment_info->is_stopped)
+				index = -1;
+			else
+				index = __split_largest_segment(segment_info, index);
+		}
+		_da_thread_mutex_unlock(&(segment_info->mutex));
+	}
+
+	_da_thread_mutex_lock(&(segment_info->mutex));
+	segment_info->running_count--;
+	_da_thread_mutex_unlock(&(segment_info->mutex));
+
+	if (DA_RESULT_OK == Q_make_control_event(
+			Q_EVENT_TYPE_CONTROL_SEGMENT_FINISHED, &q_event))
+		Q_push_event(GET_DL_QUEUE(segment_info->download_id), q_event);
+
+	return DA_NULL;
+}
+
+/* MUST be called with segment_info->mutex */
+da_result_t __create_segment_thread(segment_info_t *segment_info, int index)
+{
+	segment_thread_input *thread_input = DA_NULL;
+
+	thread_input = (segment_thread_input *)calloc(1,
+			sizeof(segment_thread_input));
+	if (!thread_input)
+		return DA_ERR_FAIL_TO_MEMALLOC;
+	thread_input->segment_info = segment_info;
+	thread_input->index = index;
+
+	if (pthread_create(&(segment_info->thread_id[segment_info->thread_count]),
+			DA_NULL, __thread_segment_download, thread_input) != 0) {
+		DA_LOG_ERR(Thread, "fail to make segment thread");
+		free(thread_input);
+		return DA_ERR_FAIL_TO_CREATE_THREAD;
+	}
+	segment_info->thread_count++;
+	segment_info->running_count++;
+
+	return DA_RESULT_OK;
+}
+
+da_result_t segment_start_threads(stage_info *stage)
+{
+	da_result_t ret = DA_RESULT_OK;
+	segment_info_t *segment_info = GET_SEGMENT_INFO(stage);
+	source_info_basic_t *source_info_basic = DA_NULL;
+	int segment_count = 0;
+	int i = 0;
+
+	DA_LOG_FUNC_START(HTTPManager);
+
+	if (!segment_info)
+		return ret;
+
+	segment_count = GET_REQUEST_HTTP_SEGMENT_COUNT(
+			GET_STAGE_TRANSACTION_INFO(stage));
+	if (segment_count > DA_MAX_SEGMENT_COUNT)
+		segment_count = DA_MAX_SEGMENT_COUNT;
+
+	_da_thread_mutex_lock(&(segment_info->mutex));
+
+	if (segment_info->file_path)
+		free(segment_info->file_path);
+	segment_info->file_path = strdup(GET_CONTENT_STORE_TMP_FILE_NAME(
+			GET_STAGE_CONTENT_STORE_INFO(stage)));
+	if (!segment_info->file_path) {
+		ret = DA_ERR_FAIL_TO_MEMALLOC;
+		goto ERR;
+	}
+	segment_info->space_reservation = GET_CONTENT_STORE_SPACE_RESERVATION(
+			GET_STAGE_CONTENT_STORE_INFO(stage));
+	source_info_basic = GET_SOURCE_BASIC(GET_STAGE_SOURCE_INFO(stage));
+	segment_info->durability = source_info_basic ?
+			source_info_basic->durability : DA_DURABILITY_ON_COMPLETE;
+	segment_info->drop_cache_size = source_info_basic ?
+			source_info_basic->drop_cache_size : DA_DEFAULT_DROP_CACHE_SIZE;
+
+	/* Segments which are loaded for resume should be received first */
+	for (i = 0; i < DA_MAX_SEGMENT_COUNT; i++) {
+		if (i == DA_MAIN_SEGMENT ||
+				segment_info->segment[i].state != SEGMENT_STATE_RUNNING)
+			continue;
+		ret = __create_segment_thread(segment_info, i);
+		if (ret != DA_RESULT_OK)
+			goto ERR;
+	}
+
+	while (segment_info->thread_count < segment_count - 1) {
+		if (__create_segment_thread(segment_info, -1) != DA_RESULT_OK)
+			break;
+	}
+	DA_LOG(HTTPManager, "segment threads [%d]", segment_info->thread_count);
+
+ERR:
+	_da_thread_mutex_unlock(&(segment_info->mutex));
+	return ret;
+}
+
+/* Returns the length which main transaction should write.
+ * out_is_range_done is set only when main segment is completed by this body. */
+int segment_accept_main_body(stage_info *stage, int body_len,
+		da_bool_t *out_is_range_done)
+{
+	segment_info_t *segment_info = GET_SEGMENT_INFO(stage);
+	segment_t *segment = DA_NULL;
+
+	*out_is_range_done = DA_FALSE;
+	if (!segment_info)
+		return body_len;
+
+	_da_thread_mutex_lock(&(segment_info->mutex));
+	segment = &(segment_info->segment[DA_MAIN_SEGMENT]);
+	if (segment->state != SEGMENT_STATE_RUNNING) {
+		body_len = 0;
+	} else {
+		if ((unsigned long long)body_len > segment->end - segment->cur)
+			body_len = segment->end - segment->cur;
+		segment->cur += body_len;
+		if (segment->cur >= segment->end) {
+			segment->state = SEGMENT_STATE_FINISHED;
+			*out_is_range_done = DA_TRUE;
+		}
+	}
+	_da_thread_mutex_unlock(&(segment_info->mutex));
+
+	return body_len;
+}
+
+unsigned long long segment_get_main_offset(stage_info *stage)
+{
+	segment_info_t *segment_info = GET_SEGMENT_INFO(stage);
+	unsigned long long offset = 0;
+
+	if (!segment_info)
+		return 0;
+
+	_da_thread_mutex_lock(&(segment_info->mutex));
+	offset = segment_info->segment[DA_MAIN_SEGMENT].cur;
+	_da_thread_mutex_unlock(&(segment_info->mutex));
+
+	return offset;
+}
+
+unsigned long long segment_get_total_size(stage_info *stage)
+{
+	segment_info_t *segment_info = GET_SEGMENT_INFO(stage);
+
+	if (!segment_info)
+		return 0;
+	return segment_info->total_size;
+}
+
+unsigned long long segment_get_received_size(stage_info *stage)
+{
+	segment_info_t *segment_info = GET_SEGMENT_INFO(stage);
+	segment_t *segment = DA_NULL;
+	unsigned long long remained = 0;
+	int i = 0;
+
+	if (!segment_info)
+		return 0;
+
+	/* The range which is not on the map is already received */
+	_da_thread_mutex_lock(&(segment_info->mutex));
+	for (i = 0; i < DA_MAX_SEGMENT_COUNT; i++) {
+		segment = &(segment_info->segment[i]);
+		if (segment->state == SEGMENT_STATE_RUNNING ||
+				segment->state == SEGMENT_STATE_FAILED)
+			remained += segment->end - segment->cur;
+	}
+	_da_thread_mutex_unlock(&(segment_info->mutex));
+
+	return segment_info->total_size - remained;
+}
+
+void segment_set_main_tranx_finished(stage_info *stage)
+{
+	segment_info_t *segment_info = GET_SEGMENT_INFO(stage);
+
+	if (!segment_info)
+		return;
+
+	_da_thread_mutex_lock(&(segment_info->mutex));
+	segment_info->is_main_tranx_finished = DA_TRUE;
+	_da_thread_mutex_unlock(&(segment_info->mutex));
+}
+
+da_bool_t segment_is_all_finished(stage_info *stage)
+{
+	segment_info_t *segment_info = GET_SEGMENT_INFO(stage);
+	da_bool_t b_ret = DA_FALSE;
+
+	if (!segment_info)
+		return DA_TRUE;
+
+	_da_thread_mutex_lock(&(segment_info->mutex));
+	if (segment_info->is_main_tranx_finished &&
+			segment_info->running_count == 0)
+		b_ret = DA_TRUE;
+	_da_thread_mutex_unlock(&(segment_info->mutex));
+
+	return b_ret;
+}
+
+da_result_t segment_get_result(stage_info *stage)
+{
+	segment_info_t *segment_info = GET_SEGMENT_INFO(stage);
+	da_result_t ret = DA_RESULT_OK;
+
+	if (!segment_info)
+		return ret;
+
+	_da_thread_mutex_lock(&(segment_info->mutex));
+	ret = segment_info->result;
+	_da_thread_mutex_unlock(&(segment_info->mutex));
+
+	return ret;
+}
+
+da_result_t segment_check_all_received(stage_info *stage)
+{
+	segment_info_t *segment_info = GET_SEGMENT_INFO(stage);
+	segment_t *segment = DA_NULL;
+	da_result_t ret = DA_RESULT_OK;
+	int i = 0;
+
+	if (!segment_info)
+		return ret;
+
+	_da_thread_mutex_lock(&(segment_info->mutex));
+	for (i = 0; i < DA_MAX_SEGMENT_COUNT; i++) {
+		segment = &(segment_info->segment[i]);
+		if (segment->state != SEGMENT_STATE_IDLE &&
+				segment->cur < segment->end) {
+			DA_LOG_ERR(HTTPManager, "segment[%d] is not received : %llu/%llu",
+					i, segment->cur, segment->end);
+			ret = DA_ERR_MISMATCH_CONTENT_SIZE;
+			break;
+		}
+	}
+	_da_thread_mutex_unlock(&(segment_info->mutex));
+
+	return ret;
+}
+
+void segment_stop(stage_info *stage)
+{
+	segment_info_t *segment_info = GET_SEGMENT_INFO(stage);
+	int i = 0;
+
+	if (!segment_info)
+		return;
+
+	DA_LOG_FUNC_START(HTTPManager);
+
+	_da_thread_mutex_lock(&(segment_info->mutex));
+	segment_info->is_stopped = DA_TRUE;
+	for (i = 0; i < DA_MAX_SEGMENT_COUNT; i++) {
+		if (i != DA_MAIN_SEGMENT &&
+				segment_info->segment[i].tranx_id != DA_INVALID_ID)
+			PI_http_cancel_transaction(segment_info->segment[i].tranx_id,
+					DA_FALSE);
+	}
+	_da_thread_mutex_unlock(&(segment_info->mutex));
+}
+
+/* Threads are created only by the thread of http mgr, which calls this */
+void segment_stop_and_wait(stage_info *stage)
+{
+	segment_info_t *segment_info = GET_SEGMENT_INFO(stage);
+	int i = 0;
+
+	if (!segment_info)
+		return;
+
+	segment_stop(stage);
+	for (i = 0; i < segment_info->thread_count; i++)
+		pthread_join(segment_info->thread_id[i], DA_NULL);
+	segment_info->thread_count = 0;
+}
+
+da_result_t segment_save_map(stage_info *stage)
+{
+	da_result_t ret = DA_RESULT_OK;
+	segment_info_t *segment_info = GET_SEGMENT_INFO(stage);
+	segment_t *segment = DA_NULL;
+	char *map_path = DA_NULL;
+	FILE *fp = DA_NULL;
+	int i = 0;
+
+	DA_LOG_FUNC_START(HTTPManager);
+
+	if (!segment_info)
+		return ret;
+
+	map_path = __get_segment_map_path(stage);
+	if (!map_path) {
+		ret = DA_ERR_FAIL_TO_MEMALLOC;
+		goto ERR;
+	}
+
+	fp = fopen(map_path, "w");
+	if (!fp) {
+		DA_LOG_ERR(HTTPManager, "fail to open segment map [%s]", map_path);
+		ret = DA_ERR_FAIL_TO_ACCESS_FILE;
+		goto ERR;
+	}
+
+	_da_thread_mutex_lock(&(segment_info->mutex));
+	fprintf(fp, "%llu\n", segment_info->total_size);
+	for (i = 0; i < DA_MAX_SEGMENT_COUNT; i++) {
+		segment = &(segment_info->segment[i]);
+		/* Main segment is always kept to know where main transaction is resumed */
+		if (i != DA_MAIN_SEGMENT && (segment->state == SEGMENT_STATE_IDLE
+				|| segment->cur >= segment->end))
+			continue;
+		fprintf(fp, "%d %llu %llu %llu\n", i, segment->start, segment->end,
+				segment->cur);
+	}
+	_da_thread_mutex_unlock(&(segment_info->mutex));
+
+	if (fflush(fp) != 0) {
+		DA_LOG_ERR(HTTPManager, "fail to write segment map");
+		ret = DA_ERR_FAIL_TO_ACCESS_FILE;
+	}
+
+ERR:
+	if (fp)
+		fclose(fp);
+	if (ret != DA_RESULT_OK && map_path)
+		remove_file(map_path);
+	if (map_path)
+		free(map_path);
+	return ret;
+}
+
+void segment_remove_map(stage_info *stage)
+{
+	char *map_path = DA_NULL;
+
+	map_path = __get_segment_map_path(stage);
+	if (map_path) {
+		if (is_file_exist(map_path))
+			remove_file(map_path);
+		free(map_path);
+	}
+}
+
+void destroy_segment_info(segment_info_t **in_segment_info)
+{
+	segment_info_t *segment_info = DA_NULL;
+	int i = 0;
+
+	if (!in_segment_info || !(*in_segment_info))
+		return;
+
+	DA_LOG_FUNC_START(HTTPManager);
+
+	segment_info = *in_segment_info;
+
+	_da_thread_mutex_lock(&(segment_info->mutex));
+	segment_info->is_stopped = DA_TRUE;
+	for (i = 0; i < DA_MAX_SEGMENT_COUNT; i++) {
+		if (i != DA_MAIN_SEGMENT &&
+				segment_info->segment[i].tranx_id != DA_INVALID_ID)
+			PI_http_cancel_transaction(segment_info->segment[i].tranx_id,
+					DA_FALSE);
+	}
+	_da_thread_mutex_unlock(&(segment_info->mutex));
+
+	for (i = 0; i < segment_info->thread_count; i++)
+		pthread_join(segment_info->thread_id[i], DA_NULL);
+
+	for (i = 0; i < segment_info->source_count; i++) {
+		if (segment_info->url[i])
+			free(segment_info->url[i]);
+	}
+	if (segment_info->etag)
+		free(segment_info->etag);
+	if (segment_info->file_path)
+		free(segment_info->file_path);
+	_da_thread_mutex_destroy(&(segment_info->mutex));
+
+	free(segment_info);
+	*in_segment_info = DA_NULL;
+}
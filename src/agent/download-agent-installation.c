@@ -44,6 +44,8 @@ da_result_t install_content(stage_info *stage)
 	char *temp_saved_file_path = DA_NULL;
 	char *install_file_path = DA_NULL;
 	unsigned int start_time = 0;
+	struct stat tmp_file_state;
+	struct stat install_file_state;
 
 	DA_LOG_FUNC_START(InstallManager);
 
@@ -61,10 +63,6 @@ da_result_t install_content(stage_info *stage)
 			GET_CONTENT_STORE_TMP_FILE_NAME(file_storage);
 	DA_LOG(InstallManager,"Source path[%s]",temp_saved_file_path);
 
-	ret = check_enough_storage(stage);
-	if (ret != DA_RESULT_OK)
-		goto ERR;
-
 	ret = _extract_file_path_which_will_be_installed(
 			GET_CONTENT_STORE_PURE_FILE_NAME(file_storage),
 			GET_CONTENT_STORE_EXTENSION(file_storage),
@@ -73,6 +71,15 @@ da_result_t install_content(stage_info *stage)
 	if (ret != DA_RESULT_OK)
 		goto ERR;
 
+	/* Renaming on same file system does not need more space */
+	if (stat(temp_saved_file_path, &tmp_file_state) != 0 ||
+			stat(install_file_path, &install_file_state) != 0 ||
+			tmp_file_state.st_dev != install_file_state.st_dev) {
+		ret = check_enough_storage(stage);
+		if (ret != DA_RESULT_OK)
+			goto ERR;
+	}
+
 	DA_LOG(InstallManager,"Installing path [%s]", install_file_path);
 	DA_LOG(InstallManager,"Move start time : [%ld]",start_time=time(NULL));
 	ret = move_file(temp_saved_file_path, install_file_path);
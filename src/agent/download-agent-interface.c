@@ -33,6 +33,9 @@
 #include "download-agent-basic.h"
 #include "download-agent-file.h"
 #include "download-agent-installation.h"
+#include "download-agent-http-rate.h"
+#include "download-agent-pool.h"
+#include "download-agent-tmp-gc.h"
 
 int da_init(
         da_client_cb_t *da_client_callback,
@@ -51,6 +54,8 @@ int da_init(
 	if (ret != DA_RESULT_OK)
 		goto ERR;
 
+	pool_preallocate();
+
 	ret = init_client_app_mgr();
 	if (ret != DA_RESULT_OK)
 		goto ERR;
@@ -84,7 +89,6 @@ ERR:
 int da_deinit()
 {
 	da_result_t ret = DA_RESULT_OK;
-	char *client_dir_path = DA_NULL;
 
 	DA_LOG_FUNC_START(Default);
 	if (DA_FALSE == is_this_client_available()) {
@@ -92,20 +96,15 @@ int da_deinit()
 		return ret;
 	}
 
+	tmp_gc_stop();
 	deinit_http_mgr();
 	deinit_download_mgr();
 
-	ret = get_client_download_path(&client_dir_path);
-	if (ret == DA_RESULT_OK) {
-		ret = clean_files_from_dir(client_dir_path);
-
-		if (client_dir_path) {
-			free(client_dir_path);
-			client_dir_path = DA_NULL;
-		}
-	}
+	/* Temporary files are kept to be resumed.
+	 * Orphaned ones are removed by da_collect_tmp_files() */
 
 	dereg_client_app();
+	pool_deinit();
 	DA_LOG(Default, "====== da_deinit EXIT =====");
 
 	return ret;
@@ -164,6 +163,20 @@ int da_start_download_with_extension(
 	extension_data.install_path = NULL;
 	extension_data.file_name = NULL;
 	extension_data.user_data = NULL;
+	extension_data.segment_count = NULL;
+	extension_data.rate_group = NULL;
+	extension_data.retry_budget = NULL;
+	extension_data.validated_path = NULL;
+	extension_data.mirror_url = NULL;
+	extension_data.mirror_url_count = NULL;
+	extension_data.low_speed_limit = NULL;
+	extension_data.low_speed_time = NULL;
+	extension_data.queue_high_watermark = NULL;
+	extension_data.queue_low_watermark = NULL;
+	extension_data.durability = NULL;
+	extension_data.drop_cache_size = NULL;
+	extension_data.digest_algorithm = NULL;
+	extension_data.digest_expected = NULL;
 
 	if (DA_FALSE == is_this_client_available()) {
 		ret = DA_ERR_INVALID_CLIENT;
@@ -218,6 +231,96 @@ int da_start_download_with_extension(
 					DA_LOG_ERR(Default, "No property value for DA_FEATURE_REQUEST_HEADER!");
 					ret = DA_ERR_INVALID_ARGUMENT;
 				}
+			} else if (!strncmp(property_name, DA_FEATURE_SEGMENT_COUNT, strlen(DA_FEATURE_SEGMENT_COUNT))) {
+				extension_data.segment_count = va_arg(argptr, const int *);
+				if (extension_data.segment_count) {
+					property_name = va_arg(argptr, char *);
+				} else {
+					DA_LOG_ERR(Default, "No property value for DA_FEATURE_SEGMENT_COUNT!");
+					ret = DA_ERR_INVALID_ARGUMENT;
+				}
+			} else if (!strncmp(property_name, DA_FEATURE_RATE_GROUP, strlen(DA_FEATURE_RATE_GROUP))) {
+				extension_data.rate_group = va_arg(argptr, const char *);
+				if (extension_data.rate_group) {
+					property_name = va_arg(argptr, char *);
+				} else {
+					DA_LOG_ERR(Default, "No property value for DA_FEATURE_RATE_GROUP!");
+					ret = DA_ERR_INVALID_ARGUMENT;
+				}
+			} else if (!strncmp(property_name, DA_FEATURE_RETRY_BUDGET, strlen(DA_FEATURE_RETRY_BUDGET))) {
+				extension_data.retry_budget = va_arg(argptr, const int *);
+				if (extension_data.retry_budget) {
+					property_name = va_arg(argptr, char *);
+				} else {
+					DA_LOG_ERR(Default, "No property value for DA_FEATURE_RETRY_BUDGET!");
+					ret = DA_ERR_INVALID_ARGUMENT;
+				}
+			} else if (!strncmp(property_name, DA_FEATURE_VALIDATED_PATH, strlen(DA_FEATURE_VALIDATED_PATH))) {
+				extension_data.validated_path = va_arg(argptr, const char *);
+				if (extension_data.validated_path) {
+					property_name = va_arg(argptr, char *);
+				} else {
+					DA_LOG_ERR(Default, "No property value for DA_FEATURE_VALIDATED_PATH!");
+					ret = DA_ERR_INVALID_ARGUMENT;
+				}
+			} else if (!strncmp(property_name, DA_FEATURE_MIRROR_URL, strlen(DA_FEATURE_MIRROR_URL))) {
+				extension_data.mirror_url = va_arg(argptr, const char **);
+				extension_data.mirror_url_count = va_arg(argptr, const int *);
+				/* Zero count is allowed not to make a special case for no mirror */
+				if (extension_data.mirror_url_count &&
+						(extension_data.mirror_url ||
+						*(extension_data.mirror_url_count) == 0)) {
+					property_name = va_arg(argptr, char *);
+				} else {
+					DA_LOG_ERR(Default, "No property value for DA_FEATURE_MIRROR_URL!");
+					ret = DA_ERR_INVALID_ARGUMENT;
+				}
+			} else if (!strncmp(property_name, DA_FEATURE_LOW_SPEED, strlen(DA_FEATURE_LOW_SPEED))) {
+				extension_data.low_speed_limit = va_arg(argptr, const int *);
+				extension_data.low_speed_time = va_arg(argptr, const int *);
+				if (extension_data.low_speed_limit &&
+						extension_data.low_speed_time) {
+					property_name = va_arg(argptr, char *);
+				} else {
+					DA_LOG_ERR(Default, "No property value for DA_FEATURE_LOW_SPEED!");
+					ret = DA_ERR_INVALID_ARGUMENT;
+				}
+			} else if (!strncmp(property_name, DA_FEATURE_QUEUE_WATERMARK, strlen(DA_FEATURE_QUEUE_WATERMARK))) {
+				extension_data.queue_high_watermark = va_arg(argptr, const int *);
+				extension_data.queue_low_watermark = va_arg(argptr, const int *);
+				if (extension_data.queue_high_watermark &&
+						extension_data.queue_low_watermark) {
+					property_name = va_arg(argptr, char *);
+				} else {
+					DA_LOG_ERR(Default, "No property value for DA_FEATURE_QUEUE_WATERMARK!");
+					ret = DA_ERR_INVALID_ARGUMENT;
+				}
+			} else if (!strncmp(property_name, DA_FEATURE_DURABILITY, strlen(DA_FEATURE_DURABILITY))) {
+				extension_data.durability = va_arg(argptr, const int *);
+				if (extension_data.durability) {
+					property_name = va_arg(argptr, char *);
+				} else {
+					DA_LOG_ERR(Default, "No property value for DA_FEATURE_DURABILITY!");
+					ret = DA_ERR_INVALID_ARGUMENT;
+				}
+			} else if (!strncmp(property_name, DA_FEATURE_DROP_CACHE, strlen(DA_FEATURE_DROP_CACHE))) {
+				extension_data.drop_cache_size = va_arg(argptr, const int *);
+				if (extension_data.drop_cache_size) {
+					property_name = va_arg(argptr, char *);
+				} else {
+					DA_LOG_ERR(Default, "No property value for DA_FEATURE_DROP_CACHE!");
+					ret = DA_ERR_INVALID_ARGUMENT;
+				}
+			} else if (!strncmp(property_name, DA_FEATURE_DIGEST, strlen(DA_FEATURE_DIGEST))) {
+				extension_data.digest_algorithm = va_arg(argptr, const char *);
+				extension_data.digest_expected = va_arg(argptr, const char *);
+				if (extension_data.digest_algorithm &&
+						extension_data.digest_expected) {
+					property_name = va_arg(argptr, char *);
+				} else {
+					DA_LOG_ERR(Default, "No property value for DA_FEATURE_DIGEST!");
+					ret = DA_ERR_INVALID_ARGUMENT;
+				}
 			} else {
 				DA_LOG_ERR(Default, "Unknown property name; [%s]", property_name);
 				ret = DA_ERR_INVALID_ARGUMENT;
@@ -320,3 +423,94 @@ ERR:
 	return ret;
 }
 
+int da_set_max_download_count(int count)
+{
+	da_result_t ret = DA_RESULT_OK;
+
+	DA_LOG_FUNC_START(Default);
+
+	if (count < 1 || count > DA_MAX_DOWNLOAD_REQ_LIMIT) {
+		ret = DA_ERR_INVALID_ARGUMENT;
+		goto ERR;
+	}
+
+	ret = set_max_http_transaction_count(count);
+	if (ret != DA_RESULT_OK)
+		goto ERR;
+
+	ret = set_max_download_count(count);
+
+ERR:
+	DA_LOG_CRITICAL(Default, "Return: max download count = %d, ret = %d", count, ret);
+	return ret;
+}
+
+int da_get_max_download_count(void)
+{
+	return get_max_download_count();
+}
+
+int da_set_global_rate_limit(unsigned int bytes_per_sec)
+{
+	da_result_t ret = DA_RESULT_OK;
+
+	DA_LOG_FUNC_START(Default);
+
+	ret = rate_set_global_limit(bytes_per_sec);
+
+	DA_LOG_CRITICAL(Default, "Return: global rate = %u, ret = %d", bytes_per_sec, ret);
+	return ret;
+}
+
+int da_set_download_rate_limit(da_handle_t da_dl_req_id, unsigned int bytes_per_sec)
+{
+	da_result_t ret = DA_RESULT_OK;
+	int download_id = DA_INVALID_ID;
+
+	DA_LOG_FUNC_START(Default);
+
+	if (DA_FALSE == is_this_client_available()) {
+		ret = DA_ERR_INVALID_CLIENT;
+		goto ERR;
+	}
+
+	ret = get_download_id_for_dl_req_id(da_dl_req_id, &download_id);
+	if (ret != DA_RESULT_OK)
+		goto ERR;
+
+	ret = rate_set_download_limit(download_id, bytes_per_sec);
+
+ERR:
+	DA_LOG_CRITICAL(Default, "Return: id = %d, rate = %u, ret = %d", da_dl_req_id, bytes_per_sec, ret);
+	return ret;
+}
+
+int da_collect_tmp_files(const char **keep_paths, int keep_count)
+{
+	da_result_t ret = DA_RESULT_OK;
+
+	DA_LOG_FUNC_START(Default);
+
+	if (DA_FALSE == is_this_client_available()) {
+		ret = DA_ERR_INVALID_CLIENT;
+		goto ERR;
+	}
+
+	ret = tmp_gc_start(keep_paths, keep_count);
+
+ERR:
+	DA_LOG_CRITICAL(Default, "Return: keep count = %d, ret = %d", keep_count, ret);
+	return ret;
+}
+
+int da_set_group_rate_limit(const char *group, unsigned int bytes_per_sec)
+{
+	da_result_t ret = DA_RESULT_OK;
+
+	DA_LOG_FUNC_START(Default);
+
+	ret = rate_set_group_limit(group, bytes_per_sec);
+
+	DA_LOG_CRITICAL(Default, "Return: group rate = %u, ret = %d", bytes_per_sec, ret);
+	return ret;
+}
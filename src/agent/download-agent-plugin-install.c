@@ -26,9 +26,6 @@
 #include "download-agent-debug.h"
 #include "download-agent-plugin-conf.h"
 
-#define DA_DEFAULT_INSTALL_PATH_FOR_PHONE "/opt/media/Downloads"
-#define DA_DEFAULT_INSTALL_PATH_FOR_MMC "/opt/storage/sdcard/Downloads"
-
 char *PI_get_default_install_dir(void)
 {
 	da_storage_type_t type;
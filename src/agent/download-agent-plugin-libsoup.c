@@ -34,32 +34,348 @@
 
 pthread_mutex_t mutex_for_session_table = PTHREAD_MUTEX_INITIALIZER;
 
-pi_session_table_t pi_session_table[MAX_SESSION_COUNT] = { { 0, }, };
+pi_session_table_t *pi_session_table[MAX_SESSION_TABLE_SIZE] = { DA_NULL, };
+int pi_session_table_count = 0;
+int pi_max_session_count = MAX_SESSION_COUNT;
 da_bool_t using_content_sniffing;
 
+/* All transactions share one session, so that connections to the same host
+ * are kept alive and reused by the following downloads, redirections and
+ * resume requests instead of doing DNS lookup, TCP and TLS handshake again. */
+pthread_mutex_t mutex_for_shared_session = PTHREAD_MUTEX_INITIALIZER;
+SoupSession *pi_shared_session = DA_NULL;
+char *pi_shared_session_proxy_addr = DA_NULL;
+
+/* The shared session is an async session which is driven by one loop thread.
+ * All soup APIs are called and all soup callbacks are invoked on this thread,
+ * so no transport thread is added per transaction. Each download still has
+ * its own control thread, and each segment its own thread, which consume
+ * the events put to their queues by this thread.
+ * The loop is kept to the end of process, because the transactions which are
+ * cancelled on da_deinit() need it to be finished. */
+pthread_mutex_t mutex_for_loop = PTHREAD_MUTEX_INITIALIZER;
+GMainContext *pi_loop_context = DA_NULL;
+GMainLoop *pi_loop = DA_NULL;
+pthread_t pi_loop_thread_id;
+
+/* Arguments for a job which is run on loop thread */
+typedef struct _pi_invoke_t {
+	int entry;
+	SoupSession *session;
+	SoupMessage *msg;
+	char *proxy_addr;
+	int count;
+	queue_t *queue;
+	q_event_t *event;
+} pi_invoke_t;
+
+#define PI_MAX_PROBE_COUNT	16
+
+/* Requests of one probe. They are not registered to session table,
+ * because nothing is delivered to the queue of download. */
+typedef struct _pi_probe_t {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	/* Caller and each queued message have one */
+	int ref_count;
+	int pending_count;
+	int fastest;
+	SoupSession *session;
+	SoupMessage *msg[PI_MAX_PROBE_COUNT];
+	da_bool_t is_finished[PI_MAX_PROBE_COUNT];
+	char *proxy_addr;
+} pi_probe_t;
+
+#define PI_BODY_BLOCK_SIZE	8192
+
+/* libsoup reads the body from socket into this directly, and it is passed to
+ * the download thread without copying. libsoup and the queue event have their own
+ * references, and the last one frees it. The data follows this header. */
+typedef struct _pi_body_block_t {
+	volatile int ref_count;
+	gsize size;
+} pi_body_block_t;
+
+#define PI_BODY_BLOCK_DATA(BLOCK)	((char *)((BLOCK) + 1))
+
+/* Chunk allocator of a message. This is used only on loop thread,
+ * and destroyed when the message is finalized. */
+typedef struct _pi_chunk_allocator_t {
+	/* The block which is read last. It has one more reference for got-chunk */
+	pi_body_block_t *last_block;
+} pi_chunk_allocator_t;
+
 da_bool_t _pi_http_is_this_session_table_entry_using(
 		const int in_session_table_entry);
+static da_bool_t _pi_http_push_or_pause(int session_table_entry, SoupMessage *msg,
+		queue_t *da_queue, q_event_t *da_event);
+static void _pi_http_keep_pending_event(pi_session_table_t *table_entry,
+		q_event_t *da_event);
+static void _pi_http_push_final_event(int session_table_entry,
+		queue_t *da_queue, q_event_t *da_event);
+static void _pi_http_unref_body_block(void *data);
+static void _pi_http_destroy_chunk_allocator(gpointer data);
+static SoupBuffer *_pi_http_chunk_allocator_cb(SoupMessage *msg, gsize max_len,
+		gpointer data);
+
+static void *_pi_http_loop_thread(void *data)
+{
+	DA_LOG_CRITICAL(Thread, "=====http loop thread - START=====");
+
+	g_main_context_push_thread_default(pi_loop_context);
+	g_main_loop_run(pi_loop);
+	g_main_context_pop_thread_default(pi_loop_context);
+
+	DA_LOG_CRITICAL(Thread, "=====http loop thread - EXIT=====");
+	return DA_NULL;
+}
+
+static da_result_t _pi_http_start_loop(void)
+{
+	da_result_t ret = DA_RESULT_OK;
+	pthread_attr_t thread_attr;
+	GSource *source = DA_NULL;
+
+	_da_thread_mutex_lock (&mutex_for_loop);
+	if (pi_loop)
+		goto ERR;
+
+	pi_loop_context = g_main_context_new();
+	pi_loop = g_main_loop_new(pi_loop_context, FALSE);
+
+	/* One timer watches all transactions */
+	source = g_timeout_source_new(WATCHDOG_INTERVAL_MSEC);
+	g_source_set_callback(source, _pi_http_watchdog_cb, DA_NULL, DA_NULL);
+	g_source_attach(source, pi_loop_context);
+	g_source_unref(source);
+
+	if (pthread_attr_init(&thread_attr) != 0) {
+		ret = DA_ERR_FAIL_TO_CREATE_THREAD;
+		goto ERR;
+	}
+	if (pthread_attr_setdetachstate(&thread_attr,
+			PTHREAD_CREATE_DETACHED) != 0) {
+		ret = DA_ERR_FAIL_TO_CREATE_THREAD;
+		goto ERR;
+	}
+	if (pthread_create(&pi_loop_thread_id, &thread_attr,
+			_pi_http_loop_thread, DA_NULL) != 0) {
+		DA_LOG_ERR(Thread, "making loop thread failed..");
+		ret = DA_ERR_FAIL_TO_CREATE_THREAD;
+		goto ERR;
+	}
+ERR:
+	if (ret != DA_RESULT_OK && pi_loop) {
+		g_main_loop_unref(pi_loop);
+		pi_loop = DA_NULL;
+		g_main_context_unref(pi_loop_context);
+		pi_loop_context = DA_NULL;
+	}
+	_da_thread_mutex_unlock (&mutex_for_loop);
+	return ret;
+}
+
+/* Run the function on loop thread.
+ * It is run at once if the caller is the loop thread itself or there is no loop yet.
+ * Otherwise it is queued, and the jobs are run in the order of queueing. */
+static void _pi_http_invoke(int (*func)(gpointer), gpointer data)
+{
+	GSource *source = DA_NULL;
+
+	if (!pi_loop_context || g_main_context_is_owner(pi_loop_context)) {
+		func(data);
+		return;
+	}
+
+	source = g_idle_source_new();
+	/* Not to be starved by the I/O of other transactions */
+	g_source_set_priority(source, G_PRIORITY_DEFAULT);
+	g_source_set_callback(source, func, data, DA_NULL);
+	g_source_attach(source, pi_loop_context);
+	g_source_unref(source);
+}
+
+static pi_invoke_t *_pi_http_new_invoke(int entry, SoupSession *session,
+		SoupMessage *msg)
+{
+	pi_invoke_t *invoke = DA_NULL;
+
+	invoke = (pi_invoke_t *)calloc(1, sizeof(pi_invoke_t));
+	if (!invoke) {
+		DA_LOG_ERR(HTTPManager,"DA_ERR_FAIL_TO_MEMALLOC");
+		return DA_NULL;
+	}
+	invoke->entry = entry;
+	if (session)
+		invoke->session = g_object_ref(session);
+	if (msg)
+		invoke->msg = g_object_ref(msg);
+	return invoke;
+}
+
+static void _pi_http_free_invoke(pi_invoke_t *invoke)
+{
+	if (!invoke)
+		return;
+	if (invoke->session)
+		g_object_unref(invoke->session);
+	if (invoke->msg)
+		g_object_unref(invoke->msg);
+	if (invoke->proxy_addr)
+		free(invoke->proxy_addr);
+	if (invoke->event)
+		Q_destroy_q_event(&(invoke->event));
+	free(invoke);
+}
+
+SoupSession *_pi_http_create_shared_session(void)
+{
+	SoupSession *session = DA_NULL;
+
+	session = soup_session_async_new_with_options(
+			SOUP_SESSION_ASYNC_CONTEXT, pi_loop_context, NULL);
+	if (!session) {
+		DA_LOG_ERR(HTTPManager,"Fail to create session");
+		return DA_NULL;
+	}
+	DA_LOG(HTTPManager,"session[%p]", session);
+/*
+	SoupLogger* logger = soup_logger_new(SOUP_LOGGER_LOG_BODY, -1);
+	soup_logger_attach(logger, session);
+	g_object_unref(logger);
+*/
+	g_object_set(session,
+			SOUP_SESSION_MAX_CONNS, MAX_SESSION_CONNS(pi_max_session_count),
+			SOUP_SESSION_MAX_CONNS_PER_HOST,
+			MAX_SESSION_CONNS_PER_HOST(pi_max_session_count),
+			NULL);
+	/* SOUP_SESSION_TIMEOUT is not set. It cannot catch a connection which trickles,
+	 * and it is same for all transactions on shared session.
+	 * Instead, each transaction is watched by _pi_http_watchdog_cb(). */
+
+	if (using_content_sniffing)
+		soup_session_add_feature_by_type(session, SOUP_TYPE_CONTENT_SNIFFER);
+
+	return session;
+}
 
 da_result_t PI_http_init(void)
 {
+	da_result_t ret = DA_RESULT_OK;
+
 	DA_LOG_FUNC_START(HTTPManager);
 
 	using_content_sniffing = DA_TRUE;
 
+	ret = _pi_http_start_loop();
+	if (ret != DA_RESULT_OK)
+		return ret;
+
+	_da_thread_mutex_lock (&mutex_for_shared_session);
+	if (!pi_shared_session)
+		pi_shared_session = _pi_http_create_shared_session();
+	_da_thread_mutex_unlock (&mutex_for_shared_session);
+
 	return DA_RESULT_OK;
 }
 
+static int _pi_http_set_max_conns_on_loop(gpointer data)
+{
+	pi_invoke_t *invoke = (pi_invoke_t *)data;
+
+	g_object_set(invoke->session,
+			SOUP_SESSION_MAX_CONNS, MAX_SESSION_CONNS(invoke->count),
+			SOUP_SESSION_MAX_CONNS_PER_HOST,
+			MAX_SESSION_CONNS_PER_HOST(invoke->count),
+			NULL);
+	_pi_http_free_invoke(invoke);
+	return FALSE;
+}
+
+da_result_t PI_http_set_max_transaction_count(int count)
+{
+	da_result_t ret = DA_RESULT_OK;
+	pi_session_table_t *entry = DA_NULL;
+
+	DA_LOG_FUNC_START(HTTPManager);
+
+	if (count < 1 || count > MAX_SESSION_LIMIT) {
+		DA_LOG_ERR(HTTPManager,"invalid count = %d", count);
+		return DA_ERR_INVALID_ARGUMENT;
+	}
+
+	_da_thread_mutex_lock (&mutex_for_session_table);
+	while (pi_session_table_count < count) {
+		entry = (pi_session_table_t *)calloc(1, sizeof(pi_session_table_t));
+		if (!entry) {
+			DA_LOG_ERR(HTTPManager,"DA_ERR_FAIL_TO_MEMALLOC");
+			ret = DA_ERR_FAIL_TO_MEMALLOC;
+			break;
+		}
+		_da_thread_mutex_init(&(entry->mutex), DA_NULL);
+		pi_session_table[pi_session_table_count++] = entry;
+	}
+	/* Entries over the limit are not handed out any more,
+	 * but transactions which are using them are not affected. */
+	if (ret == DA_RESULT_OK)
+		pi_max_session_count = count;
+	_da_thread_mutex_unlock (&mutex_for_session_table);
+
+	if (ret != DA_RESULT_OK)
+		return ret;
+
+	DA_LOG(HTTPManager,"max session count = %d", count);
+
+	_da_thread_mutex_lock (&mutex_for_shared_session);
+	if (pi_shared_session) {
+		pi_invoke_t *invoke = _pi_http_new_invoke(-1, pi_shared_session,
+				DA_NULL);
+		if (invoke) {
+			invoke->count = count;
+			_pi_http_invoke(_pi_http_set_max_conns_on_loop, invoke);
+		}
+	}
+	_da_thread_mutex_unlock (&mutex_for_shared_session);
+
+	return ret;
+}
+
+static int _pi_http_unref_on_loop(gpointer data)
+{
+	_pi_http_free_invoke((pi_invoke_t *)data);
+	return FALSE;
+}
+
 void PI_http_deinit(void)
 {
 	DA_LOG_FUNC_START(HTTPManager);
 
+	_da_thread_mutex_lock (&mutex_for_shared_session);
+	/* Any transaction which is still alive keeps its own reference.
+	 * The last reference is dropped on loop thread which is using the session. */
+	if (pi_shared_session) {
+		pi_invoke_t *invoke = _pi_http_new_invoke(-1, DA_NULL, DA_NULL);
+		if (invoke) {
+			invoke->session = pi_shared_session;
+			_pi_http_invoke(_pi_http_unref_on_loop, invoke);
+		} else {
+			g_object_unref(pi_shared_session);
+		}
+		pi_shared_session = DA_NULL;
+	}
+	if (pi_shared_session_proxy_addr) {
+		free(pi_shared_session_proxy_addr);
+		pi_shared_session_proxy_addr = DA_NULL;
+	}
+	_da_thread_mutex_unlock (&mutex_for_shared_session);
+
 	return;
 }
 
 da_result_t _set_proxy_on_soup_session(SoupSession *session, char *proxy_addr)
 {
 	da_result_t ret = DA_RESULT_OK;
-
+	SoupURI *proxy_uri = DA_NULL;
 
 	if (proxy_addr && strlen(proxy_addr) > 0) {
 		DA_LOG_CRITICAL(HTTPManager,"received proxy = %s \n", proxy_addr);
@@ -81,23 +397,69 @@ da_result_t _set_proxy_on_soup_session(SoupSession *session, char *proxy_addr)
 				snprintf(tmp_str, needed_len, "%s%s",
 						SCHEME_HTTP, proxy_addr);
 
+				proxy_uri = soup_uri_new(tmp_str);
 				g_object_set(session, SOUP_SESSION_PROXY_URI,
-						soup_uri_new(tmp_str), NULL);
+						proxy_uri, NULL);
 
 				free(tmp_str);
 			} else {
 				DA_LOG(HTTPManager,"There is \"http\" on uri, so, push this address to soup directly.");
+				proxy_uri = soup_uri_new(proxy_addr);
 				g_object_set(session, SOUP_SESSION_PROXY_URI,
-						soup_uri_new(proxy_addr), NULL);
+						proxy_uri, NULL);
 			}
 		}
 	} else {
 		DA_LOG(HTTPManager,"There is no proxy value");
 	}
 ERR:
+	if (proxy_uri)
+		soup_uri_free(proxy_uri);
 	return ret;
 }
 
+/* Return the shared session with an additional reference for the caller. */
+SoupSession *_pi_http_get_shared_session(void)
+{
+	SoupSession *session = DA_NULL;
+
+	_da_thread_mutex_lock (&mutex_for_shared_session);
+
+	if (!pi_shared_session)
+		pi_shared_session = _pi_http_create_shared_session();
+	if (pi_shared_session)
+		session = g_object_ref(pi_shared_session);
+
+	_da_thread_mutex_unlock (&mutex_for_shared_session);
+	return session;
+}
+
+/* This should be called on loop thread.
+ * The proxy is applied again only when it is changed, because changing it
+ * drops the connections which are kept alive on the session. */
+void _pi_http_set_proxy_on_shared_session(SoupSession *session,
+		char *proxy_addr)
+{
+	_da_thread_mutex_lock (&mutex_for_shared_session);
+
+	if (proxy_addr && strlen(proxy_addr) > 0) {
+		if (!pi_shared_session_proxy_addr ||
+				strcmp(pi_shared_session_proxy_addr, proxy_addr)) {
+			if (pi_shared_session_proxy_addr)
+				free(pi_shared_session_proxy_addr);
+			pi_shared_session_proxy_addr = strdup(proxy_addr);
+			_set_proxy_on_soup_session(session, proxy_addr);
+		}
+	} else if (pi_shared_session_proxy_addr) {
+		DA_LOG(HTTPManager,"Proxy is removed");
+		free(pi_shared_session_proxy_addr);
+		pi_shared_session_proxy_addr = DA_NULL;
+		g_object_set(session, SOUP_SESSION_PROXY_URI, NULL, NULL);
+	}
+
+	_da_thread_mutex_unlock (&mutex_for_shared_session);
+}
+
 void _fill_soup_msg_header(SoupMessage *msg,
 		const input_for_tranx_t *input_for_tranx)
 {
@@ -137,6 +499,102 @@ void _fill_soup_msg_header(SoupMessage *msg,
 	}
 }
 
+static int _pi_http_queue_message_on_loop(gpointer data)
+{
+	pi_invoke_t *invoke = (pi_invoke_t *)data;
+
+	_pi_http_set_proxy_on_shared_session(invoke->session, invoke->proxy_addr);
+
+	/* soup_session_queue_message() steals the reference of invoke */
+	soup_session_queue_message(invoke->session, invoke->msg,
+			_pi_http_finished_cb, NULL);
+	invoke->msg = DA_NULL;
+
+	_pi_http_free_invoke(invoke);
+	return FALSE;
+}
+
+static int _pi_http_cancel_on_loop(gpointer data)
+{
+	pi_invoke_t *invoke = (pi_invoke_t *)data;
+
+	DA_LOG(HTTPManager,"Call soup cancel API : msg[%p]", invoke->msg);
+	/* soup_session_abort() is not used even if abort option is set,
+	 * because it cancels all messages of other downloads on shared session */
+	soup_session_cancel_message(invoke->session, invoke->msg,
+			SOUP_STATUS_CANCELLED);
+	DA_LOG(HTTPManager,"Call soup cancel API-Done");
+
+	_pi_http_free_invoke(invoke);
+	return FALSE;
+}
+
+static int _pi_http_pause_on_loop(gpointer data)
+{
+	pi_invoke_t *invoke = (pi_invoke_t *)data;
+
+	soup_session_pause_message(invoke->session, invoke->msg);
+
+	_pi_http_free_invoke(invoke);
+	return FALSE;
+}
+
+static int _pi_http_unpause_on_loop(gpointer data)
+{
+	pi_invoke_t *invoke = (pi_invoke_t *)data;
+	pi_session_table_t *table_entry = pi_session_table[invoke->entry];
+	q_event_t *event = DA_NULL;
+	q_event_t *final_event = DA_NULL;
+	da_bool_t is_same_tranx = DA_FALSE;
+
+	_da_thread_mutex_lock (&mutex_for_session_table);
+	is_same_tranx = (table_entry->is_using &&
+			table_entry->msg == invoke->msg);
+	_da_thread_mutex_unlock (&mutex_for_session_table);
+
+	/* The transaction is already finished. Its events are destroyed with the entry */
+	if (!is_same_tranx)
+		goto ERR;
+
+	/* Taken on loop thread, so that the final event is not pushed before this */
+	_da_thread_mutex_lock (&(table_entry->mutex));
+	invoke->event = table_entry->pending_event;
+	table_entry->pending_event = DA_NULL;
+	_da_thread_mutex_unlock (&(table_entry->mutex));
+
+	while (invoke->event) {
+		event = invoke->event;
+		invoke->event = event->next;
+		event->next = DA_NULL;
+		/* The event is kept by table entry again if the queue is full still,
+		 * and the rest are kept after it */
+		if (!_pi_http_push_or_pause(invoke->entry, invoke->msg,
+				invoke->queue, event)) {
+			_da_thread_mutex_lock (&(table_entry->mutex));
+			_pi_http_keep_pending_event(table_entry, invoke->event);
+			_da_thread_mutex_unlock (&(table_entry->mutex));
+			invoke->event = DA_NULL;
+			goto ERR;
+		}
+	}
+
+	_da_thread_mutex_lock (&(table_entry->mutex));
+	final_event = table_entry->pending_final_event;
+	table_entry->pending_final_event = DA_NULL;
+	_da_thread_mutex_unlock (&(table_entry->mutex));
+	if (final_event)
+		_pi_http_push_final_event(invoke->entry, invoke->queue,
+				final_event);
+
+	/* Both are run on loop thread. Finished one is not resumed */
+	if (DA_FALSE == table_entry->is_finished)
+		soup_session_unpause_message(invoke->session, invoke->msg);
+
+ERR:
+	_pi_http_free_invoke(invoke);
+	return FALSE;
+}
+
 da_result_t PI_http_start_transaction(const input_for_tranx_t *input_for_tranx,
 		int *out_tranx_id)
 {
@@ -151,6 +609,8 @@ da_result_t PI_http_start_transaction(const input_for_tranx_t *input_for_tranx,
 
 	SoupSession *session = DA_NULL;
 	SoupMessage *msg = DA_NULL;
+	pi_invoke_t *invoke = DA_NULL;
+	pi_chunk_allocator_t *allocator = DA_NULL;
 
 	DA_LOG_FUNC_START(HTTPManager);
 
@@ -164,7 +624,8 @@ da_result_t PI_http_start_transaction(const input_for_tranx_t *input_for_tranx,
 		url = input_for_tranx->http_msg_request->url;
 	}
 
-	session_table_entry = _pi_http_get_avaiable_session_table_entry();
+	session_table_entry = _pi_http_get_avaiable_session_table_entry(
+			input_for_tranx->is_extra);
 	if (session_table_entry == -1) {
 		ret = DA_ERR_ALREADY_MAX_DOWNLOAD;
 		goto ERR;
@@ -178,34 +639,21 @@ da_result_t PI_http_start_transaction(const input_for_tranx_t *input_for_tranx,
 		goto ERR;
 	}
 
-	/* modified by keunsoon.lee 2010-09-20 use sync_new() instead of async_new() for make different soup thread from UI main thread*/
-	session = soup_session_sync_new();
-	/* session=soup_session_async_new(); */
+	session = _pi_http_get_shared_session();
 	if (!session) {
-		DA_LOG_ERR(HTTPManager,"Fail to create session");
+		_pi_http_destroy_session_table_entry(session_table_entry);
 		return DA_ERR_INVALID_URL;
 	}
 	DA_LOG(HTTPManager,"session[%p]", session);
-/*
-	SoupLogger* logger = soup_logger_new(SOUP_LOGGER_LOG_BODY, -1);
-	soup_logger_attach(logger, session);
-	g_object_unref(logger);
-*/
+
 	if (DA_FALSE == _pi_http_register_session_to_session_table(
 			session_table_entry, session)) {
-		_pi_http_init_session_table_entry(session_table_entry);
+		g_object_unref(session);
+		_pi_http_destroy_session_table_entry(session_table_entry);
 		ret = DA_ERR_ALREADY_MAX_DOWNLOAD;
 		goto ERR;
 	}
 
-	g_object_set(session, SOUP_SESSION_MAX_CONNS, MAX_SESSION_COUNT, NULL);
-	/* Set timeout unlimited time to resume a download which has ETag when the network is re-connected
-	 * => This is changed to 180 seconds due to limitation of max downloading items.
-	 */
-	g_object_set(session, SOUP_SESSION_TIMEOUT, MAX_TIMEOUT, NULL);
-
-	_set_proxy_on_soup_session(session, input_for_tranx->proxy_addr);
-
 	switch (pi_http_method) {
 	case PI_HTTP_METHOD_GET:
 		msg = soup_message_new(METHOD_GET, url);
@@ -224,37 +672,60 @@ da_result_t PI_http_start_transaction(const input_for_tranx_t *input_for_tranx,
 	/* if it is failed to create a msg, the url can be invalid, becasue of the input argument of soup_message_new API */
 	if (msg == NULL) {
 		DA_LOG_ERR(HTTPManager,"Fail to create message");
+		_pi_http_destroy_session_table_entry(session_table_entry);
 		ret = DA_ERR_INVALID_URL;
 		goto ERR;
 	}
 
 	_fill_soup_msg_header(msg, input_for_tranx);
 
+	/* Watchdog starts to see this after the msg is registered */
+	pi_session_table[session_table_entry]->low_speed_limit =
+		input_for_tranx->low_speed_limit;
+	pi_session_table[session_table_entry]->low_speed_time =
+		input_for_tranx->low_speed_time;
+
 	g_signal_connect(msg, "restarted", G_CALLBACK(_pi_http_restarted_cb),
 			NULL); /* for redirection case */
+	g_signal_connect(msg, "wrote-headers",
+			G_CALLBACK(_pi_http_wroteheaders_cb), NULL);
 	g_signal_connect(msg, "got-headers",
 			G_CALLBACK(_pi_http_gotheaders_cb), NULL);
+	/* Without this, the body is copied from the read buffer of libsoup */
+	allocator = (pi_chunk_allocator_t *)calloc(1, sizeof(pi_chunk_allocator_t));
+	if (allocator)
+		soup_message_set_chunk_allocator(msg, _pi_http_chunk_allocator_cb,
+				allocator, _pi_http_destroy_chunk_allocator);
 	g_signal_connect(msg, "got-chunk", G_CALLBACK(_pi_http_gotchunk_cb),
-			NULL);
+			allocator);
 
 	if (using_content_sniffing) {
-		soup_session_add_feature_by_type(session, SOUP_TYPE_CONTENT_SNIFFER);
 		g_signal_connect(msg, "content-sniffed",
 				G_CALLBACK(_pi_http_contentsniffed_cb), NULL);
 	} else {
 		soup_message_disable_feature(msg, SOUP_TYPE_CONTENT_SNIFFER);
 	}
 
-	soup_session_queue_message(session, msg, _pi_http_finished_cb, NULL);
-//	g_signal_connect(msg, "finished", G_CALLBACK(_pi_http_finished_cb),	NULL);
-
+	/* The table entry owns the reference of msg until it is destroyed,
+	 * so the msg is valid for cancel even after it is finished on loop thread. */
 	if (DA_FALSE == _pi_http_register_msg_to_session_table(
 			session_table_entry, msg)) {
+		g_object_unref(msg);
 		_pi_http_destroy_session_table_entry(session_table_entry);
 		ret = DA_ERR_ALREADY_MAX_DOWNLOAD;
 		goto ERR;
 	}
 
+	invoke = _pi_http_new_invoke(session_table_entry, session, msg);
+	if (!invoke) {
+		_pi_http_destroy_session_table_entry(session_table_entry);
+		ret = DA_ERR_FAIL_TO_MEMALLOC;
+		goto ERR;
+	}
+	if (input_for_tranx->proxy_addr)
+		invoke->proxy_addr = strdup(input_for_tranx->proxy_addr);
+	_pi_http_invoke(_pi_http_queue_message_on_loop, invoke);
+
 	*out_tranx_id = session_table_entry;
 	DA_LOG(HTTPManager,"*out_tranx_id = %d", *out_tranx_id);
 
@@ -284,6 +755,7 @@ da_result_t PI_http_cancel_transaction(int in_tranx_id, da_bool_t abort_option)
 	SoupSession *session;
 	SoupMessage *msg;
 	int session_table_entry = -1;
+	pi_invoke_t *invoke = DA_NULL;
 
 	DA_LOG_FUNC_START(HTTPManager);
 
@@ -306,12 +778,18 @@ da_result_t PI_http_cancel_transaction(int in_tranx_id, da_bool_t abort_option)
 		DA_LOG_ERR(HTTPManager,"invalid message = %p", msg);
 		goto ERR;
 	}
-	DA_LOG(HTTPManager,"Call soup cancel API : abort option[%d]",abort_option);
-	if (abort_option)
-		soup_session_abort(session);
-	else
-		soup_session_cancel_message(session, msg, SOUP_STATUS_CANCELLED);
-	DA_LOG(HTTPManager,"Call soup cancel API-Done");
+	DA_LOG(HTTPManager,"Request soup cancel : abort option[%d]",abort_option);
+
+	_da_thread_mutex_lock (&(pi_session_table[session_table_entry]->mutex));
+	pi_session_table[session_table_entry]->is_cancelled = DA_TRUE;
+	_da_thread_mutex_unlock (&(pi_session_table[session_table_entry]->mutex));
+
+	invoke = _pi_http_new_invoke(session_table_entry, session, msg);
+	if (!invoke) {
+		ret = DA_ERR_FAIL_TO_MEMALLOC;
+		goto ERR;
+	}
+	_pi_http_invoke(_pi_http_cancel_on_loop, invoke);
 ERR:
 	return ret;
 }
@@ -320,7 +798,7 @@ void PI_http_pause_transaction(int transaction_id)
 {
 	int session_table_entry = -1;
 	pthread_mutex_t *mutex;
-	pthread_cond_t *cond;
+	pi_invoke_t *invoke = DA_NULL;
 
 	DA_LOG_FUNC_START(HTTPManager);
 
@@ -331,28 +809,32 @@ void PI_http_pause_transaction(int transaction_id)
 	if (!_pi_http_is_this_session_table_entry_using(session_table_entry))
 		return;
 
-	mutex = &(pi_session_table[session_table_entry].mutex);
-	cond = &(pi_session_table[session_table_entry].cond);
+	mutex = &(pi_session_table[session_table_entry]->mutex);
 
 	_da_thread_mutex_lock (mutex);
 
-	if (pi_session_table[session_table_entry].is_paused == DA_FALSE) {
+	if (pi_session_table[session_table_entry]->is_paused == DA_FALSE) {
 		DA_LOG_CRITICAL(HTTPManager,"paused!");
-		pi_session_table[session_table_entry].is_paused = DA_TRUE;
-		_da_thread_cond_wait(cond, mutex);
+		pi_session_table[session_table_entry]->is_paused = DA_TRUE;
+		pi_session_table[session_table_entry]->was_paused = DA_TRUE;
+		invoke = _pi_http_new_invoke(session_table_entry,
+				GET_SESSION_FROM_TABLE_ENTRY(session_table_entry),
+				GET_MSG_FROM_TABLE_ENTRY(session_table_entry));
 	} else {
 		DA_LOG_CRITICAL(HTTPManager,"NOT paused!");
 	}
 
 	_da_thread_mutex_unlock (mutex);
 
+	if (invoke)
+		_pi_http_invoke(_pi_http_pause_on_loop, invoke);
 }
 
 void PI_http_unpause_transaction(int transaction_id)
 {
 	int session_table_entry = -1;
 	pthread_mutex_t* mutex;
-	pthread_cond_t* cond;
+	pi_invoke_t *invoke = DA_NULL;
 
 	/*	DA_LOG_FUNC_START(Default); */
 
@@ -361,19 +843,213 @@ void PI_http_unpause_transaction(int transaction_id)
 	if (!_pi_http_is_this_session_table_entry_using(session_table_entry))
 		return;
 
-	mutex = &(pi_session_table[session_table_entry].mutex);
-	cond = &(pi_session_table[session_table_entry].cond);
+	mutex = &(pi_session_table[session_table_entry]->mutex);
 
 	_da_thread_mutex_lock (mutex);
 
-	if (pi_session_table[session_table_entry].is_paused == DA_TRUE) {
+	if (pi_session_table[session_table_entry]->is_paused == DA_TRUE) {
 		DA_LOG_CRITICAL(HTTPManager,"wake up!");
-		pi_session_table[session_table_entry].is_paused = DA_FALSE;
-		_da_thread_cond_signal(cond);
+		invoke = _pi_http_new_invoke(session_table_entry,
+				GET_SESSION_FROM_TABLE_ENTRY(session_table_entry),
+				GET_MSG_FROM_TABLE_ENTRY(session_table_entry));
+		if (invoke) {
+			pi_session_table[session_table_entry]->is_paused = DA_FALSE;
+			invoke->queue = GET_QUEUE_FROM_TABLE_ENTRY(session_table_entry);
+		}
 	}
 
 	_da_thread_mutex_unlock (mutex);
 
+	/* Not to be run with the mutex locked, if it is called on loop thread */
+	if (invoke)
+		_pi_http_invoke(_pi_http_unpause_on_loop, invoke);
+}
+
+/* This should be called on loop thread */
+static void _pi_http_unref_probe(pi_probe_t *probe)
+{
+	int i = 0;
+	int ref_count = 0;
+
+	_da_thread_mutex_lock (&(probe->mutex));
+	ref_count = --(probe->ref_count);
+	_da_thread_mutex_unlock (&(probe->mutex));
+	if (ref_count > 0)
+		return;
+
+	for (i = 0; i < PI_MAX_PROBE_COUNT; i++) {
+		if (probe->msg[i])
+			g_object_unref(probe->msg[i]);
+	}
+	if (probe->session)
+		g_object_unref(probe->session);
+	if (probe->proxy_addr)
+		free(probe->proxy_addr);
+	pthread_mutex_destroy(&(probe->mutex));
+	pthread_cond_destroy(&(probe->cond));
+	free(probe);
+}
+
+static void _pi_http_probe_gotheaders_cb(SoupMessage *msg, gpointer data)
+{
+	pi_probe_t *probe = (pi_probe_t *)data;
+
+	if (SOUP_STATUS_IS_REDIRECTION(msg->status_code))
+		return;
+
+	soup_message_body_set_accumulate(msg->response_body, FALSE);
+	/* Do not receive whole content from the server which ignores range */
+	if (msg->status_code != SOUP_STATUS_PARTIAL_CONTENT) {
+		DA_LOG(HTTPManager,"probe msg[%p] status[%d]", msg, msg->status_code);
+		soup_session_cancel_message(probe->session, msg,
+				SOUP_STATUS_CANCELLED);
+	}
+}
+
+static void _pi_http_probe_finished_cb(SoupSession *session, SoupMessage *msg,
+		gpointer data)
+{
+	pi_probe_t *probe = (pi_probe_t *)data;
+	int i = 0;
+
+	_da_thread_mutex_lock (&(probe->mutex));
+	for (i = 0; i < PI_MAX_PROBE_COUNT; i++) {
+		if (probe->msg[i] != msg)
+			continue;
+		probe->is_finished[i] = DA_TRUE;
+		probe->pending_count--;
+		if (probe->fastest < 0 &&
+				msg->status_code == SOUP_STATUS_PARTIAL_CONTENT) {
+			DA_LOG(HTTPManager,"fastest probe [%d]", i);
+			probe->fastest = i;
+		}
+		break;
+	}
+	_da_thread_mutex_unlock (&(probe->mutex));
+
+	_da_thread_cond_signal(&(probe->cond));
+	_pi_http_unref_probe(probe);
+}
+
+static int _pi_http_probe_on_loop(gpointer data)
+{
+	pi_probe_t *probe = (pi_probe_t *)data;
+	int i = 0;
+
+	_pi_http_set_proxy_on_shared_session(probe->session, probe->proxy_addr);
+
+	for (i = 0; i < PI_MAX_PROBE_COUNT; i++) {
+		if (!probe->msg[i])
+			continue;
+		/* soup_session_queue_message() steals the reference */
+		soup_session_queue_message(probe->session,
+				g_object_ref(probe->msg[i]),
+				_pi_http_probe_finished_cb, probe);
+	}
+	return FALSE;
+}
+
+static int _pi_http_cancel_probe_on_loop(gpointer data)
+{
+	pi_probe_t *probe = (pi_probe_t *)data;
+	da_bool_t need_cancel = DA_FALSE;
+	int i = 0;
+
+	for (i = 0; i < PI_MAX_PROBE_COUNT; i++) {
+		_da_thread_mutex_lock (&(probe->mutex));
+		need_cancel = (probe->msg[i] && !probe->is_finished[i]);
+		_da_thread_mutex_unlock (&(probe->mutex));
+		if (need_cancel)
+			soup_session_cancel_message(probe->session, probe->msg[i],
+					SOUP_STATUS_CANCELLED);
+	}
+	/* Reference of caller */
+	_pi_http_unref_probe(probe);
+	return FALSE;
+}
+
+da_result_t PI_http_probe_transactions(http_msg_request_t **requests,
+		int count, char *proxy_addr, unsigned long timeout_msec,
+		int *out_index)
+{
+	pi_probe_t *probe = DA_NULL;
+	SoupMessage *msg = DA_NULL;
+	input_for_tranx_t input_for_tranx;
+	struct timespec ts;
+	int i = 0;
+
+	DA_LOG_FUNC_START(HTTPManager);
+
+	*out_index = -1;
+	if (!requests || count < 1 || count > PI_MAX_PROBE_COUNT)
+		return DA_ERR_INVALID_ARGUMENT;
+
+	probe = (pi_probe_t *)calloc(1, sizeof(pi_probe_t));
+	if (!probe) {
+		DA_LOG_ERR(HTTPManager,"DA_ERR_FAIL_TO_MEMALLOC");
+		return DA_ERR_FAIL_TO_MEMALLOC;
+	}
+	_da_thread_mutex_init(&(probe->mutex), DA_NULL);
+	_da_thread_cond_init(&(probe->cond), DA_NULL);
+	probe->fastest = -1;
+	probe->ref_count = 1;
+
+	probe->session = _pi_http_get_shared_session();
+	if (!probe->session) {
+		_pi_http_unref_probe(probe);
+		return DA_ERR_INVALID_URL;
+	}
+	if (proxy_addr)
+		probe->proxy_addr = strdup(proxy_addr);
+
+	memset(&input_for_tranx, 0x00, sizeof(input_for_tranx_t));
+	for (i = 0; i < count; i++) {
+		if (!requests[i] || !requests[i]->url)
+			continue;
+		msg = soup_message_new(METHOD_GET, requests[i]->url);
+		if (!msg) {
+			DA_LOG_ERR(HTTPManager,"invalid url [%s]", requests[i]->url);
+			continue;
+		}
+		input_for_tranx.http_msg_request = requests[i];
+		_fill_soup_msg_header(msg, &input_for_tranx);
+		soup_message_disable_feature(msg, SOUP_TYPE_CONTENT_SNIFFER);
+		g_signal_connect(msg, "got-headers",
+				G_CALLBACK(_pi_http_probe_gotheaders_cb), probe);
+		probe->msg[i] = msg;
+		probe->pending_count++;
+	}
+	if (probe->pending_count == 0) {
+		_pi_http_unref_probe(probe);
+		return DA_ERR_INVALID_URL;
+	}
+	probe->ref_count += probe->pending_count;
+
+	_pi_http_invoke(_pi_http_probe_on_loop, probe);
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += timeout_msec / 1000;
+	ts.tv_nsec += (timeout_msec % 1000) * 1000000;
+	if (ts.tv_nsec >= 1000000000) {
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000;
+	}
+
+	_da_thread_mutex_lock (&(probe->mutex));
+	while (probe->fastest < 0 && probe->pending_count > 0) {
+		if (pthread_cond_timedwait(&(probe->cond), &(probe->mutex),
+				&ts) == ETIMEDOUT)
+			break;
+	}
+	*out_index = probe->fastest;
+	_da_thread_mutex_unlock (&(probe->mutex));
+
+	DA_LOG(HTTPManager,"probe result [%d]", *out_index);
+
+	/* The others are not needed any more */
+	_pi_http_invoke(_pi_http_cancel_probe_on_loop, probe);
+
+	return DA_RESULT_OK;
 }
 
 da_bool_t _pi_http_is_valid_input_for_tranx(
@@ -404,7 +1080,7 @@ da_bool_t _pi_http_is_this_session_table_entry_using(
 
 	_da_thread_mutex_lock (&mutex_for_session_table);
 
-	is_using = pi_session_table[in_session_table_entry].is_using;
+	is_using = pi_session_table[in_session_table_entry]->is_using;
 
 	_da_thread_mutex_unlock (&mutex_for_session_table);
 
@@ -420,14 +1096,24 @@ void _pi_http_init_session_table_entry(const int in_session_table_entry)
 
 //	_da_thread_mutex_lock (&mutex_for_session_table);
 
-	pi_session_table[entry].is_using = DA_TRUE;
-	pi_session_table[entry].msg = NULL;
-	pi_session_table[entry].session = NULL;
-	pi_session_table[entry].queue = NULL;
-
-	_da_thread_mutex_init(&(pi_session_table[entry].mutex), DA_NULL);
-	_da_thread_cond_init(&(pi_session_table[entry].cond), NULL);
-	pi_session_table[entry].is_paused = DA_FALSE;
+	pi_session_table[entry]->is_using = DA_TRUE;
+	pi_session_table[entry]->msg = NULL;
+	pi_session_table[entry]->session = NULL;
+	pi_session_table[entry]->queue = NULL;
+
+	pi_session_table[entry]->is_paused = DA_FALSE;
+	pi_session_table[entry]->is_cancelled = DA_FALSE;
+	pi_session_table[entry]->pending_event = DA_NULL;
+	pi_session_table[entry]->pending_final_event = DA_NULL;
+
+	pi_session_table[entry]->low_speed_limit = 0;
+	pi_session_table[entry]->low_speed_time = 0;
+	pi_session_table[entry]->low_speed_bytes = 0;
+	pi_session_table[entry]->low_speed_msec = 0;
+	pi_session_table[entry]->was_paused = DA_FALSE;
+	pi_session_table[entry]->is_started = DA_FALSE;
+	pi_session_table[entry]->is_finished = DA_FALSE;
+	pi_session_table[entry]->is_stalled = DA_FALSE;
 
 //	_da_thread_mutex_unlock (&mutex_for_session_table);
 
@@ -437,70 +1123,107 @@ void _pi_http_init_session_table_entry(const int in_session_table_entry)
 void _pi_http_destroy_session_table_entry(const int in_session_table_entry)
 {
 	int entry = in_session_table_entry;
+	q_event_t *pending_event = DA_NULL;
+	q_event_t *next_event = DA_NULL;
+	q_event_t *pending_final_event = DA_NULL;
+	pi_invoke_t *invoke = DA_NULL;
 
 	if (DA_FALSE == IS_VALID_SESSION_TABLE_ENTRY(entry))
 		return;
 
 	_da_thread_mutex_lock (&mutex_for_session_table);
 
-	if (pi_session_table[entry].is_paused == DA_TRUE)
-		PI_http_unpause_transaction(entry);
-
-	/* Warning! Do not g_object_unref(msg) here!
-	 * soup_session_queue_message() steals msg's reference count,
-	 * so, we don't need to do anything for memory management.
-	 *
-	 * But, if using soup_session_send_message(), MUST call g_object_unref(msg). */
-	/* if (pi_session_table[entry].msg)
-		g_object_unref(pi_session_table[entry].msg); */
-
-	pi_session_table[entry].msg = NULL;
-
-	/* FIXME Cannot g_object_unref(session) here,
-	 * because msg inside this session is not destoryed yet.
-	 * The msg's reference count is stealed by soup_session_queue_message(),
-	 * and it will be destroyed when _pi_http_finished_cb() is returned.
-	 * For now, this _pi_http_destroy_session_table_entry() is called inside
-	 * _pi_http_finished_cb(), so, g_object_unref(session) is not working.
-	 * Should find out call this function after _pi_http_finished_cb(). */
-	if (pi_session_table[entry].session)
-		g_object_unref(pi_session_table[entry].session);
+	_da_thread_mutex_lock (&(pi_session_table[entry]->mutex));
+	pending_event = pi_session_table[entry]->pending_event;
+	pi_session_table[entry]->pending_event = DA_NULL;
+	pending_final_event = pi_session_table[entry]->pending_final_event;
+	pi_session_table[entry]->pending_final_event = DA_NULL;
+	/* Nobody will unpause it any more. Finish it not to keep the connection.
+	 * If the final event is kept, it is finished already */
+	if (pi_session_table[entry]->is_paused == DA_TRUE &&
+			pi_session_table[entry]->is_cancelled == DA_FALSE &&
+			!pending_final_event &&
+			pi_session_table[entry]->session && pi_session_table[entry]->msg)
+		invoke = _pi_http_new_invoke(entry, pi_session_table[entry]->session,
+				pi_session_table[entry]->msg);
+	_da_thread_mutex_unlock (&(pi_session_table[entry]->mutex));
+
+	while (pending_event) {
+		next_event = pending_event->next;
+		Q_destroy_q_event(&pending_event);
+		pending_event = next_event;
+	}
+	if (pending_final_event)
+		Q_destroy_q_event(&pending_final_event);
+	if (invoke)
+		_pi_http_invoke(_pi_http_cancel_on_loop, invoke);
+
+	/* soup_session_queue_message() steals the reference which is taken for it,
+	 * so this only drops the reference of table entry. */
+	if (pi_session_table[entry]->msg)
+		g_object_unref(pi_session_table[entry]->msg);
+
+	pi_session_table[entry]->msg = NULL;
+
+	/* The session is shared by all transactions.
+	 * This only drops the reference which is taken by PI_http_start_transaction(),
+	 * so, the session and its idle connections are alive for next transaction. */
+	if (pi_session_table[entry]->session)
+		g_object_unref(pi_session_table[entry]->session);
 	else
 		DA_LOG_ERR(HTTPManager,"session is NULL. Cannot unref this.");
-	DA_LOG(HTTPManager,"unref session [%p]",pi_session_table[entry].session);
+	DA_LOG(HTTPManager,"unref session [%p]",pi_session_table[entry]->session);
 
-	pi_session_table[entry].session = NULL;
+	pi_session_table[entry]->session = NULL;
 
-	pi_session_table[entry].queue = NULL;
-	pi_session_table[entry].is_paused = DA_FALSE;
-	pi_session_table[entry].is_using = DA_FALSE;
-
-	_da_thread_mutex_destroy(&(pi_session_table[entry].mutex));
-	_da_thread_cond_destroy(&(pi_session_table[entry].cond));
+	pi_session_table[entry]->queue = NULL;
+	pi_session_table[entry]->is_paused = DA_FALSE;
+	pi_session_table[entry]->is_cancelled = DA_FALSE;
+	pi_session_table[entry]->is_using = DA_FALSE;
 
 	_da_thread_mutex_unlock (&mutex_for_session_table);
 
 	return;
 }
 
-int _pi_http_get_avaiable_session_table_entry(void)
+int _pi_http_get_avaiable_session_table_entry(da_bool_t is_extra)
 {
 	int i;
 	int avaiable_entry = -1;
+	int using_count = 0;
+	int max_count = 0;
+	pi_session_table_t *entry = DA_NULL;
 
 	_da_thread_mutex_lock (&mutex_for_session_table);
 
-	for (i = 0; i < MAX_SESSION_COUNT; i++) {
-		if (pi_session_table[i].is_using == DA_FALSE) {
-			/*	pi_session_table[i].is_using = DA_TRUE; */
-			DA_LOG(HTTPManager,"available entry = %d", i);
-
-			avaiable_entry = i;
-
-			break;
+	/* Downloads and extra transactions have their own limits */
+	max_count = is_extra ? MAX_EXTRA_SESSION_COUNT : pi_max_session_count;
+	for (i = 0; i < pi_session_table_count; i++) {
+		if (pi_session_table[i]->is_using == DA_FALSE) {
+			if (avaiable_entry < 0)
+				avaiable_entry = i;
+		} else if (pi_session_table[i]->is_extra == is_extra) {
+			using_count++;
+		}
+	}
+	if (using_count >= max_count) {
+		DA_LOG_ERR(HTTPManager,"no more entry. extra[%d] using[%d]",
+				is_extra, using_count);
+		avaiable_entry = -1;
+	} else if (avaiable_entry < 0 &&
+			pi_session_table_count < MAX_SESSION_TABLE_SIZE) {
+		entry = (pi_session_table_t *)calloc(1, sizeof(pi_session_table_t));
+		if (entry) {
+			_da_thread_mutex_init(&(entry->mutex), DA_NULL);
+			avaiable_entry = pi_session_table_count;
+			pi_session_table[pi_session_table_count++] = entry;
 		}
 	}
-	_pi_http_init_session_table_entry(avaiable_entry);
+	if (avaiable_entry >= 0) {
+		DA_LOG(HTTPManager,"available entry = %d", avaiable_entry);
+		_pi_http_init_session_table_entry(avaiable_entry);
+		pi_session_table[avaiable_entry]->is_extra = is_extra;
+	}
 	_da_thread_mutex_unlock (&mutex_for_session_table);
 
 	return avaiable_entry;
@@ -520,12 +1243,12 @@ da_bool_t _pi_http_register_queue_to_session_table(
 
 	_da_thread_mutex_lock (&mutex_for_session_table);
 
-	if (pi_session_table[entry].is_using == DA_FALSE) {
+	if (pi_session_table[entry]->is_using == DA_FALSE) {
 		DA_LOG_ERR(HTTPManager,"this entry [%d] is not using", entry);
 		ret = DA_FALSE;
 	} else {
-		pi_session_table[entry].queue = queue;
-		DA_LOG(HTTPManager,"queue = %p", pi_session_table[entry].queue);
+		pi_session_table[entry]->queue = queue;
+		DA_LOG(HTTPManager,"queue = %p", pi_session_table[entry]->queue);
 		ret = DA_TRUE;
 	}
 
@@ -552,10 +1275,10 @@ da_bool_t _pi_http_register_session_to_session_table(
 
 	_da_thread_mutex_lock (&mutex_for_session_table);
 
-	if (pi_session_table[entry].is_using == DA_FALSE) {
+	if (pi_session_table[entry]->is_using == DA_FALSE) {
 		ret = DA_FALSE;
 	} else {
-		pi_session_table[entry].session = session;
+		pi_session_table[entry]->session = session;
 		ret = DA_TRUE;
 	}
 
@@ -582,10 +1305,10 @@ da_bool_t _pi_http_register_msg_to_session_table(
 
 	_da_thread_mutex_lock (&mutex_for_session_table);
 
-	if (pi_session_table[entry].is_using == DA_FALSE) {
+	if (pi_session_table[entry]->is_using == DA_FALSE) {
 		ret = DA_FALSE;
 	} else {
-		pi_session_table[entry].msg = msg;
+		pi_session_table[entry]->msg = msg;
 		ret = DA_TRUE;
 	}
 
@@ -607,7 +1330,7 @@ queue_t *_pi_http_get_queue_from_session_table_entry(
 
 	_da_thread_mutex_lock (&mutex_for_session_table);
 
-	out_queue = pi_session_table[entry].queue;
+	out_queue = pi_session_table[entry]->queue;
 	_da_thread_mutex_unlock (&mutex_for_session_table);
 
 	return out_queue;
@@ -680,7 +1403,9 @@ void _pi_http_store_read_header_to_queue(SoupMessage *msg, const char *sniffedTy
 		da_event->type.q_event_data_http.http_response_msg
 				= http_msg_response;
 
-		Q_push_event(da_queue, da_event);
+		/* It is kept with the following packets if the queue is full */
+		_pi_http_push_or_pause(session_table_entry, msg, da_queue,
+				da_event);
 	}
 	return;
 
@@ -691,11 +1416,12 @@ ERR:
 	return;
 }
 
+/* If body_block is given, its reference is taken by this,
+ * and body_data is passed without copying */
 void _pi_http_store_read_data_to_queue(SoupMessage *msg, const char* body_data,
-		int received_body_len)
+		int received_body_len, void *body_block)
 {
 	da_result_t ret = DA_RESULT_OK;
-	da_bool_t b_ret = DA_FALSE;
 
 	char *body_buffer = NULL;
 	queue_t *da_queue = NULL;
@@ -721,7 +1447,9 @@ void _pi_http_store_read_data_to_queue(SoupMessage *msg, const char* body_data,
 		da_event_type_data = Q_EVENT_TYPE_DATA_FINAL;
 	} else {
 		da_event_type_data = Q_EVENT_TYPE_DATA_PACKET;
-		if (received_body_len > 0) {
+		if (body_block) {
+			body_buffer = (char *)body_data;
+		} else if (received_body_len > 0) {
 			body_buffer = (char*) calloc(1, received_body_len);
 			DA_LOG(HTTPManager,"body_buffer[%p]msg[%p]",body_buffer,msg);
 			if (body_buffer == DA_NULL) {
@@ -735,6 +1463,11 @@ void _pi_http_store_read_data_to_queue(SoupMessage *msg, const char* body_data,
 	da_queue = _pi_http_get_queue_from_session_table_entry(
 			session_table_entry);
 
+	/* for watchdog. Both are run on loop thread */
+	if (received_body_len > 0)
+		pi_session_table[session_table_entry]->low_speed_bytes +=
+			received_body_len;
+
 	ret = Q_make_http_data_event(da_event_type_data, &da_event);
 	if (ret != DA_RESULT_OK) {
 		DA_LOG_ERR(HTTPManager,"fail to make da_event");
@@ -743,48 +1476,29 @@ void _pi_http_store_read_data_to_queue(SoupMessage *msg, const char* body_data,
 		Q_set_status_code_on_http_data_event(da_event, http_status);
 		Q_set_http_body_on_http_data_event(da_event, received_body_len,
 				body_buffer);
-
-		_da_thread_mutex_lock (&(da_queue->mutex_queue));
-		b_ret = Q_push_event_without_lock(da_queue, da_event);
-		if (b_ret == DA_FALSE) {
-			DA_LOG_CRITICAL(HTTPManager,"----------------------------------------fail to push!");
-
-			pthread_mutex_t *session_mutex = NULL;
-			pthread_cond_t *session_cond = NULL;
-
-			session_mutex
-					= &(pi_session_table[session_table_entry].mutex);
-			session_cond
-					= &(pi_session_table[session_table_entry].cond);
-
-			/*  MUST keep this order for these mutexes */
-			_da_thread_mutex_lock (session_mutex);
-			_da_thread_mutex_unlock (&(da_queue->mutex_queue));
-
-			if (pi_session_table[session_table_entry].is_paused
-					== DA_FALSE) {
-				DA_LOG_CRITICAL(HTTPManager,"paused!");
-				pi_session_table[session_table_entry].is_paused
-						= DA_TRUE;
-				_da_thread_cond_wait(session_cond, session_mutex);
-			} else {
-				DA_LOG_CRITICAL(HTTPManager,"NOT paused!");
-			}
-
-			_da_thread_mutex_unlock (session_mutex);
-
-			DA_LOG_CRITICAL(HTTPManager,"wake up! push again");
-			Q_push_event(da_queue, da_event);
-		} else {
-			_da_thread_mutex_unlock (&(da_queue->mutex_queue));
+		if (body_block) {
+			/* The watermarks are for the memory. Whole block is counted */
+			Q_set_http_body_owner_on_http_data_event(da_event, body_block,
+					(int)((pi_body_block_t *)body_block)->size,
+					_pi_http_unref_body_block);
+			body_block = DA_NULL;
 		}
 
+		/* The final one comes from finished-cb. Its msg is not paused */
+		if (da_event_type_data == Q_EVENT_TYPE_DATA_FINAL)
+			_pi_http_push_final_event(session_table_entry, da_queue,
+					da_event);
+		else
+			_pi_http_push_or_pause(session_table_entry, msg, da_queue,
+					da_event);
 	}
 
 	return;
 
 ERR:
-	if (DA_RESULT_OK != ret) {
+	if (body_block) {
+		_pi_http_unref_body_block(body_block);
+	} else if (DA_RESULT_OK != ret) {
 		if (DA_NULL != body_buffer) {
 			free(body_buffer);
 		}
@@ -793,6 +1507,93 @@ ERR:
 	return;
 }
 
+/* This is called on loop thread. It should not be blocked even if the queue is full.
+ * In this case, the event is kept by the table entry and reading of the msg is paused,
+ * until the queue is drained to the low watermark and PI_http_unpause_transaction() is called. */
+static da_bool_t _pi_http_push_or_pause(int session_table_entry,
+		SoupMessage *msg, queue_t *da_queue, q_event_t *da_event)
+{
+	da_bool_t b_ret = DA_FALSE;
+	pi_session_table_t *table_entry = pi_session_table[session_table_entry];
+
+	/* Lock free for the most of the packets. pending_event is set only on
+	 * loop thread, so it is not set while this is checking it */
+	if (!table_entry->pending_event &&
+			Q_push_event(da_queue, da_event) == DA_TRUE)
+		return DA_TRUE;
+
+	/* Try again with mutex_queue. If the consumer drained the queue before this,
+	 * the push succeeds. Otherwise, it checks the queue after the table entry is paused.
+	 * The kept events go first, e.g. a header which comes after the restart
+	 * while the msg is not paused */
+	_da_thread_mutex_lock (&(da_queue->mutex_queue));
+	/*  MUST keep this order for these mutexes,
+	 * not to miss the unpause request which is sent when the queue is drained */
+	_da_thread_mutex_lock (&(table_entry->mutex));
+	if (!table_entry->pending_event)
+		b_ret = Q_push_event_without_lock(da_queue, da_event);
+	_da_thread_mutex_unlock (&(da_queue->mutex_queue));
+	if (b_ret == DA_FALSE) {
+		DA_LOG_CRITICAL(HTTPManager,"----------------------------------------fail to push!");
+		DA_LOG_CRITICAL(HTTPManager,"paused!");
+		_pi_http_keep_pending_event(table_entry, da_event);
+		table_entry->is_paused = DA_TRUE;
+		table_entry->was_paused = DA_TRUE;
+	}
+	_da_thread_mutex_unlock (&(table_entry->mutex));
+
+	/* Even if it is unpaused already, that is run after this on loop thread.
+	 * Finished one is not paused. Its final event is kept until this is pushed */
+	if (b_ret == DA_FALSE && DA_FALSE == table_entry->is_finished)
+		soup_session_pause_message(table_entry->session, msg);
+
+	return b_ret;
+}
+
+/* This is called with the mutex of table entry.
+ * da_event may be a list, and it is linked after the kept ones */
+static void _pi_http_keep_pending_event(pi_session_table_t *table_entry,
+		q_event_t *da_event)
+{
+	q_event_t *cur = table_entry->pending_event;
+
+	if (!cur) {
+		table_entry->pending_event = da_event;
+		return;
+	}
+	while (cur->next)
+		cur = cur->next;
+	cur->next = da_event;
+}
+
+/* This is called on loop thread for the final or abort event, after the msg is finished.
+ * The event is never dropped. It is pushed after the pending event, if there is one.
+ * If the ring is full, it is kept by the table entry until the queue is drained,
+ * and PI_http_unpause_transaction() pushes it. The msg is not paused for both */
+static void _pi_http_push_final_event(int session_table_entry,
+		queue_t *da_queue, q_event_t *da_event)
+{
+	pi_session_table_t *table_entry = pi_session_table[session_table_entry];
+
+	_da_thread_mutex_lock (&(da_queue->mutex_queue));
+	/*  MUST keep this order for these mutexes, as _pi_http_push_or_pause() */
+	_da_thread_mutex_lock (&(table_entry->mutex));
+	if (!table_entry->pending_event &&
+			Q_push_event_without_lock(da_queue, da_event) == DA_TRUE) {
+		_da_thread_mutex_unlock (&(table_entry->mutex));
+		_da_thread_mutex_unlock (&(da_queue->mutex_queue));
+		return;
+	}
+
+	DA_LOG_CRITICAL(HTTPManager,"keep the final event until the queue is drained");
+	table_entry->pending_final_event = da_event;
+	table_entry->is_paused = DA_TRUE;
+	/* Let the consumer unpause it when the queue is drained */
+	da_queue->is_over_high_watermark = 1;
+	_da_thread_mutex_unlock (&(table_entry->mutex));
+	_da_thread_mutex_unlock (&(da_queue->mutex_queue));
+}
+
 int _translate_error_code(int soup_error)
 {
 	switch (soup_error) {
@@ -814,12 +1615,30 @@ int _translate_error_code(int soup_error)
 	}
 }
 
+/* The error which may be gone if it is tried again after a while */
+da_bool_t _pi_http_is_transient_error(int soup_error)
+{
+	switch (soup_error) {
+	case SOUP_STATUS_CANT_RESOLVE:
+	case SOUP_STATUS_CANT_RESOLVE_PROXY:
+	case SOUP_STATUS_CANT_CONNECT:
+	case SOUP_STATUS_CANT_CONNECT_PROXY:
+	case SOUP_STATUS_IO_ERROR:
+	case SOUP_STATUS_TRY_AGAIN:
+		return DA_TRUE;
+
+	default:
+		return DA_FALSE;
+	}
+}
+
 void _pi_http_store_neterr_to_queue(SoupMessage *msg)
 {
 	da_result_t ret = DA_RESULT_OK;
 	int error_type = -1;
 	queue_t *da_queue = NULL;
 	q_event_t *da_event = NULL;
+	q_event_t *control_event = NULL;
 	int session_table_entry = -1;
 
 	DA_LOG_FUNC_START(HTTPManager);
@@ -837,6 +1656,19 @@ void _pi_http_store_neterr_to_queue(SoupMessage *msg)
 	da_queue = _pi_http_get_queue_from_session_table_entry(
 			session_table_entry);
 
+	/* Cancelled by watchdog */
+	if (pi_session_table[session_table_entry]->is_stalled)
+		error_type = DA_ERR_HTTP_TIMEOUT;
+
+	/* Let the receiver know that the abort can be retried.
+	 * Control event is popped before the data event. */
+	if (_pi_http_is_transient_error(msg->status_code) &&
+			Q_make_control_event(Q_EVENT_TYPE_CONTROL_NET_DISCONNECTED,
+			&control_event) == DA_RESULT_OK) {
+		DA_LOG_CRITICAL(HTTPManager,"Q_EVENT_TYPE_CONTROL_NET_DISCONNECTED");
+		Q_push_event(da_queue, control_event);
+	}
+
 	DA_LOG_CRITICAL(HTTPManager,"Q_EVENT_TYPE_DATA_ABORT");
 	ret = Q_make_http_data_event(Q_EVENT_TYPE_DATA_ABORT, &da_event);
 	if (ret != DA_RESULT_OK) {
@@ -845,13 +1677,89 @@ void _pi_http_store_neterr_to_queue(SoupMessage *msg)
 	} else {
 		Q_set_error_type_on_http_data_event(da_event, error_type);
 
-		Q_push_event(da_queue, da_event);
+		_pi_http_push_final_event(session_table_entry, da_queue,
+				da_event);
 	}
 
 ERR:
 	return;
 }
 
+/* This is called on loop thread every WATCHDOG_INTERVAL_MSEC.
+ * A transaction is stalled if its average speed stays under the limit for the time.
+ * The time while it is paused by flow control or rate limit is not counted,
+ * nor the time before its request is written, e.g. waiting for a connection
+ * under the limit of connections per host.
+ * Stalled one is cancelled with transport error, so it is retried like disconnection. */
+gboolean _pi_http_watchdog_cb(gpointer data)
+{
+	pi_session_table_t *table_entry = DA_NULL;
+	pi_invoke_t *stalled[MAX_SESSION_TABLE_SIZE] = {DA_NULL,};
+	int stalled_count = 0;
+	unsigned long limit = 0;
+	unsigned long time_msec = 0;
+	da_bool_t is_paused = DA_FALSE;
+	int i = 0;
+
+	_da_thread_mutex_lock (&mutex_for_session_table);
+	for (i = 0; i < pi_session_table_count; i++) {
+		table_entry = pi_session_table[i];
+		if (table_entry->is_using == DA_FALSE || !table_entry->msg ||
+				!table_entry->session || !table_entry->is_started ||
+				table_entry->is_finished || table_entry->is_stalled)
+			continue;
+
+		_da_thread_mutex_lock (&(table_entry->mutex));
+		is_paused = (table_entry->is_paused || table_entry->was_paused ||
+				table_entry->is_cancelled);
+		table_entry->was_paused = DA_FALSE;
+		_da_thread_mutex_unlock (&(table_entry->mutex));
+
+		if (is_paused) {
+			table_entry->low_speed_bytes = 0;
+			table_entry->low_speed_msec = 0;
+			continue;
+		}
+
+		if (table_entry->low_speed_time > 0) {
+			limit = table_entry->low_speed_limit;
+			time_msec = table_entry->low_speed_time * 1000;
+		} else {
+			limit = 0;
+			time_msec = MAX_TIMEOUT * 1000;
+		}
+		table_entry->low_speed_msec += WATCHDOG_INTERVAL_MSEC;
+		if (table_entry->low_speed_bytes > 0 &&
+				table_entry->low_speed_bytes * 1000 >=
+				(unsigned long long)limit * table_entry->low_speed_msec) {
+			table_entry->low_speed_bytes = 0;
+			table_entry->low_speed_msec = 0;
+			continue;
+		}
+		if (table_entry->low_speed_msec < time_msec)
+			continue;
+
+		DA_LOG_ERR(HTTPManager,"stalled! entry[%d] [%llu]bytes in [%lu]msec",
+				i, table_entry->low_speed_bytes, table_entry->low_speed_msec);
+		table_entry->is_stalled = DA_TRUE;
+		if (stalled_count < MAX_SESSION_TABLE_SIZE)
+			stalled[stalled_count++] = _pi_http_new_invoke(i,
+					table_entry->session, table_entry->msg);
+	}
+	_da_thread_mutex_unlock (&mutex_for_session_table);
+
+	/* Finished callback may be called in this, and it takes the mutex */
+	for (i = 0; i < stalled_count; i++) {
+		if (!stalled[i])
+			continue;
+		soup_session_cancel_message(stalled[i]->session, stalled[i]->msg,
+				SOUP_STATUS_IO_ERROR);
+		_pi_http_free_invoke(stalled[i]);
+	}
+
+	return TRUE;
+}
+
 int _pi_http_get_session_table_entry_from_message(SoupMessage *msg)
 {
 
@@ -865,9 +1773,9 @@ int _pi_http_get_session_table_entry_from_message(SoupMessage *msg)
 
 	_da_thread_mutex_lock (&mutex_for_session_table);
 
-	for (i = 0; i < MAX_SESSION_COUNT; i++) {
-		if (pi_session_table[i].is_using == DA_TRUE) {
-			if (pi_session_table[i].msg == msg) {
+	for (i = 0; i < pi_session_table_count; i++) {
+		if (pi_session_table[i]->is_using == DA_TRUE) {
+			if (pi_session_table[i]->msg == msg) {
 				out_entry = i;
 				break;
 			}
@@ -876,7 +1784,7 @@ int _pi_http_get_session_table_entry_from_message(SoupMessage *msg)
 
 	_da_thread_mutex_unlock (&mutex_for_session_table);
 
-	if (i == MAX_SESSION_COUNT) {
+	if (out_entry < 0) {
 		DA_LOG_ERR(HTTPManager,"fail to find message = %p", msg);
 	}
 
@@ -887,9 +1795,15 @@ int _pi_http_get_session_table_entry_from_message(SoupMessage *msg)
 void _pi_http_finished_cb(SoupSession *session, SoupMessage *msg, gpointer data)
 {
 	char *url = NULL;
+	int session_table_entry = -1;
 
 	DA_LOG_FUNC_START(HTTPManager);
 
+	/* Not to be cancelled by watchdog any more */
+	session_table_entry = _pi_http_get_session_table_entry_from_message(msg);
+	if (session_table_entry >= 0)
+		pi_session_table[session_table_entry]->is_finished = DA_TRUE;
+
 	url = soup_uri_to_string(soup_message_get_uri(msg), DA_FALSE);
 
 	DA_LOG(HTTPManager,"status_code[%d], reason[%s], url[%s]",msg->status_code,msg->reason_phrase,url);
@@ -901,12 +1815,12 @@ void _pi_http_finished_cb(SoupSession *session, SoupMessage *msg, gpointer data)
 
 	if (SOUP_STATUS_IS_TRANSPORT_ERROR(msg->status_code)) {
 		if (msg->status_code == SOUP_STATUS_CANCELLED) {
-			_pi_http_store_read_data_to_queue(msg, DA_NULL, 0);
+			_pi_http_store_read_data_to_queue(msg, DA_NULL, 0, DA_NULL);
 		} else {
 			_pi_http_store_neterr_to_queue(msg);
 		}
 	} else {
-		_pi_http_store_read_data_to_queue(msg, DA_NULL, 0);
+		_pi_http_store_read_data_to_queue(msg, DA_NULL, 0, DA_NULL);
 	}
 
 }
@@ -915,9 +1829,29 @@ void _pi_http_finished_cb(SoupSession *session, SoupMessage *msg, gpointer data)
 void _pi_http_restarted_cb(SoupMessage *msg, gpointer data)
 {
 	DA_LOG_FUNC_START(HTTPManager);
+	int session_table_entry = -1;
+
 	/* Location URL is needed when extracting the file name from url.
 	 * So, the response header should be handled by http mgr.*/
 	_pi_http_store_read_header_to_queue(msg, NULL);
+
+	/* The msg is queued again, and may wait for a connection */
+	session_table_entry = _pi_http_get_session_table_entry_from_message(msg);
+	if (session_table_entry >= 0)
+		pi_session_table[session_table_entry]->is_started = DA_FALSE;
+}
+
+/* Low speed window of watchdog starts from here */
+void _pi_http_wroteheaders_cb(SoupMessage *msg, gpointer data)
+{
+	int session_table_entry = -1;
+
+	session_table_entry = _pi_http_get_session_table_entry_from_message(msg);
+	if (session_table_entry < 0)
+		return;
+	pi_session_table[session_table_entry]->low_speed_bytes = 0;
+	pi_session_table[session_table_entry]->low_speed_msec = 0;
+	pi_session_table[session_table_entry]->is_started = DA_TRUE;
 }
 
 void _pi_http_gotheaders_cb(SoupMessage *msg, gpointer data)
@@ -953,16 +1887,73 @@ void _pi_http_contentsniffed_cb(SoupMessage *msg, const char *sniffedType,
 		_pi_http_store_read_header_to_queue(msg, sniffedType);
 }
 
+static void _pi_http_unref_body_block(void *data)
+{
+	pi_body_block_t *block = (pi_body_block_t *)data;
+
+	/* This can be called on download thread, too */
+	if (block && __sync_sub_and_fetch(&(block->ref_count), 1) == 0)
+		free(block);
+}
+
+static void _pi_http_destroy_chunk_allocator(gpointer data)
+{
+	pi_chunk_allocator_t *allocator = (pi_chunk_allocator_t *)data;
+
+	if (!allocator)
+		return;
+	_pi_http_unref_body_block(allocator->last_block);
+	free(allocator);
+}
+
+/* This is called on loop thread before the body is read from socket */
+static SoupBuffer *_pi_http_chunk_allocator_cb(SoupMessage *msg, gsize max_len,
+		gpointer data)
+{
+	pi_chunk_allocator_t *allocator = (pi_chunk_allocator_t *)data;
+	pi_body_block_t *block = DA_NULL;
+	gsize size = PI_BODY_BLOCK_SIZE;
+
+	if (max_len > 0 && max_len < size)
+		size = max_len;
+
+	/* The last one did not reach got-chunk. e.g. it is decoded or sniffed */
+	_pi_http_unref_body_block(allocator->last_block);
+	allocator->last_block = DA_NULL;
+
+	block = (pi_body_block_t *)malloc(sizeof(pi_body_block_t) + size);
+	if (!block) {
+		/* NULL pauses the message. Let it be copied at got-chunk */
+		return soup_buffer_new(SOUP_MEMORY_TAKE, g_malloc(size), size);
+	}
+	/* One for libsoup, and one for got-chunk */
+	block->ref_count = 2;
+	block->size = size;
+	allocator->last_block = block;
+
+	return soup_buffer_new_with_owner(PI_BODY_BLOCK_DATA(block), size,
+			block, _pi_http_unref_body_block);
+}
+
 void _pi_http_gotchunk_cb(SoupMessage *msg, SoupBuffer *chunk, gpointer data)
 {
+	pi_chunk_allocator_t *allocator = (pi_chunk_allocator_t *)data;
+	pi_body_block_t *block = DA_NULL;
+
 	DA_LOG_FUNC_START(HTTPManager);
 
 	if (SOUP_STATUS_IS_REDIRECTION(msg->status_code))
 		return;
 
 	if (chunk->data && chunk->length > 0) {
+		/* The chunk is read into our block. Pass it without copying */
+		if (allocator && allocator->last_block &&
+				chunk->data == PI_BODY_BLOCK_DATA(allocator->last_block)) {
+			block = allocator->last_block;
+			allocator->last_block = DA_NULL;
+		}
 		_pi_http_store_read_data_to_queue(msg, chunk->data,
-				chunk->length);
+				chunk->length, block);
 	}
 }
 
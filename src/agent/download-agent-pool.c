@@ -0,0 +1,309 @@
+/*
+ * Download Agent
+ *
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Jungki Kwak <jungki.kwak@samsung.com>, Keunsoon Lee <keunsoon.lee@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file		download-agent-pool.c
+ * @brief		functions for pools of small objects
+ ***/
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "download-agent-debug.h"
+#include "download-agent-pthread.h"
+#include "download-agent-pool.h"
+#include "download-agent-http-queue.h"
+#include "download-agent-client-mgr.h"
+#include "download-agent-http-msg-handler.h"
+
+/* Free object keeps the next one on its first bytes */
+typedef struct _pool_object_t pool_object_t;
+struct _pool_object_t {
+	pool_object_t *next;
+};
+
+typedef struct _pool_t {
+	const char *name;
+	size_t object_size;
+	int preallocate_count;
+	pthread_mutex_t mutex;
+	pool_object_t *depot;
+	int depot_count;
+	unsigned long hit_count;
+	unsigned long miss_count;
+} pool_t;
+
+/* Used only by the thread which owns it */
+typedef struct _pool_local_t {
+	pool_object_t *head[DA_POOL_TYPE_COUNT];
+	int count[DA_POOL_TYPE_COUNT];
+	unsigned long hit_count[DA_POOL_TYPE_COUNT];
+	unsigned long miss_count[DA_POOL_TYPE_COUNT];
+} pool_local_t;
+
+/* 0 preallocate_count means that the objects are allocated when they are needed */
+static pool_t pools[DA_POOL_TYPE_COUNT] = {
+	{"q_event", sizeof(q_event_t), 64, PTHREAD_MUTEX_INITIALIZER, DA_NULL, 0, 0, 0},
+	{"client_noti", sizeof(client_noti_t), 16, PTHREAD_MUTEX_INITIALIZER, DA_NULL, 0, 0, 0},
+	{"http_header", sizeof(http_header_t), 32, PTHREAD_MUTEX_INITIALIZER, DA_NULL, 0, 0, 0},
+};
+
+static pthread_key_t pool_local_key;
+static pthread_once_t pool_local_key_once = PTHREAD_ONCE_INIT;
+static da_bool_t is_pool_local_key_created = DA_FALSE;
+
+static void __create_local_key(void);
+static void __destroy_local(void *data);
+static pool_local_t *__get_local(void);
+static void __flush_local_stat(pool_t *pool, pool_local_t *local, int type);
+static void __give_back_to_depot(pool_t *pool, pool_local_t *local, int type,
+		int count);
+
+static void __create_local_key(void)
+{
+	if (pthread_key_create(&pool_local_key, __destroy_local) == 0)
+		is_pool_local_key_created = DA_TRUE;
+	else
+		DA_LOG_ERR(Default, "fail to create key");
+}
+
+/* Called when the thread exits */
+static void __destroy_local(void *data)
+{
+	pool_local_t *local = (pool_local_t *)data;
+	int type = 0;
+
+	if (!local)
+		return;
+
+	for (type = 0; type < DA_POOL_TYPE_COUNT; type++) {
+		_da_thread_mutex_lock(&(pools[type].mutex));
+		__give_back_to_depot(&pools[type], local, type, local->count[type]);
+		__flush_local_stat(&pools[type], local, type);
+		_da_thread_mutex_unlock(&(pools[type].mutex));
+	}
+	free(local);
+}
+
+/* NULL if the thread can not have its own objects. Then the depot is used directly */
+static pool_local_t *__get_local(void)
+{
+	pool_local_t *local = DA_NULL;
+
+	pthread_once(&pool_local_key_once, __create_local_key);
+	if (DA_FALSE == is_pool_local_key_created)
+		return DA_NULL;
+
+	local = (pool_local_t *)pthread_getspecific(pool_local_key);
+	if (!local) {
+		local = (pool_local_t *)calloc(1, sizeof(pool_local_t));
+		if (local && pthread_setspecific(pool_local_key, local) != 0) {
+			free(local);
+			local = DA_NULL;
+		}
+	}
+	return local;
+}
+
+/* Should be called with pool->mutex locked */
+static void __flush_local_stat(pool_t *pool, pool_local_t *local, int type)
+{
+	pool->hit_count += local->hit_count[type];
+	pool->miss_count += local->miss_count[type];
+	local->hit_count[type] = 0;
+	local->miss_count[type] = 0;
+}
+
+/* Should be called with pool->mutex locked. The objects over the limit of depot are freed */
+static void __give_back_to_depot(pool_t *pool, pool_local_t *local, int type,
+		int count)
+{
+	pool_object_t *object = DA_NULL;
+
+	while (count-- > 0 && local->head[type]) {
+		object = local->head[type];
+		local->head[type] = object->next;
+		local->count[type]--;
+		if (pool->depot_count < DA_POOL_DEPOT_MAX_COUNT) {
+			object->next = pool->depot;
+			pool->depot = object;
+			pool->depot_count++;
+		} else {
+			free(object);
+		}
+	}
+}
+
+void *pool_alloc(da_pool_type type)
+{
+	pool_t *pool = DA_NULL;
+	pool_local_t *local = DA_NULL;
+	pool_object_t *object = DA_NULL;
+	int i = 0;
+
+	if (type < 0 || type >= DA_POOL_TYPE_COUNT)
+		return DA_NULL;
+	pool = &pools[type];
+
+	local = __get_local();
+	if (local) {
+		if (!local->head[type]) {
+			_da_thread_mutex_lock(&(pool->mutex));
+			for (i = 0; i < DA_POOL_BATCH_COUNT && pool->depot; i++) {
+				object = pool->depot;
+				pool->depot = object->next;
+				pool->depot_count--;
+				object->next = local->head[type];
+				local->head[type] = object;
+				local->count[type]++;
+			}
+			__flush_local_stat(pool, local, type);
+			_da_thread_mutex_unlock(&(pool->mutex));
+		}
+		object = local->head[type];
+		if (object) {
+			local->head[type] = object->next;
+			local->count[type]--;
+			local->hit_count[type]++;
+		} else {
+			local->miss_count[type]++;
+		}
+	} else {
+		_da_thread_mutex_lock(&(pool->mutex));
+		object = pool->depot;
+		if (object) {
+			pool->depot = object->next;
+			pool->depot_count--;
+			pool->hit_count++;
+		} else {
+			pool->miss_count++;
+		}
+		_da_thread_mutex_unlock(&(pool->mutex));
+	}
+
+	if (object) {
+		memset(object, 0x00, pool->object_size);
+		return object;
+	}
+	return calloc(1, pool->object_size);
+}
+
+void pool_free(da_pool_type type, void *object)
+{
+	pool_t *pool = DA_NULL;
+	pool_local_t *local = DA_NULL;
+	pool_object_t *pool_object = (pool_object_t *)object;
+
+	if (!object)
+		return;
+	if (type < 0 || type >= DA_POOL_TYPE_COUNT) {
+		free(object);
+		return;
+	}
+	pool = &pools[type];
+
+	local = __get_local();
+	if (local) {
+		if (local->count[type] >= DA_POOL_LOCAL_MAX_COUNT) {
+			_da_thread_mutex_lock(&(pool->mutex));
+			__give_back_to_depot(pool, local, type, DA_POOL_BATCH_COUNT);
+			__flush_local_stat(pool, local, type);
+			_da_thread_mutex_unlock(&(pool->mutex));
+		}
+		pool_object->next = local->head[type];
+		local->head[type] = pool_object;
+		local->count[type]++;
+	} else {
+		_da_thread_mutex_lock(&(pool->mutex));
+		if (pool->depot_count < DA_POOL_DEPOT_MAX_COUNT) {
+			pool_object->next = pool->depot;
+			pool->depot = pool_object;
+			pool->depot_count++;
+			pool_object = DA_NULL;
+		}
+		_da_thread_mutex_unlock(&(pool->mutex));
+		if (pool_object)
+			free(pool_object);
+	}
+}
+
+void pool_preallocate(void)
+{
+	pool_t *pool = DA_NULL;
+	pool_object_t *object = DA_NULL;
+	int type = 0;
+
+	for (type = 0; type < DA_POOL_TYPE_COUNT; type++) {
+		pool = &pools[type];
+		_da_thread_mutex_lock(&(pool->mutex));
+		while (pool->depot_count < pool->preallocate_count) {
+			object = (pool_object_t *)calloc(1, pool->object_size);
+			if (!object)
+				break;
+			object->next = pool->depot;
+			pool->depot = object;
+			pool->depot_count++;
+		}
+		DA_LOG(Default, "pool[%s] size[%lu] count[%d]", pool->name,
+				(unsigned long)pool->object_size, pool->depot_count);
+		_da_thread_mutex_unlock(&(pool->mutex));
+	}
+}
+
+void pool_deinit(void)
+{
+	pool_t *pool = DA_NULL;
+	pool_local_t *local = DA_NULL;
+	pool_object_t *object = DA_NULL;
+	int type = 0;
+
+	local = __get_local();
+	for (type = 0; type < DA_POOL_TYPE_COUNT; type++) {
+		pool = &pools[type];
+		_da_thread_mutex_lock(&(pool->mutex));
+		if (local)
+			__flush_local_stat(pool, local, type);
+		while (pool->depot) {
+			object = pool->depot;
+			pool->depot = object->next;
+			free(object);
+		}
+		pool->depot_count = 0;
+		DA_LOG_CRITICAL(Default, "pool[%s] hit[%lu] miss[%lu]", pool->name,
+				pool->hit_count, pool->miss_count);
+		_da_thread_mutex_unlock(&(pool->mutex));
+	}
+}
+
+void pool_get_stat(da_pool_type type, unsigned long *out_hit_count,
+		unsigned long *out_miss_count)
+{
+	pool_t *pool = DA_NULL;
+
+	if (type < 0 || type >= DA_POOL_TYPE_COUNT)
+		return;
+	pool = &pools[type];
+
+	_da_thread_mutex_lock(&(pool->mutex));
+	if (out_hit_count)
+		*out_hit_count = pool->hit_count;
+	if (out_miss_count)
+		*out_miss_count = pool->miss_count;
+	_da_thread_mutex_unlock(&(pool->mutex));
+}
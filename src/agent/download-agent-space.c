@@ -0,0 +1,193 @@
+/*
+ * Download Agent
+ *
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Jungki Kwak <jungki.kwak@samsung.com>, Keunsoon Lee <keunsoon.lee@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file		download-agent-space.c
+ * @brief		functions for the reservation of storage space
+ ***/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/statfs.h>
+
+#include "download-agent-debug.h"
+#include "download-agent-pthread.h"
+#include "download-agent-space.h"
+
+struct _da_space_reservation_t {
+	dev_t dev;
+	unsigned long long remaining;
+};
+
+typedef struct _space_ledger_t {
+	dev_t dev;
+	unsigned long long reserved;	/* 0 means empty one */
+} space_ledger_t;
+
+static pthread_mutex_t mutex_space = PTHREAD_MUTEX_INITIALIZER;
+static space_ledger_t space_ledger[DA_MAX_SPACE_LEDGER_COUNT];
+
+static space_ledger_t *__find_ledger(dev_t dev, da_bool_t is_new);
+static void __return_space(da_space_reservation_t *reservation,
+		unsigned long long len);
+
+/* Should be called with mutex_space locked */
+static space_ledger_t *__find_ledger(dev_t dev, da_bool_t is_new)
+{
+	space_ledger_t *empty = DA_NULL;
+	int i = 0;
+
+	for (i = 0; i < DA_MAX_SPACE_LEDGER_COUNT; i++) {
+		if (space_ledger[i].reserved == 0) {
+			if (!empty)
+				empty = &space_ledger[i];
+			continue;
+		}
+		if (space_ledger[i].dev == dev)
+			return &space_ledger[i];
+	}
+	if (DA_FALSE == is_new || !empty)
+		return DA_NULL;
+	empty->dev = dev;
+	return empty;
+}
+
+/* Should be called with mutex_space locked */
+static void __return_space(da_space_reservation_t *reservation,
+		unsigned long long len)
+{
+	space_ledger_t *ledger = DA_NULL;
+
+	if (len > reservation->remaining)
+		len = reservation->remaining;
+	if (len == 0)
+		return;
+	reservation->remaining -= len;
+	ledger = __find_ledger(reservation->dev, DA_FALSE);
+	if (!ledger)
+		return;
+	if (len > ledger->reserved)
+		ledger->reserved = 0;
+	else
+		ledger->reserved -= len;
+}
+
+da_result_t space_reserve(const char *dir_path, unsigned long long size,
+		unsigned long long margin, da_space_reservation_t **out_reservation)
+{
+	da_result_t ret = DA_RESULT_OK;
+	da_space_reservation_t *reservation = DA_NULL;
+	space_ledger_t *ledger = DA_NULL;
+	struct statfs filesys_info;
+	struct stat dir_state;
+	unsigned long long available = 0;
+	unsigned long long reserved = 0;
+
+	if (!dir_path || !out_reservation)
+		return DA_ERR_INVALID_ARGUMENT;
+	*out_reservation = DA_NULL;
+
+	if (statfs(dir_path, &filesys_info) != 0 || stat(dir_path, &dir_state) != 0) {
+		DA_LOG_ERR(Default, "statfs error [%s]", dir_path);
+		return DA_ERR_FAIL_TO_ACCESS_STORAGE;
+	}
+	available = (unsigned long long)filesys_info.f_bavail *
+			(unsigned long long)filesys_info.f_bsize;
+
+	reservation = (da_space_reservation_t *)calloc(1,
+			sizeof(da_space_reservation_t));
+	if (!reservation)
+		return DA_ERR_FAIL_TO_MEMALLOC;
+	reservation->dev = dir_state.st_dev;
+
+	_da_thread_mutex_lock(&mutex_space);
+	ledger = __find_ledger(dir_state.st_dev, DA_FALSE);
+	if (ledger)
+		reserved = ledger->reserved;
+	DA_LOG(Default, "available[%llu] reserved[%llu] size[%llu]",
+			available, reserved, size);
+	if (available < reserved + size + margin) {
+		ret = DA_ERR_DISK_FULL;
+	} else if (size > 0) {
+		if (!ledger)
+			ledger = __find_ledger(dir_state.st_dev, DA_TRUE);
+		/* Too many file systems. Admitted without the ledger */
+		if (ledger) {
+			ledger->reserved += size;
+			reservation->remaining = size;
+		}
+	}
+	_da_thread_mutex_unlock(&mutex_space);
+
+	if (DA_RESULT_OK != ret) {
+		DA_LOG_ERR(Default, "There is no space for [%llu]", size);
+		free(reservation);
+		return ret;
+	}
+	*out_reservation = reservation;
+	return ret;
+}
+
+void space_consume(da_space_reservation_t *reservation, unsigned long long len)
+{
+	if (!reservation)
+		return;
+	_da_thread_mutex_lock(&mutex_space);
+	__return_space(reservation, len);
+	_da_thread_mutex_unlock(&mutex_space);
+}
+
+void space_shrink(da_space_reservation_t *reservation,
+		unsigned long long remaining)
+{
+	if (!reservation)
+		return;
+	_da_thread_mutex_lock(&mutex_space);
+	if (reservation->remaining > remaining)
+		__return_space(reservation, reservation->remaining - remaining);
+	_da_thread_mutex_unlock(&mutex_space);
+}
+
+void space_release(da_space_reservation_t *reservation)
+{
+	if (!reservation)
+		return;
+	_da_thread_mutex_lock(&mutex_space);
+	__return_space(reservation, reservation->remaining);
+	_da_thread_mutex_unlock(&mutex_space);
+	free(reservation);
+}
+
+unsigned long long space_get_reserved(const char *path)
+{
+	space_ledger_t *ledger = DA_NULL;
+	struct stat path_state;
+	unsigned long long reserved = 0;
+
+	if (!path || stat(path, &path_state) != 0)
+		return 0;
+	_da_thread_mutex_lock(&mutex_space);
+	ledger = __find_ledger(path_state.st_dev, DA_FALSE);
+	if (ledger)
+		reserved = ledger->reserved;
+	_da_thread_mutex_unlock(&mutex_space);
+	return reserved;
+}
@@ -0,0 +1,311 @@
+/*
+ * Download Agent
+ *
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Jungki Kwak <jungki.kwak@samsung.com>, Keunsoon Lee <keunsoon.lee@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file		download-agent-tmp-gc.c
+ * @brief		functions for the collector of orphaned temporary files
+ ***/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "download-agent-debug.h"
+#include "download-agent-pthread.h"
+#include "download-agent-file.h"
+#include "download-agent-plugin-install.h"
+#include "download-agent-http-segment.h"
+#include "download-agent-tmp-gc.h"
+
+typedef struct {
+	char **keep_paths;	/* sorted to be searched with bsearch() */
+	int keep_count;
+	time_t start_time;
+} tmp_gc_info_t;
+
+typedef struct {
+	unsigned long long reclaimed_size;
+	int removed_count;
+	int kept_count;
+	int batch_count;
+} tmp_gc_result_t;
+
+static pthread_mutex_t mutex_tmp_gc = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t tmp_gc_thread_id;
+/* The thread clears is_tmp_gc_running when it is finished,
+ * and it is joined by the next start or stop */
+static da_bool_t is_tmp_gc_running = DA_FALSE;
+static da_bool_t is_tmp_gc_joinable = DA_FALSE;
+static da_bool_t is_tmp_gc_stopped = DA_FALSE;
+
+static int __compare_path(const void *a, const void *b);
+static da_bool_t __is_kept(tmp_gc_info_t *info, const char *file_path);
+static void __destroy_info(tmp_gc_info_t *info);
+static da_bool_t __collect_dir(tmp_gc_info_t *info, const char *dir_path,
+		const char *prefix, tmp_gc_result_t *result);
+static int __get_install_dirs(tmp_gc_info_t *info, char **dirs, int max_count);
+static void *__thread_for_tmp_gc(void *data);
+
+static int __compare_path(const void *a, const void *b)
+{
+	return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+static da_bool_t __is_kept(tmp_gc_info_t *info, const char *file_path)
+{
+	char path[DA_MAX_FULL_PATH_LEN] = {0,};
+	const char *key = path;
+	int len = 0;
+	int ext_len = strlen(DA_SEGMENT_MAP_FILE_EXT);
+
+	snprintf(path, sizeof(path), "%s", file_path);
+	/* Segment map is kept with its file */
+	len = strlen(path);
+	if (len > ext_len && !strcmp(path + len - ext_len, DA_SEGMENT_MAP_FILE_EXT))
+		path[len - ext_len] = '\0';
+
+	if (info->keep_count > 0 && bsearch(&key, info->keep_paths,
+			info->keep_count, sizeof(char *), __compare_path))
+		return DA_TRUE;
+	return DA_FALSE;
+}
+
+static void __destroy_info(tmp_gc_info_t *info)
+{
+	int i = 0;
+
+	if (!info)
+		return;
+	for (i = 0; i < info->keep_count; i++)
+		free(info->keep_paths[i]);
+	if (info->keep_paths)
+		free(info->keep_paths);
+	free(info);
+}
+
+/* Removes the files on dir_path which are not kept. If prefix is given,
+ * only the files whose name starts with it are removed.
+ * Returns DA_TRUE if the collector is stopped meanwhile */
+static da_bool_t __collect_dir(tmp_gc_info_t *info, const char *dir_path,
+		const char *prefix, tmp_gc_result_t *result)
+{
+	DIR *dir = DA_NULL;
+	struct dirent *d = DA_NULL;
+	struct stat file_state;
+	char file_path[DA_MAX_FULL_PATH_LEN] = {0,};
+	int prefix_len = prefix ? strlen(prefix) : 0;
+	da_bool_t is_stopped = DA_FALSE;
+
+	dir = opendir(dir_path);
+	if (!dir) {
+		DA_LOG(FileManager, "no directory [%s]", dir_path);
+		return DA_FALSE;
+	}
+
+	while (DA_NULL != (d = readdir(dir))) {
+		if (!strcmp(d->d_name, ".") || !strcmp(d->d_name, ".."))
+			continue;
+		if (prefix && strncmp(d->d_name, prefix, prefix_len))
+			continue;
+		snprintf(file_path, sizeof(file_path), "%s/%s",
+				dir_path, d->d_name);
+		if (lstat(file_path, &file_state) != 0 ||
+				!S_ISREG(file_state.st_mode))
+			continue;
+		/* Resumable one, or the one of the download started meanwhile */
+		if (DA_TRUE == __is_kept(info, file_path) ||
+				file_state.st_mtime >= info->start_time) {
+			result->kept_count++;
+			continue;
+		}
+
+		if (unlink(file_path) != 0) {
+			DA_LOG_ERR(FileManager, "fail to remove [%s]", file_path);
+			continue;
+		}
+		DA_LOG(FileManager, "removed [%s]", file_path);
+		result->reclaimed_size +=
+				(unsigned long long)file_state.st_blocks * 512;
+		result->removed_count++;
+
+		if (++result->batch_count < DA_TMP_GC_BATCH_COUNT)
+			continue;
+		result->batch_count = 0;
+		usleep(DA_TMP_GC_BATCH_INTERVAL_MSEC * 1000);
+		_da_thread_mutex_lock(&mutex_tmp_gc);
+		is_stopped = is_tmp_gc_stopped;
+		_da_thread_mutex_unlock(&mutex_tmp_gc);
+		if (DA_TRUE == is_stopped)
+			break;
+	}
+	closedir(dir);
+	return is_stopped;
+}
+
+/* Install directories which the hidden temporary files may be written on.
+ * They are the default ones, and the ones of the kept files */
+static int __get_install_dirs(tmp_gc_info_t *info, char **dirs, int max_count)
+{
+	char dir[DA_MAX_FULL_PATH_LEN] = {0,};
+	char *ptr = DA_NULL;
+	int count = 0;
+	int i = 0;
+	int j = 0;
+
+	dirs[count++] = strdup(DA_DEFAULT_INSTALL_PATH_FOR_PHONE);
+	dirs[count++] = strdup(DA_DEFAULT_INSTALL_PATH_FOR_MMC);
+	for (i = 0; i < info->keep_count && count < max_count; i++) {
+		snprintf(dir, sizeof(dir), "%s", info->keep_paths[i]);
+		ptr = strrchr(dir, '/');
+		if (!ptr || ptr == dir)
+			continue;
+		*ptr = '\0';
+		if (!strcmp(dir, DA_DEFAULT_TMP_FILE_DIR_PATH))
+			continue;
+		for (j = 0; j < count; j++) {
+			if (dirs[j] && !strcmp(dirs[j], dir))
+				break;
+		}
+		if (j == count)
+			dirs[count++] = strdup(dir);
+	}
+	return count;
+}
+
+static void *__thread_for_tmp_gc(void *data)
+{
+	tmp_gc_info_t *info = (tmp_gc_info_t *)data;
+	tmp_gc_result_t result = {0,};
+	char *install_dirs[DA_TMP_GC_MAX_INSTALL_DIR_COUNT] = {DA_NULL,};
+	int install_dir_count = 0;
+	int i = 0;
+	da_bool_t is_stopped = DA_FALSE;
+
+	DA_LOG_FUNC_START(FileManager);
+
+	/* All of the files on the temporary directory are ours */
+	is_stopped = __collect_dir(info, DA_DEFAULT_TMP_FILE_DIR_PATH, DA_NULL,
+			&result);
+
+	/* Only the hidden ones are ours on the install directories */
+	install_dir_count = __get_install_dirs(info, install_dirs,
+			DA_TMP_GC_MAX_INSTALL_DIR_COUNT);
+	for (i = 0; i < install_dir_count; i++) {
+		if (DA_FALSE == is_stopped && install_dirs[i])
+			is_stopped = __collect_dir(info, install_dirs[i],
+					DA_HIDDEN_TMP_FILE_PREFIX, &result);
+		if (install_dirs[i])
+			free(install_dirs[i]);
+	}
+
+	DA_LOG_CRITICAL(FileManager, "removed[%d] kept[%d] reclaimed[%llu] bytes",
+			result.removed_count, result.kept_count,
+			result.reclaimed_size);
+	__destroy_info(info);
+
+	_da_thread_mutex_lock(&mutex_tmp_gc);
+	is_tmp_gc_running = DA_FALSE;
+	_da_thread_mutex_unlock(&mutex_tmp_gc);
+	return DA_NULL;
+}
+
+da_result_t tmp_gc_start(const char **keep_paths, int keep_count)
+{
+	da_result_t ret = DA_RESULT_OK;
+	tmp_gc_info_t *info = DA_NULL;
+	int i = 0;
+
+	DA_LOG_FUNC_START(FileManager);
+
+	if (keep_count < 0 || (keep_count > 0 && !keep_paths))
+		return DA_ERR_INVALID_ARGUMENT;
+
+	info = (tmp_gc_info_t *)calloc(1, sizeof(tmp_gc_info_t));
+	if (!info)
+		return DA_ERR_FAIL_TO_MEMALLOC;
+	if (keep_count > 0) {
+		info->keep_paths = (char **)calloc(keep_count, sizeof(char *));
+		if (!info->keep_paths) {
+			ret = DA_ERR_FAIL_TO_MEMALLOC;
+			goto ERR;
+		}
+	}
+	for (i = 0; i < keep_count; i++) {
+		if (!keep_paths[i])
+			continue;
+		info->keep_paths[info->keep_count] = strdup(keep_paths[i]);
+		if (!info->keep_paths[info->keep_count]) {
+			ret = DA_ERR_FAIL_TO_MEMALLOC;
+			goto ERR;
+		}
+		info->keep_count++;
+	}
+	qsort(info->keep_paths, info->keep_count, sizeof(char *), __compare_path);
+	info->start_time = time(NULL);
+
+	_da_thread_mutex_lock(&mutex_tmp_gc);
+	if (DA_TRUE == is_tmp_gc_running) {
+		_da_thread_mutex_unlock(&mutex_tmp_gc);
+		DA_LOG_ERR(FileManager, "collector is running already");
+		ret = DA_ERR_INVALID_STATE;
+		goto ERR;
+	}
+	/* The last one is finished. It does not take the mutex any more */
+	if (DA_TRUE == is_tmp_gc_joinable) {
+		pthread_join(tmp_gc_thread_id, DA_NULL);
+		is_tmp_gc_joinable = DA_FALSE;
+	}
+	is_tmp_gc_stopped = DA_FALSE;
+	if (pthread_create(&tmp_gc_thread_id, DA_NULL, __thread_for_tmp_gc,
+			info) != 0) {
+		_da_thread_mutex_unlock(&mutex_tmp_gc);
+		DA_LOG_ERR(FileManager, "fail to create thread");
+		ret = DA_ERR_FAIL_TO_CREATE_THREAD;
+		goto ERR;
+	}
+	is_tmp_gc_running = DA_TRUE;
+	is_tmp_gc_joinable = DA_TRUE;
+	_da_thread_mutex_unlock(&mutex_tmp_gc);
+	return ret;
+
+ERR:
+	__destroy_info(info);
+	return ret;
+}
+
+void tmp_gc_stop(void)
+{
+	da_bool_t is_joinable = DA_FALSE;
+	pthread_t thread_id;
+
+	_da_thread_mutex_lock(&mutex_tmp_gc);
+	is_joinable = is_tmp_gc_joinable;
+	thread_id = tmp_gc_thread_id;
+	is_tmp_gc_stopped = DA_TRUE;
+	is_tmp_gc_joinable = DA_FALSE;
+	_da_thread_mutex_unlock(&mutex_tmp_gc);
+
+	/* The thread takes the mutex to finish, so it is joined without it */
+	if (DA_TRUE == is_joinable)
+		pthread_join(thread_id, DA_NULL);
+}
@@ -43,6 +43,7 @@
 #include "download-agent-plugin-conf.h"
 #include "download-agent-plugin-install.h"
 #include "download-agent-dl-info-util.h"
+#include "download-agent-space.h"
 
 #define DA_HTTP_HEADER_CONTENT_TYPE		"Content-Type"
 #define DA_HTTP_HEADER_CONTENT_LENGTH	"Content-Length"
@@ -59,6 +60,14 @@ void get_random_number(int *out_num)
 	*out_num = temp;
 }
 
+unsigned long long get_monotonic_msec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
 da_result_t get_extension_from_mime_type(char *mime_type, char **extension)
 {
 	da_result_t ret = DA_RESULT_OK;
@@ -192,6 +201,8 @@ da_result_t get_available_memory(
 {
 	int fs_ret = 0;
 	struct statfs filesys_info = {0, };
+	const char *path = DA_NULL;
+	unsigned long long reserved_blocks = 0;
 
 	DA_LOG_FUNC_START(Default);
 
@@ -199,12 +210,14 @@ da_result_t get_available_memory(
 		return DA_ERR_INVALID_ARGUMENT;
 
 	if (storage_type == DA_STORAGE_PHONE) {
-		fs_ret = statfs(DA_DEFAULT_TMP_FILE_DIR_PATH, &filesys_info);
+		path = DA_DEFAULT_TMP_FILE_DIR_PATH;
+		fs_ret = statfs(path, &filesys_info);
 	} else if (storage_type == DA_STORAGE_MMC) {
 		char *default_install_dir = NULL;
 		default_install_dir = PI_get_default_install_dir();
 		if (default_install_dir) {
-			fs_ret = statfs(default_install_dir, &filesys_info);
+			path = default_install_dir;
+			fs_ret = statfs(path, &filesys_info);
 		} else {
 			return DA_ERR_FAIL_TO_ACCESS_STORAGE;
 		}
@@ -220,6 +233,13 @@ da_result_t get_available_memory(
 
 	avail_memory->b_available = filesys_info.f_bavail;
 	avail_memory->b_size = filesys_info.f_bsize;
+	/* Space which other downloads are going to write is not available */
+	if (filesys_info.f_bsize > 0)
+		reserved_blocks = space_get_reserved(path) / filesys_info.f_bsize;
+	if (reserved_blocks > avail_memory->b_available)
+		avail_memory->b_available = 0;
+	else
+		avail_memory->b_available -= reserved_blocks;
 
 	DA_LOG(Default, "Memory type : %d", storage_type);
 	DA_LOG(Default, "Available Memory(f_bavail) : %lu", filesys_info.f_bavail);
@@ -279,6 +299,12 @@ ERR:
 	return b_ret;
 }
 
+static void __move_file_progress_cb(unsigned long long copied_size,
+		unsigned long long total_size, void *user_data)
+{
+	DA_LOG(FileManager, "copying [%llu/%llu]", copied_size, total_size);
+}
+
 da_result_t move_file(const char *from_path, const char *to_path)
 {
 	da_result_t ret = DA_RESULT_OK;
@@ -290,13 +316,15 @@ da_result_t move_file(const char *from_path, const char *to_path)
 		DA_LOG_CRITICAL(FileManager,"rename failed : syserr[%d]",errno);
 		if (errno == EXDEV) {
 			DA_LOG_CRITICAL(FileManager,"File system is diffrent. Try to copy a file");
-			ret = copy_file(from_path, to_path);
+			ret = copy_file_with_progress(from_path, to_path,
+					__move_file_progress_cb, DA_NULL);
 			if (ret == DA_RESULT_OK) {
 				remove_file(from_path);
 			} else {
 				if (is_file_exist(to_path))
 					remove_file(to_path);
-				ret = DA_ERR_FAIL_TO_INSTALL_FILE;
+				if (ret != DA_ERR_DISK_FULL)
+					ret = DA_ERR_FAIL_TO_INSTALL_FILE;
 			}
 		} else {
 			ret = DA_ERR_FAIL_TO_INSTALL_FILE;
@@ -342,9 +370,28 @@ char *print_dl_state(da_state state)
 		return "DA_STATE_RESUMED";
 	case DA_STATE_FAILED:
 		return "DA_STATE_FAILED";
+	case DA_STATE_RETRY_WAITING:
+		return "DA_STATE_RETRY_WAITING";
 	default:
 		return "STATE ERROR";
 
 	}
 }
 
+
+void release_body_slice(da_body_slice_t *slice)
+{
+	if (!slice)
+		return;
+
+	if (slice->release) {
+		if (slice->owner)
+			slice->release(slice->owner);
+	} else if (slice->data) {
+		free(slice->data);
+	}
+	slice->data = DA_NULL;
+	slice->len = 0;
+	slice->owner = DA_NULL;
+	slice->release = DA_NULL;
+}
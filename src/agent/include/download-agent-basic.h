@@ -37,6 +37,20 @@ typedef struct _extension_data_t {
 	const char *install_path;
 	const char *file_name;
 	void *user_data;
+	const int *segment_count;
+	const char *rate_group;
+	const int *retry_budget;
+	const char *validated_path;
+	const char **mirror_url;
+	const int *mirror_url_count;
+	const int *low_speed_limit;
+	const int *low_speed_time;
+	const int *queue_high_watermark;
+	const int *queue_low_watermark;
+	const char *digest_algorithm;
+	const char *digest_expected;
+	const int *durability;
+	const int *drop_cache_size;
 } extension_data_t;
 
 da_result_t start_download(const char* url, da_handle_t *dl_req_id);
@@ -87,7 +87,8 @@ da_result_t dereg_client_app(void);
 da_result_t send_client_da_state (int download_id, da_state state, int err);
 da_result_t send_client_update_dl_info (int download_id, int dl_req_id,
 		char *file_type, unsigned long int file_size, char *tmp_saved_path,
-		char *http_response_header, char *http_raw_data);
+		char *http_response_header, char *http_raw_data,
+		char *etag, char *last_modified);
 da_result_t send_client_update_downloading_info (int download_id, int dl_req_id,
 		unsigned long int total_received_size, char *saved_path);
 
@@ -45,6 +45,13 @@ typedef int da_handle_t;
  */
 #define DA_MAX_DOWNLOAD_REQ_AT_ONCE	5
 
+/**
+ * @ingroup Reference
+ * Upper bound of the count which can be set by da_set_max_download_count(). \n
+ * DA_MAX_DOWNLOAD_REQ_AT_ONCE is used as default count.
+ */
+#define DA_MAX_DOWNLOAD_REQ_LIMIT	64
+
 /**
  * @ingroup Reference
  */
@@ -138,6 +145,147 @@ typedef int da_handle_t;
  * @see user_download_info_t
  */
 #define DA_FEATURE_FILE_NAME	"file_name"
+
+/**
+ * @def DA_FEATURE_SEGMENT_COUNT
+ * @brief Content will be received with designated number of parallel range requests.
+ * @remarks
+ * 	property value type for this is 'int*'.
+ * @details
+ * 	This is applied only if the server accepts range request and the content is large enough. \n
+ * 	Otherwise, the content is received with one request as usual. \n
+ * 	The count is limited to 8 and each range request uses one of the http transactions.
+ * @see da_start_download_with_extension
+ */
+#define DA_FEATURE_SEGMENT_COUNT	"segment_count"
+
+/**
+ * @def DA_FEATURE_RATE_GROUP
+ * @brief Download will share the bandwidth limit of designated group.
+ * @remarks
+ * 	property value type for this is 'char*'.
+ * @details
+ * 	All downloads with same group name (e.g. package name of requesting application) are limited together. \n
+ * 	The limit of group is set by da_set_group_rate_limit().
+ * @see da_start_download_with_extension
+ * @see da_set_group_rate_limit
+ */
+#define DA_FEATURE_RATE_GROUP	"rate_group"
+
+/**
+ * @def DA_FEATURE_RETRY_BUDGET
+ * @brief Download will be retried automatically up to designated count on transient network failure.
+ * @remarks
+ * 	property value type for this is 'int*'.
+ * @details
+ * 	The default count is 5. 0 means no automatic retry. \n
+ * 	Retry is started after backoff time and continues from the received data if possible. \n
+ * 	Before each retry, DA_STATE_RETRY_WAITING is notified with the error which caused it. \n
+ * 	DA_STATE_SUSPENDED is not counted. It is notified when the client suspends the download, or stops the retry. \n
+ * 	So, client can save the used count and pass the rest of it on next request.
+ * @see da_start_download_with_extension
+ */
+#define DA_FEATURE_RETRY_BUDGET	"retry_budget"
+
+/**
+ * @def DA_FEATURE_VALIDATED_PATH
+ * @brief Designated file will be the result if the server says that it is not modified.
+ * @remarks
+ * 	property value type for this is 'char*'.
+ * @details
+ * 	Client puts validators of the file (If-None-Match, If-Modified-Since) with DA_FEATURE_REQUEST_HEADER. \n
+ * 	If the server replies 304, nothing is received and DA_STATE_FINISHED is notified with this path. \n
+ * 	Empty string means that there is no file to validate.
+ * @see da_start_download_with_extension
+ */
+#define DA_FEATURE_VALIDATED_PATH	"validated_path"
+
+/**
+ * @def DA_FEATURE_MIRROR_URL
+ * @brief Content will be received from the fastest one of the url and designated mirror urls.
+ * @remarks
+ * 	property value type for this is 'char**' and 'int*'.
+ * @details
+ * 	All mirrors should serve the same content as the url. At most 8 mirrors are used. \n
+ * 	Before the first request, small range requests are sent to all of them at once, and the first one to reply is used. \n
+ * 	If a source fails, the download continues with the next source from the received data. \n
+ * 	Range requests of DA_FEATURE_SEGMENT_COUNT are also spread over the sources.
+ * @see da_start_download_with_extension
+ */
+#define DA_FEATURE_MIRROR_URL	"mirror_url"
+
+/**
+ * @def DA_FEATURE_LOW_SPEED
+ * @brief Transfer will be aborted and retried if it is slower than designated speed for designated time.
+ * @remarks
+ * 	property value type for this is 'int*' and 'int*'.
+ * @details
+ * 	The first one is the speed in bytes per second, and the second one is the time in seconds. \n
+ * 	The default is 1024 bytes per second for 30 seconds. \n
+ * 	The time while receiving is paused by rate limit or by slow writing is not counted. \n
+ * 	The stalled transfer is resumed on a new connection, or from the next source of DA_FEATURE_MIRROR_URL. \n
+ * 	It is counted as a retry of DA_FEATURE_RETRY_BUDGET, and the count of stalls is reported with user_downloading_info_t. \n
+ * 	0 time means that only the transfer which receives nothing for 180 seconds is aborted.
+ * @see da_start_download_with_extension
+ */
+#define DA_FEATURE_LOW_SPEED	"low_speed"
+
+/**
+ * @def DA_FEATURE_QUEUE_WATERMARK
+ * @brief Receiving from network is paused if the data which is not written to file is more than designated size.
+ * @remarks
+ * 	property value type for this is 'int*' and 'int*'.
+ * @details
+ * 	The first one is the high watermark, and the second one is the low watermark in bytes. \n
+ * 	Receiving is paused when the received data which is waiting to be written reaches the high watermark,
+ * 	and it is continued when the data is written down to the low watermark. \n
+ * 	The default is 64KB and 16KB. Larger one is good for the storage which is slow sometimes. \n
+ * 	The high watermark is limited to 1MB, and the low watermark should be lower than the high watermark.
+ * @see da_start_download_with_extension
+ */
+#define DA_FEATURE_QUEUE_WATERMARK	"queue_watermark"
+
+/**
+ * @def DA_FEATURE_DIGEST
+ * @brief Digest of the content is made while it is received, and it is verified with designated one.
+ * @remarks
+ * 	property value type for this is 'char*' and 'char*'.
+ * @details
+ * 	The first one is the algorithm which is one of "md5", "sha1" and "sha256". \n
+ * 	The second one is the expected digest in hex. Empty string means that the digest is only made. \n
+ * 	If it is different, the download fails with DA_ERR_MISMATCH_DIGEST before it is installed. \n
+ * 	The digest is given with the last user_downloading_info_t which has the saved path. \n
+ * 	For resumed download, only the data which is received before is read again, once.
+ * @see da_start_download_with_extension
+ */
+#define DA_FEATURE_DIGEST	"digest"
+
+/**
+ * @def DA_FEATURE_DURABILITY
+ * @brief When the received data is synced to the storage.
+ * @remarks
+ * 	property value type for this is 'int*'.
+ * @details
+ * 	The value is one of da_durability_t. The default is DA_DURABILITY_ON_COMPLETE. \n
+ * 	Regardless of this, dirty pages of the file are written back little by little while downloading,
+ * 	so that a large download does not make a long burst of write back which stalls other I/O.
+ * @see da_start_download_with_extension
+ */
+#define DA_FEATURE_DURABILITY	"durability"
+
+/**
+ * @def DA_FEATURE_DROP_CACHE
+ * @brief Pages of a large file are dropped from the page cache after they are written to the storage.
+ * @remarks
+ * 	property value type for this is 'int*'.
+ * @details
+ * 	The value is the size of the file in MB from which the pages are dropped. The default is 64MB. \n
+ * 	0 means all files, and negative one means that the pages are left to the kernel. \n
+ * 	The data of a large download is rarely read again soon, and it should not evict the pages of other applications. \n
+ * 	Only the pages which are written back already are dropped while downloading, and the others are dropped on completion.
+ * @see da_start_download_with_extension
+ */
+#define DA_FEATURE_DROP_CACHE	"drop_cache"
 /**
 *@}
 */
@@ -154,6 +302,17 @@ typedef enum {
 	DA_DOWNLOAD_MANAGING_METHOD_MAX
 } da_download_managing_method;
 
+/**
+ * @ingroup Reference
+ * Value of DA_FEATURE_DURABILITY
+ */
+typedef enum {
+	DA_DURABILITY_NONE = 0,	// DA does not sync. The kernel writes it back later
+	DA_DURABILITY_PERIODIC,	// fdatasync() for each DA_DISK_WRITER_WRITE_BACK_SIZE bytes, and fsync() on completion
+	DA_DURABILITY_ON_COMPLETE,	// fsync() when the file is completed
+	DA_DURABILITY_MAX
+} da_durability_t;
+
 /**
  * @warning depricated
  */
@@ -185,6 +344,7 @@ typedef enum {
 	\n DA_STATE_CANCELED,
 	DA_STATE_SUSPENDED,
 	DA_STATE_RESUMED,
+	DA_STATE_RETRY_WAITING,
 
 	@li Last notification for all case
 	\n DA_STATE_FINISHED,
@@ -213,7 +373,9 @@ typedef enum {
 	/// Canceled all download. Emitted only if receiving DA_DOWNLOAD_REQ_ID_FOR_ALL_ITEMS_WITH_UNIFIED_NOTI.
 	DA_STATE_CANCELED_ALL,		// 10
 	/// Failed to download
-	DA_STATE_FAILED			//	11
+	DA_STATE_FAILED,			//	11
+	/// Suspended by error, and waiting to be resumed automatically. err is the error.
+	DA_STATE_RETRY_WAITING		//	12
 } da_state;
 
 
@@ -297,6 +459,7 @@ typedef enum {
 #define DA_ERR_MISMATCH_CONTENT_TYPE	-500
 #define DA_ERR_MISMATCH_CONTENT_SIZE	-501
 #define DA_ERR_SERVER_RESPOND_BUT_SEND_NO_CONTENT	-502
+#define DA_ERR_MISMATCH_DIGEST	-503
 /**
  * @}
  */
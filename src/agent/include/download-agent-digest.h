@@ -0,0 +1,50 @@
+/*
+ * Download Agent
+ *
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Jungki Kwak <jungki.kwak@samsung.com>, Keunsoon Lee <keunsoon.lee@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file		download-agent-digest.h
+ * @brief		Including functions regarding the digest of downloaded content
+ ***/
+
+#ifndef _Download_Agent_Digest_H
+#define _Download_Agent_Digest_H
+
+#include "download-agent-type.h"
+
+/* Read size to hash the file which is already on storage */
+#define DA_DIGEST_READ_BUF_SIZE	(1024*256)
+
+typedef struct _da_digest_t da_digest_t;
+
+/* "md5", "sha1" and "sha256" are supported. Case is ignored */
+da_bool_t digest_is_supported(const char *algorithm);
+da_result_t digest_create(const char *algorithm, da_digest_t **out_digest);
+void digest_destroy(da_digest_t *digest);
+/* Data should be given in the order of the file */
+void digest_update(da_digest_t *digest, const char *data, int len);
+/* Hashes the first len bytes of the file */
+da_result_t digest_update_from_file(da_digest_t *digest, const char *file_path,
+		unsigned long long len);
+/* Length of the data which is hashed */
+unsigned long long digest_get_len(da_digest_t *digest);
+/* Hex string in lower case. Caller must free it. It can be updated after this */
+char *digest_get_hex(da_digest_t *digest);
+/* Case is ignored */
+da_bool_t digest_is_same(const char *hex1, const char *hex2);
+
+#endif
@@ -0,0 +1,62 @@
+/*
+ * Download Agent
+ *
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Jungki Kwak <jungki.kwak@samsung.com>, Keunsoon Lee <keunsoon.lee@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file		download-agent-disk-writer.h
+ * @brief		Including functions regarding the writer thread for each storage device
+ ***/
+
+#ifndef _Download_Agent_Disk_Writer_H
+#define _Download_Agent_Disk_Writer_H
+
+#include "download-agent-type.h"
+
+/* Body which is submitted but not written yet, for each device.
+ * Submitting is blocked over this, so that the queue and the network
+ * are throttled by flow control when the storage is slow */
+#define DA_DISK_WRITER_MAX_IN_FLIGHT	(1024*1024*4) //bytes
+/* Dirty pages are written back for each this size written to a file,
+ * not to be written all at once by the kernel later */
+#define DA_DISK_WRITER_WRITE_BACK_SIZE	(1024*1024*4) //bytes
+/* Pages of the file over this size are dropped from the page cache */
+#define DA_DEFAULT_DROP_CACHE_SIZE	64 //MB
+
+typedef struct _disk_writer_job_t disk_writer_job_t;
+
+/* Files on the same device share one writer thread, which writes
+ * all the submitted body in order while downloading goes on.
+ * durability is da_durability_t, and drop_cache_size is the one of
+ * DA_FEATURE_DROP_CACHE */
+da_result_t disk_writer_open(int fd, int durability, int drop_cache_size,
+		disk_writer_job_t **out_job);
+/* The slices and the array of them are taken, even if it is failed.
+ * Error of the previous write is returned */
+da_result_t disk_writer_submit(disk_writer_job_t *job, da_body_slice_t *slices,
+		int slice_count, int len, unsigned long long offset);
+/* Waits until all the submitted body is written */
+da_result_t disk_writer_wait(disk_writer_job_t *job);
+/* Waits, and frees the job. The fd is not closed */
+da_result_t disk_writer_close(disk_writer_job_t *job);
+/* Drops the clean pages from start to end of the file, if size is over
+ * drop_cache_size. 0 end means the end of the file.
+ * Dirty ones are not dropped. DA_FALSE if the file is not big enough */
+da_bool_t disk_writer_drop_cache(int fd, int drop_cache_size,
+		unsigned long long size, unsigned long long start,
+		unsigned long long end);
+
+#endif
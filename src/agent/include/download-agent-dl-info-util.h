@@ -29,11 +29,10 @@
 #include "download-agent-http-queue.h"
 #include "download-agent-utils-dl-req-id-history.h"
 
-#define DA_MAX_DOWNLOAD_ID	DA_MAX_DOWNLOAD_REQ_AT_ONCE
+#define DA_MAX_DOWNLOAD_ID	DA_MAX_DOWNLOAD_REQ_LIMIT
 #define DA_MAX_TYPE_COUNT	10
 
 #define DOWNLOAD_NOTIFY_LIMIT (1024*32) //bytes
-extern pthread_mutex_t mutex_download_state[];
 
 typedef enum {
 	DOWNLOAD_STATE_IDLE = 0,
@@ -69,6 +68,19 @@ typedef struct _client_input_basic_t {
 	char *req_url;
 	char **user_request_header;
 	int user_request_header_count;
+	int segment_count;
+	int retry_budget;
+	char *validated_path;
+	char **mirror_url;
+	int mirror_url_count;
+	int low_speed_limit;
+	int low_speed_time;
+	int queue_high_watermark;
+	int queue_low_watermark;
+	char *digest_algorithm;
+	char *digest_expected;
+	int durability;
+	int drop_cache_size;
 } client_input_basic_t;
 
 
@@ -89,6 +101,27 @@ typedef struct _source_info_basic_t {
 	char *url;
 	char **user_request_header;
 	int user_request_header_count;
+	int segment_count;
+	int retry_budget;
+	/* The file which is validated with conditional request headers */
+	char *validated_path;
+	/* Other sources of the same content. They are used in this order
+	 * after the url, unless the probe finds a faster one. */
+	char **mirror_url;
+	int mirror_url_count;
+	/* Transfer slower than limit(bytes/sec) for time(sec) is aborted */
+	int low_speed_limit;
+	int low_speed_time;
+	/* Receiving is paused above high, and continued below low (bytes) */
+	int queue_high_watermark;
+	int queue_low_watermark;
+	/* Digest is made with the algorithm. It is verified if expected one is set */
+	char *digest_algorithm;
+	char *digest_expected;
+	/* da_durability_t. When the file is synced to the storage */
+	int durability;
+	/* MB. Pages of the file over this are dropped. Negative for never */
+	int drop_cache_size;
 } source_info_basic_t;
 
 typedef struct _source_info_t {
@@ -97,6 +130,8 @@ typedef struct _source_info_t {
 	} source_info_type;
 } source_info_t;
 
+typedef struct _segment_info_t segment_info_t;
+
 #define GET_SOURCE_TYPE(SOURCE)			((SOURCE)->source_type)
 #define GET_SOURCE_BASIC(SOURCE)   		((SOURCE)->source_info_type.source_info_basic)
 #define GET_SOURCE_BASIC_URL(SOURCE)   		(GET_SOURCE_BASIC(SOURCE)->url)
@@ -109,8 +144,14 @@ typedef struct _req_dl_info {
 	/* The location url is assigned here in case of redirection.
 	 * At this time, the pointer should be freed. */
 	char *location_url;
+	/* The url from the permanent redirection cache.
+	 * destination_url points it in that case, and it should be freed. */
+	char *cached_redirect_url;
 	char **user_request_header;
 	int user_request_header_count;
+	/* The number of parallel range requests which client wants */
+	int segment_count;
+	segment_info_t *segment_info;
 
 	http_state_t http_state;
 	pthread_mutex_t mutex_http_state;
@@ -121,19 +162,56 @@ typedef struct _req_dl_info {
 	char *content_type_from_header; /* calloced in set hdr fiels on download info */
 	int content_len_from_header;
 	char *etag_from_header;
+	char *last_modified_from_header;
 
 	unsigned long int downloaded_data_size;
 
 	int invloved_transaction_id;
+	/* The transaction is paused by rate limit */
+	da_bool_t is_throttled;
+
+	/* The number of automatic retries which are left */
+	int retry_budget;
+	/* The number of failures since any data is received. */
+	int retry_backoff_count;
+	/* Transport reported that the network is gone for a while */
+	da_bool_t is_net_disconnected;
+	da_bool_t is_retry_pending;
+	/* Nothing is received yet, so the retry starts from the first request */
+	da_bool_t is_retry_from_start;
+	unsigned long long retry_at_msec;
+	/* Server replied 304 for the validated file */
+	da_bool_t is_not_modified;
+
+	/* The source which is requested now. 0 is the url, others are mirrors */
+	int source_index;
+	/* The source which gave the ETag. Others are not asked with If-Range */
+	int validator_source_index;
+	/* The number of source switches since any data is received */
+	int source_failover_count;
+
+	int low_speed_limit;
+	int low_speed_time;
+
+	int queue_high_watermark;
+	int queue_low_watermark;
 } req_dl_info;
 
 #define GET_REQUEST_HTTP_RESULT(REQUEST)  		(REQUEST->result)
 #define GET_REQUEST_HTTP_TRANS_ID(REQUEST)  	(REQUEST->invloved_transaction_id)
 #define GET_REQUEST_HTTP_REQ_URL(REQUEST)  		(REQUEST->destination_url)
 #define GET_REQUEST_HTTP_REQ_LOCATION(REQUEST)  		(REQUEST->location_url)
+#define GET_REQUEST_HTTP_CACHED_REDIRECT_URL(REQUEST)  		(REQUEST->cached_redirect_url)
 #define GET_REQUEST_HTTP_USER_REQUEST_HEADER(REQUEST)  		(REQUEST->user_request_header)
 #define GET_REQUEST_HTTP_USER_REQUEST_HEADER_COUNT(REQUEST)  		(REQUEST->user_request_header_count)
+#define GET_REQUEST_HTTP_SEGMENT_COUNT(REQUEST)  		(REQUEST->segment_count)
+#define GET_REQUEST_HTTP_RETRY_BUDGET(REQUEST)  		(REQUEST->retry_budget)
+#define GET_REQUEST_HTTP_LOW_SPEED_LIMIT(REQUEST)  		(REQUEST->low_speed_limit)
+#define GET_REQUEST_HTTP_LOW_SPEED_TIME(REQUEST)  		(REQUEST->low_speed_time)
+#define GET_REQUEST_HTTP_QUEUE_HIGH_WATERMARK(REQUEST)  		(REQUEST->queue_high_watermark)
+#define GET_REQUEST_HTTP_QUEUE_LOW_WATERMARK(REQUEST)  		(REQUEST->queue_low_watermark)
 #define GET_REQUEST_HTTP_HDR_ETAG(REQUEST)  	(REQUEST->etag_from_header)
+#define GET_REQUEST_HTTP_HDR_LAST_MODIFIED(REQUEST)  	(REQUEST->last_modified_from_header)
 #define GET_REQUEST_HTTP_HDR_CONT_TYPE(REQUEST) (REQUEST->content_type_from_header)
 #define GET_REQUEST_HTTP_HDR_CONT_LEN(REQUEST)  (REQUEST->content_len_from_header)
 #define GET_REQUEST_HTTP_CONTENT_OFFSET(REQUEST)(REQUEST->downloaded_data_size)
@@ -147,16 +225,27 @@ typedef struct _req_dl_info {
 }
 
 typedef struct _file_info {
-	void *file_handle;
+	int file_fd; /* -1 if it is not opened */
+	/* Next offset to write. Body is written with pwritev() at this offset */
+	unsigned long long file_offset;
+	/* Body is written by the writer thread of the device */
+	struct _disk_writer_job_t *write_job;
+	/* Body is hashed in the order of the file, except for segmented download */
+	struct _da_digest_t *digest;
+	/* Bytes which are not written yet are reserved on the file system */
+	struct _da_space_reservation_t *space_reservation;
 	char *pure_file_name;
 	char *extension;
 	char *file_name_tmp; /* malloced in make file info. */
 	char *file_name_final; /* malloced in set_file_path_for_final_saving */
 	char *content_type; /* malloced in make file info. */
-	char *add_to_buffer;
+	/* Body which is not written yet. It is written at once with writev() */
+	da_body_slice_t *pending_slices;
+	int pending_slice_count;
 	unsigned int file_size; /* http header's Content-Length has higher priority than DD's <size> */
 	unsigned int total_bytes_written_to_file; /* current written file size */
-	unsigned int bytes_written_to_file;
+	unsigned int bytes_written_to_file; /* DA_TRUE if progress should be notified */
+	unsigned int unnotified_len; /* received after the last progress notification */
 	unsigned int current_buffer_len;
 } file_info;
 
@@ -164,12 +253,19 @@ typedef struct _file_info {
 #define GET_CONTENT_STORE_EXTENSION(FILE_CNTXT) (FILE_CNTXT)->extension
 #define GET_CONTENT_STORE_TMP_FILE_NAME(FILE_CNTXT) (FILE_CNTXT)->file_name_tmp
 #define GET_CONTENT_STORE_ACTUAL_FILE_NAME(FILE_CNTXT) (FILE_CNTXT)->file_name_final
-#define GET_CONTENT_STORE_FILE_HANDLE(FILE_CNTXT) (FILE_CNTXT)->file_handle
+#define GET_CONTENT_STORE_FILE_FD(FILE_CNTXT) (FILE_CNTXT)->file_fd
+#define IS_CONTENT_STORE_FILE_OPENED(FILE_CNTXT) ((FILE_CNTXT)->file_fd >= 0)
+#define GET_CONTENT_STORE_FILE_OFFSET(FILE_CNTXT) (FILE_CNTXT)->file_offset
+#define GET_CONTENT_STORE_FILE_WRITE_JOB(FILE_CNTXT) (FILE_CNTXT)->write_job
+#define GET_CONTENT_STORE_DIGEST(FILE_CNTXT) (FILE_CNTXT)->digest
+#define GET_CONTENT_STORE_SPACE_RESERVATION(FILE_CNTXT) (FILE_CNTXT)->space_reservation
 #define GET_CONTENT_STORE_FILE_SIZE(FILE_CNTXT) (FILE_CNTXT)->file_size
 #define GET_CONTENT_STORE_CURRENT_FILE_SIZE(FILE_CNTXT) (FILE_CNTXT)->total_bytes_written_to_file
 #define IS_CONTENT_STORE_FILE_BYTES_WRITTEN_TO_FILE(FILE_CNTXT) (FILE_CNTXT)->bytes_written_to_file
-#define GET_CONTENT_STORE_FILE_BUFFER(FILE_CNTXT) (FILE_CNTXT)->add_to_buffer
+#define GET_CONTENT_STORE_FILE_SLICES(FILE_CNTXT) (FILE_CNTXT)->pending_slices
+#define GET_CONTENT_STORE_FILE_SLICE_COUNT(FILE_CNTXT) ((FILE_CNTXT)->pending_slice_count)
 #define GET_CONTENT_STORE_FILE_BUFF_LEN(FILE_CNTXT) ((FILE_CNTXT)->current_buffer_len)
+#define GET_CONTENT_STORE_FILE_UNNOTIFIED_LEN(FILE_CNTXT) ((FILE_CNTXT)->unnotified_len)
 #define GET_CONTENT_STORE_CONTENT_TYPE(FILE_CNTXT) (FILE_CNTXT)->content_type
 
 typedef struct _stage_info {
@@ -192,6 +288,7 @@ typedef struct _download_info_t {
 	int dl_req_id;
 	pthread_t active_dl_thread_id;
 	download_state_t state;
+	pthread_mutex_t mutex_state;
 	stage_info *download_stage_data;
 	da_state cur_da_state;
 	queue_t queue;
@@ -199,25 +296,32 @@ typedef struct _download_info_t {
 	char *user_install_path;
 	char *user_file_name;
 	void *user_data;
+	/* The number of transfers which are aborted as stalled */
+	unsigned int stall_count;
+	/* Hex digest of the file which is verified */
+	char *digest;
 } download_info_t;
 
-#define GET_DL_THREAD_ID(ID)		(download_mgr.download_info[ID].active_dl_thread_id)
-#define GET_DL_STATE_ON_ID(ID)		(download_mgr.download_info[ID].state)
+#define GET_DL_THREAD_ID(ID)		(download_mgr.download_info[ID]->active_dl_thread_id)
+#define GET_DL_STATE_ON_ID(ID)		(download_mgr.download_info[ID]->state)
 #define GET_DL_STATE_ON_STAGE(STAGE)	(GET_DL_STATE_ON_ID(GET_STAGE_DL_ID(STAGE)))
-#define GET_DL_CURRENT_STAGE(ID)	(download_mgr.download_info[ID].download_stage_data)
-#define GET_DL_REQ_ID(ID)		(download_mgr.download_info[ID].dl_req_id)
-#define GET_DL_DA_STATE(ID)		(download_mgr.download_info[ID].cur_da_state)
-#define GET_DL_QUEUE(ID)		&(download_mgr.download_info[ID].queue)
-#define GET_DL_USER_INSTALL_PATH(ID)		(download_mgr.download_info[ID].user_install_path)
-#define GET_DL_USER_FILE_NAME(ID)		(download_mgr.download_info[ID].user_file_name)
-#define GET_DL_USER_DATA(ID)		(download_mgr.download_info[ID].user_data)
-#define IS_THIS_DL_ID_USING(ID)	(download_mgr.download_info[ID].is_using)
+#define GET_DL_CURRENT_STAGE(ID)	(download_mgr.download_info[ID]->download_stage_data)
+#define GET_DL_REQ_ID(ID)		(download_mgr.download_info[ID]->dl_req_id)
+#define GET_DL_DA_STATE(ID)		(download_mgr.download_info[ID]->cur_da_state)
+#define GET_DL_QUEUE(ID)		&(download_mgr.download_info[ID]->queue)
+#define GET_DL_USER_INSTALL_PATH(ID)		(download_mgr.download_info[ID]->user_install_path)
+#define GET_DL_USER_FILE_NAME(ID)		(download_mgr.download_info[ID]->user_file_name)
+#define GET_DL_USER_DATA(ID)		(download_mgr.download_info[ID]->user_data)
+#define GET_DL_MUTEX_STATE(ID)		(download_mgr.download_info[ID]->mutex_state)
+#define GET_DL_STALL_COUNT(ID)		(download_mgr.download_info[ID]->stall_count)
+#define GET_DL_DIGEST(ID)		(download_mgr.download_info[ID]->digest)
+#define IS_THIS_DL_ID_USING(ID)	(download_mgr.download_info[ID] && download_mgr.download_info[ID]->is_using)
 
 #define CHANGE_DOWNLOAD_STATE(STATE,STAGE) {\
-	_da_thread_mutex_lock (&mutex_download_state[GET_STAGE_DL_ID(STAGE)]);\
+	_da_thread_mutex_lock (&GET_DL_MUTEX_STATE(GET_STAGE_DL_ID(STAGE)));\
 	GET_DL_STATE_ON_STAGE(STAGE) = STATE;\
 	DA_LOG_CRITICAL(Default, "Changed download_state to - [%d] ", GET_DL_STATE_ON_STAGE(STAGE));\
-	_da_thread_mutex_unlock (&mutex_download_state[GET_STAGE_DL_ID(STAGE)]);\
+	_da_thread_mutex_unlock (&GET_DL_MUTEX_STATE(GET_STAGE_DL_ID(STAGE)));\
 	}
 
 typedef enum {
@@ -229,7 +333,7 @@ typedef enum {
 
 typedef struct _state_watcher_t {
 	state_watcher_type_t type;
-	unsigned short state_watching_bitmap;
+	unsigned long long state_watching_bitmap;
 	da_bool_t is_progressing_to_all;
 	pthread_mutex_t mutex;
 } state_watcher_t;
@@ -242,7 +346,12 @@ typedef struct _default_http_hdr_info_t {
 
 typedef struct _download_mgr_t {
 	da_bool_t is_init;
-	download_info_t download_info[DA_MAX_DOWNLOAD_ID];
+	/* Each entry is allocated when max_download_count is raised over
+	 * download_info_count and is kept to the end of process,
+	 * because download threads and transactions refer to its queue. */
+	download_info_t *download_info[DA_MAX_DOWNLOAD_ID];
+	int download_info_count;
+	int max_download_count;
 	default_http_hdr_info_t *default_hdr_info;
 	state_watcher_t state_watcher;
 
@@ -269,6 +378,8 @@ extern download_mgr_t download_mgr;
 
 da_result_t init_download_mgr();
 da_result_t deinit_download_mgr(void);
+da_result_t set_max_download_count(int count);
+int get_max_download_count(void);
 
 void init_download_info(int download_id);
 void destroy_download_info(int download_id);
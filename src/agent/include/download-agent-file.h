@@ -44,11 +44,22 @@ da_bool_t is_dir_exist(char *dir_path);
 
 void get_file_size(char *file_path, int *out_file_size);
 
-da_result_t clean_files_from_dir(char* dir_path);
 da_result_t create_temp_saved_dir(void);
 
-da_result_t  file_write_ongoing(stage_info *stage, char *body, int body_len);
+/* Body is kept without copying up to DA_FILE_WRITE_BUF_SIZE bytes
+ * or this count of slices, and written at once */
+#define DA_MAX_PENDING_SLICE_COUNT	64
+/* Bigger one needs less system calls. Progress is notified with
+ * DOWNLOAD_NOTIFY_LIMIT regardless of this */
+#ifndef DA_FILE_WRITE_BUF_SIZE
+#define DA_FILE_WRITE_BUF_SIZE	(1024*256) //bytes
+#endif
+
+/* The body is taken and cleared, except for manual download type */
+da_result_t  file_write_ongoing(stage_info *stage, da_body_slice_t *body);
 da_result_t  file_write_complete(stage_info *stage);
+/* Called after the whole content is written. Digest of DA_FEATURE_DIGEST is kept on download info */
+da_result_t  file_verify_digest(stage_info *stage);
 da_result_t  start_file_writing(stage_info *stage);
 da_result_t  start_file_writing_append(stage_info *stage);
 
@@ -57,9 +68,32 @@ da_result_t  discard_download(stage_info *stage) ;
 void clean_paused_file(stage_info *stage);
 da_result_t  replace_content_file_in_stage(stage_info *stage, const char *dest_dd_file_path);
 da_result_t  decide_final_file_path(stage_info *stage);
+/* Directory which the content is written on, before it is installed. Caller must free it.
+ * It is not created. If it does not exist yet, its nearest existing parent is returned */
+char *get_tmp_file_dir(stage_info *stage);
+/* Prefix of the temporary file which is written on the install directory.
+ * The files with it on the install directories are collected by tmp_gc */
+#define DA_HIDDEN_TMP_FILE_PREFIX	".da_tmp_"
+
+/* "_1" ~ "_9999" is appended to the file name if it is already taken */
+#define DA_MAX_FILE_NAME_SUFFIX	9999
+/* The last suffix for each path is kept, and tried first next time */
+#define DA_MAX_UNIQUE_PATH_HINT_COUNT	32
+/* The path is created atomically as an empty file. Caller must free it */
 char *get_full_path_avoided_duplication(char *in_dir, char *in_candidate_file_name, char * in_extension);
 
+/* Bytes copied between progress reports */
+#define DA_COPY_CHUNK_SIZE	(1024*1024*8)
+/* Buffer for the copy in user space, if the kernel can not copy it */
+#define DA_COPY_BUF_SIZE	(1024*1024)
+
+typedef void (*da_copy_progress_cb)(unsigned long long copied_size,
+		unsigned long long total_size, void *user_data);
+
 da_result_t copy_file(const char *src, const char *dest);
+/* The whole size of src should be copied, otherwise it is failed */
+da_result_t copy_file_with_progress(const char *src, const char *dest,
+		da_copy_progress_cb progress_cb, void *user_data);
 da_result_t create_dir(const char *install_dir);
 
 #endif
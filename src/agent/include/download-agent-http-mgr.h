@@ -31,11 +31,22 @@
 #include "download-agent-type.h"
 #include "download-agent-dl-mgr.h"
 #include "download-agent-http-queue.h"
+#include "download-agent-http-msg-handler.h"
 
 #define	DA_MAX_SESSION_INFO				DA_MAX_DOWNLOAD_ID
 #define	DA_MAX_TRANSACTION_INFO			10
 #define DA_MAX_TRANSACTION_MUTEX		DA_MAX_SESSION_INFO*DA_MAX_TRANSACTION_INFO
 
+/* Retry on transient network failure. The backoff is doubled from base
+ * to max on each failure without receiving any data, with random jitter. */
+#define DA_DEFAULT_RETRY_BUDGET		5
+#define DA_RETRY_BACKOFF_BASE_MSEC	1000
+#define DA_RETRY_BACKOFF_MAX_MSEC	30000
+
+/* Transfer which is slower than this for the time is aborted as stalled */
+#define DA_DEFAULT_LOW_SPEED_LIMIT	1024	// bytes per second
+#define DA_DEFAULT_LOW_SPEED_TIME	30	// second
+
 typedef struct _http_mgr_t
 {
 	da_bool_t is_init;
@@ -46,11 +57,16 @@ extern http_mgr_t http_mgr;
 
 da_result_t  init_http_mgr(void);
 void deinit_http_mgr(void);
+da_result_t set_max_http_transaction_count(int count);
 da_result_t  make_req_dl_info_http(stage_info *stage, req_dl_info *out_info);
 da_result_t  request_http_download(stage_info *stage);
 da_result_t  request_to_cancel_http_download(stage_info *stage);
 da_result_t  request_to_abort_http_download(stage_info *stage);
 da_result_t  request_to_suspend_http_download(stage_info *stage);
 da_result_t  request_to_resume_http_download(stage_info *stage);
+da_result_t  make_default_http_request_hdr(const char *url,
+		char **user_request_header,
+		int user_request_heaer_count,
+		http_msg_request_t **out_http_msg_request);
 
 #endif
@@ -0,0 +1,49 @@
+/*
+ * Download Agent
+ *
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Jungki Kwak <jungki.kwak@samsung.com>, Keunsoon Lee <keunsoon.lee@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file		download-agent-http-mirror.h
+ * @brief		Including functions regarding mirrors of download
+ ***/
+
+#ifndef _Download_Agent_Http_Mirror_H
+#define _Download_Agent_Http_Mirror_H
+
+#include "download-agent-type.h"
+#include "download-agent-dl-mgr.h"
+#include "download-agent-http-msg-handler.h"
+
+#define DA_MAX_MIRROR_COUNT	8
+/* Each source is requested this size of range to find the fastest one */
+#define DA_MIRROR_PROBE_SIZE	(16*1024)
+#define DA_MIRROR_PROBE_TIMEOUT_MSEC	3000
+
+/* Source 0 is the url of request, and others are the mirrors in order. */
+int mirror_get_source_count(stage_info *stage);
+char *mirror_get_source_url(stage_info *stage, int source_index);
+/* Probe all sources at once, and use the first one which sends the range */
+da_result_t mirror_select_fastest_source(stage_info *stage);
+/* Every other source is tried once until any data is received */
+da_bool_t mirror_is_failover_available(stage_info *stage);
+void mirror_switch_to_next_source(stage_info *stage);
+/* Partial content from other source than the one which gave the ETag
+ * is accepted only if the total size in Content-Range is same. */
+da_bool_t mirror_is_same_content(http_msg_response_t *http_msg_response,
+		unsigned long long total_size);
+
+#endif
@@ -34,7 +34,11 @@
 #define HTTP_FIELD_CONTENT_TYPE		"Content-Type"
 #define HTTP_FIELD_IF_MATCH			"If-Match"
 #define HTTP_FIELD_RANGE			"Range"
+#define HTTP_FIELD_CONTENT_RANGE	"Content-Range"
 #define HTTP_FIELD_IF_RANGE			"If-Range"
+#define HTTP_FIELD_LAST_MODIFIED	"Last-Modified"
+#define HTTP_FIELD_CACHE_CONTROL	"Cache-Control"
+#define HTTP_FIELD_ACCEPT_RANGES	"Accept-Ranges"
 #define HTTP_FIELD_ACCEPT_LANGUAGE	"Accept-Language"
 #define HTTP_FIELD_ACCEPT_CHARSET	"Accept-Charset"
 
@@ -109,6 +113,10 @@ void http_msg_response_set_content_type(http_msg_response_t* http_msg_response,
 da_bool_t http_msg_response_get_content_length(http_msg_response_t* http_msg_response, int* out_length);
 da_bool_t http_msg_response_get_content_disposition(http_msg_response_t* http_msg_response, char** out_disposition, char** out_file_name);
 da_bool_t http_msg_response_get_ETag(http_msg_response_t* http_msg_response, char** out_value);
+da_bool_t http_msg_response_get_last_modified(http_msg_response_t* http_msg_response, char** out_value);
+da_bool_t http_msg_response_get_cache_control(http_msg_response_t* http_msg_response, char** out_value);
+da_bool_t http_msg_response_get_accept_ranges(http_msg_response_t* http_msg_response, char** out_value);
+da_bool_t http_msg_response_get_content_range(http_msg_response_t* http_msg_response, char** out_value);
 da_bool_t http_msg_response_get_date(http_msg_response_t* http_msg_response, char** out_value);
 da_bool_t http_msg_response_get_location(http_msg_response_t* http_msg_response, char** out_value);
 // should be refactored later
@@ -35,6 +35,19 @@
 
 #define	MAX_QUEUE_SIZE	1024*64
 
+/* Flow control. The producer is paused when the queue reaches the high watermark,
+ * and it is unpaused when the consumer drains the queue to the low watermark */
+#define	Q_DEFAULT_HIGH_WATERMARK	MAX_QUEUE_SIZE
+#define	Q_DEFAULT_LOW_WATERMARK	(MAX_QUEUE_SIZE / 4)
+#define	Q_MAX_HIGH_WATERMARK	(1024*1024)
+
+/* Slot count of the data ring. It should be power of 2 */
+#define	Q_DATA_RING_SIZE	256
+#define	Q_DATA_RING_MASK	(Q_DATA_RING_SIZE - 1)
+/* Slots which only the events without body can use.
+ * The final or abort event should not be rejected even if the ring is full of packets */
+#define	Q_DATA_RING_RESERVED	8
+
 typedef enum
 {
 	Q_EVENT_TYPE_DATA_HTTP,
@@ -48,6 +61,7 @@ typedef enum
 	Q_EVENT_TYPE_CONTROL_RESUME,
 	Q_EVENT_TYPE_CONTROL_NET_DISCONNECTED,
 	Q_EVENT_TYPE_CONTROL_ABORT,
+	Q_EVENT_TYPE_CONTROL_SEGMENT_FINISHED,
 // [090205][jungki]not used yet.
 //	Q_EVENT_TYPE_CONTROL_USER_CONFIRM_RESULT,
 //	Q_EVENT_TYPE_CONTROL_INSTALL_RESULT,
@@ -70,6 +84,9 @@ typedef struct _q_event_data_http_t
 
 	int body_len;
 	char *body_data;
+	/* If it is set, body_data is kept by body_owner without copying */
+	void *body_owner;
+	void (*release_body)(void *body_owner);
 
 	da_result_t error_type;
 }q_event_data_http_t;
@@ -93,21 +110,38 @@ struct _q_event_t
 	q_event_t *next;
 };
 
+/* Control events can be pushed by any thread, so they are kept on a list with mutex_queue.
+ * Data events are pushed only by the loop thread of http plugin, and popped only by
+ * the download thread. They are passed with the lock free ring of single producer and
+ * single consumer, and mutex_queue is taken only to wake up the sleeping consumer. */
 typedef struct _queue_t
 {
-	da_bool_t having_data;
-
 	q_event_t *control_head;
-	q_event_t *data_head;
+	volatile int control_count;
+
+	q_event_t *data_ring[Q_DATA_RING_SIZE];
+	/* Written only by producer */
+	volatile unsigned int data_tail;
+	/* Written only by consumer */
+	volatile unsigned int data_head;
+
+	volatile int is_waiting;
 
 	pthread_mutex_t mutex_queue;
 	pthread_cond_t cond_queue;
 
-	int queue_size;
+	volatile int queue_size;
+
+	int high_watermark;
+	int low_watermark;
+	/* Set by producer when a packet is rejected, and cleared by consumer */
+	volatile int is_over_high_watermark;
 }queue_t;
 
 void Q_init_queue(queue_t *queue);
 void Q_destroy_queue(queue_t *queue);
+/* Invalid one is replaced with the default */
+void Q_set_watermark(queue_t *queue, int high_watermark, int low_watermark);
 
 void Q_init_q_event(q_event_t *q_event);
 void Q_destroy_q_event(q_event_t **q_event);
@@ -117,16 +151,26 @@ da_result_t  Q_make_control_event(q_event_type_control control_type, q_event_t *
 da_result_t  Q_make_http_data_event(q_event_type_data data_type, q_event_t **out_event);
 da_result_t  Q_set_status_code_on_http_data_event(q_event_t *q_event, int status_code);
 da_result_t  Q_set_http_body_on_http_data_event(q_event_t *q_event, int body_len, char *body_data);
+/* owner_size is the memory held by body_owner. It is counted to the queue size instead of body_len */
+da_result_t  Q_set_http_body_owner_on_http_data_event(q_event_t *q_event, void *body_owner, int owner_size, void (*release_body)(void *body_owner));
+/* The body is moved to out_slice. body_len is kept on the event */
+void Q_take_http_body_from_http_data_event(q_event_t *q_event, da_body_slice_t *out_slice);
 da_result_t  Q_set_error_type_on_http_data_event(q_event_t *q_event, int error_type);
 
 
 da_bool_t Q_push_event(const queue_t *in_queue, const q_event_t *in_event);
+/* Should be called with mutex_queue locked */
 da_bool_t Q_push_event_without_lock(const queue_t *in_queue, const q_event_t *in_event);
 void Q_pop_event(const queue_t *in_queue, q_event_t **out_event);
+da_bool_t Q_is_having_data(const queue_t *in_queue);
+/* For consumer. TRUE only once after the producer is rejected,
+ * when the queue is drained to the low watermark */
+da_bool_t Q_is_drained_to_low_watermark(const queue_t *in_queue);
 
-#define GET_IS_Q_HAVING_DATA(QUEUE)		(QUEUE->having_data)
+#define GET_IS_Q_HAVING_DATA(QUEUE)		Q_is_having_data(QUEUE)
 
 void Q_goto_sleep(const queue_t *in_queue);
+void Q_goto_sleep_with_timeout(const queue_t *in_queue, unsigned long msec);
 void Q_wake_up(const queue_t *in_queue);
 
 
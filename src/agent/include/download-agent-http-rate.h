@@ -0,0 +1,50 @@
+/*
+ * Download Agent
+ *
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Jungki Kwak <jungki.kwak@samsung.com>, Keunsoon Lee <keunsoon.lee@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file		download-agent-http-rate.h
+ * @brief		Including functions regarding bandwidth shaping with token buckets
+ ***/
+
+#ifndef _Download_Agent_Http_Rate_H
+#define _Download_Agent_Http_Rate_H
+
+#include "download-agent-type.h"
+
+#define DA_MAX_RATE_GROUP_COUNT	16
+/* A bucket can hold tokens for this time at most. It is the max burst. */
+#define DA_RATE_BURST_MSEC	1000
+/* The throttled thread checks the bucket again after this time at most,
+ * so that a changed rate is applied soon. */
+#define DA_RATE_MAX_THROTTLE_MSEC	500
+
+/* Every bucket which a download belongs to is charged for received data;
+ * the global one, its own one and one of its group (e.g. package).
+ * When any of them is in debt, the transaction is paused on transport
+ * until the debt is paid back, so that no data is buffered for it. */
+da_result_t rate_set_global_limit(unsigned int bytes_per_sec);
+da_result_t rate_set_download_limit(int download_id, unsigned int bytes_per_sec);
+da_result_t rate_set_group_limit(const char *group, unsigned int bytes_per_sec);
+da_result_t rate_set_download_group(int download_id, const char *group);
+void rate_reset_download(int download_id);
+
+void rate_charge_transaction(int download_id, int tranx_id, int body_len,
+		da_bool_t *is_throttled);
+unsigned long rate_get_throttle_msec(int download_id, da_bool_t *is_throttled);
+
+#endif
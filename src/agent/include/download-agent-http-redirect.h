@@ -0,0 +1,53 @@
+/*
+ * Download Agent
+ *
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Jungki Kwak <jungki.kwak@samsung.com>, Keunsoon Lee <keunsoon.lee@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file		download-agent-http-redirect.h
+ * @brief		Including functions regarding the cache of permanent redirection
+ ***/
+
+#ifndef _Download_Agent_Http_Redirect_H
+#define _Download_Agent_Http_Redirect_H
+
+#include "download-agent-type.h"
+
+#ifdef _TARGET
+#define DA_REDIRECT_CACHE_FILE_PATH	"/opt/media/.download_agent_redirect"
+#else
+// FIXME Later : temporary code
+#define DA_REDIRECT_CACHE_FILE_PATH	"/tmp/.download_agent_redirect"
+#endif
+
+#define DA_MAX_REDIRECT_CACHE_COUNT	64
+/* Chained redirections are followed up to this count on lookup */
+#define DA_MAX_REDIRECT_CACHE_HOPS	5
+/* Used if there is no max-age in Cache-Control */
+#define DA_REDIRECT_CACHE_DEFAULT_TTL_SEC	(24 * 60 * 60)
+#define DA_REDIRECT_CACHE_MAX_TTL_SEC	(7 * 24 * 60 * 60)
+
+/* 301 and 308 responses are kept with the url which was requested,
+ * and the next download of the url goes to the final location at once.
+ * The cache is saved on a file, so that it is kept after reboot. */
+/* Caller must free the returned url. NULL if it is not cached */
+char *redirect_cache_get_target(const char *url);
+void redirect_cache_add(const char *url, const char *target,
+		const char *cache_control);
+/* Removes all the cached redirections from the url */
+void redirect_cache_remove(const char *url);
+
+#endif
@@ -0,0 +1,118 @@
+/*
+ * Download Agent
+ *
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Jungki Kwak <jungki.kwak@samsung.com>, Keunsoon Lee <keunsoon.lee@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file		download-agent-http-segment.h
+ * @brief		Including functions regarding segmented range download
+ ***/
+
+#ifndef _Download_Agent_Http_Segment_H
+#define _Download_Agent_Http_Segment_H
+
+#include <pthread.h>
+
+#include "download-agent-type.h"
+#include "download-agent-dl-info-util.h"
+#include "download-agent-http-msg-handler.h"
+#include "download-agent-http-mirror.h"
+
+#define DA_MAX_SEGMENT_COUNT	8
+/* A segment is split only if it has at least twice of this size to receive */
+#define DA_MIN_SEGMENT_SIZE	(1024*512)
+#define DA_SEGMENT_MAP_FILE_EXT	".seg"
+
+/* The segment 0 is received by main transaction of http mgr.
+ * Others are received by segment threads with their own transaction. */
+#define DA_MAIN_SEGMENT	0
+
+typedef enum {
+	SEGMENT_STATE_IDLE = 0,
+	SEGMENT_STATE_RUNNING,
+	SEGMENT_STATE_FINISHED,
+	SEGMENT_STATE_FAILED,
+} segment_state_t;
+
+typedef struct _segment_t {
+	unsigned long long start;
+	unsigned long long end; /* not included */
+	unsigned long long cur; /* next offset to be received */
+	segment_state_t state;
+	int tranx_id;
+} segment_t;
+
+struct _segment_info_t {
+	int download_id;
+	unsigned long long total_size;
+	/* Segment threads use the sources in turn from the one of main transaction.
+	 * Only the validator source is requested with If-Range. The response of
+	 * others is accepted if the total size in Content-Range is same. */
+	char *url[DA_MAX_MIRROR_COUNT + 1];
+	int source_count;
+	int main_source;
+	int validator_source;
+	unsigned long low_speed_limit;
+	unsigned long low_speed_time;
+	int queue_high_watermark;
+	int queue_low_watermark;
+	/* This is just pointer assignment from stage */
+	char **user_request_header;
+	int user_request_header_count;
+	char *etag;
+	char *file_path;
+	/* Body is written by the disk writer like the one of main transaction.
+	 * The reservation is just pointer assignment from file_info.
+	 * Threads are joined before it is released. */
+	int durability;
+	int drop_cache_size;
+	struct _da_space_reservation_t *space_reservation;
+
+	segment_t segment[DA_MAX_SEGMENT_COUNT];
+	pthread_t thread_id[DA_MAX_SEGMENT_COUNT];
+	int thread_count;
+	int running_count;
+
+	da_bool_t is_main_tranx_finished;
+	da_bool_t is_stopped;
+	da_result_t result;
+	pthread_mutex_t mutex;
+};
+
+#define GET_SEGMENT_INFO(STAGE)	(GET_STAGE_TRANSACTION_INFO(STAGE)->segment_info)
+#define IS_SEGMENTED_DOWNLOAD(STAGE)	(GET_SEGMENT_INFO(STAGE) != DA_NULL)
+
+da_result_t segment_prepare_download(stage_info *stage,
+		http_msg_response_t *http_msg_response);
+da_result_t segment_prepare_resume(stage_info *stage);
+da_result_t segment_start_threads(stage_info *stage);
+int segment_accept_main_body(stage_info *stage, int body_len,
+		da_bool_t *out_is_range_done);
+unsigned long long segment_get_main_offset(stage_info *stage);
+unsigned long long segment_get_total_size(stage_info *stage);
+unsigned long long segment_get_received_size(stage_info *stage);
+void segment_set_main_tranx_finished(stage_info *stage);
+da_bool_t segment_is_all_finished(stage_info *stage);
+da_result_t segment_get_result(stage_info *stage);
+da_result_t segment_check_all_received(stage_info *stage);
+void segment_stop(stage_info *stage);
+/* Stops, and waits until all the received body is written */
+void segment_stop_and_wait(stage_info *stage);
+da_result_t segment_save_map(stage_info *stage);
+void segment_remove_map(stage_info *stage);
+void destroy_segment_info(segment_info_t **in_segment_info);
+
+#endif
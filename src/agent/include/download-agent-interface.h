@@ -192,6 +192,10 @@ typedef struct {
 	unsigned long int total_received_size;
 	/// This has only file name for now.
 	char *saved_path;
+	/// The number of transfers which are aborted by DA_FEATURE_LOW_SPEED.
+	unsigned int stall_count;
+	/// Hex digest of the file by DA_FEATURE_DIGEST. It is given only with the saved path of finished download.
+	char *digest;
 } user_downloading_info_t;
 
 /**
@@ -214,6 +218,10 @@ typedef struct {
 	char *http_response_header;
 	/// This is raw data of chunked data
 	char *http_chunked_data;
+	/// ETag from http header. Client can validate the file with this later.
+	char *etag;
+	/// Last-Modified from http header. Client can validate the file with this later.
+	char *last_modified;
 } user_download_info_t;
 
 /**
@@ -433,6 +441,16 @@ int da_start_download(
 * 	@li DA_FEATURE_USER_DATA	: void*	\n
 * 	@li DA_FEATURE_INSTALL_PATH	: char*	\n
 * 	@li DA_FEATURE_FILE_NAME	: char*	\n
+* 	@li DA_FEATURE_SEGMENT_COUNT	: int*	\n
+* 	@li DA_FEATURE_RATE_GROUP	: char*	\n
+* 	@li DA_FEATURE_RETRY_BUDGET	: int*	\n
+* 	@li DA_FEATURE_VALIDATED_PATH	: char*	\n
+* 	@li DA_FEATURE_MIRROR_URL	: char** int*	\n
+* 	@li DA_FEATURE_LOW_SPEED	: int* int*	\n
+* 	@li DA_FEATURE_QUEUE_WATERMARK	: int* int*	\n
+* 	@li DA_FEATURE_DIGEST	: char* char*	\n
+* 	@li DA_FEATURE_DURABILITY	: int*	\n
+* 	@li DA_FEATURE_DROP_CACHE	: int*	\n
 *
 * @see ExtensionFeatures
 *
@@ -594,6 +612,155 @@ int da_resume_download(
 );
 
 
+/**
+ * @fn int da_set_max_download_count(int count)
+ * @ingroup Reference
+ * @brief This function sets the max count of downloads which can be progressed at once.
+ *
+ * The default count is DA_MAX_DOWNLOAD_REQ_AT_ONCE. \n
+ * Client can raise it for fast network, or lower it for constrained device.
+ *
+ * @remarks This can be called before da_init(). In this case, the count is applied on da_init(). \n
+ * 			If the count is lowered, the downloads which are already progressing are not affected. \n
+ * 			Only new download is refused until the count of progressing downloads is under the new count.
+ *
+ * @pre None.
+ * @post None.
+ *
+ * @param[in]		count		max count of downloads, from 1 to DA_MAX_DOWNLOAD_REQ_LIMIT
+ * @return		DA_RESULT_OK for success, or DA_ERR_XXX for fail
+ *
+ * @see da_get_max_download_count()
+ *
+ * @par Example
+ * @code
+   #include <download-agent-interface.h>
+
+   int da_ret;
+
+   da_ret = da_set_max_download_count(20);
+   if(da_ret != DA_RESULT_OK)
+		printf("failed to set max download count with error code %d\n", da_ret);
+ @endcode
+ */
+int da_set_max_download_count(int count);
+
+/**
+ * @fn int da_get_max_download_count(void)
+ * @ingroup Reference
+ * @brief This function gets the max count of downloads which can be progressed at once.
+ *
+ * @pre None.
+ * @post None.
+ *
+ * @return		max count of downloads
+ *
+ * @see da_set_max_download_count()
+ */
+int da_get_max_download_count(void);
+
+/**
+ * @fn int da_set_global_rate_limit(unsigned int bytes_per_sec)
+ * @ingroup Reference
+ * @brief This function limits the bandwidth which all downloads can use together.
+ *
+ * @remarks When the limit is reached, receiving is paused on transport until the limit allows it again. \n
+ * 			So, the data is not buffered in memory while a download is limited.
+ *
+ * @pre None.
+ * @post None.
+ *
+ * @param[in]		bytes_per_sec		max bytes per second. 0 means unlimited
+ * @return		DA_RESULT_OK for success, or DA_ERR_XXX for fail
+ *
+ * @see da_set_download_rate_limit()
+ * @see da_set_group_rate_limit()
+ */
+int da_set_global_rate_limit(unsigned int bytes_per_sec);
+
+/**
+ * @fn int da_set_download_rate_limit(da_handle_t da_dl_req_id, unsigned int bytes_per_sec)
+ * @ingroup Reference
+ * @brief This function limits the bandwidth of a download.
+ *
+ * @remarks The global limit and the limit of group are also applied to the download.
+ *
+ * @pre The download should be progressing.
+ * @post None.
+ *
+ * @param[in]		da_dl_req_id		download request id
+ * @param[in]		bytes_per_sec		max bytes per second. 0 means unlimited
+ * @return		DA_RESULT_OK for success, or DA_ERR_XXX for fail
+ *
+ * @see da_set_global_rate_limit()
+ *
+ * @par Example
+ * @code
+   #include <download-agent-interface.h>
+
+   int da_ret;
+   int da_dl_req_id;
+
+   da_ret = da_set_download_rate_limit(da_dl_req_id, 100 * 1024);
+   if(da_ret != DA_RESULT_OK)
+		printf("failed to set rate limit with error code %d\n", da_ret);
+ @endcode
+ */
+int da_set_download_rate_limit(da_handle_t da_dl_req_id, unsigned int bytes_per_sec);
+
+/**
+ * @fn int da_set_group_rate_limit(const char *group, unsigned int bytes_per_sec)
+ * @ingroup Reference
+ * @brief This function limits the bandwidth which downloads of a group can use together.
+ *
+ * @remarks A download joins a group with DA_FEATURE_RATE_GROUP on da_start_download_with_extension(). \n
+ * 			The limit can be set before any download of the group is started.
+ *
+ * @pre None.
+ * @post None.
+ *
+ * @param[in]		group		group name (e.g. package name)
+ * @param[in]		bytes_per_sec		max bytes per second. 0 means unlimited
+ * @return		DA_RESULT_OK for success, or DA_ERR_XXX for fail
+ *
+ * @see DA_FEATURE_RATE_GROUP
+ */
+int da_set_group_rate_limit(const char *group, unsigned int bytes_per_sec);
+
+/**
+ * @fn int da_collect_tmp_files(const char **keep_paths, int keep_count)
+ * @ingroup Reference
+ * @brief This function removes the orphaned files on the temporary directory, on background.
+ *
+ * Files of crashed or removed downloads are left on the temporary directory. \n
+ * Client passes the temporary paths which it can still resume, e.g. saved path on its database, and the others are removed.
+ *
+ * @remarks This returns at once. Files are removed by a few at a time, and the reclaimed bytes are logged at the end. \n
+ * 			Files which are modified after this call, e.g. by new downloads, are not removed. \n
+ * 			This should be called once after da_init().
+ *
+ * @pre da_init() should be called.
+ * @post None.
+ *
+ * @param[in]		keep_paths		temporary paths which should not be removed. These are copied
+ * @param[in]		keep_count		count of keep_paths
+ * @return		DA_RESULT_OK for success, or DA_ERR_XXX for fail
+ *
+ * @par Example
+ * @code
+   #include <download-agent-interface.h>
+
+   int da_ret;
+   const char *keep_paths[] = { "/opt/media/.tmp_download/sample.mp3" };
+
+   da_ret = da_collect_tmp_files(keep_paths, 1);
+   if(da_ret != DA_RESULT_OK)
+		printf("failed to collect with error code %d\n", da_ret);
+ @endcode
+ */
+int da_collect_tmp_files(const char **keep_paths, int keep_count);
+
+
 /**
 * @}
 */
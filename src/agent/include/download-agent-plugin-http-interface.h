@@ -43,18 +43,34 @@ typedef struct _input_for_tranx_t {
 	queue_t *queue;
 
 	http_msg_request_t* http_msg_request;
+
+	/* The transaction is aborted as stalled, if it receives less than
+	 * low_speed_limit bytes per second for low_speed_time seconds.
+	 * 0 time means that only the idle one is aborted after MAX_TIMEOUT. */
+	unsigned long low_speed_limit;
+	unsigned long low_speed_time;
+
+	/* Extra transaction of a download which has its own one already,
+	 * e.g. a segment. It does not take the capacity for downloads */
+	da_bool_t is_extra;
 } input_for_tranx_t;
 
 
 
 da_result_t  PI_http_init(void);
 void PI_http_deinit(void);
+da_result_t PI_http_set_max_transaction_count(int count);
 
 da_result_t  PI_http_start_transaction(const input_for_tranx_t *input_for_tranx, int *out_tranx_id);
 da_result_t  PI_http_cancel_transaction(int in_tranx_id, da_bool_t abort_option);
 da_result_t  PI_http_disconnect_transaction(int in_tranx_id);
 void PI_http_pause_transaction(int transaction_id);
 void PI_http_unpause_transaction(int transaction_id);
+/* All requests are sent at once. out_index is the index of the request
+ * which is completed first with 206, or -1 if there is none in time. */
+da_result_t PI_http_probe_transactions(http_msg_request_t **requests,
+		int count, char *proxy_addr, unsigned long timeout_msec,
+		int *out_index);
 
 #endif
 
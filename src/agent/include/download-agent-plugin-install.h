@@ -28,6 +28,9 @@
 
 #include "download-agent-type.h"
 
+#define DA_DEFAULT_INSTALL_PATH_FOR_PHONE "/opt/media/Downloads"
+#define DA_DEFAULT_INSTALL_PATH_FOR_MMC "/opt/storage/sdcard/Downloads"
+
 char *PI_get_default_install_dir(void);
 
 #endif
@@ -35,32 +35,67 @@
 
 typedef struct  _pi_session_table_t {
 	da_bool_t is_using;
+	da_bool_t is_extra;
 	SoupSession *session;
 	SoupMessage *msg;
 	queue_t *queue;
+	/* for flow control. The events which are not pushed to the full queue
+	 * are kept here in order, linked with next */
 	pthread_mutex_t mutex;
-	pthread_cond_t cond;
 	da_bool_t is_paused;
+	da_bool_t is_cancelled;
+	q_event_t *pending_event;
+	/* The final or abort event which is pushed after pending_event list */
+	q_event_t *pending_final_event;
+	/* for stall watchdog. These are used only on loop thread,
+	 * except was_paused which is set with the mutex */
+	unsigned long low_speed_limit;
+	unsigned long low_speed_time;
+	unsigned long long low_speed_bytes;
+	unsigned long low_speed_msec;
+	da_bool_t was_paused;
+	/* The request is written. Before it, the msg may wait for a connection */
+	da_bool_t is_started;
+	da_bool_t is_finished;
+	da_bool_t is_stalled;
 } pi_session_table_t;
 
-extern pi_session_table_t pi_session_table[];
+/* Entries are allocated when the limit is raised or an extra transaction
+ * needs one, and are never freed,
+ * so that a pointer to an entry is valid even after the limit is lowered. */
+extern pi_session_table_t *pi_session_table[];
+extern int pi_session_table_count;
+extern int pi_max_session_count;
 
 #define MAX_SESSION_COUNT	DA_MAX_DOWNLOAD_REQ_AT_ONCE
+#define MAX_SESSION_LIMIT	DA_MAX_DOWNLOAD_REQ_LIMIT
+/* Extra transactions of all downloads, e.g. segments. They are counted apart
+ * from the downloads, so that they do not make new downloads fail */
+#define MAX_EXTRA_SESSION_COUNT	16
+#define MAX_SESSION_TABLE_SIZE	(MAX_SESSION_LIMIT + MAX_EXTRA_SESSION_COUNT)
+/* Transaction which has no low speed limit is aborted if it receives nothing for this */
 #define MAX_TIMEOUT		180	// second
+#define WATCHDOG_INTERVAL_MSEC	1000
+/* Limits of connection pool on shared session */
+#define MAX_SESSION_CONNS(COUNT)	((COUNT) * 2 + MAX_EXTRA_SESSION_COUNT)
+#define MAX_SESSION_CONNS_PER_HOST(COUNT)	(COUNT)
 
-#define IS_VALID_SESSION_TABLE_ENTRY(ENTRY)		((((ENTRY) < 0) || ((ENTRY) > MAX_SESSION_COUNT-1)) ? 0 : 1)
+#define IS_VALID_SESSION_TABLE_ENTRY(ENTRY)		((((ENTRY) < 0) || ((ENTRY) > pi_session_table_count-1)) ? 0 : 1)
 
 
-#define GET_SESSION_FROM_TABLE_ENTRY(ENTRY)	(pi_session_table[ENTRY].session)
-#define GET_MSG_FROM_TABLE_ENTRY(ENTRY)	(pi_session_table[ENTRY].msg)
-#define GET_QUEUE_FROM_TABLE_ENTRY(ENTRY)		(pi_session_table[ENTRY].queue)
+#define GET_SESSION_FROM_TABLE_ENTRY(ENTRY)	(pi_session_table[ENTRY]->session)
+#define GET_MSG_FROM_TABLE_ENTRY(ENTRY)	(pi_session_table[ENTRY]->msg)
+#define GET_QUEUE_FROM_TABLE_ENTRY(ENTRY)		(pi_session_table[ENTRY]->queue)
 
 
+SoupSession *_pi_http_create_shared_session(void);
+SoupSession *_pi_http_get_shared_session(void);
+void _pi_http_set_proxy_on_shared_session(SoupSession *session, char *proxy_addr);
 da_bool_t _pi_http_is_valid_input_for_tranx(const input_for_tranx_t *input_for_tranx);
 
 void _pi_http_init_session_table_entry(const int in_session_table_entry);
 void _pi_http_destroy_session_table_entry(const int in_session_table_entry);
-int _pi_http_get_avaiable_session_table_entry(void);
+int _pi_http_get_avaiable_session_table_entry(da_bool_t is_extra);
 
 da_bool_t _pi_http_register_queue_to_session_table(const int session_table_entry, const queue_t *in_queue);
 da_bool_t _pi_http_register_session_to_session_table(const int in_session_table_entry, SoupSession *session);
@@ -69,13 +104,16 @@ da_bool_t _pi_http_register_msg_to_session_table(const int in_session_table_entr
 queue_t * _pi_http_get_queue_from_session_table_entry(const int in_session_table_entry);
 int _pi_http_get_session_table_entry_from_message(SoupMessage *msg);
 
-void _pi_http_store_read_data_to_queue(SoupMessage *msg,const char* body_data, int received_body_len);
+void _pi_http_store_read_data_to_queue(SoupMessage *msg,const char* body_data, int received_body_len, void *body_block);
 void _pi_http_store_read_header_to_queue(SoupMessage *msg, const char *sniffedType);
+da_bool_t _pi_http_is_transient_error(int soup_error);
 void _pi_http_store_neterr_to_queue(SoupMessage *msg);
+gboolean _pi_http_watchdog_cb(gpointer data);
 
 
 void _pi_http_finished_cb(SoupSession *session, SoupMessage* msg, gpointer data);
 void _pi_http_restarted_cb(SoupMessage* msg, gpointer data);
+void _pi_http_wroteheaders_cb(SoupMessage* msg, gpointer data);
 void _pi_http_gotheaders_cb(SoupMessage* msg, gpointer data);
 void _pi_http_contentsniffed_cb(SoupMessage* msg, const char* sniffedType, GHashTable *params, gpointer data);
 void _pi_http_gotchunk_cb(SoupMessage* msg, SoupBuffer* chunk, gpointer data);
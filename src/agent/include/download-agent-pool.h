@@ -0,0 +1,57 @@
+/*
+ * Download Agent
+ *
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Jungki Kwak <jungki.kwak@samsung.com>, Keunsoon Lee <keunsoon.lee@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file		download-agent-pool.h
+ * @brief		Including functions regarding pools of small objects
+ ***/
+
+#ifndef _Download_Agent_Pool_H
+#define _Download_Agent_Pool_H
+
+#include "download-agent-type.h"
+
+typedef enum {
+	DA_POOL_Q_EVENT,
+	DA_POOL_CLIENT_NOTI,
+	DA_POOL_HTTP_HEADER,
+	DA_POOL_TYPE_COUNT
+} da_pool_type;
+
+/* Objects kept by each thread */
+#define DA_POOL_LOCAL_MAX_COUNT	32
+/* Objects moved between a thread and the depot at once */
+#define DA_POOL_BATCH_COUNT	16
+/* Objects kept by the depot which is shared by all threads */
+#define DA_POOL_DEPOT_MAX_COUNT	512
+
+/* Objects are usually freed by another thread, e.g. the queue event is made
+ * on http loop thread and destroyed on download thread. So each thread keeps
+ * a few objects without lock, and exchanges them with the depot in batch. */
+/* The object is filled with zero like calloc() */
+void *pool_alloc(da_pool_type type);
+void pool_free(da_pool_type type, void *object);
+/* Fills the depots with the count of objects for each type. Called at da_init() */
+void pool_preallocate(void);
+/* Frees the objects in the depots, and logs the counters */
+void pool_deinit(void);
+/* Counters of the thread which is running are added when it uses the depot */
+void pool_get_stat(da_pool_type type, unsigned long *out_hit_count,
+		unsigned long *out_miss_count);
+
+#endif
@@ -0,0 +1,51 @@
+/*
+ * Download Agent
+ *
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Jungki Kwak <jungki.kwak@samsung.com>, Keunsoon Lee <keunsoon.lee@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file		download-agent-space.h
+ * @brief		Including functions regarding the reservation of storage space
+ ***/
+
+
+#ifndef _Download_Agent_Space_H
+#define _Download_Agent_Space_H
+
+#include "download-agent-type.h"
+
+/* File systems which have reserved space at the same time */
+#define DA_MAX_SPACE_LEDGER_COUNT	8
+
+typedef struct _da_space_reservation_t da_space_reservation_t;
+
+/* Bytes which downloads are going to write are kept for each file system.
+ * A download is admitted only if free space minus them is enough,
+ * so that concurrent downloads do not fail late with disk full. */
+/* DA_ERR_DISK_FULL if there is no space for the size and the margin */
+da_result_t space_reserve(const char *dir_path, unsigned long long size,
+		unsigned long long margin, da_space_reservation_t **out_reservation);
+/* Called as the data lands on the file system */
+void space_consume(da_space_reservation_t *reservation, unsigned long long len);
+/* Called when the blocks are allocated already, e.g. by fallocate */
+void space_shrink(da_space_reservation_t *reservation,
+		unsigned long long remaining);
+/* Remained bytes are returned to the file system. The reservation is freed */
+void space_release(da_space_reservation_t *reservation);
+/* Sum of the reserved bytes on the file system of the path */
+unsigned long long space_get_reserved(const char *path);
+
+#endif
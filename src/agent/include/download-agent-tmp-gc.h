@@ -0,0 +1,45 @@
+/*
+ * Download Agent
+ *
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Jungki Kwak <jungki.kwak@samsung.com>, Keunsoon Lee <keunsoon.lee@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @file		download-agent-tmp-gc.h
+ * @brief		Including functions regarding the collector of orphaned temporary files
+ ***/
+
+
+#ifndef _Download_Agent_Tmp_Gc_H
+#define _Download_Agent_Tmp_Gc_H
+
+#include "download-agent-type.h"
+
+/* Files are removed by this count, with the interval between them,
+ * not to disturb the downloads which are started meanwhile */
+#define DA_TMP_GC_BATCH_COUNT	16
+#define DA_TMP_GC_BATCH_INTERVAL_MSEC	100
+/* Install directories which are scanned for the hidden temporary files */
+#define DA_TMP_GC_MAX_INSTALL_DIR_COUNT	16
+
+/* Removes the files on the temporary directory, and the ones with
+ * DA_HIDDEN_TMP_FILE_PREFIX on the install directories, which are not in
+ * keep_paths, on a background thread. The paths are copied. Files which are
+ * modified after this call, e.g. by new downloads, are not removed. */
+da_result_t tmp_gc_start(const char **keep_paths, int keep_count);
+/* Stops the collector, and waits for it */
+void tmp_gc_stop(void);
+
+#endif
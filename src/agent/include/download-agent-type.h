@@ -39,6 +39,16 @@ typedef int	da_bool_t;
 #define DA_MAX_MIME_STR_LEN     	256
 #define DA_MAX_PROXY_ADDR_LEN	64		// e.g. 100.200.300.400:10000
 
+/* Part of http body which is passed to the file writer without copying.
+ * data is valid until release() is called with owner.
+ * If release is NULL, data is malloced one and it is freed with free(). */
+typedef struct _da_body_slice_t {
+	char *data;
+	int len;
+	void *owner;
+	void (*release)(void *owner);
+} da_body_slice_t;
+
 
 #endif
 
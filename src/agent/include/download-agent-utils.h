@@ -62,6 +62,7 @@ typedef struct _da_storage_size_t {
 } da_storage_size_t;
 
 void get_random_number(int *out_num);
+unsigned long long get_monotonic_msec(void);
 da_result_t  get_available_dd_id(da_handle_t *available_id);
 
 da_result_t  get_extension_from_mime_type(char *mime_type, char **extension);
@@ -78,6 +79,9 @@ void remove_file(const char *file_path);
 
 char* print_dl_state(da_state state);
 
+/* The slice is cleared after it is released */
+void release_body_slice(da_body_slice_t *slice);
+
 char* _stristr(const char* long_str, const char* find_str);
 
 #endif
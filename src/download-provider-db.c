@@ -46,6 +46,73 @@ int _download_provider_sql_open()
 	return __download_provider_db_open();
 }
 
+// mirror urls are saved in one column, separated by new line.
+char *__download_provider_db_join_mirrors(download_flexible_double_string *mirrors)
+{
+	int i = 0;
+	int len = 0;
+	char *joined = NULL;
+
+	if (!mirrors || mirrors->rows <= 0 || !mirrors->str)
+		return NULL;
+
+	for (i = 0; i < mirrors->rows; i++) {
+		if (mirrors->str[i].str)
+			len += strlen(mirrors->str[i].str) + 1;
+	}
+	if (len <= 0)
+		return NULL;
+	joined = (char *)calloc(len + 1, sizeof(char));
+	if (!joined)
+		return NULL;
+	for (i = 0; i < mirrors->rows; i++) {
+		if (!mirrors->str[i].str)
+			continue;
+		strcat(joined, mirrors->str[i].str);
+		strcat(joined, "\n");
+	}
+	return joined;
+}
+
+int __download_provider_db_split_mirrors(char *joined,
+					download_flexible_double_string *mirrors)
+{
+	char *line = NULL;
+	char *next = NULL;
+	int rows = 0;
+
+	if (!joined || !mirrors)
+		return -1;
+
+	for (line = joined; *line; line++) {
+		if (*line == '\n')
+			rows++;
+	}
+	if (rows <= 0)
+		return 0;
+	mirrors->str =
+		(download_flexible_string *) calloc(rows,
+						sizeof(download_flexible_string));
+	if (!mirrors->str)
+		return -1;
+	mirrors->rows = 0;
+	for (line = joined; *line && mirrors->rows < rows; line = next + 1) {
+		next = strchr(line, '\n');
+		if (!next)
+			break;
+		if (next - line > 1) {
+			mirrors->str[mirrors->rows].length = next - line;
+			mirrors->str[mirrors->rows].str =
+				(char *)calloc(next - line + 1, sizeof(char));
+			if (mirrors->str[mirrors->rows].str)
+				memcpy(mirrors->str[mirrors->rows].str, line,
+						(next - line) * sizeof(char));
+			mirrors->rows++;
+		}
+	}
+	return 0;
+}
+
 int download_provider_db_requestinfo_remove(int uniqueid)
 {
 	int errorcode;
@@ -108,7 +175,7 @@ int download_provider_db_requestinfo_new(download_clientinfo *clientinfo)
 
 	errorcode =
 	    sqlite3_prepare_v2(g_download_provider_db,
-			       "INSERT INTO downloading (uniqueid, packagename, notification, installpath, filename, creationdate, state, url, mimetype, savedpath) VALUES (?, ?, ?, ?, ?, DATETIME('now'), ?, ?, ?, ?)",
+			       "INSERT INTO downloading (uniqueid, packagename, notification, installpath, filename, creationdate, state, url, mimetype, savedpath, mirrors) VALUES (?, ?, ?, ?, ?, DATETIME('now'), ?, ?, ?, ?, ?)",
 			       -1, &stmt, NULL);
 	if (errorcode != SQLITE_OK) {
 		TRACE_DEBUG_MSG("sqlite3_prepare_v2 is failed. [%s]",
@@ -187,6 +254,19 @@ int download_provider_db_requestinfo_new(download_clientinfo *clientinfo)
 			return -1;
 		}
 	}
+	char *mirrors =
+		__download_provider_db_join_mirrors(&clientinfo->requestinfo->options.mirrors);
+	if (mirrors) {
+		if (sqlite3_bind_text
+		    (stmt, 10, mirrors, -1, SQLITE_TRANSIENT) != SQLITE_OK) {
+			TRACE_DEBUG_MSG("sqlite3_bind_text is failed. [%s]",
+					sqlite3_errmsg(g_download_provider_db));
+			free(mirrors);
+			_download_provider_sql_close(stmt);
+			return -1;
+		}
+		free(mirrors);
+	}
 	errorcode = sqlite3_step(stmt);
 	if (errorcode == SQLITE_OK || errorcode == SQLITE_DONE) {
 		_download_provider_sql_close(stmt);
@@ -263,6 +343,24 @@ int download_provider_db_requestinfo_update_column(download_clientinfo *clientin
 			return -1;
 		}
 		break;
+	case DOWNLOAD_DB_RETRYCOUNT:
+		errorcode =
+			sqlite3_prepare_v2(g_download_provider_db,
+						"UPDATE downloading SET retrycount = ? WHERE uniqueid = ?",
+						-1, &stmt, NULL);
+		if (errorcode != SQLITE_OK) {
+			TRACE_DEBUG_MSG("sqlite3_prepare_v2 is failed. [%s]",
+					sqlite3_errmsg(g_download_provider_db));
+			_download_provider_sql_close(stmt);
+			return -1;
+		}
+		if (sqlite3_bind_int(stmt, 1, clientinfo->retrycount) != SQLITE_OK) {
+			TRACE_DEBUG_MSG("sqlite3_bind_int is failed. [%s]",
+					sqlite3_errmsg(g_download_provider_db));
+			_download_provider_sql_close(stmt);
+			return -1;
+		}
+		break;
 	case DOWNLOAD_DB_STATE:
 		errorcode =
 			sqlite3_prepare_v2(g_download_provider_db,
@@ -404,7 +502,7 @@ download_dbinfo_list *download_provider_db_get_list(int state)
 	if (state != DOWNLOAD_STATE_NONE) {
 		errorcode =
 			sqlite3_prepare_v2(g_download_provider_db,
-						"SELECT uniqueid, packagename, notification, installpath, filename, creationdate, state, url, mimetype, savedpath FROM downloading WHERE state = ?",
+						"SELECT uniqueid, packagename, notification, installpath, filename, creationdate, state, url, mimetype, savedpath, retrycount, mirrors FROM downloading WHERE state = ?",
 						-1, &stmt, NULL);
 		if (errorcode != SQLITE_OK) {
 			TRACE_DEBUG_MSG("sqlite3_prepare_v2 is failed. [%s]",
@@ -421,7 +519,7 @@ download_dbinfo_list *download_provider_db_get_list(int state)
 	} else {
 		errorcode =
 			sqlite3_prepare_v2(g_download_provider_db,
-						"SELECT uniqueid, packagename, notification, installpath, filename, creationdate, state, url, mimetype, savedpath FROM downloading",
+						"SELECT uniqueid, packagename, notification, installpath, filename, creationdate, state, url, mimetype, savedpath, retrycount, mirrors FROM downloading",
 						-1, &stmt, NULL);
 		if (errorcode != SQLITE_OK) {
 			TRACE_DEBUG_MSG("sqlite3_prepare_v2 is failed. [%s]",
@@ -510,6 +608,11 @@ download_dbinfo_list *download_provider_db_get_list(int state)
 				buffer_length * sizeof(char));
 			m_list->item[i].saved_path[buffer_length] = '\0';
 		}
+		m_list->item[i].retrycount = sqlite3_column_int(stmt, 10);
+		buffer = (char *)(sqlite3_column_text(stmt, 11));
+		m_list->item[i].mirrors = NULL;
+		if (buffer)
+			m_list->item[i].mirrors = strdup(buffer);
 		i++;
 	}
 	m_list->count = i;
@@ -608,6 +711,9 @@ void download_provider_db_info_free(download_dbinfo *info)
 	if (info->saved_path)
 		free(info->saved_path);
 	info->saved_path = NULL;
+	if (info->mirrors)
+		free(info->mirrors);
+	info->mirrors = NULL;
 }
 
 void download_provider_db_list_free(download_dbinfo_list *list)
@@ -646,7 +752,7 @@ download_dbinfo *download_provider_db_get_info(int requestid)
 
 	errorcode =
 		sqlite3_prepare_v2(g_download_provider_db,
-			"SELECT uniqueid, packagename, notification, installpath, filename, creationdate, state, url, mimetype, savedpath FROM downloading WHERE uniqueid = ?",
+			"SELECT uniqueid, packagename, notification, installpath, filename, creationdate, state, url, mimetype, savedpath, retrycount, mirrors FROM downloading WHERE uniqueid = ?",
 			-1, &stmt, NULL);
 	if (errorcode != SQLITE_OK) {
 		TRACE_DEBUG_MSG("sqlite3_prepare_v2 is failed. [%s]",
@@ -736,6 +842,11 @@ download_dbinfo *download_provider_db_get_info(int requestid)
 				buffer_length * sizeof(char));
 			dbinfo->saved_path[buffer_length] = '\0';
 		}
+		dbinfo->retrycount = sqlite3_column_int(stmt, 10);
+		buffer = (char *)(sqlite3_column_text(stmt, 11));
+		dbinfo->mirrors = NULL;
+		if (buffer)
+			dbinfo->mirrors = strdup(buffer);
 	} else {
 		TRACE_DEBUG_MSG("sqlite3_step is failed. [%s] errorcode[%d]",
 				sqlite3_errmsg(g_download_provider_db), errorcode);
@@ -814,6 +925,9 @@ download_request_info *download_provider_db_get_requestinfo(download_dbinfo *dbi
 							length] = '\0';
 		}
 	}
+	if (dbinfo->mirrors)
+		__download_provider_db_split_mirrors(dbinfo->mirrors,
+						&requestinfo->options.mirrors);
 	// disable callback.
 	memset(&requestinfo->callbackinfo, 0x00, sizeof(callback_info));
 	requestinfo->notification = dbinfo->notification;
@@ -839,7 +953,7 @@ int download_provider_db_history_new(download_clientinfo *clientinfo)
 
 	errorcode =
 		sqlite3_prepare_v2(g_download_provider_db,
-					"INSERT INTO history (uniqueid, packagename, filename, creationdate, state, mimetype, savedpath) VALUES (?, ?, ?, DATETIME('now'), ?, ?, ?)",
+					"INSERT INTO history (uniqueid, packagename, filename, creationdate, state, mimetype, savedpath, url, etag, lastmodified, contentsize, filepath, digest) VALUES (?, ?, ?, DATETIME('now'), ?, ?, ?, ?, ?, ?, ?, ?, ?)",
 					-1, &stmt, NULL);
 	if (errorcode != SQLITE_OK) {
 		TRACE_DEBUG_MSG("sqlite3_prepare_v2 is failed. [%s]",
@@ -900,6 +1014,65 @@ int download_provider_db_history_new(download_clientinfo *clientinfo)
 			return -1;
 		}
 	}
+	if (clientinfo->requestinfo->url.length > 1) {
+		if (sqlite3_bind_text
+			(stmt, 7, clientinfo->requestinfo->url.str, -1,
+			NULL) != SQLITE_OK) {
+			TRACE_DEBUG_MSG("sqlite3_bind_text is failed. [%s]",
+					sqlite3_errmsg(g_download_provider_db));
+			_download_provider_sql_close(stmt);
+			return -1;
+		}
+	}
+	if (clientinfo->etag) {
+		if (sqlite3_bind_text
+			(stmt, 8, clientinfo->etag, -1, NULL) != SQLITE_OK) {
+			TRACE_DEBUG_MSG("sqlite3_bind_text is failed. [%s]",
+					sqlite3_errmsg(g_download_provider_db));
+			_download_provider_sql_close(stmt);
+			return -1;
+		}
+	}
+	if (clientinfo->last_modified) {
+		if (sqlite3_bind_text
+			(stmt, 9, clientinfo->last_modified, -1,
+			NULL) != SQLITE_OK) {
+			TRACE_DEBUG_MSG("sqlite3_bind_text is failed. [%s]",
+					sqlite3_errmsg(g_download_provider_db));
+			_download_provider_sql_close(stmt);
+			return -1;
+		}
+	}
+	if (clientinfo->downloadinfo) {
+		if (sqlite3_bind_int64
+			(stmt, 10, clientinfo->downloadinfo->file_size)
+			!= SQLITE_OK) {
+			TRACE_DEBUG_MSG("sqlite3_bind_int64 is failed. [%s]",
+					sqlite3_errmsg(g_download_provider_db));
+			_download_provider_sql_close(stmt);
+			return -1;
+		}
+	}
+	if (clientinfo->downloadinginfo
+		&& strlen(clientinfo->downloadinginfo->saved_path) > 0) {
+		if (sqlite3_bind_text
+			(stmt, 11, clientinfo->downloadinginfo->saved_path, -1,
+			NULL) != SQLITE_OK) {
+			TRACE_DEBUG_MSG("sqlite3_bind_text is failed. [%s]",
+					sqlite3_errmsg(g_download_provider_db));
+			_download_provider_sql_close(stmt);
+			return -1;
+		}
+	}
+	if (clientinfo->digest) {
+		if (sqlite3_bind_text
+			(stmt, 12, clientinfo->digest, -1, NULL) != SQLITE_OK) {
+			TRACE_DEBUG_MSG("sqlite3_bind_text is failed. [%s]",
+					sqlite3_errmsg(g_download_provider_db));
+			_download_provider_sql_close(stmt);
+			return -1;
+		}
+	}
 	errorcode = sqlite3_step(stmt);
 	if (errorcode == SQLITE_OK || errorcode == SQLITE_DONE) {
 		_download_provider_sql_close(stmt);
@@ -1094,3 +1267,90 @@ download_dbinfo *download_provider_db_history_get_info(int requestid)
 	_download_provider_sql_close(stmt);
 	return dbinfo;
 }
+
+download_validator_info *download_provider_db_history_get_validator(char *url,
+								char *packagename)
+{
+	int errorcode;
+	sqlite3_stmt *stmt = NULL;
+	char *buffer = NULL;
+	download_validator_info *info = NULL;
+
+	if (!url)
+		return NULL;
+
+	if (_download_provider_sql_open() < 0) {
+		TRACE_DEBUG_MSG("db_util_open is failed [%s]",
+				sqlite3_errmsg(g_download_provider_db));
+		return NULL;
+	}
+
+	// the latest finished one which has any validator.
+	errorcode =
+		sqlite3_prepare_v2(g_download_provider_db,
+			"SELECT etag, lastmodified, contentsize, filepath FROM history WHERE url = ? AND packagename IS ? AND state = ? AND filepath IS NOT NULL AND (etag IS NOT NULL OR lastmodified IS NOT NULL) ORDER BY id DESC LIMIT 1",
+			-1, &stmt, NULL);
+	if (errorcode != SQLITE_OK) {
+		TRACE_DEBUG_MSG("sqlite3_prepare_v2 is failed. [%s]",
+				sqlite3_errmsg(g_download_provider_db));
+		_download_provider_sql_close(stmt);
+		return NULL;
+	}
+	if (sqlite3_bind_text(stmt, 1, url, -1, NULL) != SQLITE_OK) {
+		TRACE_DEBUG_MSG("sqlite3_bind_text is failed. [%s]",
+				sqlite3_errmsg(g_download_provider_db));
+		_download_provider_sql_close(stmt);
+		return NULL;
+	}
+	// unbound parameter is NULL.
+	if (packagename) {
+		if (sqlite3_bind_text(stmt, 2, packagename, -1, NULL)
+			!= SQLITE_OK) {
+			TRACE_DEBUG_MSG("sqlite3_bind_text is failed. [%s]",
+					sqlite3_errmsg(g_download_provider_db));
+			_download_provider_sql_close(stmt);
+			return NULL;
+		}
+	}
+	if (sqlite3_bind_int(stmt, 3, DOWNLOAD_STATE_FINISHED) != SQLITE_OK) {
+		TRACE_DEBUG_MSG("sqlite3_bind_int is failed. [%s]",
+				sqlite3_errmsg(g_download_provider_db));
+		_download_provider_sql_close(stmt);
+		return NULL;
+	}
+
+	if ((errorcode = sqlite3_step(stmt)) == SQLITE_ROW) {
+		info = (download_validator_info *)
+			calloc(1, sizeof(download_validator_info));
+		if (info) {
+			buffer = (char *)(sqlite3_column_text(stmt, 0));
+			if (buffer)
+				info->etag = strdup(buffer);
+			buffer = (char *)(sqlite3_column_text(stmt, 1));
+			if (buffer)
+				info->last_modified = strdup(buffer);
+			info->content_size = sqlite3_column_int64(stmt, 2);
+			buffer = (char *)(sqlite3_column_text(stmt, 3));
+			if (buffer)
+				info->file_path = strdup(buffer);
+		}
+	} else if (errorcode != SQLITE_DONE) {
+		TRACE_DEBUG_MSG("sqlite3_step is failed. [%s] errorcode[%d]",
+				sqlite3_errmsg(g_download_provider_db), errorcode);
+	}
+	_download_provider_sql_close(stmt);
+	return info;
+}
+
+void download_provider_db_validator_free(download_validator_info *info)
+{
+	if (!info)
+		return;
+	if (info->etag)
+		free(info->etag);
+	if (info->last_modified)
+		free(info->last_modified);
+	if (info->file_path)
+		free(info->file_path);
+	free(info);
+}
@@ -23,6 +23,43 @@ int ipc_receive_header(int fd)
 	return msgheader;
 }
 
+int ipc_receive_max_downloads(int fd)
+{
+	if (fd <= 0)
+		return -1;
+
+	int max_downloads = 0;
+	if (read(fd, &max_downloads, sizeof(int)) < 0) {
+		TRACE_DEBUG_MSG("failed to read max downloads (%s)",
+				strerror(errno));
+		return -1;
+	}
+	return max_downloads;
+}
+
+int ipc_receive_rate_limit(int fd, download_rate_limit_info *ratelimitinfo)
+{
+	if (fd <= 0 || !ratelimitinfo)
+		return -1;
+
+	if (read(fd, ratelimitinfo, sizeof(download_rate_limit_info)) < 0) {
+		TRACE_DEBUG_MSG("failed to read rate limit (%s)",
+				strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+// older client does not know the states added later.
+static int __get_state_for_client(download_clientinfo *clientinfo)
+{
+	if (clientinfo->state == DOWNLOAD_STATE_RETRY_WAITING
+		&& (!clientinfo->requestinfo
+			|| clientinfo->requestinfo->options.size == 0))
+		return DOWNLOAD_STATE_PAUSED;
+	return clientinfo->state;
+}
+
 int ipc_send_stateinfo(download_clientinfo *clientinfo)
 {
 	if (!clientinfo || clientinfo->clientfd <= 0)
@@ -31,7 +68,7 @@ int ipc_send_stateinfo(download_clientinfo *clientinfo)
 	download_state_info stateinfo;
 	download_controls type = DOWNLOAD_CONTROL_GET_STATE_INFO;
 	memset(&stateinfo, 0x00, sizeof(download_state_info));
-	stateinfo.state = clientinfo->state;
+	stateinfo.state = __get_state_for_client(clientinfo);
 	stateinfo.err = clientinfo->err;
 
 	// send control
@@ -56,7 +93,7 @@ int ipc_send_request_stateinfo(download_clientinfo *clientinfo)
 	download_request_state_info requeststateinfo;
 	download_controls type = DOWNLOAD_CONTROL_GET_REQUEST_STATE_INFO;
 	memset(&requeststateinfo, 0x00, sizeof(download_request_state_info));
-	requeststateinfo.stateinfo.state = clientinfo->state;
+	requeststateinfo.stateinfo.state = __get_state_for_client(clientinfo);
 	requeststateinfo.stateinfo.err = clientinfo->err;
 	if (clientinfo->requestinfo)
 		requeststateinfo.requestid = clientinfo->requestinfo->requestid;
@@ -113,9 +150,12 @@ int ipc_send_downloadinginfo(download_clientinfo *clientinfo)
 				strerror(errno));
 		return -1;
 	}
+	// older client does not know the fields added later.
+	size_t len = sizeof(downloading_state_info);
+	if (!clientinfo->requestinfo || clientinfo->requestinfo->options.size == 0)
+		len = DP_DOWNLOADING_INFO_MSG_LEN;
 	if (send
-		(clientinfo->clientfd, clientinfo->downloadinginfo,
-		sizeof(downloading_state_info), 0) < 0) {
+		(clientinfo->clientfd, clientinfo->downloadinginfo, len, 0) < 0) {
 		TRACE_DEBUG_MSG("failed to send message header (%s)",
 				strerror(errno));
 		return -1;
@@ -136,10 +176,10 @@ int ipc_receive_request_msg(download_clientinfo *clientinfo)
 	if (!clientinfo->requestinfo)
 		return -1;
 
-	// read reqeust structure
+	// read reqeust structure. options follow it in other message.
 	if (read
 		(clientinfo->clientfd, clientinfo->requestinfo,
-		sizeof(download_request_info)) < 0) {
+		DP_REQUEST_INFO_MSG_LEN) < 0) {
 		TRACE_DEBUG_MSG("failed to read message header");
 		return -1;
 	}
@@ -322,3 +362,124 @@ int ipc_receive_request_msg(download_clientinfo *clientinfo)
 	}
 	return 0;
 }
+
+// download_request_option_info, and the strings of it.
+int ipc_receive_request_option_msg(download_clientinfo *clientinfo)
+{
+	if (!clientinfo || clientinfo->clientfd <= 0
+		|| !clientinfo->requestinfo)
+		return -1;
+
+	download_request_option_info *options =
+		&clientinfo->requestinfo->options;
+	unsigned int size = 0;
+	if (read(clientinfo->clientfd, &size, sizeof(unsigned int)) < 0) {
+		TRACE_DEBUG_MSG("failed to read option size (%s)",
+				strerror(errno));
+		return -1;
+	}
+	if (size < DP_MIN_OPTION_INFO_LEN || size > DP_MAX_OPTION_INFO_LEN) {
+		TRACE_DEBUG_MSG("invalid option size [%u]", size);
+		return -1;
+	}
+	// older client sends the fields in front only. the others are 0.
+	// the fields of newer client which are not known are skipped.
+	unsigned int known_len = size;
+	if (known_len > sizeof(download_request_option_info))
+		known_len = sizeof(download_request_option_info);
+	memset(options, 0x00, sizeof(download_request_option_info));
+	if (read(clientinfo->clientfd, (char *)options + sizeof(unsigned int),
+			known_len - sizeof(unsigned int)) < 0) {
+		TRACE_DEBUG_MSG("failed to read options (%s)", strerror(errno));
+		return -1;
+	}
+	char skipped[64];
+	unsigned int left = size - known_len;
+	while (left > 0) {
+		ssize_t len = read(clientinfo->clientfd, skipped,
+				left < sizeof(skipped) ? left : sizeof(skipped));
+		if (len <= 0) {
+			TRACE_DEBUG_MSG("failed to read options (%s)",
+					strerror(errno));
+			return -1;
+		}
+		left -= len;
+	}
+	options->size = size;
+	// pointer of client side is meaningless.
+	options->mirrors.str = NULL;
+	TRACE_DEBUG_INFO_MSG("request options size [%u]", size);
+
+	if (options->mirrors.rows) {
+		options->mirrors.str =
+			(download_flexible_string *) calloc(options->mirrors.
+						rows, sizeof(download_flexible_string));
+		if (!options->mirrors.str) {
+			options->mirrors.rows = 0;
+			return -1;
+		}
+		int i = 0;
+		for (i = 0; i < options->mirrors.rows; i++) {
+			if (read
+				(clientinfo->clientfd,
+				&options->mirrors.str[i],
+				sizeof(download_flexible_string)) < 0) {
+				TRACE_DEBUG_MSG
+					("failed to read message header mirrors(%s)",
+					strerror(errno));
+				return -1;
+			}
+			// pointer of client side is meaningless.
+			options->mirrors.str[i].str = NULL;
+			if (options->mirrors.str[i].length > 1
+				&& options->mirrors.str[i].length <
+				DP_MAX_URL_LEN) {
+				options->mirrors.str[i].str =
+					(char *)
+					calloc((options->mirrors.
+						str[i].length + 1), sizeof(char));
+				if (read
+					(clientinfo->clientfd,
+					options->mirrors.str[i].
+					str,
+					options->mirrors.str[i].
+					length * sizeof(char)) < 0) {
+					TRACE_DEBUG_MSG
+						("failed to read message header mirrors(%s)",
+						strerror(errno));
+					return -1;
+				}
+				options->mirrors.str[i].
+					str[options->mirrors.str[i].
+					length] = '\0';
+				TRACE_DEBUG_INFO_MSG("mirrors[%d][%s]", i,
+						options->mirrors.str[i].str);
+			}
+		}
+	}
+	// pointer of client side is meaningless.
+	options->digest.str = NULL;
+	if (options->digest.length > 1
+		&& options->digest.length < DP_MAX_STR_LEN) {
+		options->digest.str =
+			(char *)
+			calloc((options->digest.length + 1),
+				sizeof(char));
+		if (!options->digest.str)
+			return -1;
+		if (read
+			(clientinfo->clientfd,
+			options->digest.str,
+			options->digest.length * sizeof(char)) <
+			0) {
+			TRACE_DEBUG_MSG
+				("failed to read message header digest(%s)",
+				strerror(errno));
+			return -1;
+		}
+		options->digest.str[options->digest.length] = '\0';
+		TRACE_DEBUG_INFO_MSG("request digest [%s]",
+				options->digest.str);
+	}
+	return 0;
+}
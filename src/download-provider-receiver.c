@@ -22,6 +22,7 @@
 
 int _init_agent(void);
 void _deinit_agent(void);
+static void __collect_tmp_files(void);
 static void __downloading_info_cb(user_downloading_info_t *download_info,
 					void *user_data);
 static void __download_info_cb(user_download_info_t *download_info,
@@ -47,6 +48,67 @@ int _change_pended_download(download_clientinfo *clientinfo)
 	return 0;
 }
 
+// validators are useful only if the file is not changed after download.
+download_validator_info *_get_validator(download_clientinfo *clientinfo)
+{
+	struct stat file_state;
+	char *packagename = NULL;
+	char *file_name = NULL;
+	int is_other_destination = 0;
+	download_validator_info *validator = NULL;
+
+	if (clientinfo->requestinfo->client_packagename.length > 1)
+		packagename = clientinfo->requestinfo->client_packagename.str;
+	validator = download_provider_db_history_get_validator
+			(clientinfo->requestinfo->url.str, packagename);
+	if (!validator)
+		return NULL;
+
+	if (!validator->file_path
+		|| stat(validator->file_path, &file_state) != 0
+		|| !S_ISREG(file_state.st_mode)
+		|| (validator->content_size > 0
+			&& file_state.st_size != (off_t)validator->content_size)) {
+		TRACE_DEBUG_INFO_MSG("validated file is changed");
+		download_provider_db_validator_free(validator);
+		return NULL;
+	}
+	// the file should be on the destination which client wants now.
+	file_name = strrchr(validator->file_path, '/');
+	if (!file_name)
+		is_other_destination = 1;
+	if (file_name && clientinfo->requestinfo->install_path.length > 1) {
+		int dir_len = file_name - validator->file_path;
+		int path_len = strlen(clientinfo->requestinfo->install_path.str);
+		if (path_len > 1
+			&& clientinfo->requestinfo->install_path.str[path_len - 1] == '/')
+			path_len--;
+		if (dir_len != path_len
+			|| strncmp(validator->file_path,
+				clientinfo->requestinfo->install_path.str, dir_len))
+			is_other_destination = 1;
+	}
+	// whole name should be same. if the requested one has no extension,
+	// the agent may append one, e.g. "name" is saved as "name.mp3".
+	if (file_name && clientinfo->requestinfo->filename.length > 1) {
+		char *requested = clientinfo->requestinfo->filename.str;
+		int name_len = strlen(requested);
+		char *rest = file_name + 1 + name_len;
+		if (strncmp(file_name + 1, requested, name_len))
+			is_other_destination = 1;
+		else if (*rest != '\0'
+			&& (*rest != '.' || strchr(requested, '.')
+				|| strchr(rest + 1, '.')))
+			is_other_destination = 1;
+	}
+	if (is_other_destination) {
+		TRACE_DEBUG_INFO_MSG("validated file is not on the destination");
+		download_provider_db_validator_free(validator);
+		return NULL;
+	}
+	return validator;
+}
+
 void *_start_download(void *args)
 {
 	int da_ret = -1;
@@ -70,20 +132,112 @@ void *_start_download(void *args)
 	clientinfo->err = DOWNLOAD_ERROR_NONE;
 	CLIENT_MUTEX_UNLOCK(&(clientinfo->client_mutex));
 
+	// downloads of same package share the bandwidth limit of the package.
+	char *rate_group = "";
+	if (clientinfo->requestinfo->client_packagename.length > 1
+		&& clientinfo->requestinfo->client_packagename.str)
+		rate_group = clientinfo->requestinfo->client_packagename.str;
+	// the retries which are used before are saved in DB.
+	int retry_budget =
+		DOWNLOAD_PROVIDER_MAX_RETRY_COUNT - clientinfo->retrycount;
+	if (retry_budget < 0)
+		retry_budget = 0;
+
+	// ask the server whether the file downloaded before is modified.
+	char *validated_path = "";
+	download_validator_info *validator = _get_validator(clientinfo);
+	int validator_count = 0;
+	if (validator) {
+		validated_path = validator->file_path;
+		if (validator->etag)
+			validator_count++;
+		if (validator->last_modified)
+			validator_count++;
+		TRACE_DEBUG_INFO_MSG("revalidate [%s]", validated_path);
+	}
+
+	// stalled transfer is aborted and retried.
+	int low_speed_limit = DOWNLOAD_PROVIDER_LOW_SPEED_LIMIT;
+	int low_speed_time = DOWNLOAD_PROVIDER_LOW_SPEED_TIME;
+	if (clientinfo->requestinfo->options.low_speed_limit > 0)
+		low_speed_limit = clientinfo->requestinfo->options.low_speed_limit;
+	if (clientinfo->requestinfo->options.low_speed_time > 0)
+		low_speed_time = clientinfo->requestinfo->options.low_speed_time;
+
+	// the agent chooses the fastest one among the url and the mirrors.
+	char **mirrors = NULL;
+	int mirror_count = 0;
+	if (clientinfo->requestinfo->options.mirrors.rows > 0) {
+		int i = 0;
+		mirrors = calloc(clientinfo->requestinfo->options.mirrors.rows,
+				sizeof(char *));
+		for (i = 0; mirrors && i < clientinfo->requestinfo->options.mirrors.rows;
+			i++) {
+			if (clientinfo->requestinfo->options.mirrors.str[i].str)
+				mirrors[mirror_count++] =
+					clientinfo->requestinfo->options.mirrors.str[i].str;
+		}
+	}
+
+	int durability = DA_DURABILITY_ON_COMPLETE;
+	if (clientinfo->requestinfo->options.durability == DOWNLOAD_DURABILITY_NONE)
+		durability = DA_DURABILITY_NONE;
+	else if (clientinfo->requestinfo->options.durability ==
+			DOWNLOAD_DURABILITY_PERIODIC)
+		durability = DA_DURABILITY_PERIODIC;
+
+	int drop_cache_size = DOWNLOAD_PROVIDER_DROP_CACHE_SIZE;
+	if (clientinfo->requestinfo->options.drop_cache_size != 0)
+		drop_cache_size = clientinfo->requestinfo->options.drop_cache_size;
+
+	// "<algorithm>:<hex>". the agent hashes the content while writing it.
+	char digest_algorithm[DP_MAX_STR_LEN] = { 0, };
+	char *digest_expected = "";
+	if (clientinfo->requestinfo->options.digest.str) {
+		snprintf(digest_algorithm, sizeof(digest_algorithm), "%s",
+			clientinfo->requestinfo->options.digest.str);
+		digest_expected = strchr(digest_algorithm, ':');
+		if (digest_expected)
+			*digest_expected++ = '\0';
+		else
+			digest_expected = "";
+	}
+
 	// call start_download() of download-agent
-	if (clientinfo->requestinfo->headers.rows > 0) {
+	if (clientinfo->requestinfo->headers.rows + validator_count > 0) {
 		int len = 0;
 		int i = 0;
 		char **req_header = NULL;
-		len = clientinfo->requestinfo->headers.rows;
+		len = clientinfo->requestinfo->headers.rows + validator_count;
 		req_header = calloc(len, sizeof(char *));
 		if (!req_header) {
 			TRACE_DEBUG_MSG("fail to calloc");
+			download_provider_db_validator_free(validator);
+			if (mirrors)
+				free(mirrors);
 			return 0;
 		}
-		for (i = 0; i < len; i++)
+		for (i = 0; i < clientinfo->requestinfo->headers.rows; i++)
 			req_header[i] =
 				strdup(clientinfo->requestinfo->headers.str[i].str);
+		if (validator && validator->etag) {
+			int header_len = strlen("If-None-Match: ")
+				+ strlen(validator->etag) + 1;
+			req_header[i] = calloc(header_len, sizeof(char));
+			if (req_header[i])
+				snprintf(req_header[i], header_len,
+					"If-None-Match: %s", validator->etag);
+			i++;
+		}
+		if (validator && validator->last_modified) {
+			int header_len = strlen("If-Modified-Since: ")
+				+ strlen(validator->last_modified) + 1;
+			req_header[i] = calloc(header_len, sizeof(char));
+			if (req_header[i])
+				snprintf(req_header[i], header_len,
+					"If-Modified-Since: %s",
+					validator->last_modified);
+		}
 		if (clientinfo->requestinfo->install_path.length > 1) {
 			if (clientinfo->requestinfo->filename.length > 1)
 				da_ret =
@@ -91,10 +245,26 @@ void *_start_download(void *args)
 							url.str, &req_dl_id,
 							DA_FEATURE_REQUEST_HEADER,
 							req_header, &len,
+							DA_FEATURE_VALIDATED_PATH,
+							validated_path,
 							DA_FEATURE_INSTALL_PATH,
 							clientinfo->requestinfo->install_path.str,
 							DA_FEATURE_FILE_NAME,
 							clientinfo->requestinfo->filename.str,
+							DA_FEATURE_RATE_GROUP,
+							rate_group,
+							DA_FEATURE_RETRY_BUDGET,
+							&retry_budget,
+							DA_FEATURE_MIRROR_URL,
+							mirrors, &mirror_count,
+							DA_FEATURE_DIGEST,
+							digest_algorithm, digest_expected,
+							DA_FEATURE_DURABILITY,
+							&durability,
+							DA_FEATURE_DROP_CACHE,
+							&drop_cache_size,
+							DA_FEATURE_LOW_SPEED,
+							&low_speed_limit, &low_speed_time,
 							DA_FEATURE_USER_DATA,
 							(void *)clientinfoslot,
 							NULL);
@@ -104,8 +274,24 @@ void *_start_download(void *args)
 							url.str, &req_dl_id,
 							DA_FEATURE_REQUEST_HEADER,
 							req_header, &len,
+							DA_FEATURE_VALIDATED_PATH,
+							validated_path,
 							DA_FEATURE_INSTALL_PATH,
 							clientinfo->requestinfo->install_path.str,
+							DA_FEATURE_RATE_GROUP,
+							rate_group,
+							DA_FEATURE_RETRY_BUDGET,
+							&retry_budget,
+							DA_FEATURE_MIRROR_URL,
+							mirrors, &mirror_count,
+							DA_FEATURE_DIGEST,
+							digest_algorithm, digest_expected,
+							DA_FEATURE_DURABILITY,
+							&durability,
+							DA_FEATURE_DROP_CACHE,
+							&drop_cache_size,
+							DA_FEATURE_LOW_SPEED,
+							&low_speed_limit, &low_speed_time,
 							DA_FEATURE_USER_DATA,
 							(void *)clientinfoslot,
 							NULL);
@@ -116,8 +302,24 @@ void *_start_download(void *args)
 							url.str, &req_dl_id,
 							DA_FEATURE_REQUEST_HEADER,
 							req_header, &len,
+							DA_FEATURE_VALIDATED_PATH,
+							validated_path,
 							DA_FEATURE_FILE_NAME,
 							clientinfo->requestinfo->filename.str,
+							DA_FEATURE_RATE_GROUP,
+							rate_group,
+							DA_FEATURE_RETRY_BUDGET,
+							&retry_budget,
+							DA_FEATURE_MIRROR_URL,
+							mirrors, &mirror_count,
+							DA_FEATURE_DIGEST,
+							digest_algorithm, digest_expected,
+							DA_FEATURE_DURABILITY,
+							&durability,
+							DA_FEATURE_DROP_CACHE,
+							&drop_cache_size,
+							DA_FEATURE_LOW_SPEED,
+							&low_speed_limit, &low_speed_time,
 							DA_FEATURE_USER_DATA,
 							(void *)clientinfoslot,
 							NULL);
@@ -127,6 +329,22 @@ void *_start_download(void *args)
 							url.str, &req_dl_id,
 							DA_FEATURE_REQUEST_HEADER,
 							req_header, &len,
+							DA_FEATURE_VALIDATED_PATH,
+							validated_path,
+							DA_FEATURE_RATE_GROUP,
+							rate_group,
+							DA_FEATURE_RETRY_BUDGET,
+							&retry_budget,
+							DA_FEATURE_MIRROR_URL,
+							mirrors, &mirror_count,
+							DA_FEATURE_DIGEST,
+							digest_algorithm, digest_expected,
+							DA_FEATURE_DURABILITY,
+							&durability,
+							DA_FEATURE_DROP_CACHE,
+							&drop_cache_size,
+							DA_FEATURE_LOW_SPEED,
+							&low_speed_limit, &low_speed_time,
 							DA_FEATURE_USER_DATA,
 							(void *)clientinfoslot,
 							NULL);
@@ -135,6 +353,7 @@ void *_start_download(void *args)
 			if (req_header[i])
 				free(req_header[i]);
 		}
+		free(req_header);
 	} else {
 		if (clientinfo->requestinfo->install_path.length > 1) {
 			if (clientinfo->requestinfo->filename.length > 1)
@@ -145,6 +364,20 @@ void *_start_download(void *args)
 							clientinfo->requestinfo->install_path.str,
 							DA_FEATURE_FILE_NAME,
 							clientinfo->requestinfo->filename.str,
+							DA_FEATURE_RATE_GROUP,
+							rate_group,
+							DA_FEATURE_RETRY_BUDGET,
+							&retry_budget,
+							DA_FEATURE_MIRROR_URL,
+							mirrors, &mirror_count,
+							DA_FEATURE_DIGEST,
+							digest_algorithm, digest_expected,
+							DA_FEATURE_DURABILITY,
+							&durability,
+							DA_FEATURE_DROP_CACHE,
+							&drop_cache_size,
+							DA_FEATURE_LOW_SPEED,
+							&low_speed_limit, &low_speed_time,
 							DA_FEATURE_USER_DATA,
 							(void *)clientinfoslot,
 							NULL);
@@ -154,6 +387,20 @@ void *_start_download(void *args)
 							url.str, &req_dl_id,
 							DA_FEATURE_INSTALL_PATH,
 							clientinfo->requestinfo->install_path.str,
+							DA_FEATURE_RATE_GROUP,
+							rate_group,
+							DA_FEATURE_RETRY_BUDGET,
+							&retry_budget,
+							DA_FEATURE_MIRROR_URL,
+							mirrors, &mirror_count,
+							DA_FEATURE_DIGEST,
+							digest_algorithm, digest_expected,
+							DA_FEATURE_DURABILITY,
+							&durability,
+							DA_FEATURE_DROP_CACHE,
+							&drop_cache_size,
+							DA_FEATURE_LOW_SPEED,
+							&low_speed_limit, &low_speed_time,
 							DA_FEATURE_USER_DATA,
 							(void *)clientinfoslot,
 							NULL);
@@ -164,6 +411,20 @@ void *_start_download(void *args)
 							url.str, &req_dl_id,
 							DA_FEATURE_FILE_NAME,
 							clientinfo->requestinfo->filename.str,
+							DA_FEATURE_RATE_GROUP,
+							rate_group,
+							DA_FEATURE_RETRY_BUDGET,
+							&retry_budget,
+							DA_FEATURE_MIRROR_URL,
+							mirrors, &mirror_count,
+							DA_FEATURE_DIGEST,
+							digest_algorithm, digest_expected,
+							DA_FEATURE_DURABILITY,
+							&durability,
+							DA_FEATURE_DROP_CACHE,
+							&drop_cache_size,
+							DA_FEATURE_LOW_SPEED,
+							&low_speed_limit, &low_speed_time,
 							DA_FEATURE_USER_DATA,
 							(void *)clientinfoslot,
 							NULL);
@@ -171,12 +432,30 @@ void *_start_download(void *args)
 				da_ret =
 					da_start_download_with_extension(clientinfo->requestinfo->
 							url.str, &req_dl_id,
+							DA_FEATURE_RATE_GROUP,
+							rate_group,
+							DA_FEATURE_RETRY_BUDGET,
+							&retry_budget,
+							DA_FEATURE_MIRROR_URL,
+							mirrors, &mirror_count,
+							DA_FEATURE_DIGEST,
+							digest_algorithm, digest_expected,
+							DA_FEATURE_DURABILITY,
+							&durability,
+							DA_FEATURE_DROP_CACHE,
+							&drop_cache_size,
+							DA_FEATURE_LOW_SPEED,
+							&low_speed_limit, &low_speed_time,
 							DA_FEATURE_USER_DATA,
 							(void *)clientinfoslot,
 							NULL);
 		}
 	}
 
+	download_provider_db_validator_free(validator);
+	if (mirrors)
+		free(mirrors);
+
 	// if start_download() return error cause of maximun download limitation,
 	// set state to DOWNLOAD_STATE_PENDED.
 	if (da_ret == DA_ERR_ALREADY_MAX_DOWNLOAD) {
@@ -274,6 +553,80 @@ int _handle_new_connection(download_clientinfo_slot *clientinfo_list, download_c
 		clear_clientinfo(request_clientinfo);
 		return -1;
 	}
+	if (type == DOWNLOAD_CONTROL_START_WITH_OPTIONS) {
+		if (ipc_receive_request_option_msg(request_clientinfo) < 0) {
+			TRACE_DEBUG_MSG("Ignore this connection, Invalid options");
+			clear_clientinfo(request_clientinfo);
+			return -1;
+		}
+		type = DOWNLOAD_CONTROL_START;
+	}
+
+	if (type == DOWNLOAD_CONTROL_SET_MAX_DOWNLOADS) {
+		// the count follows requestinfo. requestid is not needed.
+		int max_downloads =
+			ipc_receive_max_downloads(request_clientinfo->clientfd);
+		TRACE_DEBUG_INFO_MSG
+			("Request : DOWNLOAD_CONTROL_SET_MAX_DOWNLOADS [%d]",
+			max_downloads);
+		if (da_set_max_download_count(max_downloads) == DA_RESULT_OK) {
+			request_clientinfo->state = DOWNLOAD_STATE_NONE;
+			request_clientinfo->err = DOWNLOAD_ERROR_NONE;
+		} else {
+			request_clientinfo->state = DOWNLOAD_STATE_FAILED;
+			request_clientinfo->err = DOWNLOAD_ERROR_INVALID_PARAMETER;
+		}
+		ipc_send_stateinfo(request_clientinfo);
+		ipc_receive_header(request_clientinfo->clientfd);
+		clear_clientinfo(request_clientinfo);
+		// if it is raised, pended jobs are started on next timeout.
+		return 0;
+	}
+
+	if (type == DOWNLOAD_CONTROL_SET_RATE_LIMIT) {
+		// the limit follows requestinfo.
+		download_rate_limit_info ratelimitinfo;
+		int da_ret = DA_ERR_INVALID_ARGUMENT;
+		memset(&ratelimitinfo, 0x00, sizeof(download_rate_limit_info));
+		if (ipc_receive_rate_limit(request_clientinfo->clientfd,
+				&ratelimitinfo) == 0) {
+			TRACE_DEBUG_INFO_MSG
+				("Request : DOWNLOAD_CONTROL_SET_RATE_LIMIT [%d][%u]",
+				ratelimitinfo.scope, ratelimitinfo.bytes_per_sec);
+			if (ratelimitinfo.scope == DOWNLOAD_RATE_LIMIT_GLOBAL) {
+				da_ret = da_set_global_rate_limit
+						(ratelimitinfo.bytes_per_sec);
+			} else if (ratelimitinfo.scope == DOWNLOAD_RATE_LIMIT_REQUEST
+				&& request_clientinfo->requestinfo
+				&& request_clientinfo->requestinfo->requestid > 0) {
+				int searchindex = get_same_request_slot_index
+						(clientinfo_list,
+						request_clientinfo->requestinfo->requestid);
+				if (searchindex >= 0)
+					da_ret = da_set_download_rate_limit
+						(clientinfo_list[searchindex].clientinfo->req_id,
+						ratelimitinfo.bytes_per_sec);
+			} else if (ratelimitinfo.scope == DOWNLOAD_RATE_LIMIT_PACKAGE
+				&& request_clientinfo->requestinfo
+				&& request_clientinfo->requestinfo->client_packagename.length > 1
+				&& request_clientinfo->requestinfo->client_packagename.str) {
+				da_ret = da_set_group_rate_limit
+						(request_clientinfo->requestinfo->client_packagename.str,
+						ratelimitinfo.bytes_per_sec);
+			}
+		}
+		if (da_ret == DA_RESULT_OK) {
+			request_clientinfo->state = DOWNLOAD_STATE_NONE;
+			request_clientinfo->err = DOWNLOAD_ERROR_NONE;
+		} else {
+			request_clientinfo->state = DOWNLOAD_STATE_FAILED;
+			request_clientinfo->err = DOWNLOAD_ERROR_INVALID_PARAMETER;
+		}
+		ipc_send_stateinfo(request_clientinfo);
+		ipc_receive_header(request_clientinfo->clientfd);
+		clear_clientinfo(request_clientinfo);
+		return 0;
+	}
 
 	if (type == DOWNLOAD_CONTROL_STOP
 		|| type == DOWNLOAD_CONTROL_GET_STATE_INFO
@@ -431,10 +784,10 @@ int _handle_new_connection(download_clientinfo_slot *clientinfo_list, download_c
 
 			if (clientinfo_list[searchindex].clientinfo->state
 				== DOWNLOAD_STATE_READY
-				|| clientinfo_list[searchindex].clientinfo->state
-				>= DOWNLOAD_STATE_FINISHED) {
+				|| IS_FINISHED_STATE(
+					clientinfo_list[searchindex].clientinfo->state)) {
 				active_count = get_downloading_count(clientinfo_list);
-				if (active_count >= DA_MAX_DOWNLOAD_REQ_AT_ONCE) {
+				if (active_count >= da_get_max_download_count()) {
 					// deal as pended job.
 					_change_pended_download(clientinfo_list[searchindex].clientinfo);
 					TRACE_DEBUG_INFO_MSG ("Pended Request is saved to [%d/%d]",
@@ -476,9 +829,9 @@ int _handle_new_connection(download_clientinfo_slot *clientinfo_list, download_c
 											searchslot,
 											MAX_CLIENT,
 											active_count,
-											DA_MAX_DOWNLOAD_REQ_AT_ONCE);
+											da_get_max_download_count());
 
-	if (active_count >= DA_MAX_DOWNLOAD_REQ_AT_ONCE) {
+	if (active_count >= da_get_max_download_count()) {
 		// deal as pended job.
 		_change_pended_download(clientinfo_list[searchslot].clientinfo);
 		TRACE_DEBUG_INFO_MSG ("Pended Request is saved to [%d/%d]",
@@ -486,7 +839,7 @@ int _handle_new_connection(download_clientinfo_slot *clientinfo_list, download_c
 	} else {
 		// Pending First
 		unsigned free_slot_count
-			= DA_MAX_DOWNLOAD_REQ_AT_ONCE - active_count;
+			= da_get_max_download_count() - active_count;
 		int pendedslot = get_pended_slot_index(clientinfo_list);
 		if(pendedslot >= 0) {
 			TRACE_DEBUG_INFO_MSG ("Free Space [%d]", free_slot_count);
@@ -521,7 +874,7 @@ int _handle_client_request(download_clientinfo* clientinfo)
 
 	switch (msgType = ipc_receive_header(clientinfo->clientfd)) {
 	case DOWNLOAD_CONTROL_STOP:
-		if (clientinfo->state >= DOWNLOAD_STATE_FINISHED) {
+		if (IS_FINISHED_STATE(clientinfo->state)) {
 			// clear slot requested by client after finished download
 			TRACE_DEBUG_INFO_MSG("request Free slot to main thread");
 			clear_socket(clientinfo);
@@ -707,7 +1060,7 @@ void *run_manage_download_server(void *args)
 			if (!clientinfo_list[i].clientinfo)
 				continue;
 			// clear slot.
-			if (clientinfo_list[i].clientinfo->state >= DOWNLOAD_STATE_FINISHED) {
+			if (IS_FINISHED_STATE(clientinfo_list[i].clientinfo->state)) {
 				if (clientinfo_list[i].clientinfo->clientfd <= 0)
 					clear_clientinfoslot(&clientinfo_list[i]);
 				continue;
@@ -802,11 +1155,11 @@ void *run_manage_download_server(void *args)
 			// the number of downloading threads, replace below rough codes.
 			active_count = get_downloading_count(clientinfo_list);
 			// check whether the number of downloading is already maximum.
-			if (active_count >= DA_MAX_DOWNLOAD_REQ_AT_ONCE)
+			if (active_count >= da_get_max_download_count())
 				continue;
 
 			unsigned free_slot_count
-					= DA_MAX_DOWNLOAD_REQ_AT_ONCE - active_count;
+					= da_get_max_download_count() - active_count;
 			int pendedslot = get_pended_slot_index(clientinfo_list);
 			if(pendedslot >= 0) {
 				TRACE_DEBUG_INFO_MSG ("Free Space [%d]", free_slot_count);
@@ -839,7 +1192,7 @@ void *run_manage_download_server(void *args)
 				}
 				for (i = 0;
 					active_count <
-					DA_MAX_DOWNLOAD_REQ_AT_ONCE
+					da_get_max_download_count()
 					&& i < db_list->count; i++) {
 					if (db_list->item[i].requestid <= 0)
 						continue;
@@ -877,6 +1230,8 @@ void *run_manage_download_server(void *args)
 
 						CLIENT_MUTEX_INIT(&(request_clientinfo->client_mutex), NULL);
 						request_clientinfo->state = DOWNLOAD_STATE_READY;
+						request_clientinfo->retrycount =
+							db_list->item[i].retrycount;
 						clientinfo_list[searchslot].clientinfo =
 							request_clientinfo;
 
@@ -884,7 +1239,7 @@ void *run_manage_download_server(void *args)
 							("Retry download [%d/%d][%d/%d]",
 							searchslot, MAX_CLIENT,
 							active_count,
-							DA_MAX_DOWNLOAD_REQ_AT_ONCE);
+							da_get_max_download_count());
 						if (_create_download_thread(&clientinfo_list[searchslot]) > 0)
 							active_count++;
 					}
@@ -1001,6 +1356,17 @@ void __download_info_cb(user_download_info_t *download_info, void *user_data)
 		}
 	}
 
+	if (download_info->etag) {
+		if (clientinfo->etag)
+			free(clientinfo->etag);
+		clientinfo->etag = strdup(download_info->etag);
+	}
+	if (download_info->last_modified) {
+		if (clientinfo->last_modified)
+			free(clientinfo->last_modified);
+		clientinfo->last_modified = strdup(download_info->last_modified);
+	}
+
 	if (clientinfo->requestinfo->callbackinfo.started)
 		ipc_send_downloadinfo(clientinfo);
 
@@ -1034,9 +1400,16 @@ void __downloading_info_cb(user_downloading_info_t *download_info,
 	if (!clientinfo->downloadinginfo)
 		clientinfo->downloadinginfo = (downloading_state_info *) calloc(1,
 									sizeof(downloading_state_info));
-	if (clientinfo->downloadinginfo)
+	if (clientinfo->downloadinginfo) {
 		clientinfo->downloadinginfo->received_size =
 			download_info->total_received_size;
+		if (clientinfo->downloadinginfo->stall_count !=
+			download_info->stall_count)
+			TRACE_DEBUG_INFO_MSG("stall count [%d]",
+				download_info->stall_count);
+		clientinfo->downloadinginfo->stall_count =
+			download_info->stall_count;
+	}
 	if (download_info->saved_path) {
 		TRACE_DEBUG_INFO_MSG("tmp path[%s]", download_info->saved_path);
 		len = strlen(download_info->saved_path);
@@ -1051,16 +1424,30 @@ void __downloading_info_cb(user_downloading_info_t *download_info,
 				clientinfo->credentials.gid) < 0)
 			TRACE_DEBUG_INFO_MSG("Fail to chown [%s]", strerror(errno));
 	}
+	if (download_info->digest) {
+		TRACE_DEBUG_INFO_MSG("digest[%s]", download_info->digest);
+		if (clientinfo->digest)
+			free(clientinfo->digest);
+		clientinfo->digest = strdup(download_info->digest);
+		if (clientinfo->downloadinginfo)
+			snprintf(clientinfo->downloadinginfo->digest,
+				sizeof(clientinfo->downloadinginfo->digest), "%s",
+				download_info->digest);
+	}
 
 	static size_t updated_second;
 	time_t tt = time(NULL);
 	struct tm *localTime = localtime(&tt);
 
-	if (updated_second != localTime->tm_sec || download_info->saved_path) {	// every 1 second.
+	if (updated_second != localTime->tm_sec || download_info->saved_path
+		|| download_info->digest) {	// every 1 second.
 		if (clientinfo->requestinfo
 			&& clientinfo->requestinfo->notification)
 			set_downloadinginfo_appfw_notification(clientinfo);
-		if (clientinfo->requestinfo->callbackinfo.progress)
+		// the client which requested the digest gets it without progress.
+		if (clientinfo->requestinfo->callbackinfo.progress
+			|| (download_info->digest
+				&& clientinfo->requestinfo->options.digest.str))
 			ipc_send_downloadinginfo(clientinfo);
 		updated_second = localTime->tm_sec;
 	}
@@ -1095,6 +1482,12 @@ void __notify_cb(user_notify_info_t *notify_info, void *user_data)
 
 	clientinfo->state = __change_state(notify_info->state);
 	clientinfo->err = __change_error(notify_info->err);
+	// agent waits with error when it will retry by itself.
+	if (notify_info->state == DA_STATE_RETRY_WAITING) {
+		clientinfo->retrycount++;
+		download_provider_db_requestinfo_update_column(clientinfo,
+			DOWNLOAD_DB_RETRYCOUNT);
+	}
 	if (clientinfo->state == DOWNLOAD_STATE_FINISHED ||
 			clientinfo->state == DOWNLOAD_STATE_FAILED) {
 		if (clientinfo->requestinfo) {
@@ -1145,6 +1538,10 @@ int __change_state(da_state state)
 	case DA_STATE_SUSPENDED_ALL:
 		TRACE_DEBUG_INFO_MSG("DA_STATE_SUSPENDED_ALL");
 		break;
+	case DA_STATE_RETRY_WAITING:
+		TRACE_DEBUG_INFO_MSG("DA_STATE_RETRY_WAITING");
+		ret = DOWNLOAD_STATE_RETRY_WAITING;
+		break;
 	case DA_STATE_RESUMED:
 		TRACE_DEBUG_INFO_MSG("DA_STATE_RESUMED");
 		ret = DOWNLOAD_STATE_DOWNLOADING;
@@ -1206,6 +1603,9 @@ int __change_error(int err)
 	case DA_ERR_FAIL_TO_INSTALL_FILE:
 		ret = DOWNLOAD_ERROR_INSTALL_FAIL;
 		break;
+	case DA_ERR_MISMATCH_DIGEST:
+		ret = DOWNLOAD_ERROR_DIGEST_MISMATCH;
+		break;
 	case DA_ERR_FAIL_TO_CREATE_THREAD:
 	case DA_ERR_FAIL_TO_OBTAIN_MUTEX:
 	case DA_ERR_FAIL_TO_ACCESS_FILE:
@@ -1230,9 +1630,50 @@ int _init_agent()
 	if (da_ret != DA_RESULT_OK) {
 		return DOWNLOAD_ERROR_FAIL_INIT_AGENT;
 	}
+	__collect_tmp_files();
 	return DOWNLOAD_ERROR_NONE;
 }
 
+// temporary files which are not in downloading table are removed on background.
+void __collect_tmp_files()
+{
+	download_dbinfo_list *db_list = NULL;
+	const char **keep_paths = NULL;
+	int keep_count = 0;
+	int count = 0;
+	int i = 0;
+
+	count = download_provider_db_list_count(DOWNLOAD_STATE_NONE);
+	if (count < 0) {
+		// resumable files should not be removed by the failure of db.
+		TRACE_DEBUG_MSG("fail to get the count of downloading");
+		return;
+	}
+	if (count > 0) {
+		db_list = download_provider_db_get_list(DOWNLOAD_STATE_NONE);
+		if (!db_list) {
+			TRACE_DEBUG_MSG("fail to get the list of downloading");
+			return;
+		}
+		keep_paths = calloc(db_list->count, sizeof(char *));
+		if (!keep_paths) {
+			download_provider_db_list_free(db_list);
+			return;
+		}
+		for (i = 0; i < db_list->count; i++) {
+			if (db_list->item[i].saved_path)
+				keep_paths[keep_count++] = db_list->item[i].saved_path;
+		}
+	}
+	TRACE_DEBUG_INFO_MSG("keep [%d] temporary files", keep_count);
+	if (da_collect_tmp_files(keep_paths, keep_count) != DA_RESULT_OK)
+		TRACE_DEBUG_MSG("fail to collect temporary files");
+	if (keep_paths)
+		free(keep_paths);
+	if (db_list)
+		download_provider_db_list_free(db_list);
+}
+
 void _deinit_agent()
 {
 	da_deinit();
@@ -43,7 +43,6 @@ void clear_socket(download_clientinfo *clientinfo)
 		FD_CLR(clientinfo->clientfd, &g_download_provider_socket_readset);
 		FD_CLR(clientinfo->clientfd, &g_download_provider_socket_exceptset);
 		shutdown(clientinfo->clientfd, 0);
-		fdatasync(clientinfo->clientfd);
 		close(clientinfo->clientfd);
 		clientinfo->clientfd = 0;
 	}
@@ -90,6 +89,22 @@ void clear_clientinfo(download_clientinfo *clientinfo)
 			free(clientinfo->requestinfo->headers.str);
 			clientinfo->requestinfo->headers.str = NULL;
 		}
+		if (clientinfo->requestinfo->options.mirrors.rows) {
+			int i = 0;
+			for (i = 0; i < clientinfo->requestinfo->options.mirrors.rows;
+				i++) {
+				if (clientinfo->requestinfo->options.mirrors.str[i].str)
+					free(clientinfo->requestinfo->options.mirrors.
+						str[i].str);
+				clientinfo->requestinfo->options.mirrors.str[i].str =
+					NULL;
+			}
+			free(clientinfo->requestinfo->options.mirrors.str);
+			clientinfo->requestinfo->options.mirrors.str = NULL;
+		}
+		if (clientinfo->requestinfo->options.digest.str)
+			free(clientinfo->requestinfo->options.digest.str);
+		clientinfo->requestinfo->options.digest.str = NULL;
 		free(clientinfo->requestinfo);
 		clientinfo->requestinfo = NULL;
 	}
@@ -102,6 +117,15 @@ void clear_clientinfo(download_clientinfo *clientinfo)
 	if (clientinfo->tmp_saved_path)
 		free(clientinfo->tmp_saved_path);
 	clientinfo->tmp_saved_path = NULL;
+	if (clientinfo->etag)
+		free(clientinfo->etag);
+	clientinfo->etag = NULL;
+	if (clientinfo->digest)
+		free(clientinfo->digest);
+	clientinfo->digest = NULL;
+	if (clientinfo->last_modified)
+		free(clientinfo->last_modified);
+	clientinfo->last_modified = NULL;
 	if (clientinfo->ui_notification_handle || clientinfo->service_handle)
 		destroy_appfw_notification(clientinfo);
 	CLIENT_MUTEX_UNLOCK(&(clientinfo->client_mutex));
@@ -133,7 +157,10 @@ int get_downloading_count(download_clientinfo_slot *clientinfo_list)
 				|| clientinfo_list[i].clientinfo->state ==
 				DOWNLOAD_STATE_INSTALLING
 				|| clientinfo_list[i].clientinfo->state ==
-				DOWNLOAD_STATE_READY)
+				DOWNLOAD_STATE_READY
+				// the agent keeps it to retry after a while.
+				|| clientinfo_list[i].clientinfo->state ==
+				DOWNLOAD_STATE_RETRY_WAITING)
 				count++;
 		}
 	}